@@ -81,6 +81,20 @@ class t_cpp_generator : public t_oop_generator {
     gen_templates_only_ =
       (iter != parsed_options.end() && iter->second == "only");
 
+    iter = parsed_options.find("views");
+    gen_views_ = (iter != parsed_options.end());
+    in_view_ = false;
+    in_plain_struct_ = false;
+
+    iter = parsed_options.find("arena");
+    gen_arena_ = (iter != parsed_options.end());
+
+    iter = parsed_options.find("projection");
+    gen_projection_ = (iter != parsed_options.end());
+
+    iter = parsed_options.find("tables");
+    gen_tables_ = (iter != parsed_options.end());
+
     out_dir_base_ = "gen-cpp";
   }
 
@@ -107,6 +121,7 @@ class t_cpp_generator : public t_oop_generator {
     generate_cpp_struct(txception, true);
   }
   void generate_cpp_struct(t_struct* tstruct, bool is_exception);
+  void generate_struct_view(t_struct* tstruct);
 
   void generate_service(t_service* tservice);
 
@@ -119,14 +134,17 @@ class t_cpp_generator : public t_oop_generator {
                                       bool read=true,
                                       bool write=true,
                                       bool swap=false);
+  void generate_struct_view_declaration (std::ofstream& out, t_struct* tstruct);
   void generate_struct_definition   (std::ofstream& out, std::ofstream& force_cpp_out, t_struct* tstruct, bool setters=true);
   void generate_copy_constructor     (std::ofstream& out, t_struct* tstruct);
   void generate_assignment_operator  (std::ofstream& out, t_struct* tstruct);
   void generate_struct_fingerprint   (std::ofstream& out, t_struct* tstruct, bool is_definition);
-  void generate_struct_reader        (std::ofstream& out, t_struct* tstruct, bool pointers=false);
-  void generate_struct_writer        (std::ofstream& out, t_struct* tstruct, bool pointers=false);
-  void generate_struct_result_writer (std::ofstream& out, t_struct* tstruct, bool pointers=false);
+  void generate_struct_reader        (std::ofstream& out, t_struct* tstruct, bool pointers=false, bool masked=false);
+  void generate_struct_mask_builder  (std::ofstream& out, t_struct* tstruct);
+  void generate_struct_writer        (std::ofstream& out, t_struct* tstruct, bool pointers=false, bool size=false);
+  void generate_struct_result_writer (std::ofstream& out, t_struct* tstruct, bool pointers=false, bool size=false);
   void generate_struct_swap          (std::ofstream& out, t_struct* tstruct);
+  void generate_lazy_decoders        (std::ofstream& out, t_struct* tstruct);
 
   /**
    * Service-level generation functions
@@ -180,28 +198,34 @@ class t_cpp_generator : public t_oop_generator {
   void generate_serialize_field          (std::ofstream& out,
                                           t_field*    tfield,
                                           std::string prefix="",
-                                          std::string suffix="");
+                                          std::string suffix="",
+                                          bool size=false);
 
   void generate_serialize_struct         (std::ofstream& out,
                                           t_struct*   tstruct,
                                           std::string prefix="",
-                                          bool pointer=false);
+                                          bool pointer=false,
+                                          bool size=false);
 
   void generate_serialize_container      (std::ofstream& out,
                                           t_type*     ttype,
-                                          std::string prefix="");
+                                          std::string prefix="",
+                                          bool size=false);
 
   void generate_serialize_map_element    (std::ofstream& out,
                                           t_map*      tmap,
-                                          std::string iter);
+                                          std::string iter,
+                                          bool size=false);
 
   void generate_serialize_set_element    (std::ofstream& out,
                                           t_set*      tmap,
-                                          std::string iter);
+                                          std::string iter,
+                                          bool size=false);
 
   void generate_serialize_list_element   (std::ofstream& out,
                                           t_list*     tlist,
-                                          std::string iter);
+                                          std::string iter,
+                                          bool size=false);
 
   void generate_function_call            (ostream& out,
                                           t_function* tfunction,
@@ -222,6 +246,8 @@ class t_cpp_generator : public t_oop_generator {
   std::string cob_function_signature(t_function* tfunction, std::string prefix="", bool name_params=true);
   std::string argument_list(t_struct* tstruct, bool name_params=true, bool start_comma=false);
   std::string type_to_enum(t_type* ttype);
+  std::string list_array_type(t_type* ttype);
+  std::string arena_allocator(std::string value_type);
   std::string local_reflection_name(const char*, t_type* ttype, bool external=false);
 
   void generate_enum_constant_list(std::ofstream& f,
@@ -234,10 +260,41 @@ class t_cpp_generator : public t_oop_generator {
   void generate_local_reflection(std::ofstream& out, t_type* ttype, bool is_definition);
   void generate_local_reflection_pointer(std::ofstream& out, t_type* ttype);
 
+  // Tables for TTableCodec, with the tables option
+  bool has_table(t_struct* tstruct);
+  bool type_has_table(t_type* ttype);
+  void generate_struct_table(std::ofstream& out, t_struct* tstruct);
+  std::string generate_value_table(std::ofstream& out, t_type* ttype);
+  std::string generate_container_table(std::ofstream& out, t_type* ttype);
+
   bool is_reference(t_field* tfield) {
     return tfield->get_reference();
   }
 
+  /**
+   * True if the field is annotated cpp.lazy and is kept encoded until first
+   * accessed.  Only struct and container fields of plain structs qualify.
+   */
+  bool is_lazy(t_field* tfield) {
+    if (!in_plain_struct_ || in_view_ || is_reference(tfield) ||
+        tfield->annotations_.find("cpp.lazy") == tfield->annotations_.end()) {
+      return false;
+    }
+    t_type* ttype = get_true_type(tfield->get_type());
+    return ttype->is_struct() || ttype->is_xception() || ttype->is_container();
+  }
+
+  bool has_lazy_fields(t_struct* tstruct) {
+    const vector<t_field*>& members = tstruct->get_members();
+    for (vector<t_field*>::const_iterator m_iter = members.begin();
+         m_iter != members.end(); ++m_iter) {
+      if (is_lazy(*m_iter)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
   bool is_complex_type(t_type* ttype) {
     ttype = get_true_type(ttype);
 
@@ -280,6 +337,51 @@ class t_cpp_generator : public t_oop_generator {
    */
   bool gen_templates_only_;
 
+  /**
+   * True if we should generate read-only view companions of each struct.
+   */
+  bool gen_views_;
+
+  /**
+   * True while generating a view struct: strings become TStringViews and
+   * structs their views.
+   */
+  bool in_view_;
+
+  /**
+   * True if containers should allocate from the current TArena.
+   */
+  bool gen_arena_;
+
+  /**
+   * True if plain structs should get readFields(), which decodes only the
+   * fields in a TFieldMask.
+   */
+  bool gen_projection_;
+
+  /**
+   * True if plain structs should be read and written by TTableCodec through
+   * a static table of their fields, instead of by generated code.
+   */
+  bool gen_tables_;
+
+  /**
+   * Structs known to have a table or not, by has_table().
+   */
+  std::map<t_struct*, bool> has_table_;
+
+  /**
+   * Container tables already in the types implementation file, by C++ type.
+   */
+  std::map<std::string, std::string> container_tables_;
+
+  /**
+   * True while generating a plain struct, as opposed to a service argument
+   * or result struct or a view.  Only plain structs honour cpp.lazy and get
+   * projection readers.
+   */
+  bool in_plain_struct_;
+
   /**
    * True iff we should use a path prefix in our #include statements for other
    * thrift-generated header files.
@@ -379,8 +481,27 @@ void t_cpp_generator::init_generator() {
     "#include <thrift/Thrift.h>" << endl <<
     "#include <thrift/TApplicationException.h>" << endl <<
     "#include <thrift/protocol/TProtocol.h>" << endl <<
-    "#include <thrift/transport/TTransport.h>" << endl <<
-    endl;
+    "#include <thrift/protocol/TFieldDispatch.h>" << endl <<
+    "#include <thrift/transport/TTransport.h>" << endl;
+  if (gen_arena_) {
+    f_types_ << "#include <thrift/TArena.h>" << endl;
+  }
+  if (gen_projection_) {
+    f_types_ << "#include <thrift/TFieldMask.h>" << endl;
+  }
+  if (gen_tables_) {
+    f_types_ << "#include <thrift/protocol/TTableCodec.h>" << endl;
+  }
+  in_plain_struct_ = true;
+  const vector<t_struct*>& objects = program_->get_objects();
+  for (size_t i = 0; i < objects.size(); ++i) {
+    if (has_lazy_fields(objects[i])) {
+      f_types_ << "#include <thrift/protocol/TRawValue.h>" << endl;
+      break;
+    }
+  }
+  in_plain_struct_ = false;
+  f_types_ << endl;
   // Include C++xx compatibility header
   f_types_ << "#include <thrift/cxxfunctional.h>" << endl;
 
@@ -793,6 +914,11 @@ void t_cpp_generator::generate_forward_declaration(t_struct* tstruct) {
   f_types_ <<
     indent() << "class " << tstruct->get_name() << ";" << endl <<
     endl;
+  if (gen_views_) {
+    f_types_ <<
+      indent() << "class " << tstruct->get_name() << "View;" << endl <<
+      endl;
+  }
 }
 
 /**
@@ -803,6 +929,7 @@ void t_cpp_generator::generate_forward_declaration(t_struct* tstruct) {
  * @param tstruct The struct definition
  */
 void t_cpp_generator::generate_cpp_struct(t_struct* tstruct, bool is_exception) {
+  in_plain_struct_ = true;
   generate_struct_declaration(f_types_, tstruct, is_exception,
                              false, true, true, true);
   generate_struct_definition(f_types_impl_, f_types_impl_, tstruct);
@@ -810,13 +937,147 @@ void t_cpp_generator::generate_cpp_struct(t_struct* tstruct, bool is_exception)
   generate_local_reflection(f_types_, tstruct, false);
   generate_local_reflection(f_types_impl_, tstruct, true);
   generate_local_reflection_pointer(f_types_impl_, tstruct);
+  generate_struct_table(f_types_impl_, tstruct);
 
   std::ofstream& out = (gen_templates_ ? f_types_tcc_ : f_types_impl_);
   generate_struct_reader(out, tstruct);
+  if (gen_projection_) {
+    generate_struct_reader(out, tstruct, false, true);
+    generate_struct_mask_builder(f_types_impl_, tstruct);
+  }
   generate_struct_writer(out, tstruct);
+  generate_struct_writer(out, tstruct, false, true);
   generate_struct_swap(f_types_impl_, tstruct);
   generate_copy_constructor(f_types_impl_, tstruct);
   generate_assignment_operator(f_types_impl_, tstruct);
+  generate_lazy_decoders(out, tstruct);
+  in_plain_struct_ = false;
+
+  if (gen_views_) {
+    generate_struct_view(tstruct);
+  }
+}
+
+/**
+ * Generates the read-only view of a struct for the views option.  It has
+ * the fields of the struct, but reads strings and binaries as TStringViews
+ * into the transport's buffer and nested structs as their views.
+ *
+ * @param tstruct The struct definition
+ */
+void t_cpp_generator::generate_struct_view(t_struct* tstruct) {
+  in_view_ = true;
+  generate_struct_view_declaration(f_types_, tstruct);
+  std::ofstream& out = (gen_templates_ ? f_types_tcc_ : f_types_impl_);
+  generate_struct_reader(out, tstruct);
+  in_view_ = false;
+}
+
+void t_cpp_generator::generate_struct_view_declaration(ofstream& out,
+                                                       t_struct* tstruct) {
+  string name = tstruct->get_name() + "View";
+  vector<t_field*>::const_iterator m_iter;
+  const vector<t_field*>& members = tstruct->get_members();
+
+  bool has_nonrequired_fields = false;
+  for (m_iter = members.begin(); m_iter != members.end(); ++m_iter) {
+    if ((*m_iter)->get_req() != t_field::T_REQUIRED)
+      has_nonrequired_fields = true;
+  }
+
+  if (has_nonrequired_fields) {
+    out <<
+      indent() << "typedef struct _" << name << "__isset {" << endl;
+    indent_up();
+
+    indent(out) <<
+      "_" << name << "__isset() ";
+    bool first = true;
+    for (m_iter = members.begin(); m_iter != members.end(); ++m_iter) {
+      if ((*m_iter)->get_req() == t_field::T_REQUIRED) {
+        continue;
+      }
+      out << (first ? ": " : ", ") << (*m_iter)->get_name() << "(false)";
+      first = false;
+    }
+    out << " {}" << endl;
+
+    for (m_iter = members.begin(); m_iter != members.end(); ++m_iter) {
+      if ((*m_iter)->get_req() != t_field::T_REQUIRED) {
+        indent(out) <<
+          "bool " << (*m_iter)->get_name() << ";" << endl;
+      }
+    }
+
+    indent_down();
+    indent(out) <<
+      "} _" << name << "__isset;" << endl;
+  }
+
+  out <<
+    endl <<
+    indent() << "/**" << endl <<
+    indent() << " * Read-only view of " << tstruct->get_name() << ". Strings and binaries point" << endl <<
+    indent() << " * into the buffer it was read from and are only valid as long as" << endl <<
+    indent() << " * that buffer is; see ::apache::thrift::TStringView." << endl <<
+    indent() << " */" << endl <<
+    indent() << "class " << name << " {" << endl <<
+    indent() << " public:" << endl <<
+    endl;
+  indent_up();
+
+  // Default constructor.  Defaults from the IDL are not applied, a view
+  // only ever holds what was read.
+  indent(out) << name << "()";
+  bool init_ctor = false;
+  for (m_iter = members.begin(); m_iter != members.end(); ++m_iter) {
+    t_type* t = get_true_type((*m_iter)->get_type());
+    if ((t->is_base_type() && !t->is_string()) || t->is_enum()) {
+      string dval;
+      if (t->is_enum()) {
+        dval += "(" + type_name(t) + ")";
+      }
+      dval += "0";
+      out << (init_ctor ? ", " : " : ") << (*m_iter)->get_name() << "(" << dval << ")";
+      init_ctor = true;
+    }
+  }
+  out << " {}" << endl << endl;
+
+  for (m_iter = members.begin(); m_iter != members.end(); ++m_iter) {
+    indent(out) << declare_field(*m_iter) << endl;
+  }
+
+  if (has_nonrequired_fields) {
+    out <<
+      endl <<
+      indent() << "_" << name << "__isset __isset;" << endl;
+  }
+  out << endl;
+
+  if (!gen_no_default_operators_) {
+    // Declared only, as for the struct, so views can be set elements and
+    // map keys
+    out <<
+      indent() << "bool operator < (const " << name << " & ) const;" << endl <<
+      endl;
+  }
+
+  if (gen_templates_) {
+    out <<
+      indent() << "template <class Protocol_>" << endl <<
+      indent() << "uint32_t read(Protocol_* iprot);" << endl;
+  } else {
+    out <<
+      indent() << "uint32_t read(" <<
+      "::apache::thrift::protocol::TProtocol* iprot);" << endl;
+  }
+  out << endl;
+
+  indent_down();
+  indent(out) <<
+    "};" << endl <<
+    endl;
 }
 
 void t_cpp_generator::generate_copy_constructor(
@@ -837,6 +1098,10 @@ void t_cpp_generator::generate_copy_constructor(
       has_nonrequired_fields = true;
     indent(out) << (*f_iter)->get_name() << " = " << tmp_name << "." <<
       (*f_iter)->get_name() << ";" << endl;
+    if (is_lazy(*f_iter)) {
+      indent(out) << "__raw_" << (*f_iter)->get_name() << " = " << tmp_name <<
+        ".__raw_" << (*f_iter)->get_name() << ";" << endl;
+    }
   }
 
   if (has_nonrequired_fields)
@@ -864,6 +1129,10 @@ void t_cpp_generator::generate_assignment_operator(
       has_nonrequired_fields = true;
     indent(out) << (*f_iter)->get_name() << " = " << tmp_name << "." <<
       (*f_iter)->get_name() << ";" << endl;
+    if (is_lazy(*f_iter)) {
+      indent(out) << "__raw_" << (*f_iter)->get_name() << " = " << tmp_name <<
+        ".__raw_" << (*f_iter)->get_name() << ";" << endl;
+    }
   }
   if (has_nonrequired_fields)
     indent(out) << "__isset = " << tmp_name << ".__isset;" << endl;
@@ -1021,8 +1290,20 @@ void t_cpp_generator::generate_struct_declaration(ofstream& out,
       endl << endl;
   }
 
-  // Declare all fields
+  // Table of the fields, for TTableCodec
+  if (in_plain_struct_ && has_table(tstruct)) {
+    indent(out) <<
+      "static const ::apache::thrift::protocol::TStructTable __table;" <<
+      endl << endl;
+  }
+
+  // Declare all fields.  Lazy ones are private, further down.
+  bool has_lazy = false;
   for (m_iter = members.begin(); m_iter != members.end(); ++m_iter) {
+    if (is_lazy(*m_iter)) {
+      has_lazy = true;
+      continue;
+    }
     indent(out) <<
       declare_field(*m_iter, false, (pointers && !(*m_iter)->get_type()->is_xception()), !read) << endl;
   }
@@ -1055,6 +1336,29 @@ void t_cpp_generator::generate_struct_declaration(ofstream& out,
   }
   out << endl;
 
+  // Lazy fields can only be reached through these, which decode them on
+  // demand
+  for (m_iter = members.begin(); m_iter != members.end(); ++m_iter) {
+    if (!is_lazy(*m_iter)) {
+      continue;
+    }
+    string fname = (*m_iter)->get_name();
+    string ftype = type_name((*m_iter)->get_type());
+    out <<
+      indent() << "// Decodes on first call; not safe to call concurrently" << endl <<
+      indent() << "const " << ftype << "& get_" << fname << "() const {" << endl <<
+      indent() << "  if (__raw_" << fname << ".isRaw()) __decode_" << fname << "();" << endl <<
+      indent() << "  return " << fname << ";" << endl <<
+      indent() << "}" << endl << endl <<
+      indent() << ftype << "& mutable_" << fname << "() {" << endl <<
+      indent() << "  if (__raw_" << fname << ".isRaw()) __decode_" << fname << "();" << endl <<
+      indent() << "  return " << fname << ";" << endl <<
+      indent() << "}" << endl << endl <<
+      indent() << "bool __is_raw_" << fname << "() const {" << endl <<
+      indent() << "  return __raw_" << fname << ".isRaw();" << endl <<
+      indent() << "}" << endl << endl;
+  }
+
   if (!pointers) {
     // Should we generate default operators?
     if (!gen_no_default_operators_) {
@@ -1067,10 +1371,14 @@ void t_cpp_generator::generate_struct_declaration(ofstream& out,
       for (m_iter = members.begin(); m_iter != members.end(); ++m_iter) {
         // Most existing Thrift code does not use isset or optional/required,
         // so we treat "default" fields as required.
+        string value = (*m_iter)->get_name();
+        if (is_lazy(*m_iter)) {
+          value = "get_" + value + "()";
+        }
         if ((*m_iter)->get_req() != t_field::T_OPTIONAL) {
           out <<
-            indent() << "if (!(" << (*m_iter)->get_name()
-                     << " == rhs." << (*m_iter)->get_name() << "))" << endl <<
+            indent() << "if (!(" << value
+                     << " == rhs." << value << "))" << endl <<
             indent() << "  return false;" << endl;
         } else {
           out <<
@@ -1078,7 +1386,7 @@ void t_cpp_generator::generate_struct_declaration(ofstream& out,
                      << " != rhs.__isset." << (*m_iter)->get_name() << ")" << endl <<
             indent() << "  return false;" << endl <<
             indent() << "else if (__isset." << (*m_iter)->get_name() << " && !("
-                     << (*m_iter)->get_name() << " == rhs." << (*m_iter)->get_name()
+                     << value << " == rhs." << value
                      << "))" << endl <<
             indent() << "  return false;" << endl;
         }
@@ -1109,20 +1417,72 @@ void t_cpp_generator::generate_struct_declaration(ofstream& out,
         indent() << "uint32_t read(" <<
         "::apache::thrift::protocol::TProtocol* iprot);" << endl;
     }
+    if (gen_projection_ && in_plain_struct_) {
+      if (gen_templates_) {
+        out <<
+          indent() << "template <class Protocol_>" << endl <<
+          indent() << "uint32_t readFields(Protocol_* iprot, " <<
+          "const ::apache::thrift::TFieldMask& mask);" << endl;
+      } else {
+        out <<
+          indent() << "uint32_t readFields(" <<
+          "::apache::thrift::protocol::TProtocol* iprot, " <<
+          "const ::apache::thrift::TFieldMask& mask);" << endl;
+      }
+      out <<
+        indent() << "static bool addToFieldMask(::apache::thrift::TFieldMask& mask, " <<
+        "const std::string& path);" << endl;
+    }
   }
   if (write) {
     if (gen_templates_) {
       out <<
         indent() << "template <class Protocol_>" << endl <<
-        indent() << "uint32_t write(Protocol_* oprot) const;" << endl;
+        indent() << "uint32_t write(Protocol_* oprot) const;" << endl <<
+        indent() << "template <class Protocol_>" << endl <<
+        indent() << "uint32_t serializedSize(Protocol_* oprot) const;" << endl;
     } else {
       out <<
         indent() << "uint32_t write(" <<
+        "::apache::thrift::protocol::TProtocol* oprot) const;" << endl <<
+        indent() << "uint32_t serializedSize(" <<
         "::apache::thrift::protocol::TProtocol* oprot) const;" << endl;
     }
   }
   out << endl;
 
+  // Lazy fields and the encoded bytes they are decoded from
+  if (has_lazy) {
+    indent_down();
+    indent(out) << " private:" << endl;
+    indent_up();
+    for (m_iter = members.begin(); m_iter != members.end(); ++m_iter) {
+      if (is_lazy(*m_iter)) {
+        indent(out) << "mutable " << declare_field(*m_iter, false, false, !read) << endl;
+      }
+    }
+    out << endl;
+    for (m_iter = members.begin(); m_iter != members.end(); ++m_iter) {
+      if (is_lazy(*m_iter)) {
+        indent(out) << "mutable ::apache::thrift::protocol::TRawValue __raw_" <<
+          (*m_iter)->get_name() << ";" << endl;
+      }
+    }
+    out << endl;
+    for (m_iter = members.begin(); m_iter != members.end(); ++m_iter) {
+      if (is_lazy(*m_iter)) {
+        indent(out) << (gen_templates_ ? "inline " : "") << "void __decode_" <<
+          (*m_iter)->get_name() << "() const;" << endl;
+      }
+    }
+    if (swap) {
+      out << endl <<
+        indent() << "friend void swap(" << tstruct->get_name() << " &a, " <<
+        tstruct->get_name() << " &b);" << endl;
+    }
+    out << endl;
+  }
+
   indent_down();
   indent(out) <<
     "};" << endl <<
@@ -1176,6 +1536,9 @@ void t_cpp_generator::generate_struct_definition(ofstream& out,
       }
       indent_up();
       out << indent() << "this->" << (*m_iter)->get_name() << " = val;" << endl;
+      if (is_lazy(*m_iter)) {
+        out << indent() << "this->__raw_" << (*m_iter)->get_name() << ".clear();" << endl;
+      }
       indent_down();
 
       // assume all fields are required except optional fields.
@@ -1364,6 +1727,206 @@ void t_cpp_generator::generate_local_reflection_pointer(std::ofstream& out,
     endl << endl;
 }
 
+/**
+ * Decides whether a struct is read and written through its table.  Every
+ * field must be held by value in a type TTableCodec knows the layout of,
+ * and every struct in it must have a table generated alongside.
+ *
+ * @param tstruct The struct
+ */
+bool t_cpp_generator::has_table(t_struct* tstruct) {
+  if (!gen_tables_ || gen_arena_) {
+    return false;
+  }
+  std::map<t_struct*, bool>::iterator it = has_table_.find(tstruct);
+  if (it != has_table_.end()) {
+    return it->second;
+  }
+
+  // Assumed to have one while its fields are checked, for recursive structs
+  has_table_[tstruct] = true;
+  bool result = true;
+  const vector<t_field*>& members = tstruct->get_members();
+  for (vector<t_field*>::const_iterator m_iter = members.begin();
+       m_iter != members.end(); ++m_iter) {
+    if (is_reference(*m_iter) ||
+        (*m_iter)->annotations_.find("cpp.lazy") != (*m_iter)->annotations_.end() ||
+        !type_has_table((*m_iter)->get_type())) {
+      result = false;
+      break;
+    }
+  }
+
+  if (!result) {
+    // Anything decided on the assumption has to be decided again
+    for (it = has_table_.begin(); it != has_table_.end();) {
+      if (it->second) {
+        has_table_.erase(it++);
+      } else {
+        ++it;
+      }
+    }
+  }
+  has_table_[tstruct] = result;
+  return result;
+}
+
+bool t_cpp_generator::type_has_table(t_type* ttype) {
+  ttype = get_true_type(ttype);
+  if (ttype->annotations_.find("cpp.type") != ttype->annotations_.end()) {
+    return false;
+  }
+  if (ttype->is_base_type() || ttype->is_enum()) {
+    return true;
+  }
+  if (ttype->is_struct() || ttype->is_xception()) {
+    // A struct from an included IDL may have been generated without
+    // tables, so only the ones generated here can be referred to
+    return ttype->get_program() == program_ && has_table((t_struct*)ttype);
+  }
+  if (((t_container*)ttype)->has_cpp_name()) {
+    return false;
+  }
+  if (ttype->is_list()) {
+    return type_has_table(((t_list*)ttype)->get_elem_type());
+  }
+  if (ttype->is_set()) {
+    return type_has_table(((t_set*)ttype)->get_elem_type());
+  }
+  return type_has_table(((t_map*)ttype)->get_key_type()) &&
+    type_has_table(((t_map*)ttype)->get_val_type());
+}
+
+/**
+ * Generates the static TStructTable of a struct, preceded by the tables of
+ * the containers in it, for the tables option.  The fields are listed in
+ * order of id, which is the order they are written in.
+ *
+ * @param out Stream to write to
+ * @param tstruct The struct
+ */
+void t_cpp_generator::generate_struct_table(ofstream& out,
+                                            t_struct* tstruct) {
+  if (!has_table(tstruct)) {
+    return;
+  }
+
+  string name = tstruct->get_name();
+  const vector<t_field*>& fields = tstruct->get_sorted_members();
+  string fields_name = "NULL";
+
+  if (!fields.empty()) {
+    vector<string> values;
+    for (size_t i = 0; i < fields.size(); ++i) {
+      values.push_back(generate_value_table(out, fields[i]->get_type()));
+    }
+
+    fields_name = "_" + name + "__fields";
+    indent(out) <<
+      "static const ::apache::thrift::protocol::TFieldTable " << fields_name <<
+      "[] = {" << endl;
+    indent_up();
+    for (size_t i = 0; i < fields.size(); ++i) {
+      t_field* tfield = fields[i];
+      bool required = tfield->get_req() == t_field::T_REQUIRED;
+      string flags = "0";
+      if (required) {
+        flags = "::apache::thrift::protocol::T_FIELD_REQUIRED";
+      } else if (tfield->get_req() == t_field::T_OPTIONAL ||
+                 tfield->get_type()->is_xception()) {
+        flags = "::apache::thrift::protocol::T_FIELD_WRITE_IF_SET";
+      }
+      out <<
+        indent() << "{ " << tfield->get_key() << ", \"" << tfield->get_name() <<
+        "\", " << values[i] << ", " << flags << "," << endl <<
+        indent() << "  THRIFT_FIELD_OFFSET(" << name << ", " << tfield->get_name() << "), ";
+      if (required) {
+        out << "-1";
+      } else {
+        out << "static_cast<int32_t>(THRIFT_FIELD_OFFSET(" << name <<
+          ", __isset." << tfield->get_name() << "))";
+      }
+      out << " }" << (i + 1 < fields.size() ? "," : "") << endl;
+    }
+    indent_down();
+    indent(out) << "};" << endl << endl;
+  }
+
+  out <<
+    indent() << "const ::apache::thrift::protocol::TStructTable " << name <<
+    "::__table = {" << endl <<
+    indent() << "  \"" << name << "\", " << fields_name << ", " <<
+    fields.size() << endl <<
+    indent() << "};" << endl << endl;
+}
+
+/**
+ * Returns the initializer of the TValueTable of a type, first generating
+ * the table of a container type if it has none yet.
+ *
+ * @param out Stream to write container tables to
+ * @param ttype The type
+ */
+string t_cpp_generator::generate_value_table(ofstream& out, t_type* ttype) {
+  ttype = get_true_type(ttype);
+  string struct_table = "NULL";
+  string container_table = "NULL";
+  bool binary = false;
+  if (ttype->is_base_type()) {
+    binary = ((t_base_type*)ttype)->is_binary();
+  } else if (ttype->is_struct() || ttype->is_xception()) {
+    struct_table = "&" + type_name(ttype) + "::__table";
+  } else if (ttype->is_container()) {
+    container_table = "&" + generate_container_table(out, ttype);
+  }
+  return "{ " + type_to_enum(ttype) + ", " + (binary ? "true" : "false") +
+    ", " + struct_table + ", " + container_table + " }";
+}
+
+/**
+ * Generates the static TContainerTable of a container type, unless there
+ * already is one for the same C++ type, and returns its name.
+ *
+ * @param out Stream to write to
+ * @param ttype The container type
+ */
+string t_cpp_generator::generate_container_table(ofstream& out, t_type* ttype) {
+  string cpp_type = type_name(ttype);
+  std::map<string, string>::iterator it = container_tables_.find(cpp_type);
+  if (it != container_tables_.end()) {
+    return it->second;
+  }
+
+  string elem;
+  string value = "{ ::apache::thrift::protocol::T_STOP, false, NULL, NULL }";
+  string ops;
+  if (ttype->is_list()) {
+    elem = generate_value_table(out, ((t_list*)ttype)->get_elem_type());
+    ops = "TListOps";
+  } else if (ttype->is_set()) {
+    elem = generate_value_table(out, ((t_set*)ttype)->get_elem_type());
+    ops = "TSetOps";
+  } else {
+    elem = generate_value_table(out, ((t_map*)ttype)->get_key_type());
+    value = generate_value_table(out, ((t_map*)ttype)->get_val_type());
+    ops = "TMapOps";
+  }
+
+  std::ostringstream name;
+  name << "__table_c" << container_tables_.size();
+  out <<
+    indent() << "static const ::apache::thrift::protocol::TContainerTable " <<
+    name.str() << " = {" << endl <<
+    indent() << "  " << elem << "," << endl <<
+    indent() << "  " << value << "," << endl <<
+    indent() << "  &::apache::thrift::protocol::" << ops << "<" << cpp_type <<
+    ">::ops," << endl <<
+    indent() << "  " << (list_array_type(ttype).empty() ? "false" : "true") << endl <<
+    indent() << "};" << endl << endl;
+  container_tables_[cpp_type] = name.str();
+  return name.str();
+}
+
 /**
  * Makes a helper function to gen a struct reader.
  *
@@ -1372,19 +1935,38 @@ void t_cpp_generator::generate_local_reflection_pointer(std::ofstream& out,
  */
 void t_cpp_generator::generate_struct_reader(ofstream& out,
                                              t_struct* tstruct,
-                                             bool pointers) {
+                                             bool pointers,
+                                             bool masked) {
+  string name = tstruct->get_name() + (in_view_ ? "View" : "");
+  string verb = masked ? "readFields" : "read";
+  string mask_arg = masked ? ", const ::apache::thrift::TFieldMask& mask" : "";
   if (gen_templates_) {
     out <<
       indent() << "template <class Protocol_>" << endl <<
-      indent() << "uint32_t " << tstruct->get_name() <<
-      "::read(Protocol_* iprot) {" << endl;
+      indent() << "uint32_t " << name <<
+      "::" << verb << "(Protocol_* iprot" << mask_arg << ") {" << endl;
   } else {
     indent(out) <<
-      "uint32_t " << tstruct->get_name() <<
-      "::read(::apache::thrift::protocol::TProtocol* iprot) {" << endl;
+      "uint32_t " << name <<
+      "::" << verb << "(::apache::thrift::protocol::TProtocol* iprot" << mask_arg << ") {" << endl;
   }
   indent_up();
 
+  if (!masked && !pointers && in_plain_struct_ && !in_view_ && has_table(tstruct)) {
+    out <<
+      indent() << "return ::apache::thrift::protocol::table_read(iprot, __table, this);" << endl;
+    indent_down();
+    indent(out) << "}" << endl << endl;
+    return;
+  }
+
+  if (masked) {
+    out <<
+      indent() << "if (mask.isAll()) {" << endl <<
+      indent() << "  return this->read(iprot);" << endl <<
+      indent() << "}" << endl;
+  }
+
   const vector<t_field*>& fields = tstruct->get_members();
   vector<t_field*>::const_iterator f_iter;
 
@@ -1408,6 +1990,25 @@ void t_cpp_generator::generate_struct_reader(ofstream& out,
   }
   out << endl;
 
+  // Fields are switched on by their index in order of id, found by
+  // field_index(), so the switch is dense however sparse the ids are
+  const vector<t_field*>& sorted_fields = tstruct->get_sorted_members();
+  if (!sorted_fields.empty()) {
+    indent(out) << "static const int16_t fids[] = {";
+    for (f_iter = sorted_fields.begin(); f_iter != sorted_fields.end(); ++f_iter) {
+      out << (f_iter == sorted_fields.begin() ? " " : ", ") << (*f_iter)->get_key();
+    }
+    out << " };" << endl <<
+      indent() << "uint32_t fnext = 0;" << endl <<
+      indent() << "::apache::thrift::protocol::TFieldStats* fstats = NULL;" << endl <<
+      "#ifdef THRIFT_FIELD_STATS" << endl <<
+      indent() << "static ::apache::thrift::protocol::TFieldStats stats = { \"" <<
+      name << "\", 0, 0, 0, NULL };" << endl <<
+      indent() << "fstats = &stats;" << endl <<
+      "#endif" << endl <<
+      endl;
+  }
+
 
   // Loop over reading in fields
   indent(out) <<
@@ -1431,19 +2032,28 @@ void t_cpp_generator::generate_struct_reader(ofstream& out,
     else {
       // Switch statement on the field we are reading
       indent(out) <<
-        "switch (fid)" << endl;
+        "switch (::apache::thrift::protocol::field_index(fids, " <<
+        sorted_fields.size() << ", fid, fnext, fstats))" << endl;
 
         scope_up(out);
 
         // Generate deserialization code for known cases
-        for (f_iter = fields.begin(); f_iter != fields.end(); ++f_iter) {
+        size_t findex = 0;
+        for (f_iter = sorted_fields.begin(); f_iter != sorted_fields.end(); ++f_iter) {
           indent(out) <<
-            "case " << (*f_iter)->get_key() << ":" << endl;
+            "case " << findex++ << ": // " << (*f_iter)->get_key() << ": " <<
+            (*f_iter)->get_name() << endl;
           indent_up();
           indent(out) <<
-            "if (ftype == " << type_to_enum((*f_iter)->get_type()) << ") {" << endl;
+            "if (ftype == " << type_to_enum((*f_iter)->get_type());
+          if (masked) {
+            out << " && mask.includes(" << (*f_iter)->get_key() << ")";
+          }
+          out << ") {" << endl;
           indent_up();
 
+          t_type* ftype = get_true_type((*f_iter)->get_type());
+
           const char *isset_prefix =
             ((*f_iter)->get_req() != t_field::T_REQUIRED) ? "this->__isset." : "isset_";
 
@@ -1459,6 +2069,22 @@ void t_cpp_generator::generate_struct_reader(ofstream& out,
 
           if (pointers && !(*f_iter)->get_type()->is_xception()) {
             generate_deserialize_field(out, *f_iter, "(*(this->", "))");
+          } else if (masked && (ftype->is_struct() || ftype->is_xception()) &&
+                     !is_reference(*f_iter) && !is_lazy(*f_iter)) {
+            // Struct fields are projected through their nested mask
+            out <<
+              indent() << "xfer += this->" << (*f_iter)->get_name() <<
+              ".readFields(iprot, mask.nested(" << (*f_iter)->get_key() << "));" << endl;
+          } else if (is_lazy(*f_iter)) {
+            string raw = "this->__raw_" + (*f_iter)->get_name();
+            out <<
+              indent() << "if (iprot->getRawFormat() != ::apache::thrift::protocol::T_RAW_NONE) {" << endl <<
+              indent() << "  xfer += " << raw << ".read(iprot, ftype);" << endl <<
+              indent() << "} else {" << endl;
+            indent_up();
+            indent(out) << raw << ".clear();" << endl;
+            generate_deserialize_field(out, *f_iter, "this->");
+            scope_down(out);
           } else {
             generate_deserialize_field(out, *f_iter, "this->");
           }
@@ -1499,10 +2125,15 @@ void t_cpp_generator::generate_struct_reader(ofstream& out,
   // there might possibly be a chance of continuing.
   out << endl;
   for (f_iter = fields.begin(); f_iter != fields.end(); ++f_iter) {
-    if ((*f_iter)->get_req() == t_field::T_REQUIRED)
-      out <<
-        indent() << "if (!isset_" << (*f_iter)->get_name() << ')' << endl <<
+    if ((*f_iter)->get_req() == t_field::T_REQUIRED) {
+      // Unless they were left out of the mask
+      indent(out) << "if (";
+      if (masked) {
+        out << "mask.includes(" << (*f_iter)->get_key() << ") && ";
+      }
+      out << "!isset_" << (*f_iter)->get_name() << ')' << endl <<
         indent() << "  throw TProtocolException(TProtocolException::INVALID_DATA);" << endl;
+    }
   }
 
   indent(out) << "return xfer;" << endl;
@@ -1513,36 +2144,101 @@ void t_cpp_generator::generate_struct_reader(ofstream& out,
 }
 
 /**
- * Generates the write function.
+ * Generates addToFieldMask(), which adds the field a name refers to, or for
+ * a dotted name the field of a struct field, to a TFieldMask.
  *
  * @param out Stream to write to
  * @param tstruct The struct
  */
+void t_cpp_generator::generate_struct_mask_builder(ofstream& out,
+                                                   t_struct* tstruct) {
+  const vector<t_field*>& fields = tstruct->get_members();
+  vector<t_field*>::const_iterator f_iter;
+
+  indent(out) <<
+    "bool " << tstruct->get_name() << "::addToFieldMask(" <<
+    "::apache::thrift::TFieldMask& mask, const std::string& path) {" << endl;
+  indent_up();
+  out <<
+    indent() << "std::string::size_type dot = path.find('.');" << endl <<
+    indent() << "std::string name = path.substr(0, dot);" << endl;
+
+  for (f_iter = fields.begin(); f_iter != fields.end(); ++f_iter) {
+    t_type* ftype = get_true_type((*f_iter)->get_type());
+    out <<
+      indent() << "if (name == \"" << (*f_iter)->get_name() << "\") {" << endl;
+    indent_up();
+    if ((ftype->is_struct() || ftype->is_xception()) && !is_reference(*f_iter)) {
+      out <<
+        indent() << "if (dot != std::string::npos) {" << endl <<
+        indent() << "  return " << type_name(ftype) << "::addToFieldMask(mask.addNested(" <<
+        (*f_iter)->get_key() << "), path.substr(dot + 1));" << endl <<
+        indent() << "}" << endl;
+    } else {
+      out <<
+        indent() << "if (dot != std::string::npos) {" << endl <<
+        indent() << "  return false;" << endl <<
+        indent() << "}" << endl;
+    }
+    out <<
+      indent() << "mask.add(" << (*f_iter)->get_key() << ");" << endl <<
+      indent() << "return true;" << endl;
+    scope_down(out);
+  }
+
+  if (fields.empty()) {
+    out << indent() << "(void) mask;" << endl;
+  }
+  indent(out) << "return false;" << endl;
+  scope_down(out);
+  out << endl;
+}
+
+/**
+ * Generates the write function, or with size set the serializedSize
+ * function, which walks the same fields but only adds up the bytes that
+ * write would produce.  The End calls carry no bytes in any protocol that
+ * supports sizing, so the sizer leaves them out.
+ *
+ * @param out Stream to write to
+ * @param tstruct The struct
+ * @param size Generate serializedSize instead of write
+ */
 void t_cpp_generator::generate_struct_writer(ofstream& out,
                                              t_struct* tstruct,
-                                             bool pointers) {
+                                             bool pointers,
+                                             bool size) {
   string name = tstruct->get_name();
   const vector<t_field*>& fields = tstruct->get_sorted_members();
   vector<t_field*>::const_iterator f_iter;
+  string verb = size ? "serializedSize" : "write";
 
   if (gen_templates_) {
     out <<
       indent() << "template <class Protocol_>" << endl <<
       indent() << "uint32_t " << tstruct->get_name() <<
-      "::write(Protocol_* oprot) const {" << endl;
+      "::" << verb << "(Protocol_* oprot) const {" << endl;
   } else {
     indent(out) <<
       "uint32_t " << tstruct->get_name() <<
-      "::write(::apache::thrift::protocol::TProtocol* oprot) const {" << endl;
+      "::" << verb << "(::apache::thrift::protocol::TProtocol* oprot) const {" << endl;
   }
   indent_up();
 
+  if (!size && !pointers && in_plain_struct_ && has_table(tstruct)) {
+    out <<
+      indent() << "return ::apache::thrift::protocol::table_write(oprot, __table, this);" << endl;
+    indent_down();
+    indent(out) << "}" << endl << endl;
+    return;
+  }
+
   out <<
     indent() << "uint32_t xfer = 0;" << endl;
 
   indent(out) << "oprot->incrementRecursionDepth();" << endl;
   indent(out) <<
-    "xfer += oprot->writeStructBegin(\"" << name << "\");" << endl;
+    "xfer += oprot->" << verb << "StructBegin(\"" << name << "\");" << endl;
 
   for (f_iter = fields.begin(); f_iter != fields.end(); ++f_iter) {
     bool check_if_set = (*f_iter)->get_req() == t_field::T_OPTIONAL ||
@@ -1556,19 +2252,32 @@ void t_cpp_generator::generate_struct_writer(ofstream& out,
 
     // Write field header
     out <<
-      indent() << "xfer += oprot->writeFieldBegin(" <<
+      indent() << "xfer += oprot->" << verb << "FieldBegin(" <<
       "\"" << (*f_iter)->get_name() << "\", " <<
       type_to_enum((*f_iter)->get_type()) << ", " <<
       (*f_iter)->get_key() << ");" << endl;
     // Write field contents
     if (pointers && !(*f_iter)->get_type()->is_xception()) {
-      generate_serialize_field(out, *f_iter, "(*(this->", "))");
+      generate_serialize_field(out, *f_iter, "(*(this->", "))", size);
+    } else if (is_lazy(*f_iter)) {
+      // Untouched raw bytes go back out as they came in
+      string raw = "this->__raw_" + (*f_iter)->get_name();
+      out <<
+        indent() << "if (" << raw << ".matches(oprot)) {" << endl <<
+        indent() << "  xfer += " <<
+        (size ? raw + ".size()" : "oprot->writeRaw(" + raw + ".bytes())") << ";" << endl <<
+        indent() << "} else {" << endl;
+      indent_up();
+      generate_serialize_field(out, *f_iter, "this->get_", "()", size);
+      scope_down(out);
     } else {
-      generate_serialize_field(out, *f_iter, "this->");
+      generate_serialize_field(out, *f_iter, "this->", "", size);
     }
     // Write field closer
-    indent(out) <<
-      "xfer += oprot->writeFieldEnd();" << endl;
+    if (!size) {
+      indent(out) <<
+        "xfer += oprot->writeFieldEnd();" << endl;
+    }
     if (check_if_set) {
       indent_down();
       indent(out) << '}';
@@ -1579,8 +2288,8 @@ void t_cpp_generator::generate_struct_writer(ofstream& out,
 
   // Write the struct map
   out <<
-    indent() << "xfer += oprot->writeFieldStop();" << endl <<
-    indent() << "xfer += oprot->writeStructEnd();" << endl <<
+    indent() << "xfer += oprot->" << verb << "FieldStop();" << endl <<
+    indent() << "xfer += oprot->" << verb << "StructEnd();" << endl <<
     indent() << "oprot->decrementRecursionDepth();" << endl <<
     indent() << "return xfer;" << endl;
 
@@ -1597,23 +2306,26 @@ void t_cpp_generator::generate_struct_writer(ofstream& out,
  *
  * @param out Output stream
  * @param tstruct The result struct
+ * @param size Generate serializedSize instead of write
  */
 void t_cpp_generator::generate_struct_result_writer(ofstream& out,
                                                     t_struct* tstruct,
-                                                    bool pointers) {
+                                                    bool pointers,
+                                                    bool size) {
   string name = tstruct->get_name();
   const vector<t_field*>& fields = tstruct->get_sorted_members();
   vector<t_field*>::const_iterator f_iter;
+  string verb = size ? "serializedSize" : "write";
 
   if (gen_templates_) {
     out <<
       indent() << "template <class Protocol_>" << endl <<
       indent() << "uint32_t " << tstruct->get_name() <<
-      "::write(Protocol_* oprot) const {" << endl;
+      "::" << verb << "(Protocol_* oprot) const {" << endl;
   } else {
     indent(out) <<
       "uint32_t " << tstruct->get_name() <<
-      "::write(::apache::thrift::protocol::TProtocol* oprot) const {" << endl;
+      "::" << verb << "(::apache::thrift::protocol::TProtocol* oprot) const {" << endl;
   }
   indent_up();
 
@@ -1623,7 +2335,7 @@ void t_cpp_generator::generate_struct_result_writer(ofstream& out,
     endl;
 
   indent(out) <<
-    "xfer += oprot->writeStructBegin(\"" << name << "\");" << endl;
+    "xfer += oprot->" << verb << "StructBegin(\"" << name << "\");" << endl;
 
   bool first = true;
   for (f_iter = fields.begin(); f_iter != fields.end(); ++f_iter) {
@@ -1643,18 +2355,20 @@ void t_cpp_generator::generate_struct_result_writer(ofstream& out,
 
     // Write field header
     out <<
-      indent() << "xfer += oprot->writeFieldBegin(" <<
+      indent() << "xfer += oprot->" << verb << "FieldBegin(" <<
       "\"" << (*f_iter)->get_name() << "\", " <<
       type_to_enum((*f_iter)->get_type()) << ", " <<
       (*f_iter)->get_key() << ");" << endl;
     // Write field contents
     if (pointers) {
-      generate_serialize_field(out, *f_iter, "(*(this->", "))");
+      generate_serialize_field(out, *f_iter, "(*(this->", "))", size);
     } else {
-      generate_serialize_field(out, *f_iter, "this->");
+      generate_serialize_field(out, *f_iter, "this->", "", size);
     }
     // Write field closer
-    indent(out) << "xfer += oprot->writeFieldEnd();" << endl;
+    if (!size) {
+      indent(out) << "xfer += oprot->writeFieldEnd();" << endl;
+    }
 
     indent_down();
     indent(out) << "}";
@@ -1663,8 +2377,8 @@ void t_cpp_generator::generate_struct_result_writer(ofstream& out,
   // Write the struct map
   out <<
     endl <<
-    indent() << "xfer += oprot->writeFieldStop();" << endl <<
-    indent() << "xfer += oprot->writeStructEnd();" << endl <<
+    indent() << "xfer += oprot->" << verb << "FieldStop();" << endl <<
+    indent() << "xfer += oprot->" << verb << "StructEnd();" << endl <<
     indent() << "return xfer;" << endl;
 
   indent_down();
@@ -1705,6 +2419,11 @@ void t_cpp_generator::generate_struct_swap(ofstream& out, t_struct* tstruct) {
     out <<
       indent() << "swap(a." << tfield->get_name() <<
       ", b." << tfield->get_name() << ");" << endl;
+    if (is_lazy(tfield)) {
+      out <<
+        indent() << "swap(a.__raw_" << tfield->get_name() <<
+        ", b.__raw_" << tfield->get_name() << ");" << endl;
+    }
   }
 
   if (has_nonrequired_fields) {
@@ -1724,6 +2443,41 @@ void t_cpp_generator::generate_struct_swap(ofstream& out, t_struct* tstruct) {
   out << endl;
 }
 
+/**
+ * Generates the functions that decode cpp.lazy fields from their raw bytes
+ * on first access.
+ *
+ * @param out Stream to write to
+ * @param tstruct The struct
+ */
+void t_cpp_generator::generate_lazy_decoders(ofstream& out, t_struct* tstruct) {
+  const vector<t_field*>& fields = tstruct->get_members();
+  for (vector<t_field*>::const_iterator f_iter = fields.begin();
+       f_iter != fields.end();
+       ++f_iter) {
+    if (!is_lazy(*f_iter)) {
+      continue;
+    }
+    string fname = (*f_iter)->get_name();
+    out <<
+      indent() << (gen_templates_ ? "inline " : "") << "void " <<
+      tstruct->get_name() << "::__decode_" << fname << "() const {" << endl;
+    indent_up();
+    out <<
+      indent() << "boost::shared_ptr< ::apache::thrift::protocol::TProtocol> decoder =" << endl <<
+      indent() << "  this->__raw_" << fname << ".decoder();" << endl <<
+      indent() << "::apache::thrift::protocol::TProtocol* iprot = decoder.get();" << endl <<
+      indent() << "uint32_t xfer = 0;" << endl <<
+      indent() << "this->" << fname << " = " << type_name((*f_iter)->get_type()) << "();" << endl;
+    generate_deserialize_field(out, *f_iter, "this->");
+    out <<
+      indent() << "(void) xfer;" << endl <<
+      indent() << "this->__raw_" << fname << ".clear();" << endl;
+    scope_down(out);
+    out << endl;
+  }
+}
+
 /**
  * Generates a thrift service. In C++, this comprises an entirely separate
  * header and source file. The header file defines the methods and includes
@@ -1890,10 +2644,12 @@ void t_cpp_generator::generate_service_helpers(t_service* tservice) {
     generate_struct_definition(out, f_service_, ts, false);
     generate_struct_reader(out, ts);
     generate_struct_writer(out, ts);
+    generate_struct_writer(out, ts, false, true);
     ts->set_name(tservice->get_name() + "_" + (*f_iter)->get_name() + "_pargs");
     generate_struct_declaration(f_header_, ts, false, true, false, true);
     generate_struct_definition(out, f_service_, ts, false);
     generate_struct_writer(out, ts, true);
+    generate_struct_writer(out, ts, true, true);
     ts->set_name(name_orig);
 
     generate_function_helpers(tservice, *f_iter);
@@ -3347,6 +4103,7 @@ void t_cpp_generator::generate_function_helpers(t_service* tservice,
   generate_struct_definition(out, f_service_, &result, false);
   generate_struct_reader(out, &result);
   generate_struct_result_writer(out, &result);
+  generate_struct_result_writer(out, &result, false, true);
 
   result.set_name(tservice->get_name() + "_" + tfunction->get_name() + "_presult");
   generate_struct_declaration(f_header_, &result, false, true, true, gen_cob_style_);
@@ -3354,6 +4111,7 @@ void t_cpp_generator::generate_function_helpers(t_service* tservice,
   generate_struct_reader(out, &result, true);
   if (gen_cob_style_) {
     generate_struct_writer(out, &result, true);
+    generate_struct_writer(out, &result, true, true);
   }
 
 }
@@ -3551,6 +4309,12 @@ void t_cpp_generator::generate_process_function(t_service* tservice,
       indent() << "  this->eventHandler_->preWrite(ctx, " <<
         service_func_name << ");" << endl <<
       indent() << "}" << endl << endl <<
+      indent() << "if (oprot->hasSerializedSize()) {" << endl <<
+      indent() << "  oprot->getTransport()->reserveWrite(" << endl <<
+      indent() << "      oprot->serializedSizeMessageBegin(\"" <<
+        tfunction->get_name() << "\", ::apache::thrift::protocol::T_REPLY, seqid) +" << endl <<
+      indent() << "      result.serializedSize(oprot));" << endl <<
+      indent() << "}" << endl <<
       indent() << "oprot->writeMessageBegin(\"" << tfunction->get_name() <<
         "\", ::apache::thrift::protocol::T_REPLY, seqid);" << endl <<
       indent() << "result.write(oprot);" << endl <<
@@ -3775,6 +4539,12 @@ void t_cpp_generator::generate_process_function(t_service* tservice,
         indent() << "  this->eventHandler_->preWrite(ctx, " <<
           service_func_name << ");" << endl <<
         indent() << "}" << endl << endl <<
+        indent() << "if (oprot->hasSerializedSize()) {" << endl <<
+        indent() << "  oprot->getTransport()->reserveWrite(" << endl <<
+        indent() << "      oprot->serializedSizeMessageBegin(\"" <<
+          tfunction->get_name() << "\", ::apache::thrift::protocol::T_REPLY, seqid) +" << endl <<
+        indent() << "      result.serializedSize(oprot));" << endl <<
+        indent() << "}" << endl <<
         indent() << "oprot->writeMessageBegin(\"" << tfunction->get_name() <<
           "\", ::apache::thrift::protocol::T_REPLY, seqid);" << endl <<
         indent() << "result.write(oprot);" << endl <<
@@ -3883,6 +4653,12 @@ void t_cpp_generator::generate_process_function(t_service* tservice,
         indent() << "  this->eventHandler_->preWrite(ctx, " <<
           service_func_name << ");" << endl <<
         indent() << "}" << endl << endl <<
+        indent() << "if (oprot->hasSerializedSize()) {" << endl <<
+        indent() << "  oprot->getTransport()->reserveWrite(" << endl <<
+        indent() << "      oprot->serializedSizeMessageBegin(\"" <<
+          tfunction->get_name() << "\", ::apache::thrift::protocol::T_REPLY, seqid) +" << endl <<
+        indent() << "      result.serializedSize(oprot));" << endl <<
+        indent() << "}" << endl <<
         indent() << "oprot->writeMessageBegin(\"" << tfunction->get_name() <<
           "\", ::apache::thrift::protocol::T_REPLY, seqid);" << endl <<
         indent() << "result.write(oprot);" << endl <<
@@ -4022,10 +4798,10 @@ void t_cpp_generator::generate_deserialize_field(ofstream& out,
       break;
     case t_base_type::TYPE_STRING:
       if (((t_base_type*)type)->is_binary()) {
-        out << "readBinary(" << name << ");";
+        out << (in_view_ ? "readBinaryView(" : "readBinary(") << name << ");";
       }
       else {
-        out << "readString(" << name << ");";
+        out << (in_view_ ? "readStringView(" : "readString(") << name << ");";
       }
       break;
     case t_base_type::TYPE_BOOL:
@@ -4133,23 +4909,33 @@ void t_cpp_generator::generate_deserialize_container(ofstream& out,
   }
 
 
-  // For loop iterates over elements
-  string i = tmp("_i");
-  out <<
-    indent() << "uint32_t " << i << ";" << endl <<
-    indent() << "for (" << i << " = 0; " << i << " < " << size << "; ++" << i << ")" << endl;
+  string array_type = list_array_type(ttype);
+  if (!array_type.empty()) {
+    // Lists of numbers are read in one call, straight into the vector
+    indent(out) << "if (" << size << " > 0)" << endl;
+    indent_up();
+    indent(out) << "xfer += iprot->read" << array_type << "Array(&" <<
+      prefix << "[0], " << size << ");" << endl;
+    indent_down();
+  } else {
+    // For loop iterates over elements
+    string i = tmp("_i");
+    out <<
+      indent() << "uint32_t " << i << ";" << endl <<
+      indent() << "for (" << i << " = 0; " << i << " < " << size << "; ++" << i << ")" << endl;
 
-    scope_up(out);
+      scope_up(out);
 
-    if (ttype->is_map()) {
-      generate_deserialize_map_element(out, (t_map*)ttype, prefix);
-    } else if (ttype->is_set()) {
-      generate_deserialize_set_element(out, (t_set*)ttype, prefix);
-    } else if (ttype->is_list()) {
-      generate_deserialize_list_element(out, (t_list*)ttype, prefix, use_push, i);
-    }
+      if (ttype->is_map()) {
+        generate_deserialize_map_element(out, (t_map*)ttype, prefix);
+      } else if (ttype->is_set()) {
+        generate_deserialize_set_element(out, (t_set*)ttype, prefix);
+      } else if (ttype->is_list()) {
+        generate_deserialize_list_element(out, (t_list*)ttype, prefix, use_push, i);
+      }
 
-    scope_down(out);
+      scope_down(out);
+  }
 
   // Read container end
   if (ttype->is_map()) {
@@ -4224,12 +5010,15 @@ void t_cpp_generator::generate_deserialize_list_element(ofstream& out,
  *
  * @param tfield The field to serialize
  * @param prefix Name to prepend to field name
+ * @param size   Add up the serialized size instead of writing
  */
 void t_cpp_generator::generate_serialize_field(ofstream& out,
                                                t_field* tfield,
                                                string prefix,
-                                               string suffix) {
+                                               string suffix,
+                                               bool size) {
   t_type* type = get_true_type(tfield->get_type());
+  string verb = size ? "serializedSize" : "write";
 
   string name = prefix + tfield->get_name() + suffix;
 
@@ -4244,13 +5033,14 @@ void t_cpp_generator::generate_serialize_field(ofstream& out,
     generate_serialize_struct(out,
                               (t_struct*)type,
                               name, 
-                              is_reference(tfield));
+                              is_reference(tfield),
+                              size);
   } else if (type->is_container()) {
-    generate_serialize_container(out, type, name);
+    generate_serialize_container(out, type, name, size);
   } else if (type->is_base_type() || type->is_enum()) {
 
     indent(out) <<
-      "xfer += oprot->";
+      "xfer += oprot->" << verb;
 
     if (type->is_base_type()) {
       t_base_type::t_base tbase = ((t_base_type*)type)->get_base();
@@ -4261,35 +5051,35 @@ void t_cpp_generator::generate_serialize_field(ofstream& out,
         break;
       case t_base_type::TYPE_STRING:
         if (((t_base_type*)type)->is_binary()) {
-          out << "writeBinary(" << name << ");";
+          out << "Binary(" << name << ");";
         }
         else {
-          out << "writeString(" << name << ");";
+          out << "String(" << name << ");";
         }
         break;
       case t_base_type::TYPE_BOOL:
-        out << "writeBool(" << name << ");";
+        out << "Bool(" << name << ");";
         break;
       case t_base_type::TYPE_BYTE:
-        out << "writeByte(" << name << ");";
+        out << "Byte(" << name << ");";
         break;
       case t_base_type::TYPE_I16:
-        out << "writeI16(" << name << ");";
+        out << "I16(" << name << ");";
         break;
       case t_base_type::TYPE_I32:
-        out << "writeI32(" << name << ");";
+        out << "I32(" << name << ");";
         break;
       case t_base_type::TYPE_I64:
-        out << "writeI64(" << name << ");";
+        out << "I64(" << name << ");";
         break;
       case t_base_type::TYPE_DOUBLE:
-        out << "writeDouble(" << name << ");";
+        out << "Double(" << name << ");";
         break;
       default:
         throw "compiler error: no C++ writer for base type " + t_base_type::t_base_name(tbase) + name;
       }
     } else if (type->is_enum()) {
-      out << "writeI32((int32_t)" << name << ");";
+      out << "I32((int32_t)" << name << ");";
     }
     out << endl;
   } else {
@@ -4308,67 +5098,92 @@ void t_cpp_generator::generate_serialize_field(ofstream& out,
 void t_cpp_generator::generate_serialize_struct(ofstream& out,
                                                 t_struct* tstruct,
                                                 string prefix,
-                                                bool pointer) {
+                                                bool pointer,
+                                                bool size) {
+  string verb = size ? "serializedSize" : "write";
   if (pointer) {
     indent(out) << "if (" << prefix << ") {" << endl;
-    indent(out) << "  xfer += " << prefix << "->write(oprot); " << endl;
-    indent(out)  << "} else {" << "oprot->writeStructBegin(\"" <<
-      tstruct->get_name() << "\"); " << endl;
-    indent(out) << "  oprot->writeStructEnd();" << endl;
-    indent(out) << "  oprot->writeFieldStop();" << endl;
-    indent(out) << "}" << endl;
+    indent(out) << "  xfer += " << prefix << "->" << verb << "(oprot); " << endl;
+    if (size) {
+      indent(out) << "} else {" << endl;
+      indent(out) << "  xfer += oprot->serializedSizeStructBegin(\"" <<
+        tstruct->get_name() << "\");" << endl;
+      indent(out) << "  xfer += oprot->serializedSizeFieldStop();" << endl;
+      indent(out) << "  xfer += oprot->serializedSizeStructEnd();" << endl;
+      indent(out) << "}" << endl;
+    } else {
+      indent(out)  << "} else {" << "oprot->writeStructBegin(\"" <<
+        tstruct->get_name() << "\"); " << endl;
+      indent(out) << "  oprot->writeStructEnd();" << endl;
+      indent(out) << "  oprot->writeFieldStop();" << endl;
+      indent(out) << "}" << endl;
+    }
   } else {
     indent(out) <<
-      "xfer += " << prefix << ".write(oprot);" << endl;
+      "xfer += " << prefix << "." << verb << "(oprot);" << endl;
   }
 }
 
 void t_cpp_generator::generate_serialize_container(ofstream& out,
                                                    t_type* ttype,
-                                                   string prefix) {
+                                                   string prefix,
+                                                   bool size) {
+  string verb = size ? "serializedSize" : "write";
   scope_up(out);
 
   if (ttype->is_map()) {
     indent(out) <<
-      "xfer += oprot->writeMapBegin(" <<
+      "xfer += oprot->" << verb << "MapBegin(" <<
       type_to_enum(((t_map*)ttype)->get_key_type()) << ", " <<
       type_to_enum(((t_map*)ttype)->get_val_type()) << ", " <<
       "static_cast<uint32_t>(" << prefix << ".size()));" << endl;
   } else if (ttype->is_set()) {
     indent(out) <<
-      "xfer += oprot->writeSetBegin(" <<
+      "xfer += oprot->" << verb << "SetBegin(" <<
       type_to_enum(((t_set*)ttype)->get_elem_type()) << ", " <<
       "static_cast<uint32_t>(" << prefix << ".size()));" << endl;
   } else if (ttype->is_list()) {
     indent(out) <<
-      "xfer += oprot->writeListBegin(" <<
+      "xfer += oprot->" << verb << "ListBegin(" <<
       type_to_enum(((t_list*)ttype)->get_elem_type()) << ", " <<
       "static_cast<uint32_t>(" << prefix << ".size()));" << endl;
   }
 
-  string iter = tmp("_iter");
-  out <<
-    indent() << type_name(ttype) << "::const_iterator " << iter << ";" << endl <<
-    indent() << "for (" << iter << " = " << prefix  << ".begin(); " << iter << " != " << prefix << ".end(); ++" << iter << ")" << endl;
-  scope_up(out);
+  string array_type = list_array_type(ttype);
+  if (!array_type.empty()) {
+    indent(out) << "if (!" << prefix << ".empty())" << endl;
+    indent_up();
+    indent(out) << "xfer += oprot->" << verb << array_type << "Array(&" <<
+      prefix << "[0], static_cast<uint32_t>(" << prefix << ".size()));" << endl;
+    indent_down();
+  } else {
+    string iter = tmp("_iter");
+    out <<
+      indent() << type_name(ttype) << "::const_iterator " << iter << ";" << endl <<
+      indent() << "for (" << iter << " = " << prefix  << ".begin(); " << iter << " != " << prefix << ".end(); ++" << iter << ")" << endl;
+    scope_up(out);
+      if (ttype->is_map()) {
+        generate_serialize_map_element(out, (t_map*)ttype, iter, size);
+      } else if (ttype->is_set()) {
+        generate_serialize_set_element(out, (t_set*)ttype, iter, size);
+      } else if (ttype->is_list()) {
+        generate_serialize_list_element(out, (t_list*)ttype, iter, size);
+      }
+    scope_down(out);
+  }
+
+  // The end markers are empty in every protocol that supports sizing
+  if (!size) {
     if (ttype->is_map()) {
-      generate_serialize_map_element(out, (t_map*)ttype, iter);
+      indent(out) <<
+        "xfer += oprot->writeMapEnd();" << endl;
     } else if (ttype->is_set()) {
-      generate_serialize_set_element(out, (t_set*)ttype, iter);
+      indent(out) <<
+        "xfer += oprot->writeSetEnd();" << endl;
     } else if (ttype->is_list()) {
-      generate_serialize_list_element(out, (t_list*)ttype, iter);
+      indent(out) <<
+        "xfer += oprot->writeListEnd();" << endl;
     }
-  scope_down(out);
-
-  if (ttype->is_map()) {
-    indent(out) <<
-      "xfer += oprot->writeMapEnd();" << endl;
-  } else if (ttype->is_set()) {
-    indent(out) <<
-      "xfer += oprot->writeSetEnd();" << endl;
-  } else if (ttype->is_list()) {
-    indent(out) <<
-      "xfer += oprot->writeListEnd();" << endl;
   }
 
   scope_down(out);
@@ -4380,12 +5195,13 @@ void t_cpp_generator::generate_serialize_container(ofstream& out,
  */
 void t_cpp_generator::generate_serialize_map_element(ofstream& out,
                                                      t_map* tmap,
-                                                     string iter) {
+                                                     string iter,
+                                                     bool size) {
   t_field kfield(tmap->get_key_type(), iter + "->first");
-  generate_serialize_field(out, &kfield, "");
+  generate_serialize_field(out, &kfield, "", "", size);
 
   t_field vfield(tmap->get_val_type(), iter + "->second");
-  generate_serialize_field(out, &vfield, "");
+  generate_serialize_field(out, &vfield, "", "", size);
 }
 
 /**
@@ -4393,9 +5209,10 @@ void t_cpp_generator::generate_serialize_map_element(ofstream& out,
  */
 void t_cpp_generator::generate_serialize_set_element(ofstream& out,
                                                      t_set* tset,
-                                                     string iter) {
+                                                     string iter,
+                                                     bool size) {
   t_field efield(tset->get_elem_type(), "(*" + iter + ")");
-  generate_serialize_field(out, &efield, "");
+  generate_serialize_field(out, &efield, "", "", size);
 }
 
 /**
@@ -4403,9 +5220,10 @@ void t_cpp_generator::generate_serialize_set_element(ofstream& out,
  */
 void t_cpp_generator::generate_serialize_list_element(ofstream& out,
                                                       t_list* tlist,
-                                                      string iter) {
+                                                      string iter,
+                                                      bool size) {
   t_field efield(tlist->get_elem_type(), "(*" + iter + ")");
-  generate_serialize_field(out, &efield, "");
+  generate_serialize_field(out, &efield, "", "", size);
 }
 
 /**
@@ -4492,12 +5310,20 @@ string t_cpp_generator::namespace_close(string ns) {
  * @return String of the type name, i.e. std::set<type>
  */
 string t_cpp_generator::type_name(t_type* ttype, bool in_typedef, bool arg) {
+  if (in_view_) {
+    // Typedefs name the owning types, so look through them
+    ttype = get_true_type(ttype);
+  }
+
   if (ttype->is_base_type()) {
     string bname = base_type_name(((t_base_type*)ttype)->get_base());
     std::map<string, string>::iterator it = ttype->annotations_.find("cpp.type");
     if (it != ttype->annotations_.end()) {
       bname = it->second;
     }
+    if (in_view_ && ((t_base_type*)ttype)->get_base() == t_base_type::TYPE_STRING) {
+      bname = "::apache::thrift::TStringView";
+    }
 
     if (!arg) {
       return bname;
@@ -4519,15 +5345,35 @@ string t_cpp_generator::type_name(t_type* ttype, bool in_typedef, bool arg) {
       cname = tcontainer->get_cpp_name();
     } else if (ttype->is_map()) {
       t_map* tmap = (t_map*) ttype;
-      cname = "std::map<" +
-        type_name(tmap->get_key_type(), in_typedef) + ", " +
-        type_name(tmap->get_val_type(), in_typedef) + "> ";
+      string ktype = type_name(tmap->get_key_type(), in_typedef);
+      string vtype = type_name(tmap->get_val_type(), in_typedef);
+      if (gen_arena_) {
+        cname = "std::map<" + ktype + ", " + vtype + ", std::less<" + ktype +
+          " >, " + arena_allocator("std::pair<const " + ktype + ", " + vtype + " >") + "> ";
+      } else {
+        cname = "std::map<" + ktype + ", " + vtype + "> ";
+      }
     } else if (ttype->is_set()) {
       t_set* tset = (t_set*) ttype;
-      cname = "std::set<" + type_name(tset->get_elem_type(), in_typedef) + "> ";
+      string etype = type_name(tset->get_elem_type(), in_typedef);
+      if (gen_arena_) {
+        cname = "std::set<" + etype + ", std::less<" + etype + " >, " +
+          arena_allocator(etype) + "> ";
+      } else {
+        cname = "std::set<" + etype + "> ";
+      }
     } else if (ttype->is_list()) {
       t_list* tlist = (t_list*) ttype;
-      cname = "std::vector<" + type_name(tlist->get_elem_type(), in_typedef) + "> ";
+      string etype = type_name(tlist->get_elem_type(), in_typedef);
+      // Protocols read bool lists through std::vector<bool>::reference
+      t_type* elem = get_true_type(tlist->get_elem_type());
+      bool is_bool = elem->is_base_type() &&
+        ((t_base_type*)elem)->get_base() == t_base_type::TYPE_BOOL;
+      if (gen_arena_ && !is_bool) {
+        cname = "std::vector<" + etype + ", " + arena_allocator(etype) + "> ";
+      } else {
+        cname = "std::vector<" + etype + "> ";
+      }
     }
 
     if (arg) {
@@ -4558,6 +5404,12 @@ string t_cpp_generator::type_name(t_type* ttype, bool in_typedef, bool arg) {
     pname += "::type";
   }
 
+  // XXX: Like templates, this assumes included files were also generated
+  // with views.
+  if (in_view_ && (ttype->is_struct() || ttype->is_xception())) {
+    pname += "View";
+  }
+
   if (arg) {
     if (is_complex_type(ttype)) {
       return "const " + pname + "&";
@@ -4779,6 +5631,46 @@ string t_cpp_generator::type_to_enum(t_type* type) {
   throw "INVALID TYPE IN type_to_enum: " + type->get_name();
 }
 
+/**
+ * Decides whether a container can go through the protocol's bulk array
+ * calls: a plain std::vector of i32, i64 or double.
+ *
+ * @param ttype Container type
+ * @return "I32", "I64" or "Double" to name the array call, or "" if the
+ *         elements have to be read and written one at a time
+ */
+string t_cpp_generator::list_array_type(t_type* ttype) {
+  if (!ttype->is_list() || ((t_list*)ttype)->has_cpp_name()) {
+    return "";
+  }
+
+  t_type* etype = get_true_type(((t_list*)ttype)->get_elem_type());
+  if (!etype->is_base_type() ||
+      etype->annotations_.find("cpp.type") != etype->annotations_.end()) {
+    return "";
+  }
+
+  switch (((t_base_type*)etype)->get_base()) {
+  case t_base_type::TYPE_I32:
+    return "I32";
+  case t_base_type::TYPE_I64:
+    return "I64";
+  case t_base_type::TYPE_DOUBLE:
+    return "Double";
+  default:
+    return "";
+  }
+}
+
+/**
+ * Names the allocator for containers generated with the arena option.
+ *
+ * @param value_type C++ type of the allocated elements
+ */
+string t_cpp_generator::arena_allocator(string value_type) {
+  return "::apache::thrift::TArenaAllocator<" + value_type + " > ";
+}
+
 /**
  * Returns the symbol name of the local reflection of a type.
  */
@@ -4851,5 +5743,13 @@ THRIFT_REGISTER_GENERATOR(cpp, "C++",
 "    pure_enums:      Generate pure enums instead of wrapper classes.\n"
 "    dense:           Generate type specifications for the dense protocol.\n"
 "    include_prefix:  Use full include paths in generated files.\n"
+"    views:           Also generate read-only FooView structs that read strings and\n"
+"                     binaries as views into the transport's buffer, without copying.\n"
+"    arena:           Allocate containers from the current TArena, if any.\n"
+"    projection:      Generate readFields(), which decodes only the fields named in a\n"
+"                     TFieldMask and skips the rest.\n"
+"    tables:          Read and write structs through static field tables and the shared\n"
+"                     TTableCodec, for smaller code.  Structs that hold a struct from an\n"
+"                     included program keep generated read() and write().\n"
 )
 
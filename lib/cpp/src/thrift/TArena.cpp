@@ -0,0 +1,150 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/TArena.h>
+
+#include <cassert>
+#include <cstdlib>
+
+namespace apache { namespace thrift {
+
+namespace {
+
+#ifdef _WIN32
+__declspec(thread) TArena* currentArena = NULL;
+#else
+__thread TArena* currentArena = NULL;
+#endif
+
+}
+
+const size_t TArena::DEFAULT_BLOCK_SIZE;
+const size_t TArena::ALIGNMENT;
+const size_t TArena::HEADER_SIZE;
+
+TArena::TArena(size_t blockSize)
+  : blocks_(NULL),
+    blockStart_(NULL),
+    pos_(NULL),
+    end_(NULL),
+    used_(0),
+    live_(0),
+    blockSize_(blockSize < 4 * ALIGNMENT ? 4 * ALIGNMENT : blockSize) {
+}
+
+TArena::~TArena() {
+  while (blocks_ != NULL) {
+    Block* next = blocks_->next;
+    std::free(blocks_);
+    blocks_ = next;
+  }
+}
+
+void TArena::reset() {
+  // Anything still alive would be left pointing into freed blocks
+  assert(live_ == 0);
+
+  // Keep one ordinary block; oversized ones were for single allocations
+  Block* keep = NULL;
+  while (blocks_ != NULL) {
+    Block* next = blocks_->next;
+    if (keep == NULL && blocks_->size == blockSize_) {
+      keep = blocks_;
+      keep->next = NULL;
+    } else {
+      std::free(blocks_);
+    }
+    blocks_ = next;
+  }
+
+  used_ = 0;
+  if (keep != NULL) {
+    blocks_ = keep;
+    startBlock(keep);
+  } else {
+    blockStart_ = pos_ = end_ = NULL;
+  }
+}
+
+TArena* TArena::getCurrent() {
+  return currentArena;
+}
+
+void TArena::setCurrent(TArena* arena) {
+  currentArena = arena;
+}
+
+void* TArena::allocateTagged(size_t n) {
+  TArena* arena = currentArena;
+  void* raw;
+  if (arena != NULL) {
+    raw = arena->allocate(n + ALIGNMENT);
+    ++arena->live_;
+  } else {
+    raw = ::operator new(n + ALIGNMENT);
+  }
+  *static_cast<TArena**>(raw) = arena;
+  return static_cast<char*>(raw) + ALIGNMENT;
+}
+
+void* TArena::allocateSlow(size_t n) {
+  if (n > blockSize_ / 4) {
+    // Too big to share a block: give it one of its own and keep filling
+    // the current block afterwards
+    Block* block = newBlock(n);
+    used_ += n;
+    if (blocks_ == NULL) {
+      blocks_ = block;
+    } else {
+      block->next = blocks_->next;
+      blocks_->next = block;
+    }
+    return reinterpret_cast<char*>(block) + HEADER_SIZE;
+  }
+
+  Block* block = newBlock(blockSize_);
+  if (blocks_ != NULL) {
+    used_ += pos_ - blockStart_;
+  }
+  block->next = blocks_;
+  blocks_ = block;
+  startBlock(block);
+
+  void* p = pos_;
+  pos_ += n;
+  return p;
+}
+
+TArena::Block* TArena::newBlock(size_t size) {
+  Block* block = static_cast<Block*>(std::malloc(HEADER_SIZE + size));
+  if (block == NULL) {
+    throw std::bad_alloc();
+  }
+  block->next = NULL;
+  block->size = size;
+  return block;
+}
+
+void TArena::startBlock(Block* block) {
+  blockStart_ = reinterpret_cast<char*>(block) + HEADER_SIZE;
+  pos_ = blockStart_;
+  end_ = blockStart_ + block->size;
+}
+
+}} // apache::thrift
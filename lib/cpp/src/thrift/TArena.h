@@ -0,0 +1,242 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TARENA_H_
+#define _THRIFT_TARENA_H_ 1
+
+#include <stddef.h>
+#include <limits>
+#include <new>
+#include <boost/noncopyable.hpp>
+
+namespace apache { namespace thrift {
+
+/**
+ * Monotonic allocator for request-scoped objects.
+ *
+ * Memory is handed out by bumping a pointer through blocks of blockSize
+ * bytes, and is given back all at once by reset().  Nothing is freed
+ * individually.
+ *
+ * Most code does not call allocate() directly.  Containers in structs
+ * generated with the cpp:arena option use TArenaAllocator, which takes its
+ * memory from the arena made current on this thread by a TArena::Scope, and
+ * from the heap when there is none.  Anything allocated while a scope is
+ * active must be destroyed, or at least never touched again, before the
+ * arena is reset.  Open a TArena::Scope(NULL) to build values that have to
+ * outlive the request.
+ *
+ * The arena counts the TArenaAllocator allocations it has handed out that
+ * are not yet freed.  reset() asserts that none are left, so a container
+ * that was copied out of a request and would otherwise dangle is caught in
+ * debug builds.
+ */
+class TArena : boost::noncopyable {
+ public:
+  static const size_t DEFAULT_BLOCK_SIZE = 16384;
+
+  /// Every allocation is aligned to this many bytes
+  static const size_t ALIGNMENT = 16;
+
+  explicit TArena(size_t blockSize = DEFAULT_BLOCK_SIZE);
+
+  ~TArena();
+
+  /**
+   * Returns n bytes, aligned to ALIGNMENT, that stay valid until reset().
+   *
+   * @throws std::bad_alloc if a new block cannot be allocated.
+   */
+  void* allocate(size_t n) {
+    n = (n + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    if (static_cast<size_t>(end_ - pos_) >= n) {
+      void* p = pos_;
+      pos_ += n;
+      return p;
+    }
+    return allocateSlow(n);
+  }
+
+  /**
+   * Gives back everything allocated so far.  One block is kept for reuse
+   * and the rest are freed.  Every TArenaAllocator allocation from this
+   * arena must have been freed first.
+   */
+  void reset();
+
+  /// Bytes handed out since construction or the last reset()
+  size_t getBytesUsed() const {
+    return used_ + (pos_ - blockStart_);
+  }
+
+  size_t getBlockSize() const {
+    return blockSize_;
+  }
+
+  /// TArenaAllocator allocations from this arena that are not yet freed
+  size_t getLiveAllocations() const {
+    return live_;
+  }
+
+  /// The arena TArenaAllocator uses on this thread, or NULL for the heap
+  static TArena* getCurrent();
+
+  /**
+   * Makes an arena current on this thread for the lifetime of the scope
+   * and restores the previous one afterwards.  Scopes nest, and a NULL
+   * arena sends allocations back to the heap.
+   */
+  class Scope : boost::noncopyable {
+   public:
+    explicit Scope(TArena* arena) : previous_(getCurrent()) {
+      setCurrent(arena);
+    }
+
+    ~Scope() {
+      setCurrent(previous_);
+    }
+
+   private:
+    TArena* previous_;
+  };
+  friend class Scope;
+
+  /*
+   * Used by TArenaAllocator.  Each allocation is prefixed with the arena it
+   * came from, so memory can be freed correctly whichever scope is current
+   * when it is released.
+   */
+  static void* allocateTagged(size_t n);
+
+  static void deallocateTagged(void* p) {
+    char* raw = static_cast<char*>(p) - ALIGNMENT;
+    TArena* arena = *reinterpret_cast<TArena**>(raw);
+    if (arena == NULL) {
+      ::operator delete(raw);
+    } else {
+      --arena->live_;
+    }
+  }
+
+ private:
+  struct Block {
+    Block* next;
+    size_t size;
+  };
+
+  /// Size of a Block header, rounded up so block data stays aligned
+  static const size_t HEADER_SIZE =
+    (sizeof(Block) + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+
+  static void setCurrent(TArena* arena);
+
+  void* allocateSlow(size_t n);
+
+  Block* newBlock(size_t size);
+
+  void startBlock(Block* block);
+
+  /// Blocks in use, most recently started first
+  Block* blocks_;
+
+  char* blockStart_;
+  char* pos_;
+  char* end_;
+
+  /// Bytes used in blocks other than the current one
+  size_t used_;
+
+  /// Tagged allocations not yet passed to deallocateTagged()
+  size_t live_;
+
+  size_t blockSize_;
+};
+
+/**
+ * STL allocator that draws from the current TArena.
+ *
+ * It holds no state, so every instance compares equal and containers can
+ * swap or splice freely, even between arenas.
+ */
+template <class T>
+class TArenaAllocator {
+ public:
+  typedef T value_type;
+  typedef T* pointer;
+  typedef const T* const_pointer;
+  typedef T& reference;
+  typedef const T& const_reference;
+  typedef size_t size_type;
+  typedef ptrdiff_t difference_type;
+
+  template <class U>
+  struct rebind {
+    typedef TArenaAllocator<U> other;
+  };
+
+  TArenaAllocator() {}
+
+  template <class U>
+  TArenaAllocator(const TArenaAllocator<U>&) {}
+
+  pointer address(reference x) const {
+    return &x;
+  }
+
+  const_pointer address(const_reference x) const {
+    return &x;
+  }
+
+  pointer allocate(size_type n, const void* = 0) {
+    if (n > max_size()) {
+      throw std::bad_alloc();
+    }
+    return static_cast<pointer>(TArena::allocateTagged(n * sizeof(T)));
+  }
+
+  void deallocate(pointer p, size_type) {
+    TArena::deallocateTagged(p);
+  }
+
+  size_type max_size() const {
+    return (std::numeric_limits<size_type>::max() - TArena::ALIGNMENT) / sizeof(T);
+  }
+
+  void construct(pointer p, const T& value) {
+    new (static_cast<void*>(p)) T(value);
+  }
+
+  void destroy(pointer p) {
+    p->~T();
+  }
+};
+
+template <class T, class U>
+inline bool operator==(const TArenaAllocator<T>&, const TArenaAllocator<U>&) {
+  return true;
+}
+
+template <class T, class U>
+inline bool operator!=(const TArenaAllocator<T>&, const TArenaAllocator<U>&) {
+  return false;
+}
+
+}} // apache::thrift
+
+#endif // #ifndef _THRIFT_TARENA_H_
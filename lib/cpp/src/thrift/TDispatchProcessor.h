@@ -20,9 +20,20 @@
 #define _THRIFT_TDISPATCHPROCESSOR_H_ 1
 
 #include <thrift/TProcessor.h>
+#include <thrift/protocol/TDeadlineProtocol.h>
 
 namespace apache { namespace thrift {
 
+/**
+ * Reads the rest of a call whose deadline has passed, so that the next one
+ * can be processed.  No reply is sent; the client has stopped waiting.
+ */
+inline void skipExpiredCall(protocol::TProtocol* in) {
+  in->skip(protocol::T_STRUCT);
+  in->readMessageEnd();
+  in->getTransport()->readEnd();
+}
+
 /**
  * TDispatchProcessor is a helper class to parse the message header then call
  * another function to dispatch based on the function name.
@@ -42,7 +53,7 @@ class TDispatchProcessorT : public TProcessor {
     Protocol_* specificIn = dynamic_cast<Protocol_*>(inRaw);
     Protocol_* specificOut = dynamic_cast<Protocol_*>(outRaw);
     if (specificIn && specificOut) {
-      return processFast(specificIn, specificOut, connectionContext);
+      return processFast(specificIn, specificOut, out, connectionContext);
     }
 
     // Log the fact that we have to use the slow path
@@ -65,11 +76,25 @@ class TDispatchProcessorT : public TProcessor {
       return false;
     }
 
+    int64_t deadline;
+    if (protocol::TDeadlineProtocol::stripDeadline(fname, deadline)) {
+      if (protocol::TDeadlineProtocol::isExpired(deadline)) {
+        skipExpiredCall(inRaw);
+        return true;
+      }
+      protocol::TDeadlineProtocol deadlineOut(out);
+      deadlineOut.setDeadline(deadline);
+      return this->dispatchCall(inRaw, &deadlineOut, fname, seqid,
+                                connectionContext);
+    }
+
     return this->dispatchCall(inRaw, outRaw, fname, seqid, connectionContext);
   }
 
  protected:
-  bool processFast(Protocol_* in, Protocol_* out, void* connectionContext) {
+  bool processFast(Protocol_* in, Protocol_* out,
+                   const boost::shared_ptr<protocol::TProtocol>& outPtr,
+                   void* connectionContext) {
     std::string fname;
     protocol::TMessageType mtype;
     int32_t seqid;
@@ -81,6 +106,20 @@ class TDispatchProcessorT : public TProcessor {
       return false;
     }
 
+    // Calls with a deadline take the generic path, replying through a
+    // decorator that can drop the reply
+    int64_t deadline;
+    if (protocol::TDeadlineProtocol::stripDeadline(fname, deadline)) {
+      if (protocol::TDeadlineProtocol::isExpired(deadline)) {
+        skipExpiredCall(in);
+        return true;
+      }
+      protocol::TDeadlineProtocol deadlineOut(outPtr);
+      deadlineOut.setDeadline(deadline);
+      return this->dispatchCall(in, &deadlineOut, fname, seqid,
+                                connectionContext);
+    }
+
     return this->dispatchCallTemplated(in, out, fname,
                                        seqid, connectionContext);
   }
@@ -118,6 +157,18 @@ class TDispatchProcessor : public TProcessor {
       return false;
     }
 
+    int64_t deadline;
+    if (protocol::TDeadlineProtocol::stripDeadline(fname, deadline)) {
+      if (protocol::TDeadlineProtocol::isExpired(deadline)) {
+        skipExpiredCall(in.get());
+        return true;
+      }
+      protocol::TDeadlineProtocol deadlineOut(out);
+      deadlineOut.setDeadline(deadline);
+      return dispatchCall(in.get(), &deadlineOut, fname, seqid,
+                          connectionContext);
+    }
+
     return dispatchCall(in.get(), out.get(), fname, seqid, connectionContext);
   }
 
@@ -0,0 +1,91 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/TFieldMask.h>
+
+namespace apache { namespace thrift {
+
+TFieldMask::TFieldMask(const TFieldMask& other)
+  : all_(false),
+    bits_(0) {
+  *this = other;
+}
+
+TFieldMask& TFieldMask::operator=(const TFieldMask& other) {
+  if (this == &other) {
+    return *this;
+  }
+  all_ = other.all_;
+  bits_ = other.bits_;
+  // Nested masks are copied too, so changing a copy leaves other alone
+  FieldMap fields;
+  for (FieldMap::const_iterator it = other.fields_.begin();
+       it != other.fields_.end(); ++it) {
+    fields[it->first].reset(new TFieldMask(*it->second));
+  }
+  fields_.swap(fields);
+  return *this;
+}
+
+const TFieldMask& TFieldMask::all() {
+  static const TFieldMask allMask(true);
+  return allMask;
+}
+
+TFieldMask& TFieldMask::add(int16_t id) {
+  TFieldMask& child = addNested(id);
+  child.all_ = true;
+  child.bits_ = 0;
+  child.fields_.clear();
+  return *this;
+}
+
+TFieldMask& TFieldMask::addNested(int16_t id) {
+  if (all_) {
+    return *this;
+  }
+  boost::shared_ptr<TFieldMask>& child = fields_[id];
+  if (!child) {
+    child.reset(new TFieldMask());
+    if (id >= 0 && id < 64) {
+      bits_ |= static_cast<uint64_t>(1) << id;
+    }
+  }
+  return *child;
+}
+
+const TFieldMask& TFieldMask::nested(int16_t id) const {
+  FieldMap::const_iterator it = fields_.find(id);
+  if (all_ || it == fields_.end()) {
+    return all();
+  }
+  return *it->second;
+}
+
+std::string TFieldMask::trim(const std::string& str) {
+  const char* space = " \t\r\n";
+  std::string::size_type first = str.find_first_not_of(space);
+  if (first == std::string::npos) {
+    return std::string();
+  }
+  std::string::size_type last = str.find_last_not_of(space);
+  return str.substr(first, last - first + 1);
+}
+
+}} // apache::thrift
@@ -0,0 +1,122 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TFIELDMASK_H_
+#define _THRIFT_TFIELDMASK_H_ 1
+
+#include <thrift/Thrift.h>
+
+#include <map>
+#include <string>
+#include <boost/shared_ptr.hpp>
+
+namespace apache { namespace thrift {
+
+/**
+ * The set of fields to decode from a struct, for the readFields() function
+ * of structs generated with the cpp:projection option.  Fields left out are
+ * skipped on the wire and keep whatever value they had.
+ *
+ * A struct field can be included whole, or through a nested mask naming the
+ * fields to decode from it.  Masks are meant to be built once, typically
+ * from field names with fromPaths(), and then shared read-only.
+ */
+class TFieldMask {
+ public:
+  /// An empty mask, which includes no fields
+  TFieldMask() : all_(false), bits_(0) {}
+
+  TFieldMask(const TFieldMask& other);
+
+  TFieldMask& operator=(const TFieldMask& other);
+
+  /// A mask that includes every field, nested ones too
+  static const TFieldMask& all();
+
+  /**
+   * Builds a mask for Struct_ from a comma-separated list of field names.
+   * A dotted name such as "header.id" includes just that field of a struct
+   * field.
+   *
+   * @throws TException if a name does not match a field of Struct_.
+   */
+  template <class Struct_>
+  static TFieldMask fromPaths(const std::string& paths) {
+    TFieldMask mask;
+    std::string::size_type start = 0;
+    while (start <= paths.size()) {
+      std::string::size_type end = paths.find(',', start);
+      if (end == std::string::npos) {
+        end = paths.size();
+      }
+      std::string path = trim(paths.substr(start, end - start));
+      if (!path.empty() && !Struct_::addToFieldMask(mask, path)) {
+        throw TException("TFieldMask: no field named " + path);
+      }
+      start = end + 1;
+    }
+    return mask;
+  }
+
+  /// Includes the whole of field id
+  TFieldMask& add(int16_t id);
+
+  /**
+   * Returns the nested mask for struct field id, including the field if it
+   * is not yet.  If the whole field is already included this is an all()
+   * mask, and adding to it changes nothing.
+   */
+  TFieldMask& addNested(int16_t id);
+
+  bool isAll() const {
+    return all_;
+  }
+
+  bool includes(int16_t id) const {
+    if (all_) {
+      return true;
+    }
+    if (id >= 0 && id < 64) {
+      return (bits_ >> id) & 1;
+    }
+    return fields_.find(id) != fields_.end();
+  }
+
+  /// The mask for the fields of struct field id, or all() if it has none
+  const TFieldMask& nested(int16_t id) const;
+
+ private:
+  explicit TFieldMask(bool all) : all_(all), bits_(0) {}
+
+  typedef std::map<int16_t, boost::shared_ptr<TFieldMask> > FieldMap;
+
+  static std::string trim(const std::string& str);
+
+  bool all_;
+
+  /// Fields 0 to 63, for a quick includes()
+  uint64_t bits_;
+
+  /// Every included field, with its nested mask
+  FieldMap fields_;
+};
+
+}} // apache::thrift
+
+#endif // #ifndef _THRIFT_TFIELDMASK_H_
@@ -0,0 +1,114 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TSTRINGVIEW_H_
+#define _THRIFT_TSTRINGVIEW_H_ 1
+
+#include <stdint.h>
+#include <string.h>
+#include <ostream>
+#include <string>
+
+namespace apache { namespace thrift {
+
+/**
+ * Non-owning reference to a string or binary value.
+ *
+ * Structs generated with the cpp:views option read their string and binary
+ * fields as views into the transport's read buffer instead of copying them
+ * out.  A view stays valid only as long as those bytes do: for a
+ * TMemoryBuffer until it is reset, written to or destroyed, and for a
+ * TFramedTransport until the next frame is read.  Call str() to keep a
+ * value beyond that.
+ */
+class TStringView {
+ public:
+  TStringView() : data_(NULL), size_(0) {}
+
+  TStringView(const char* data, uint32_t size) : data_(data), size_(size) {}
+
+  TStringView(const char* str)
+    : data_(str), size_(static_cast<uint32_t>(strlen(str))) {}
+
+  TStringView(const std::string& str)
+    : data_(str.data()), size_(static_cast<uint32_t>(str.size())) {}
+
+  const char* data() const {
+    return data_;
+  }
+
+  uint32_t size() const {
+    return size_;
+  }
+
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  const char* begin() const {
+    return data_;
+  }
+
+  const char* end() const {
+    return data_ + size_;
+  }
+
+  char operator[](uint32_t i) const {
+    return data_[i];
+  }
+
+  /// Copies the viewed bytes into a string that owns them
+  std::string str() const {
+    return std::string(data_, size_);
+  }
+
+  /// Orders views like std::string::compare()
+  int compare(const TStringView& other) const {
+    uint32_t n = size_ < other.size_ ? size_ : other.size_;
+    int cmp = n == 0 ? 0 : memcmp(data_, other.data_, n);
+    if (cmp != 0) {
+      return cmp;
+    }
+    return size_ < other.size_ ? -1 : (size_ > other.size_ ? 1 : 0);
+  }
+
+ private:
+  const char* data_;
+  uint32_t size_;
+};
+
+inline bool operator==(const TStringView& a, const TStringView& b) {
+  return a.size() == b.size() && a.compare(b) == 0;
+}
+
+inline bool operator!=(const TStringView& a, const TStringView& b) {
+  return !(a == b);
+}
+
+inline bool operator<(const TStringView& a, const TStringView& b) {
+  return a.compare(b) < 0;
+}
+
+inline std::ostream& operator<<(std::ostream& out, const TStringView& str) {
+  return out.write(str.data(), str.size());
+}
+
+}} // apache::thrift
+
+#endif // #ifndef _THRIFT_TSTRINGVIEW_H_
@@ -20,9 +20,27 @@
 #define _THRIFT_ASYNC_TASYNCDISPATCHPROCESSOR_H_ 1
 
 #include <thrift/async/TAsyncProcessor.h>
+#include <thrift/TDispatchProcessor.h>
 
 namespace apache { namespace thrift { namespace async {
 
+/**
+ * Strips a client deadline from a call's name.  Replies are written after
+ * process() returns, so unlike TDispatchProcessor only calls that are
+ * already late on arrival get dropped.
+ *
+ * @return true if the call was late and has been skipped
+ */
+inline bool skipIfExpired(std::string& fname, protocol::TProtocol* in) {
+  int64_t deadline;
+  if (protocol::TDeadlineProtocol::stripDeadline(fname, deadline) &&
+      protocol::TDeadlineProtocol::isExpired(deadline)) {
+    skipExpiredCall(in);
+    return true;
+  }
+  return false;
+}
+
 /**
  * TAsyncDispatchProcessor is a helper class to parse the message header then
  * call another function to dispatch based on the function name.
@@ -66,6 +84,11 @@ class TAsyncDispatchProcessorT : public TAsyncProcessor {
       return;
     }
 
+    if (skipIfExpired(fname, inRaw)) {
+      _return(true);
+      return;
+    }
+
     return this->dispatchCall(_return, inRaw, outRaw, fname, seqid);
   }
 
@@ -83,6 +106,11 @@ class TAsyncDispatchProcessorT : public TAsyncProcessor {
       return;
     }
 
+    if (skipIfExpired(fname, in)) {
+      _return(true);
+      return;
+    }
+
     return this->dispatchCallTemplated(_return, in, out, fname, seqid);
   }
 
@@ -126,6 +154,11 @@ class TAsyncDispatchProcessor : public TAsyncProcessor {
       return;
     }
 
+    if (skipIfExpired(fname, inRaw)) {
+      _return(true);
+      return;
+    }
+
     return dispatchCall(_return, inRaw, outRaw, fname, seqid);
   }
 
@@ -0,0 +1,134 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_CONCURRENCY_ATOMIC_H_
+#define _THRIFT_CONCURRENCY_ATOMIC_H_ 1
+
+#ifdef _WIN32
+#include <thrift/windows/config.h>
+#endif
+
+namespace apache { namespace thrift { namespace concurrency {
+
+/*
+ * Minimal set of atomic operations for the few lock-free structures in the
+ * library.  They map onto the compiler builtins (or Interlocked* calls on
+ * Windows) and are all full memory barriers.
+ */
+
+/**
+ * Sets *ptr to newval if it still equals oldval.
+ *
+ * @return the value *ptr had before the call
+ */
+template <typename T>
+inline T* atomicCompareAndSwap(T* volatile* ptr, T* oldval, T* newval) {
+#ifdef _WIN32
+  return static_cast<T*>(InterlockedCompareExchangePointer(
+      reinterpret_cast<PVOID volatile*>(ptr), newval, oldval));
+#else
+  return __sync_val_compare_and_swap(ptr, oldval, newval);
+#endif
+}
+
+/**
+ * Sets *ptr to newval if it still equals oldval.
+ *
+ * @return the value *ptr had before the call
+ */
+inline long atomicCompareAndSwap(volatile long* ptr, long oldval, long newval) {
+#ifdef _WIN32
+  return InterlockedCompareExchange(ptr, newval, oldval);
+#else
+  return __sync_val_compare_and_swap(ptr, oldval, newval);
+#endif
+}
+
+/**
+ * Stores newval in *ptr.
+ *
+ * @return the value *ptr had before the call
+ */
+template <typename T>
+inline T* atomicExchange(T* volatile* ptr, T* newval) {
+#ifdef _WIN32
+  return static_cast<T*>(InterlockedExchangePointer(
+      reinterpret_cast<PVOID volatile*>(ptr), newval));
+#else
+  T* oldval = *ptr;
+  T* seen;
+  while ((seen = __sync_val_compare_and_swap(ptr, oldval, newval)) != oldval) {
+    oldval = seen;
+  }
+  return oldval;
+#endif
+}
+
+/**
+ * Adds delta to *ptr.
+ *
+ * @return the value *ptr has after the call
+ */
+inline long atomicAdd(volatile long* ptr, long delta) {
+#ifdef _WIN32
+  return InterlockedExchangeAdd(ptr, delta) + delta;
+#else
+  return __sync_add_and_fetch(ptr, delta);
+#endif
+}
+
+/**
+ * Adds delta to *ptr.  With the long overload this covers int64_t whether
+ * it is long, as on LP64 platforms, or long long, as on Windows and ILP32.
+ *
+ * @return the value *ptr has after the call
+ */
+inline long long atomicAdd(volatile long long* ptr, long long delta) {
+#ifdef _WIN32
+  return InterlockedExchangeAdd64(ptr, delta) + delta;
+#else
+  return __sync_add_and_fetch(ptr, delta);
+#endif
+}
+
+/**
+ * Reads *ptr, ordered with the loads and stores around it.
+ */
+inline long atomicLoad(volatile long* ptr) {
+#ifdef _WIN32
+  return InterlockedCompareExchange(ptr, 0, 0);
+#else
+  return __sync_add_and_fetch(ptr, 0);
+#endif
+}
+
+/**
+ * Reads *ptr in one piece, even on 32-bit platforms.
+ */
+inline long long atomicLoad(volatile long long* ptr) {
+#ifdef _WIN32
+  return InterlockedCompareExchange64(ptr, 0, 0);
+#else
+  return __sync_add_and_fetch(ptr, 0);
+#endif
+}
+
+}}} // apache::thrift::concurrency
+
+#endif // #ifndef _THRIFT_CONCURRENCY_ATOMIC_H_
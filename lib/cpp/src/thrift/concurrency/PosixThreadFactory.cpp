@@ -21,6 +21,7 @@
 
 #include <thrift/concurrency/PosixThreadFactory.h>
 #include <thrift/concurrency/Exception.h>
+#include <thrift/concurrency/Util.h>
 
 #if GOOGLE_PERFTOOLS_REGISTER_THREAD
 #  include <google/profiler.h>
@@ -66,10 +67,12 @@ class PthreadThread: public Thread {
   int stackSize_;
   weak_ptr<PthreadThread> self_;
   bool detached_;
+  std::vector<int> cpus_;
 
  public:
 
-  PthreadThread(int policy, int priority, int stackSize, bool detached, shared_ptr<Runnable> runnable) :
+  PthreadThread(int policy, int priority, int stackSize, bool detached,
+                const std::vector<int>& cpus, shared_ptr<Runnable> runnable) :
 
 #ifndef _WIN32
     pthread_(0),
@@ -79,7 +82,8 @@ class PthreadThread: public Thread {
     policy_(policy),
     priority_(priority),
     stackSize_(stackSize),
-    detached_(detached) {
+    detached_(detached),
+    cpus_(cpus) {
 
     this->Thread::runnable(runnable);
   }
@@ -137,6 +141,22 @@ class PthreadThread: public Thread {
       throw SystemResourceException("pthread_attr_setschedparam failed");
     }
 
+#ifdef HAVE_PTHREAD_ATTR_SETAFFINITY_NP
+    // Set thread CPU affinity, so it never starts anywhere else
+    if (!cpus_.empty()) {
+      cpu_set_t cpu_set;
+      CPU_ZERO(&cpu_set);
+      for (size_t i = 0; i < cpus_.size(); ++i) {
+        if (cpus_[i] >= 0 && cpus_[i] < CPU_SETSIZE) {
+          CPU_SET(cpus_[i], &cpu_set);
+        }
+      }
+      if (pthread_attr_setaffinity_np(&thread_attr, sizeof(cpu_set), &cpu_set) != 0) {
+        throw SystemResourceException("pthread_attr_setaffinity_np failed");
+      }
+    }
+#endif
+
     // Create reference
     shared_ptr<PthreadThread>* selfRef = new shared_ptr<PthreadThread>();
     *selfRef = self_.lock();
@@ -203,6 +223,12 @@ void* PthreadThread::threadMain(void* arg) {
   ProfilerRegisterThread();
 #endif
 
+#ifndef HAVE_PTHREAD_ATTR_SETAFFINITY_NP
+  if (!thread->cpus_.empty()) {
+    Util::setCurrentThreadCpus(thread->cpus_);
+  }
+#endif
+
   thread->state_ = started;
   thread->runnable()->run();
   if (thread->state_ != stopping && thread->state_ != stopped) {
@@ -222,6 +248,7 @@ class PosixThreadFactory::Impl {
   PRIORITY priority_;
   int stackSize_;
   bool detached_;
+  std::vector<int> cpus_;
 
   /**
    * Converts generic posix thread schedule policy enums into pthread
@@ -283,7 +310,7 @@ class PosixThreadFactory::Impl {
    * @param runnable A runnable object
    */
   shared_ptr<Thread> newThread(shared_ptr<Runnable> runnable) const {
-    shared_ptr<PthreadThread> result = shared_ptr<PthreadThread>(new PthreadThread(toPthreadPolicy(policy_), toPthreadPriority(policy_, priority_), stackSize_, detached_, runnable));
+    shared_ptr<PthreadThread> result = shared_ptr<PthreadThread>(new PthreadThread(toPthreadPolicy(policy_), toPthreadPriority(policy_, priority_), stackSize_, detached_, cpus_, runnable));
     result->weakRef(result);
     runnable->thread(result);
     return result;
@@ -307,6 +334,10 @@ class PosixThreadFactory::Impl {
 
   void setDetached(bool value) { detached_ = value; }
 
+  std::vector<int> getCpuSet() const { return cpus_; }
+
+  void setCpuSet(const std::vector<int>& value) { cpus_ = value; }
+
   Thread::id_t getCurrentThreadId() const {
 
 #ifndef _WIN32
@@ -336,6 +367,10 @@ bool PosixThreadFactory::isDetached() const { return impl_->isDetached(); }
 
 void PosixThreadFactory::setDetached(bool value) { impl_->setDetached(value); }
 
+std::vector<int> PosixThreadFactory::getCpuSet() const { return impl_->getCpuSet(); }
+
+void PosixThreadFactory::setCpuSet(const std::vector<int>& value) { impl_->setCpuSet(value); }
+
 Thread::id_t PosixThreadFactory::getCurrentThreadId() const { return impl_->getCurrentThreadId(); }
 
 }}} // apache::thrift::concurrency
@@ -24,6 +24,8 @@
 
 #include <boost/shared_ptr.hpp>
 
+#include <vector>
+
 namespace apache { namespace thrift { namespace concurrency {
 
 /**
@@ -120,6 +122,22 @@ class PosixThreadFactory : public ThreadFactory {
    */
   virtual bool isDetached() const;
 
+  /**
+   * Gets the CPUs created threads are restricted to
+   */
+  virtual std::vector<int> getCpuSet() const;
+
+  /**
+   * Restricts threads created from now on to the given CPUs; an empty set
+   * (the default) leaves them free to run anywhere.  Threads keep the set
+   * that was current when they were created, so changing it between
+   * newThread() calls pins each thread differently.  Not supported on all
+   * platforms; it is silently ignored where thread affinity is missing.
+   *
+   * @param cpus CPU numbers
+   */
+  virtual void setCpuSet(const std::vector<int>& cpus);
+
  private:
   class Impl;
   boost::shared_ptr<Impl> impl_;
@@ -304,7 +304,6 @@ class ThreadManager::Worker: public Runnable {
         } else {
           idle_ = true;
           manager_->workerCount_--;
-          notifyManager = (manager_->workerCount_ == manager_->workerMaxCount_);
         }
       }
 
@@ -319,12 +318,12 @@ class ThreadManager::Worker: public Runnable {
       }
     }
 
+    // The manager waits for every exiting worker to get here, not just for
+    // the worker count, as it may be destroyed as soon as it stops waiting
     {
       Synchronized s(manager_->workerMonitor_);
       manager_->deadWorkers_.insert(this->thread());
-      if (notifyManager) {
-        manager_->workerMonitor_.notify();
-      }
+      manager_->workerMonitor_.notify();
     }
 
     return;
@@ -441,7 +440,7 @@ void ThreadManager::Impl::removeWorker(size_t value) {
   {
     Synchronized s(workerMonitor_);
 
-    while (workerCount_ != workerMaxCount_) {
+    while (workerCount_ != workerMaxCount_ || deadWorkers_.size() < value) {
       workerMonitor_.wait();
     }
 
@@ -189,6 +189,15 @@ class ThreadManager {
    */
   static boost::shared_ptr<ThreadManager> newSimpleThreadManager(size_t count=4, size_t pendingTaskCountMax=0);
 
+  /**
+   * Creates a thread manager like newSimpleThreadManager, but every worker has
+   * its own task queue and steals from the others when it runs dry.  add()
+   * does not take a lock unless pendingTaskCountMax is reached, so it scales
+   * to many submitting threads and high task rates.  Tasks are still run
+   * roughly in the order they were added, but not strictly.
+   */
+  static boost::shared_ptr<ThreadManager> newWorkStealingThreadManager(size_t count=4, size_t pendingTaskCountMax=0);
+
   class Task;
 
   class Worker;
@@ -26,6 +26,13 @@
 #include <sys/time.h>
 #endif
 
+#if defined(HAVE_SCHED_H)
+#include <sched.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
 namespace apache { namespace thrift { namespace concurrency {
 
 int64_t Util::currentTimeTicks(int64_t ticksPerSec) {
@@ -38,4 +45,134 @@ int64_t Util::currentTimeTicks(int64_t ticksPerSec) {
   return result;
 }
 
+bool Util::setCurrentThreadCpus(const std::vector<int>& cpus) {
+#ifdef HAVE_SCHED_SETAFFINITY
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (cpus.empty()) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      CPU_SET(cpu, &set);
+    }
+  }
+  for (size_t i = 0; i < cpus.size(); ++i) {
+    if (cpus[i] >= 0 && cpus[i] < CPU_SETSIZE) {
+      CPU_SET(cpus[i], &set);
+    }
+  }
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+  THRIFT_UNUSED_VARIABLE(cpus);
+  return false;
+#endif
+}
+
+bool Util::getCurrentThreadCpus(std::vector<int>& cpus) {
+  cpus.clear();
+#ifdef HAVE_SCHED_SETAFFINITY
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+    return false;
+  }
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (CPU_ISSET(cpu, &set)) {
+      cpus.push_back(cpu);
+    }
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+int Util::getCurrentCpu() {
+#ifdef HAVE_SCHED_GETCPU
+  return sched_getcpu();
+#else
+  return -1;
+#endif
+}
+
+#ifdef HAVE_SCHED_SETAFFINITY
+/**
+ * Reads a sysfs CPU list such as "0-3,8,10-11".
+ */
+static bool readCpuList(const char* path, std::vector<int>& cpus) {
+  FILE* f = fopen(path, "r");
+  if (f == NULL) {
+    return false;
+  }
+  char line[4096];
+  bool ok = (fgets(line, sizeof(line), f) != NULL);
+  fclose(f);
+  if (!ok) {
+    return false;
+  }
+
+  char* p = line;
+  while (*p != '\0' && *p != '\n') {
+    char* end;
+    long first = strtol(p, &end, 10);
+    if (end == p) {
+      return false;
+    }
+    long last = first;
+    p = end;
+    if (*p == '-') {
+      ++p;
+      last = strtol(p, &end, 10);
+      if (end == p) {
+        return false;
+      }
+      p = end;
+    }
+    for (long cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(static_cast<int>(cpu));
+    }
+    if (*p == ',') {
+      ++p;
+    }
+  }
+  return true;
+}
+
+#endif
+
+int Util::getNumaNode(int cpu) {
+#ifdef HAVE_SCHED_SETAFFINITY
+  // Linux exposes the topology in sysfs; 64 nodes is plenty
+  char path[64];
+  std::vector<int> cpus;
+  for (int node = 0; node < 64; ++node) {
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    cpus.clear();
+    if (!readCpuList(path, cpus)) {
+      continue;
+    }
+    for (size_t i = 0; i < cpus.size(); ++i) {
+      if (cpus[i] == cpu) {
+        return node;
+      }
+    }
+  }
+#else
+  THRIFT_UNUSED_VARIABLE(cpu);
+#endif
+  return -1;
+}
+
+std::vector<int> Util::getNumaNodeCpus(int node) {
+  std::vector<int> cpus;
+#ifdef HAVE_SCHED_SETAFFINITY
+  char path[64];
+  snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+  if (!readCpuList(path, cpus)) {
+    cpus.clear();
+  }
+#else
+  THRIFT_UNUSED_VARIABLE(node);
+#endif
+  return cpus;
+}
+
 }}} // apache::thrift::concurrency
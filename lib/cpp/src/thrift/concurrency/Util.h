@@ -25,6 +25,8 @@
 #include <stdint.h>
 #include <time.h>
 
+#include <vector>
+
 #ifdef HAVE_SYS_TIME_H
 #include <sys/time.h>
 #endif
@@ -145,6 +147,36 @@ class Util {
    * Get current time as micros from epoch
    */
   static int64_t currentTimeUsec() { return currentTimeTicks(US_PER_S); }
+
+  /**
+   * Restricts the calling thread to the given CPUs.
+   *
+   * @param cpus CPU numbers; an empty list allows every CPU
+   * @return false if the platform has no CPU affinity or the call failed
+   */
+  static bool setCurrentThreadCpus(const std::vector<int>& cpus);
+
+  /**
+   * Gets the CPUs the calling thread may run on.
+   *
+   * @return false if the platform has no CPU affinity or the call failed
+   */
+  static bool getCurrentThreadCpus(std::vector<int>& cpus);
+
+  /**
+   * Get the CPU the calling thread is running on, or -1 if unknown
+   */
+  static int getCurrentCpu();
+
+  /**
+   * Get the NUMA node a CPU belongs to, or -1 if unknown
+   */
+  static int getNumaNode(int cpu);
+
+  /**
+   * Get the CPUs of a NUMA node; empty if unknown
+   */
+  static std::vector<int> getNumaNodeCpus(int node);
 };
 
 }}} // apache::thrift::concurrency
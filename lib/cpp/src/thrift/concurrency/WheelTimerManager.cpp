@@ -0,0 +1,422 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/concurrency/WheelTimerManager.h>
+#include <thrift/concurrency/Exception.h>
+#include <thrift/concurrency/Util.h>
+
+#include <assert.h>
+
+namespace apache { namespace thrift { namespace concurrency {
+
+using boost::shared_ptr;
+
+const int WheelTimerManager::WHEELS;
+const int WheelTimerManager::SLOT_BITS;
+const uint32_t WheelTimerManager::SLOTS;
+const uint32_t WheelTimerManager::NIL;
+const uint32_t WheelTimerManager::NO_SLOT;
+
+class WheelTimerManager::Dispatcher: public Runnable {
+
+ public:
+  Dispatcher(WheelTimerManager* manager) :
+    manager_(manager) {}
+
+  /**
+   * Dispatcher entry point
+   *
+   * Advances the wheel to the current time and runs what fell due, then
+   * sleeps until the next slot that has work or the next cascade.
+   */
+  void run() {
+    {
+      Synchronized s(manager_->monitor_);
+      if (manager_->state_ == TimerManager::STARTING) {
+        manager_->state_ = TimerManager::STARTED;
+        manager_->monitor_.notifyAll();
+      }
+    }
+
+    std::vector<shared_ptr<Runnable> > expired;
+
+    do {
+      {
+        Synchronized s(manager_->monitor_);
+        while (manager_->state_ == TimerManager::STARTED) {
+          int64_t now = Util::currentTime();
+          manager_->advance(now / manager_->tickMs_, expired);
+          if (!expired.empty()) {
+            break;
+          }
+
+          int64_t wakeup = manager_->nextWakeup();
+          manager_->wakeupTick_ = wakeup;
+          try {
+            if (wakeup < 0) {
+              manager_->monitor_.wait();
+            } else {
+              int64_t timeout = wakeup * manager_->tickMs_ - now;
+              manager_->monitor_.wait(timeout > 0 ? timeout : 1);
+            }
+          } catch (TimedOutException &) {}
+          manager_->wakeupTick_ = 0;
+        }
+      }
+
+      for (size_t ix = 0; ix < expired.size(); ix++) {
+        expired[ix]->run();
+      }
+      expired.clear();
+
+    } while (manager_->state_ == TimerManager::STARTED);
+
+    {
+      Synchronized s(manager_->monitor_);
+      if (manager_->state_ == TimerManager::STOPPING) {
+        manager_->state_ = TimerManager::STOPPED;
+        manager_->monitor_.notify();
+      }
+    }
+  }
+
+ private:
+  WheelTimerManager* manager_;
+  friend class WheelTimerManager;
+};
+
+#if defined(_MSC_VER)
+#pragma warning(push)
+#pragma warning(disable: 4355) // 'this' used in base member initializer list
+#endif
+
+WheelTimerManager::WheelTimerManager(int64_t tickMs) :
+  tickMs_(tickMs > 0 ? tickMs : 1),
+  freeList_(NIL),
+  innerCount_(0),
+  taskCount_(0),
+  currentTick_(0),
+  wakeupTick_(0),
+  state_(TimerManager::UNINITIALIZED),
+  dispatcher_(shared_ptr<Dispatcher>(new Dispatcher(this))) {
+  for (uint32_t ix = 0; ix < WHEELS * SLOTS; ix++) {
+    slots_[ix] = NIL;
+  }
+}
+
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+WheelTimerManager::~WheelTimerManager() {
+  if (state_ != STOPPED) {
+    stop();
+  }
+}
+
+void WheelTimerManager::start() {
+  shared_ptr<const ThreadFactory> threadFactory = this->threadFactory();
+  bool doStart = false;
+  {
+    Synchronized s(monitor_);
+    if (!threadFactory) {
+      throw InvalidArgumentException();
+    }
+    if (state_ == TimerManager::UNINITIALIZED) {
+      state_ = TimerManager::STARTING;
+      currentTick_ = Util::currentTime() / tickMs_;
+      doStart = true;
+    }
+  }
+
+  if (doStart) {
+    dispatcherThread_ = threadFactory->newThread(dispatcher_);
+    dispatcherThread_->start();
+  }
+
+  {
+    Synchronized s(monitor_);
+    while (state_ == TimerManager::STARTING) {
+      monitor_.wait();
+    }
+    assert(state_ != TimerManager::STARTING);
+  }
+}
+
+void WheelTimerManager::stop() {
+  bool doStop = false;
+  {
+    Synchronized s(monitor_);
+    if (state_ == TimerManager::UNINITIALIZED) {
+      state_ = TimerManager::STOPPED;
+    } else if (state_ != STOPPING &&  state_ != STOPPED) {
+      doStop = true;
+      state_ = STOPPING;
+      monitor_.notifyAll();
+    }
+    while (state_ != STOPPED) {
+      monitor_.wait();
+    }
+  }
+
+  if (doStop) {
+    // Clean up any outstanding tasks
+    Synchronized s(monitor_);
+    for (uint32_t ix = 0; ix < nodes_.size(); ix++) {
+      if (nodes_[ix].slot != NO_SLOT) {
+        unlink(ix);
+        freeNode(ix);
+      }
+    }
+    taskCount_ = 0;
+
+    // Remove dispatcher's reference to us.
+    dispatcher_->manager_ = NULL;
+  }
+}
+
+size_t WheelTimerManager::taskCount() const {
+  return taskCount_;
+}
+
+TimerManager::STATE WheelTimerManager::state() const { return state_; }
+
+void WheelTimerManager::add(shared_ptr<Runnable> task, int64_t timeout) {
+  schedule(task, timeout);
+}
+
+WheelTimerManager::Handle WheelTimerManager::schedule(shared_ptr<Runnable> task, int64_t timeout) {
+  // Round up so that tasks never fire early
+  int64_t expiration = (Util::currentTime() + timeout + tickMs_ - 1) / tickMs_;
+
+  Synchronized s(monitor_);
+  if (state_ != TimerManager::STARTED) {
+    throw IllegalStateException();
+  }
+
+  uint32_t index = allocateNode();
+  Node& node = nodes_[index];
+  node.task = task;
+  node.expiration = expiration;
+  link(index);
+  taskCount_++;
+
+  // Kick the dispatcher if it sleeps past the new expiration
+  if (wakeupTick_ < 0 || (wakeupTick_ > 0 && expiration < wakeupTick_)) {
+    monitor_.notify();
+  }
+
+  return (static_cast<Handle>(node.generation) << 32) | index;
+}
+
+bool WheelTimerManager::cancel(Handle handle) {
+  uint32_t index = static_cast<uint32_t>(handle & 0xffffffff);
+  uint32_t generation = static_cast<uint32_t>(handle >> 32);
+
+  Synchronized s(monitor_);
+  if (index >= nodes_.size() ||
+      nodes_[index].generation != generation ||
+      nodes_[index].slot == NO_SLOT) {
+    return false;
+  }
+
+  unlink(index);
+  freeNode(index);
+  taskCount_--;
+  return true;
+}
+
+void WheelTimerManager::remove(shared_ptr<Runnable> task) {
+  Synchronized s(monitor_);
+  if (state_ != TimerManager::STARTED) {
+    throw IllegalStateException();
+  }
+
+  size_t removed = 0;
+  for (uint32_t ix = 0; ix < nodes_.size(); ix++) {
+    if (nodes_[ix].slot != NO_SLOT && nodes_[ix].task == task) {
+      unlink(ix);
+      freeNode(ix);
+      removed++;
+    }
+  }
+
+  if (removed == 0) {
+    throw NoSuchTaskException();
+  }
+  taskCount_ -= removed;
+}
+
+uint32_t WheelTimerManager::allocateNode() {
+  if (freeList_ != NIL) {
+    uint32_t index = freeList_;
+    freeList_ = nodes_[index].next;
+    return index;
+  }
+
+  if (nodes_.size() >= NIL) {
+    throw SystemResourceException("WheelTimerManager: too many timers");
+  }
+  Node node;
+  node.expiration = 0;
+  node.prev = NIL;
+  node.next = NIL;
+  node.generation = 1;
+  node.slot = NO_SLOT;
+  nodes_.push_back(node);
+  return static_cast<uint32_t>(nodes_.size() - 1);
+}
+
+void WheelTimerManager::freeNode(uint32_t index) {
+  Node& node = nodes_[index];
+  node.task.reset();
+  node.slot = NO_SLOT;
+  if (++node.generation == 0) {
+    node.generation = 1;
+  }
+  node.prev = NIL;
+  node.next = freeList_;
+  freeList_ = index;
+}
+
+void WheelTimerManager::link(uint32_t index) {
+  Node& node = nodes_[index];
+
+  // Anything already due goes into the slot processed next
+  int64_t expiration = node.expiration > currentTick_ ? node.expiration : currentTick_;
+  int64_t delta = expiration - currentTick_;
+
+  int wheel = 0;
+  while (wheel < WHEELS - 1 && delta >= (static_cast<int64_t>(1) << (SLOT_BITS * (wheel + 1)))) {
+    wheel++;
+  }
+
+  // Beyond the outermost wheel: park in its furthest slot and re-file from
+  // there when it cascades
+  int64_t horizon = (static_cast<int64_t>(1) << (SLOT_BITS * WHEELS)) - 1;
+  if (delta > horizon) {
+    expiration = currentTick_ + horizon;
+  }
+
+  uint32_t slot = wheel * SLOTS + static_cast<uint32_t>((expiration >> (SLOT_BITS * wheel)) & (SLOTS - 1));
+  node.slot = slot;
+  node.prev = NIL;
+  node.next = slots_[slot];
+  if (node.next != NIL) {
+    nodes_[node.next].prev = index;
+  }
+  slots_[slot] = index;
+
+  if (wheel == 0) {
+    innerCount_++;
+  }
+}
+
+void WheelTimerManager::unlink(uint32_t index) {
+  Node& node = nodes_[index];
+  if (node.prev != NIL) {
+    nodes_[node.prev].next = node.next;
+  } else {
+    slots_[node.slot] = node.next;
+  }
+  if (node.next != NIL) {
+    nodes_[node.next].prev = node.prev;
+  }
+  if (node.slot < SLOTS) {
+    innerCount_--;
+  }
+  node.prev = NIL;
+  node.next = NIL;
+  node.slot = NO_SLOT;
+}
+
+void WheelTimerManager::cascade(int wheel) {
+  uint32_t slot = wheel * SLOTS + static_cast<uint32_t>((currentTick_ >> (SLOT_BITS * wheel)) & (SLOTS - 1));
+  uint32_t index = slots_[slot];
+  slots_[slot] = NIL;
+
+  while (index != NIL) {
+    uint32_t next = nodes_[index].next;
+    nodes_[index].slot = NO_SLOT;
+    link(index);
+    index = next;
+  }
+}
+
+void WheelTimerManager::advance(int64_t now, std::vector<shared_ptr<Runnable> >& expired) {
+  while (currentTick_ <= now) {
+    if (taskCount_ == 0) {
+      currentTick_ = now + 1;
+      break;
+    }
+
+    // At a boundary of the innermost wheel, refill it from the outer ones
+    if ((currentTick_ & (SLOTS - 1)) == 0) {
+      for (int wheel = WHEELS - 1; wheel > 0; wheel--) {
+        if ((currentTick_ & ((static_cast<int64_t>(1) << (SLOT_BITS * wheel)) - 1)) == 0) {
+          cascade(wheel);
+        }
+      }
+    }
+
+    // Nothing left in this revolution: skip to the next boundary
+    if (innerCount_ == 0) {
+      int64_t boundary = (currentTick_ | (SLOTS - 1)) + 1;
+      currentTick_ = boundary < now + 1 ? boundary : now + 1;
+      continue;
+    }
+
+    uint32_t slot = static_cast<uint32_t>(currentTick_ & (SLOTS - 1));
+    uint32_t index = slots_[slot];
+    slots_[slot] = NIL;
+    while (index != NIL) {
+      uint32_t next = nodes_[index].next;
+      expired.push_back(nodes_[index].task);
+      innerCount_--;
+      freeNode(index);
+      taskCount_--;
+      index = next;
+    }
+
+    currentTick_++;
+  }
+}
+
+int64_t WheelTimerManager::nextWakeup() const {
+  if (taskCount_ == 0) {
+    return -1;
+  }
+
+  int64_t tick = currentTick_;
+  if ((tick & (SLOTS - 1)) == 0) {
+    return tick;
+  }
+
+  if (innerCount_ > 0) {
+    for (; (tick & (SLOTS - 1)) != 0; tick++) {
+      if (slots_[tick & (SLOTS - 1)] != NIL) {
+        return tick;
+      }
+    }
+  }
+
+  return (currentTick_ | (SLOTS - 1)) + 1;
+}
+
+}}} // apache::thrift::concurrency
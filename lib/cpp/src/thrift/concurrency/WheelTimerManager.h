@@ -0,0 +1,161 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_CONCURRENCY_WHEELTIMERMANAGER_H_
+#define _THRIFT_CONCURRENCY_WHEELTIMERMANAGER_H_ 1
+
+#include <thrift/concurrency/TimerManager.h>
+
+#include <boost/shared_ptr.hpp>
+#include <stdint.h>
+#include <vector>
+
+namespace apache { namespace thrift { namespace concurrency {
+
+/**
+ * Timer Manager backed by a hierarchical timing wheel
+ *
+ * Tasks sit in intrusive lists hanging off four wheels of 256 slots, the
+ * first of which advances one slot per tick.  A slot of an outer wheel is
+ * spread over the wheel below when that one comes round, so scheduling and
+ * cancelling are O(1) whatever the number of live timers, and the
+ * dispatcher only holds the lock for the slots that fall due.  Timer nodes
+ * are recycled, so after warm-up scheduling allocates nothing.
+ *
+ * Tasks fire on the first tick boundary at or after their expiration, never
+ * early.  Use schedule() and cancel() to be able to cancel a task cheaply;
+ * the inherited add() and remove() keep working, but remove() has to search
+ * every live timer.
+ */
+class WheelTimerManager : public TimerManager {
+
+ public:
+
+  /**
+   * Names a scheduled task for cancel().  Handles stay safe to use after the
+   * task has run or been cancelled, and 0 never names a task.
+   */
+  typedef uint64_t Handle;
+
+  /**
+   * @param tickMs Resolution of the wheel in milliseconds
+   */
+  explicit WheelTimerManager(int64_t tickMs = 1);
+
+  virtual ~WheelTimerManager();
+
+  /**
+   * Starts the timer manager service
+   *
+   * @throws IllegalArgumentException Missing thread factory attribute
+   */
+  virtual void start();
+
+  /**
+   * Stops the timer manager service.  Tasks that have not run yet are
+   * dropped.
+   */
+  virtual void stop();
+
+  virtual size_t taskCount() const;
+
+  using TimerManager::add;
+
+  virtual void add(boost::shared_ptr<Runnable> task, int64_t timeout);
+
+  /**
+   * Removes every pending instance of a task.  This has to look at every
+   * live timer; prefer cancel().
+   *
+   * @throws NoSuchTaskException Specified task isn't pending
+   */
+  virtual void remove(boost::shared_ptr<Runnable> task);
+
+  virtual STATE state() const;
+
+  /**
+   * Adds a task to be executed at some time in the future by the dispatcher
+   * thread.
+   *
+   * @param task The task to execute
+   * @param timeout Time in milliseconds to delay before executing task
+   * @return A handle to cancel the task with
+   */
+  Handle schedule(boost::shared_ptr<Runnable> task, int64_t timeout);
+
+  /**
+   * Cancels a scheduled task.
+   *
+   * @return false if the task already ran, is running or was cancelled
+   */
+  bool cancel(Handle handle);
+
+ private:
+  class Dispatcher;
+  friend class Dispatcher;
+
+  struct Node {
+    boost::shared_ptr<Runnable> task;
+    int64_t expiration;
+    uint32_t prev;
+    uint32_t next;
+    uint32_t generation;
+    /// wheel * SLOTS + slot while scheduled, otherwise NO_SLOT
+    uint32_t slot;
+  };
+
+  static const int WHEELS = 4;
+  static const int SLOT_BITS = 8;
+  static const uint32_t SLOTS = 1 << SLOT_BITS;
+  static const uint32_t NIL = 0xffffffff;
+  static const uint32_t NO_SLOT = 0xffffffff;
+
+  uint32_t allocateNode();
+  void freeNode(uint32_t index);
+  void link(uint32_t index);
+  void unlink(uint32_t index);
+
+  /// Fires due slots up to tick now, collecting their tasks
+  void advance(int64_t now, std::vector<boost::shared_ptr<Runnable> >& expired);
+
+  /// Redistributes the current slot of the given wheel over the lower ones
+  void cascade(int wheel);
+
+  /// First tick after the current one that might have work, at most one
+  /// revolution of the innermost wheel away
+  int64_t nextWakeup() const;
+
+  const int64_t tickMs_;
+  std::vector<Node> nodes_;
+  uint32_t freeList_;
+  uint32_t slots_[WHEELS * SLOTS];
+  size_t innerCount_;
+  size_t taskCount_;
+  int64_t currentTick_;
+  int64_t wakeupTick_;
+
+  Monitor monitor_;
+  STATE state_;
+  boost::shared_ptr<Dispatcher> dispatcher_;
+  boost::shared_ptr<Thread> dispatcherThread_;
+};
+
+}}} // apache::thrift::concurrency
+
+#endif // #ifndef _THRIFT_CONCURRENCY_WHEELTIMERMANAGER_H_
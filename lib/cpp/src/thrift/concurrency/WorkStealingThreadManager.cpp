@@ -0,0 +1,716 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/thrift-config.h>
+
+#include <thrift/concurrency/ThreadManager.h>
+#include <thrift/concurrency/Atomic.h>
+#include <thrift/concurrency/Exception.h>
+#include <thrift/concurrency/Monitor.h>
+#include <thrift/concurrency/Util.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include <deque>
+#include <map>
+#include <set>
+#include <vector>
+
+namespace apache { namespace thrift { namespace concurrency {
+
+using boost::shared_ptr;
+
+/**
+ * Work stealing thread manager
+ *
+ * Tasks are spread round robin over one queue per worker instead of a single
+ * queue behind the manager's monitor.  add() pushes onto the target queue's
+ * lock-free inbox; the queue's own mutex is only taken by the worker that
+ * owns it and by idle workers stealing from it, so submitters never contend
+ * with each other or with the workers on a lock.  A worker serves its own
+ * queue first and, when that is empty, steals half of another worker's.
+ *
+ * The counters behind the statistics and the pendingTaskCountMax limit are
+ * kept with atomic operations.  Monitors are only used to park idle workers,
+ * to block add() while the pool is full and to add and remove workers.
+ *
+ * Workers added beyond the initial count share the existing queues, and
+ * queues of removed workers are drained by stealing.
+ */
+class WorkStealingThreadManager : public ThreadManager {
+
+ public:
+  WorkStealingThreadManager(size_t workerCount, size_t pendingTaskCountMax);
+
+  ~WorkStealingThreadManager();
+
+  void start();
+
+  void stop() { stopImpl(false); }
+
+  void join() { stopImpl(true); }
+
+  ThreadManager::STATE state() const {
+    return state_;
+  }
+
+  shared_ptr<ThreadFactory> threadFactory() const {
+    Synchronized s(monitor_);
+    return threadFactory_;
+  }
+
+  void threadFactory(shared_ptr<ThreadFactory> value) {
+    Synchronized s(monitor_);
+    threadFactory_ = value;
+  }
+
+  void addWorker(size_t value);
+
+  void removeWorker(size_t value);
+
+  size_t idleWorkerCount() const {
+    return static_cast<size_t>(idleCount_);
+  }
+
+  size_t workerCount() const {
+    Synchronized s(monitor_);
+    return workerCount_;
+  }
+
+  size_t pendingTaskCount() const {
+    return pendingCount_ > 0 ? static_cast<size_t>(pendingCount_) : 0;
+  }
+
+  size_t totalTaskCount() const {
+    return pendingTaskCount() + static_cast<size_t>(executingCount_);
+  }
+
+  size_t pendingTaskCountMax() const {
+    return static_cast<size_t>(pendingTaskCountMax_);
+  }
+
+  size_t expiredTaskCount() {
+    long result = expiredCount_;
+    atomicAdd(&expiredCount_, -result);
+    return static_cast<size_t>(result);
+  }
+
+  void add(shared_ptr<Runnable> value, int64_t timeout, int64_t expiration);
+
+  void remove(shared_ptr<Runnable> task);
+
+  shared_ptr<Runnable> removeNextPending();
+
+  void removeExpiredTasks();
+
+  void setExpireCallback(ExpireCallback expireCallback);
+
+ private:
+  class Task;
+  friend class Task;
+  class Worker;
+  friend class Worker;
+
+  /**
+   * A worker's queue.  Submitters push onto inbox_ without locking; whoever
+   * holds mutex_ moves the inbox into tasks_ in arrival order.
+   */
+  struct Queue {
+    Queue() : inbox_(NULL), size_(0) {}
+
+    Mutex mutex_;
+    std::deque<Task*> tasks_;
+    Task* volatile inbox_;
+    /// tasks_.size(), readable without the mutex as a hint
+    volatile size_t size_;
+  };
+
+  void stopImpl(bool join);
+
+  bool canSleep();
+
+  /// Reserves a pending task slot, blocking or throwing while the pool is full
+  void reservePending(int64_t timeout);
+
+  /// Releases a pending task slot and wakes an add() waiting for one
+  void releasePending();
+
+  /// Moves q's inbox into its task deque; q->mutex_ must be held
+  void collect(Queue* q);
+
+  /// Takes the next task for a worker whose own queue is home
+  Task* take(size_t home);
+
+  /// Takes tasks off the front of another queue, keeping all but one in home
+  Task* steal(size_t home);
+
+  /// Drops an expired task that was taken off a queue
+  void expire(Task* task);
+
+  /// Lets the calling worker exit if a removal is outstanding
+  bool claimRetirement();
+
+  std::vector<Queue*> queues_;
+  volatile long nextQueue_;
+
+  const size_t initialWorkerCount_;
+  const long pendingTaskCountMax_;
+  volatile long pendingCount_;
+  volatile long executingCount_;
+  volatile long idleCount_;
+  volatile long expiredCount_;
+  volatile long retiring_;
+  volatile long maxWaiters_;
+  ExpireCallback expireCallback_;
+
+  ThreadManager::STATE state_;
+  shared_ptr<ThreadFactory> threadFactory_;
+
+  size_t workerCount_;
+  size_t workerMaxCount_;
+  size_t nextHome_;
+  Monitor monitor_;
+  Monitor workerMonitor_;
+  Monitor idleMonitor_;
+  Monitor maxMonitor_;
+
+  std::set<shared_ptr<Thread> > workers_;
+  std::set<shared_ptr<Thread> > deadWorkers_;
+  std::map<const Thread::id_t, shared_ptr<Thread> > idMap_;
+};
+
+class WorkStealingThreadManager::Task {
+
+ public:
+  Task(shared_ptr<Runnable> runnable, int64_t expiration) :
+    runnable_(runnable),
+    expireTime_(expiration != 0LL ? Util::currentTime() + expiration : 0LL),
+    next_(NULL) {}
+
+  shared_ptr<Runnable> getRunnable() const {
+    return runnable_;
+  }
+
+  int64_t getExpireTime() const {
+    return expireTime_;
+  }
+
+  bool isExpired(int64_t now) const {
+    return expireTime_ != 0LL && expireTime_ <= now;
+  }
+
+ private:
+  shared_ptr<Runnable> runnable_;
+  int64_t expireTime_;
+  friend class WorkStealingThreadManager;
+  Task* next_;
+};
+
+class WorkStealingThreadManager::Worker : public Runnable {
+
+ public:
+  Worker(WorkStealingThreadManager* manager, size_t home) :
+    manager_(manager),
+    home_(home) {}
+
+  /**
+   * Worker entry point
+   *
+   * Takes tasks off the home queue, or steals them, until the worker is
+   * asked to go away.  With nothing to do it parks on the idle monitor.
+   */
+  void run() {
+    bool active = false;
+    bool notifyManager = false;
+
+    {
+      Synchronized s(manager_->monitor_);
+      active = manager_->workerCount_ < manager_->workerMaxCount_;
+      if (active) {
+        manager_->workerCount_++;
+        notifyManager = manager_->workerCount_ == manager_->workerMaxCount_;
+      }
+    }
+
+    if (notifyManager) {
+      Synchronized s(manager_->workerMonitor_);
+      manager_->workerMonitor_.notify();
+    }
+
+    while (active) {
+      // A joining manager keeps its workers until the queues are empty
+      if (manager_->retiring_ > 0 &&
+          (manager_->state_ != ThreadManager::JOINING || manager_->pendingCount_ <= 0) &&
+          manager_->claimRetirement()) {
+        break;
+      }
+
+      Task* task = manager_->take(home_);
+
+      if (task != NULL) {
+        if (task->getExpireTime() != 0LL && task->isExpired(Util::currentTime())) {
+          manager_->expire(task);
+          continue;
+        }
+
+        atomicAdd(&manager_->executingCount_, 1);
+        manager_->releasePending();
+        try {
+          task->getRunnable()->run();
+        } catch(...) {
+          // XXX need to log this
+        }
+        atomicAdd(&manager_->executingCount_, -1);
+        delete task;
+        continue;
+      }
+
+      // Either add() sees us idle and notifies, or we see its pending task
+      Synchronized s(manager_->idleMonitor_);
+      atomicAdd(&manager_->idleCount_, 1);
+      while (manager_->pendingCount_ <= 0 && manager_->retiring_ <= 0) {
+        manager_->idleMonitor_.waitForever();
+      }
+      atomicAdd(&manager_->idleCount_, -1);
+    }
+
+    {
+      Synchronized s(manager_->monitor_);
+      if (active) {
+        manager_->workerCount_--;
+      }
+      notifyManager = manager_->workerCount_ == manager_->workerMaxCount_;
+    }
+
+    {
+      Synchronized s(manager_->workerMonitor_);
+      manager_->deadWorkers_.insert(this->thread());
+      if (notifyManager) {
+        manager_->workerMonitor_.notify();
+      }
+    }
+  }
+
+ private:
+  WorkStealingThreadManager* manager_;
+  size_t home_;
+};
+
+WorkStealingThreadManager::WorkStealingThreadManager(size_t workerCount,
+                                                     size_t pendingTaskCountMax) :
+  nextQueue_(0),
+  initialWorkerCount_(workerCount),
+  pendingTaskCountMax_(static_cast<long>(pendingTaskCountMax)),
+  pendingCount_(0),
+  executingCount_(0),
+  idleCount_(0),
+  expiredCount_(0),
+  retiring_(0),
+  maxWaiters_(0),
+  state_(ThreadManager::UNINITIALIZED),
+  workerCount_(0),
+  workerMaxCount_(0),
+  nextHome_(0) {
+  size_t count = workerCount > 0 ? workerCount : 1;
+  queues_.reserve(count);
+  for (size_t ix = 0; ix < count; ix++) {
+    queues_.push_back(new Queue());
+  }
+}
+
+WorkStealingThreadManager::~WorkStealingThreadManager() {
+  stop();
+
+  for (size_t ix = 0; ix < queues_.size(); ix++) {
+    Queue* q = queues_[ix];
+    {
+      Guard g(q->mutex_);
+      collect(q);
+    }
+    for (std::deque<Task*>::iterator it = q->tasks_.begin(); it != q->tasks_.end(); ++it) {
+      delete *it;
+    }
+    delete q;
+  }
+}
+
+void WorkStealingThreadManager::start() {
+
+  if (state_ == ThreadManager::STOPPED) {
+    return;
+  }
+
+  bool doStart = false;
+  {
+    Synchronized s(monitor_);
+    if (state_ == ThreadManager::UNINITIALIZED) {
+      if (!threadFactory_) {
+        throw InvalidArgumentException();
+      }
+      state_ = ThreadManager::STARTED;
+      doStart = true;
+    }
+  }
+
+  if (doStart) {
+    addWorker(initialWorkerCount_);
+  }
+}
+
+void WorkStealingThreadManager::stopImpl(bool join) {
+  bool doStop = false;
+  if (state_ == ThreadManager::STOPPED) {
+    return;
+  }
+
+  {
+    Synchronized s(monitor_);
+    if (state_ != ThreadManager::STOPPING &&
+        state_ != ThreadManager::JOINING &&
+        state_ != ThreadManager::STOPPED) {
+      doStop = true;
+      state_ = join ? ThreadManager::JOINING : ThreadManager::STOPPING;
+    }
+  }
+
+  if (doStop) {
+    removeWorker(workerCount());
+  }
+
+  {
+    Synchronized s(monitor_);
+    state_ = ThreadManager::STOPPED;
+  }
+}
+
+void WorkStealingThreadManager::addWorker(size_t value) {
+  std::set<shared_ptr<Thread> > newThreads;
+  {
+    Synchronized s(monitor_);
+    for (size_t ix = 0; ix < value; ix++) {
+      shared_ptr<Worker> worker(new Worker(this, nextHome_++ % queues_.size()));
+      newThreads.insert(threadFactory_->newThread(worker));
+    }
+    workerMaxCount_ += value;
+    workers_.insert(newThreads.begin(), newThreads.end());
+  }
+
+  for (std::set<shared_ptr<Thread> >::iterator ix = newThreads.begin(); ix != newThreads.end(); ix++) {
+    (*ix)->start();
+    Synchronized s(monitor_);
+    idMap_.insert(std::pair<const Thread::id_t, shared_ptr<Thread> >((*ix)->getId(), *ix));
+  }
+
+  {
+    Synchronized s(workerMonitor_);
+    while (workerCount() != workerMaxCount_) {
+      workerMonitor_.wait();
+    }
+  }
+}
+
+void WorkStealingThreadManager::removeWorker(size_t value) {
+  {
+    Synchronized s(monitor_);
+    if (value > workerMaxCount_) {
+      throw InvalidArgumentException();
+    }
+    workerMaxCount_ -= value;
+  }
+
+  atomicAdd(&retiring_, static_cast<long>(value));
+  {
+    Synchronized s(idleMonitor_);
+    idleMonitor_.notifyAll();
+  }
+
+  {
+    Synchronized s(workerMonitor_);
+
+    while (workerCount() != workerMaxCount_) {
+      workerMonitor_.wait();
+    }
+
+    Synchronized m(monitor_);
+    for (std::set<shared_ptr<Thread> >::iterator ix = deadWorkers_.begin(); ix != deadWorkers_.end(); ix++) {
+      idMap_.erase((*ix)->getId());
+      workers_.erase(*ix);
+    }
+
+    deadWorkers_.clear();
+  }
+}
+
+bool WorkStealingThreadManager::claimRetirement() {
+  if (atomicAdd(&retiring_, -1) >= 0) {
+    return true;
+  }
+  atomicAdd(&retiring_, 1);
+  return false;
+}
+
+bool WorkStealingThreadManager::canSleep() {
+  const Thread::id_t id = threadFactory_->getCurrentThreadId();
+  Synchronized s(monitor_);
+  return idMap_.find(id) == idMap_.end();
+}
+
+void WorkStealingThreadManager::reservePending(int64_t timeout) {
+  if (pendingTaskCountMax_ <= 0) {
+    atomicAdd(&pendingCount_, 1);
+    return;
+  }
+
+  if (atomicAdd(&pendingCount_, 1) <= pendingTaskCountMax_) {
+    return;
+  }
+  atomicAdd(&pendingCount_, -1);
+
+  removeExpiredTasks();
+  if (atomicAdd(&pendingCount_, 1) <= pendingTaskCountMax_) {
+    return;
+  }
+  atomicAdd(&pendingCount_, -1);
+
+  if (!canSleep() || timeout < 0) {
+    throw TooManyPendingTasksException();
+  }
+
+  // Workers look at maxWaiters_ after releasing a slot, so one of us sees
+  // the other: either the slot is free below or we get notified.
+  Synchronized s(maxMonitor_);
+  atomicAdd(&maxWaiters_, 1);
+  try {
+    while (atomicAdd(&pendingCount_, 1) > pendingTaskCountMax_) {
+      atomicAdd(&pendingCount_, -1);
+      maxMonitor_.wait(timeout);
+    }
+  } catch(...) {
+    atomicAdd(&maxWaiters_, -1);
+    throw;
+  }
+  atomicAdd(&maxWaiters_, -1);
+}
+
+void WorkStealingThreadManager::releasePending() {
+  atomicAdd(&pendingCount_, -1);
+  if (maxWaiters_ > 0) {
+    Synchronized s(maxMonitor_);
+    maxMonitor_.notify();
+  }
+}
+
+void WorkStealingThreadManager::add(shared_ptr<Runnable> value,
+                                    int64_t timeout,
+                                    int64_t expiration) {
+  if (state_ != ThreadManager::STARTED) {
+    throw IllegalStateException("ThreadManager::Impl::add ThreadManager "
+                                "not started");
+  }
+
+  reservePending(timeout);
+
+  Task* task = new Task(value, expiration);
+  unsigned long index = static_cast<unsigned long>(atomicAdd(&nextQueue_, 1));
+  Queue* q = queues_[index % queues_.size()];
+
+  Task* head = q->inbox_;
+  Task* seen;
+  for (;;) {
+    task->next_ = head;
+    seen = atomicCompareAndSwap(&q->inbox_, head, task);
+    if (seen == head) {
+      break;
+    }
+    head = seen;
+  }
+
+  // If idle thread is available notify it, otherwise all worker threads are
+  // running and will get around to this task in time.
+  if (idleCount_ > 0) {
+    Synchronized s(idleMonitor_);
+    idleMonitor_.notify();
+  }
+}
+
+void WorkStealingThreadManager::collect(Queue* q) {
+  Task* head = atomicExchange(&q->inbox_, static_cast<Task*>(NULL));
+  if (head == NULL) {
+    return;
+  }
+
+  // The inbox is newest first; reverse it to keep arrival order
+  Task* task = NULL;
+  while (head != NULL) {
+    Task* next = head->next_;
+    head->next_ = task;
+    task = head;
+    head = next;
+  }
+
+  while (task != NULL) {
+    Task* next = task->next_;
+    task->next_ = NULL;
+    q->tasks_.push_back(task);
+    task = next;
+  }
+  q->size_ = q->tasks_.size();
+}
+
+WorkStealingThreadManager::Task* WorkStealingThreadManager::take(size_t home) {
+  Queue* q = queues_[home];
+  {
+    Guard g(q->mutex_);
+    if (q->tasks_.empty()) {
+      collect(q);
+    }
+    if (!q->tasks_.empty()) {
+      Task* task = q->tasks_.front();
+      q->tasks_.pop_front();
+      q->size_ = q->tasks_.size();
+      return task;
+    }
+  }
+
+  return queues_.size() > 1 ? steal(home) : NULL;
+}
+
+WorkStealingThreadManager::Task* WorkStealingThreadManager::steal(size_t home) {
+  std::vector<Task*> stolen;
+
+  for (size_t ix = 1; ix < queues_.size() && stolen.empty(); ix++) {
+    Queue* victim = queues_[(home + ix) % queues_.size()];
+    if (victim->size_ == 0 && victim->inbox_ == NULL) {
+      continue;
+    }
+    // Never wait for a victim, someone else is serving it
+    if (!victim->mutex_.trylock()) {
+      continue;
+    }
+    collect(victim);
+    size_t count = (victim->tasks_.size() + 1) / 2;
+    for (size_t n = 0; n < count; n++) {
+      stolen.push_back(victim->tasks_.front());
+      victim->tasks_.pop_front();
+    }
+    victim->size_ = victim->tasks_.size();
+    victim->mutex_.unlock();
+  }
+
+  if (stolen.empty()) {
+    return NULL;
+  }
+
+  if (stolen.size() > 1) {
+    Queue* q = queues_[home];
+    Guard g(q->mutex_);
+    q->tasks_.insert(q->tasks_.end(), stolen.begin() + 1, stolen.end());
+    q->size_ = q->tasks_.size();
+  }
+  return stolen[0];
+}
+
+void WorkStealingThreadManager::expire(Task* task) {
+  if (expireCallback_) {
+    expireCallback_(task->getRunnable());
+  }
+  atomicAdd(&expiredCount_, 1);
+  releasePending();
+  delete task;
+}
+
+void WorkStealingThreadManager::remove(shared_ptr<Runnable> task) {
+  (void) task;
+  if (state_ != ThreadManager::STARTED) {
+    throw IllegalStateException("ThreadManager::Impl::remove ThreadManager not "
+                                "started");
+  }
+}
+
+shared_ptr<Runnable> WorkStealingThreadManager::removeNextPending() {
+  if (state_ != ThreadManager::STARTED) {
+    throw IllegalStateException("ThreadManager::Impl::removeNextPending "
+                                "ThreadManager not started");
+  }
+
+  for (size_t ix = 0; ix < queues_.size(); ix++) {
+    Queue* q = queues_[ix];
+    Task* task = NULL;
+    {
+      Guard g(q->mutex_);
+      collect(q);
+      if (!q->tasks_.empty()) {
+        task = q->tasks_.front();
+        q->tasks_.pop_front();
+        q->size_ = q->tasks_.size();
+      }
+    }
+    if (task != NULL) {
+      shared_ptr<Runnable> result = task->getRunnable();
+      releasePending();
+      delete task;
+      return result;
+    }
+  }
+
+  return shared_ptr<Runnable>();
+}
+
+void WorkStealingThreadManager::removeExpiredTasks() {
+  int64_t now = 0LL; // we won't ask for the time untile we need it
+
+  // note that each queue is only scanned up to its first non-expiring task
+  for (size_t ix = 0; ix < queues_.size(); ix++) {
+    Queue* q = queues_[ix];
+    std::vector<Task*> expired;
+    {
+      Guard g(q->mutex_);
+      collect(q);
+      while (!q->tasks_.empty()) {
+        Task* task = q->tasks_.front();
+        if (task->getExpireTime() == 0LL) {
+          break;
+        }
+        if (now == 0LL) {
+          now = Util::currentTime();
+        }
+        if (!task->isExpired(now)) {
+          break;
+        }
+        expired.push_back(task);
+        q->tasks_.pop_front();
+      }
+      q->size_ = q->tasks_.size();
+    }
+
+    for (size_t n = 0; n < expired.size(); n++) {
+      expire(expired[n]);
+    }
+  }
+}
+
+void WorkStealingThreadManager::setExpireCallback(ExpireCallback expireCallback) {
+  expireCallback_ = expireCallback;
+}
+
+shared_ptr<ThreadManager> ThreadManager::newWorkStealingThreadManager(size_t count, size_t pendingTaskCountMax) {
+  return shared_ptr<ThreadManager>(new WorkStealingThreadManager(count, pendingTaskCountMax));
+}
+
+}}} // apache::thrift::concurrency
@@ -139,6 +139,132 @@ class TBinaryProtocolT
 
   inline uint32_t writeBinary(const std::string& str);
 
+  uint32_t writeI32Array(const int32_t* values, const uint32_t count);
+
+  uint32_t writeI64Array(const int64_t* values, const uint32_t count);
+
+  uint32_t writeDoubleArray(const double* values, const uint32_t count);
+
+  /**
+   * Size calculation functions
+   */
+
+  bool hasSerializedSize() const {
+    return true;
+  }
+
+  inline uint32_t serializedSizeMessageBegin(const std::string& name,
+                                             const TMessageType messageType,
+                                             const int32_t seqid);
+
+  uint32_t serializedSizeStructBegin(const char* name) {
+    (void) name;
+    return 0;
+  }
+
+  uint32_t serializedSizeStructEnd() {
+    return 0;
+  }
+
+  uint32_t serializedSizeFieldBegin(const char* name,
+                                    const TType fieldType,
+                                    const int16_t fieldId) {
+    (void) name;
+    (void) fieldType;
+    (void) fieldId;
+    return 3;
+  }
+
+  uint32_t serializedSizeFieldStop() {
+    return 1;
+  }
+
+  uint32_t serializedSizeMapBegin(const TType keyType,
+                                  const TType valType,
+                                  const uint32_t size) {
+    (void) keyType;
+    (void) valType;
+    (void) size;
+    return 6;
+  }
+
+  uint32_t serializedSizeListBegin(const TType elemType, const uint32_t size) {
+    (void) elemType;
+    (void) size;
+    return 5;
+  }
+
+  uint32_t serializedSizeSetBegin(const TType elemType, const uint32_t size) {
+    (void) elemType;
+    (void) size;
+    return 5;
+  }
+
+  uint32_t serializedSizeBool(const bool value) {
+    (void) value;
+    return 1;
+  }
+
+  uint32_t serializedSizeByte(const int8_t byte) {
+    (void) byte;
+    return 1;
+  }
+
+  uint32_t serializedSizeI16(const int16_t i16) {
+    (void) i16;
+    return 2;
+  }
+
+  uint32_t serializedSizeI32(const int32_t i32) {
+    (void) i32;
+    return 4;
+  }
+
+  uint32_t serializedSizeI64(const int64_t i64) {
+    (void) i64;
+    return 8;
+  }
+
+  uint32_t serializedSizeDouble(const double dub) {
+    (void) dub;
+    return 8;
+  }
+
+  uint32_t serializedSizeString(const std::string& str) {
+    return 4 + static_cast<uint32_t>(str.size());
+  }
+
+  uint32_t serializedSizeBinary(const std::string& str) {
+    return serializedSizeString(str);
+  }
+
+  uint32_t serializedSizeI32Array(const int32_t* values, const uint32_t count) {
+    (void) values;
+    return count * 4;
+  }
+
+  uint32_t serializedSizeI64Array(const int64_t* values, const uint32_t count) {
+    (void) values;
+    return count * 8;
+  }
+
+  uint32_t serializedSizeDoubleArray(const double* values, const uint32_t count) {
+    (void) values;
+    return count * 8;
+  }
+
+  /**
+   * Raw value functions
+   */
+
+  TRawFormat getRawFormat() const {
+    return T_RAW_BINARY;
+  }
+
+  uint32_t readRaw(TType type, std::string& raw);
+
+  uint32_t writeRaw(const std::string& raw);
+
   /**
    * Reading functions
    */
@@ -193,6 +319,16 @@ class TBinaryProtocolT
 
   inline uint32_t readBinary(std::string& str);
 
+  uint32_t readStringView(TStringView& str);
+
+  inline uint32_t readBinaryView(TStringView& str);
+
+  uint32_t readI32Array(int32_t* values, uint32_t count);
+
+  uint32_t readI64Array(int64_t* values, uint32_t count);
+
+  uint32_t readDoubleArray(double* values, uint32_t count);
+
  protected:
   template<typename StrType>
   uint32_t readStringBody(StrType& str, int32_t sz);
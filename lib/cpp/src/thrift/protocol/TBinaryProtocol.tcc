@@ -22,6 +22,9 @@
 
 #include <thrift/protocol/TBinaryProtocol.h>
 
+#include <thrift/transport/TRecordingTransport.h>
+
+#include <algorithm>
 #include <limits>
 
 
@@ -47,6 +50,17 @@ uint32_t TBinaryProtocolT<Transport_>::writeMessageBegin(const std::string& name
   }
 }
 
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::serializedSizeMessageBegin(
+    const std::string& name,
+    const TMessageType messageType,
+    const int32_t seqid) {
+  (void) messageType;
+  (void) seqid;
+  // Version or type, name, seqid
+  return (this->strict_write_ ? 4 : 1) + serializedSizeString(name) + 4;
+}
+
 template <class Transport_>
 uint32_t TBinaryProtocolT<Transport_>::writeMessageEnd() {
   return 0;
@@ -174,6 +188,59 @@ uint32_t TBinaryProtocolT<Transport_>::writeDouble(const double dub) {
   return 8;
 }
 
+/*
+ * The array functions swap a chunk at a time into a stack buffer and write
+ * that, or read straight into the caller's array and swap in place.  The
+ * swap loops are kept simple enough for the compiler to vectorize.
+ */
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeI32Array(const int32_t* values,
+                                                     const uint32_t count) {
+  uint32_t net[256];
+  for (uint32_t i = 0; i < count; ) {
+    uint32_t n = std::min(count - i, (uint32_t)(sizeof(net) / sizeof(net[0])));
+    for (uint32_t j = 0; j < n; ++j) {
+      net[j] = htonl((uint32_t)values[i + j]);
+    }
+    this->trans_->write((uint8_t*)net, n * 4);
+    i += n;
+  }
+  return count * 4;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeI64Array(const int64_t* values,
+                                                     const uint32_t count) {
+  uint64_t net[128];
+  for (uint32_t i = 0; i < count; ) {
+    uint32_t n = std::min(count - i, (uint32_t)(sizeof(net) / sizeof(net[0])));
+    for (uint32_t j = 0; j < n; ++j) {
+      net[j] = htonll((uint64_t)values[i + j]);
+    }
+    this->trans_->write((uint8_t*)net, n * 8);
+    i += n;
+  }
+  return count * 8;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeDoubleArray(const double* values,
+                                                        const uint32_t count) {
+  BOOST_STATIC_ASSERT(sizeof(double) == sizeof(uint64_t));
+  BOOST_STATIC_ASSERT(std::numeric_limits<double>::is_iec559);
+
+  uint64_t net[128];
+  for (uint32_t i = 0; i < count; ) {
+    uint32_t n = std::min(count - i, (uint32_t)(sizeof(net) / sizeof(net[0])));
+    for (uint32_t j = 0; j < n; ++j) {
+      net[j] = htonll(bitwise_cast<uint64_t>(values[i + j]));
+    }
+    this->trans_->write((uint8_t*)net, n * 8);
+    i += n;
+  }
+  return count * 8;
+}
+
 
 template <class Transport_>
 template<typename StrType>
@@ -417,6 +484,80 @@ uint32_t TBinaryProtocolT<Transport_>::readBinary(std::string& str) {
   return TBinaryProtocolT<Transport_>::readString(str);
 }
 
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readStringView(TStringView& str) {
+  int32_t size;
+  uint32_t result = readI32(size);
+
+  if (size < 0) {
+    throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+  }
+  if (this->string_limit_ > 0 && size > this->string_limit_) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+  if (size == 0) {
+    str = TStringView();
+    return result;
+  }
+
+  uint32_t got = size;
+  const uint8_t* borrow_buf = this->trans_->borrow(NULL, &got);
+  if (borrow_buf == NULL) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "string view needs the whole string buffered");
+  }
+  str = TStringView(reinterpret_cast<const char*>(borrow_buf), size);
+  this->trans_->consume(size);
+  return result + (uint32_t)size;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readBinaryView(TStringView& str) {
+  return TBinaryProtocolT<Transport_>::readStringView(str);
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readI32Array(int32_t* values,
+                                                    uint32_t count) {
+  if (count > std::numeric_limits<uint32_t>::max() / 4) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+  this->trans_->readAll((uint8_t*)values, count * 4);
+  for (uint32_t i = 0; i < count; ++i) {
+    values[i] = (int32_t)ntohl((uint32_t)values[i]);
+  }
+  return count * 4;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readI64Array(int64_t* values,
+                                                    uint32_t count) {
+  if (count > std::numeric_limits<uint32_t>::max() / 8) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+  this->trans_->readAll((uint8_t*)values, count * 8);
+  for (uint32_t i = 0; i < count; ++i) {
+    values[i] = (int64_t)ntohll((uint64_t)values[i]);
+  }
+  return count * 8;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readDoubleArray(double* values,
+                                                       uint32_t count) {
+  BOOST_STATIC_ASSERT(sizeof(double) == sizeof(uint64_t));
+  BOOST_STATIC_ASSERT(std::numeric_limits<double>::is_iec559);
+
+  if (count > std::numeric_limits<uint32_t>::max() / 8) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+  this->trans_->readAll((uint8_t*)values, count * 8);
+  for (uint32_t i = 0; i < count; ++i) {
+    values[i] = bitwise_cast<double>(ntohll(bitwise_cast<uint64_t>(values[i])));
+  }
+  return count * 8;
+}
+
 template <class Transport_>
 template<typename StrType>
 uint32_t TBinaryProtocolT<Transport_>::readStringBody(StrType& str,
@@ -451,6 +592,24 @@ uint32_t TBinaryProtocolT<Transport_>::readStringBody(StrType& str,
   return (uint32_t)size;
 }
 
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readRaw(TType type, std::string& raw) {
+  using transport::TRecordingTransport;
+  boost::shared_ptr<TRecordingTransport> recorder(
+    new TRecordingTransport(this->getTransport(), &raw));
+  TBinaryProtocolT<TRecordingTransport> prot(recorder, string_limit_,
+                                             container_limit_, strict_read_,
+                                             strict_write_);
+  return ::apache::thrift::protocol::skip(prot, type);
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeRaw(const std::string& raw) {
+  uint32_t size = static_cast<uint32_t>(raw.size());
+  trans_->write(reinterpret_cast<const uint8_t*>(raw.data()), size);
+  return size;
+}
+
 }}} // apache::thrift::protocol
 
 #endif // #ifndef _THRIFT_PROTOCOL_TBINARYPROTOCOL_TCC_
@@ -70,11 +70,18 @@ class TCompactProtocolT
   std::stack<int16_t> lastField_;
   int16_t lastFieldId_;
 
+  /**
+   * (Sizing) Set by serializedSizeFieldBegin() for a boolean field, whose
+   * value takes no space of its own.
+   */
+  bool sizingBoolField_;
+
  public:
   TCompactProtocolT(boost::shared_ptr<Transport_> trans) :
     TVirtualProtocol< TCompactProtocolT<Transport_> >(trans),
     trans_(trans.get()),
     lastFieldId_(0),
+    sizingBoolField_(false),
     string_limit_(0),
     string_buf_(NULL),
     string_buf_size_(0),
@@ -89,6 +96,7 @@ class TCompactProtocolT
     TVirtualProtocol< TCompactProtocolT<Transport_> >(trans),
     trans_(trans.get()),
     lastFieldId_(0),
+    sizingBoolField_(false),
     string_limit_(string_limit),
     string_buf_(NULL),
     string_buf_size_(0),
@@ -146,6 +154,96 @@ class TCompactProtocolT
 
   uint32_t writeBinary(const std::string& str);
 
+  uint32_t writeI32Array(const int32_t* values, const uint32_t count);
+
+  uint32_t writeI64Array(const int64_t* values, const uint32_t count);
+
+  uint32_t writeDoubleArray(const double* values, const uint32_t count);
+
+  /**
+   * Size calculation functions
+   */
+
+  bool hasSerializedSize() const {
+    return true;
+  }
+
+  uint32_t serializedSizeMessageBegin(const std::string& name,
+                                      const TMessageType messageType,
+                                      const int32_t seqid);
+
+  uint32_t serializedSizeStructBegin(const char* name);
+
+  uint32_t serializedSizeStructEnd();
+
+  uint32_t serializedSizeFieldBegin(const char* name,
+                                    const TType fieldType,
+                                    const int16_t fieldId);
+
+  uint32_t serializedSizeFieldStop() {
+    return 1;
+  }
+
+  uint32_t serializedSizeMapBegin(const TType keyType,
+                                  const TType valType,
+                                  const uint32_t size);
+
+  uint32_t serializedSizeListBegin(const TType elemType, const uint32_t size);
+
+  uint32_t serializedSizeSetBegin(const TType elemType, const uint32_t size);
+
+  uint32_t serializedSizeBool(const bool value);
+
+  uint32_t serializedSizeByte(const int8_t byte) {
+    (void) byte;
+    return 1;
+  }
+
+  uint32_t serializedSizeI16(const int16_t i16) {
+    return varintSize32(i32ToZigzag(i16));
+  }
+
+  uint32_t serializedSizeI32(const int32_t i32) {
+    return varintSize32(i32ToZigzag(i32));
+  }
+
+  uint32_t serializedSizeI64(const int64_t i64) {
+    return varintSize64(i64ToZigzag(i64));
+  }
+
+  uint32_t serializedSizeDouble(const double dub) {
+    (void) dub;
+    return 8;
+  }
+
+  uint32_t serializedSizeString(const std::string& str);
+
+  uint32_t serializedSizeBinary(const std::string& str) {
+    return serializedSizeString(str);
+  }
+
+  uint32_t serializedSizeI32Array(const int32_t* values, const uint32_t count);
+
+  uint32_t serializedSizeI64Array(const int64_t* values, const uint32_t count);
+
+  uint32_t serializedSizeDoubleArray(const double* values, const uint32_t count) {
+    (void) values;
+    return count * 8;
+  }
+
+  /**
+   * Raw value functions.  A bool field keeps its value in the field header,
+   * so bools cannot be read or written raw.
+   */
+
+  TRawFormat getRawFormat() const {
+    return T_RAW_COMPACT;
+  }
+
+  uint32_t readRaw(TType type, std::string& raw);
+
+  uint32_t writeRaw(const std::string& raw);
+
   /**
   * These methods are called by structs, but don't actually have any wired
   * output or purpose
@@ -166,6 +264,8 @@ class TCompactProtocolT
   uint32_t writeVarint64(uint64_t n);
   uint64_t i64ToZigzag(const int64_t l);
   uint32_t i32ToZigzag(const int32_t n);
+  static uint32_t varintSize32(uint32_t n);
+  static uint32_t varintSize64(uint64_t n);
   inline int8_t getCompactType(const TType ttype);
 
  public:
@@ -209,6 +309,16 @@ class TCompactProtocolT
 
   uint32_t readBinary(std::string& str);
 
+  uint32_t readStringView(TStringView& str);
+
+  uint32_t readBinaryView(TStringView& str);
+
+  uint32_t readI32Array(int32_t* values, uint32_t count);
+
+  uint32_t readI64Array(int64_t* values, uint32_t count);
+
+  uint32_t readDoubleArray(double* values, uint32_t count);
+
   /*
    *These methods are here for the struct to call, but don't have any wire
    * encoding.
@@ -222,6 +332,8 @@ class TCompactProtocolT
  protected:
   uint32_t readVarint32(int32_t& i32);
   uint32_t readVarint64(int64_t& i64);
+  const uint8_t* decodeVarint32(const uint8_t* buf, uint32_t& val);
+  const uint8_t* decodeVarint64(const uint8_t* buf, uint64_t& val);
   int32_t zigzagToI32(uint32_t n);
   int64_t zigzagToI64(uint64_t n);
   TType getTType(int8_t type);
@@ -19,6 +19,9 @@
 #ifndef _THRIFT_PROTOCOL_TCOMPACTPROTOCOL_TCC_
 #define _THRIFT_PROTOCOL_TCOMPACTPROTOCOL_TCC_ 1
 
+#include <thrift/transport/TRecordingTransport.h>
+
+#include <algorithm>
 #include <limits>
 
 /*
@@ -260,6 +263,92 @@ uint32_t TCompactProtocolT<Transport_>::writeDouble(const double dub) {
   return 8;
 }
 
+/**
+ * Write the elements of a list<i32>, encoding them into a local buffer and
+ * handing that to the transport in one go rather than one write per varint.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeI32Array(const int32_t* values,
+                                                      const uint32_t count) {
+  uint8_t buf[1024];
+  uint32_t used = 0;
+  uint32_t wsize = 0;
+
+  for (uint32_t i = 0; i < count; ++i) {
+    if (used > sizeof(buf) - 5) {
+      trans_->write(buf, used);
+      wsize += used;
+      used = 0;
+    }
+    uint32_t n = i32ToZigzag(values[i]);
+    while ((n & ~0x7F) != 0) {
+      buf[used++] = (uint8_t)((n & 0x7F) | 0x80);
+      n >>= 7;
+    }
+    buf[used++] = (uint8_t)n;
+  }
+  trans_->write(buf, used);
+  return wsize + used;
+}
+
+/**
+ * As writeI32Array(), for list<i64>.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeI64Array(const int64_t* values,
+                                                      const uint32_t count) {
+  uint8_t buf[1024];
+  uint32_t used = 0;
+  uint32_t wsize = 0;
+
+  for (uint32_t i = 0; i < count; ++i) {
+    if (used > sizeof(buf) - 10) {
+      trans_->write(buf, used);
+      wsize += used;
+      used = 0;
+    }
+    uint64_t n = i64ToZigzag(values[i]);
+    while ((n & ~0x7FULL) != 0) {
+      buf[used++] = (uint8_t)((n & 0x7F) | 0x80);
+      n >>= 7;
+    }
+    buf[used++] = (uint8_t)n;
+  }
+  trans_->write(buf, used);
+  return wsize + used;
+}
+
+/**
+ * Write the elements of a list<double>.  Doubles are little-endian on the
+ * wire, so on little-endian hosts the array goes out as it is.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeDoubleArray(const double* values,
+                                                         const uint32_t count) {
+  BOOST_STATIC_ASSERT(sizeof(double) == sizeof(uint64_t));
+  BOOST_STATIC_ASSERT(std::numeric_limits<double>::is_iec559);
+
+#if __THRIFT_BYTE_ORDER == __THRIFT_LITTLE_ENDIAN
+  for (uint32_t i = 0; i < count; ) {
+    // Keep each write's length within uint32_t
+    uint32_t n = std::min(count - i, (uint32_t)(1 << 28));
+    trans_->write((const uint8_t*)(values + i), n * 8);
+    i += n;
+  }
+#else
+  uint64_t le[128];
+  for (uint32_t i = 0; i < count; ) {
+    uint32_t n = std::min(count - i, (uint32_t)(sizeof(le) / sizeof(le[0])));
+    for (uint32_t j = 0; j < n; ++j) {
+      le[j] = htolell(bitwise_cast<uint64_t>(values[i + j]));
+    }
+    trans_->write((uint8_t*)le, n * 8);
+    i += n;
+  }
+#endif
+  return count * 8;
+}
+
 /**
  * Write a string to the wire with a varint size preceeding.
  */
@@ -397,6 +486,32 @@ uint32_t TCompactProtocolT<Transport_>::i32ToZigzag(const int32_t n) {
   return (n << 1) ^ (n >> 31);
 }
 
+/**
+ * Number of bytes writeVarint32() takes for n.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::varintSize32(uint32_t n) {
+  uint32_t size = 1;
+  while ((n & ~0x7F) != 0) {
+    n >>= 7;
+    ++size;
+  }
+  return size;
+}
+
+/**
+ * Number of bytes writeVarint64() takes for n.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::varintSize64(uint64_t n) {
+  uint32_t size = 1;
+  while ((n & ~0x7FULL) != 0) {
+    n >>= 7;
+    ++size;
+  }
+  return size;
+}
+
 /**
  * Given a TType value, find the appropriate detail::compact::Types value
  */
@@ -405,6 +520,124 @@ int8_t TCompactProtocolT<Transport_>::getCompactType(const TType ttype) {
   return detail::compact::TTypeToCType[ttype];
 }
 
+//
+// Size Calculation Methods
+//
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::serializedSizeMessageBegin(
+    const std::string& name,
+    const TMessageType messageType,
+    const int32_t seqid) {
+  (void) messageType;
+  // Protocol id, version and type, seqid, name
+  return 2 + varintSize32(seqid) + serializedSizeString(name);
+}
+
+/**
+ * Structs keep the same field id stack as writeStructBegin() does, so that
+ * field headers are sized with the right deltas.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::serializedSizeStructBegin(const char* name) {
+  (void) name;
+  lastField_.push(lastFieldId_);
+  lastFieldId_ = 0;
+  return 0;
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::serializedSizeStructEnd() {
+  lastFieldId_ = lastField_.top();
+  lastField_.pop();
+  return 0;
+}
+
+/**
+ * A field header is the same size whether or not a boolean value is folded
+ * into it, so only the value's own size depends on sizingBoolField_.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::serializedSizeFieldBegin(
+    const char* name,
+    const TType fieldType,
+    const int16_t fieldId) {
+  (void) name;
+  uint32_t size;
+  if (fieldId > lastFieldId_ && fieldId - lastFieldId_ <= 15) {
+    size = 1;
+  } else {
+    size = 1 + serializedSizeI16(fieldId);
+  }
+  lastFieldId_ = fieldId;
+  sizingBoolField_ = (fieldType == T_BOOL);
+  return size;
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::serializedSizeMapBegin(
+    const TType keyType,
+    const TType valType,
+    const uint32_t size) {
+  (void) keyType;
+  (void) valType;
+  return size == 0 ? 1 : varintSize32(size) + 1;
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::serializedSizeListBegin(
+    const TType elemType,
+    const uint32_t size) {
+  (void) elemType;
+  return size <= 14 ? 1 : 1 + varintSize32(size);
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::serializedSizeSetBegin(
+    const TType elemType,
+    const uint32_t size) {
+  return serializedSizeListBegin(elemType, size);
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::serializedSizeBool(const bool value) {
+  (void) value;
+  if (sizingBoolField_) {
+    sizingBoolField_ = false;
+    return 0;
+  }
+  return 1;
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::serializedSizeString(
+    const std::string& str) {
+  uint32_t size = static_cast<uint32_t>(str.size());
+  return varintSize32(size) + size;
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::serializedSizeI32Array(
+    const int32_t* values,
+    const uint32_t count) {
+  uint32_t size = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    size += varintSize32(i32ToZigzag(values[i]));
+  }
+  return size;
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::serializedSizeI64Array(
+    const int64_t* values,
+    const uint32_t count) {
+  uint32_t size = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    size += varintSize64(i64ToZigzag(values[i]));
+  }
+  return size;
+}
+
 //
 // Reading Methods
 //
@@ -707,16 +940,167 @@ uint32_t TCompactProtocolT<Transport_>::readBinary(std::string& str) {
   return rsize + (uint32_t)size;
 }
 
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readStringView(TStringView& str) {
+  return readBinaryView(str);
+}
+
+/**
+ * Read a byte[] from the wire without copying it out of the transport.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readBinaryView(TStringView& str) {
+  int32_t rsize = 0;
+  int32_t size;
+
+  rsize += readVarint32(size);
+  if (size == 0) {
+    str = TStringView();
+    return rsize;
+  }
+
+  if (size < 0) {
+    throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+  }
+  if (string_limit_ > 0 && size > string_limit_) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+
+  uint32_t got = size;
+  const uint8_t* borrowed = trans_->borrow(NULL, &got);
+  if (borrowed == NULL) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "string view needs the whole string buffered");
+  }
+  str = TStringView(reinterpret_cast<const char*>(borrowed), size);
+  trans_->consume(size);
+
+  return rsize + (uint32_t)size;
+}
+
+/**
+ * Read the elements of a list<i32>.  Varints are decoded straight out of the
+ * transport's buffer for as long as it holds a whole varint, and the bytes
+ * are consumed once per batch; past that this falls back to readI32(),
+ * which lets the transport refill.  Either way a varint over 5 bytes is
+ * rejected.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readI32Array(int32_t* values,
+                                                     uint32_t count) {
+  uint32_t rsize = 0;
+  uint32_t i = 0;
+
+  while (i < count) {
+    uint32_t avail = 5;
+    const uint8_t* borrowed = trans_->borrow(NULL, &avail);
+    if (borrowed == NULL) {
+      rsize += readI32(values[i++]);
+      continue;
+    }
+    const uint8_t* p = borrowed;
+    const uint8_t* last = borrowed + avail - 5;
+    while (i < count && p <= last) {
+      uint32_t val;
+      p = decodeVarint32(p, val);
+      values[i++] = zigzagToI32(val);
+    }
+    uint32_t used = (uint32_t)(p - borrowed);
+    trans_->consume(used);
+    rsize += used;
+  }
+  return rsize;
+}
+
+/**
+ * As readI32Array(), for list<i64>.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readI64Array(int64_t* values,
+                                                     uint32_t count) {
+  uint32_t rsize = 0;
+  uint32_t i = 0;
+
+  while (i < count) {
+    uint32_t avail = 10;
+    const uint8_t* borrowed = trans_->borrow(NULL, &avail);
+    if (borrowed == NULL) {
+      rsize += readI64(values[i++]);
+      continue;
+    }
+    const uint8_t* p = borrowed;
+    const uint8_t* last = borrowed + avail - 10;
+    while (i < count && p <= last) {
+      uint64_t val;
+      p = decodeVarint64(p, val);
+      values[i++] = zigzagToI64(val);
+    }
+    uint32_t used = (uint32_t)(p - borrowed);
+    trans_->consume(used);
+    rsize += used;
+  }
+  return rsize;
+}
+
+/**
+ * Read the elements of a list<double> straight into the array.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readDoubleArray(double* values,
+                                                        uint32_t count) {
+  BOOST_STATIC_ASSERT(sizeof(double) == sizeof(uint64_t));
+  BOOST_STATIC_ASSERT(std::numeric_limits<double>::is_iec559);
+
+  if (count > std::numeric_limits<uint32_t>::max() / 8) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+  trans_->readAll((uint8_t*)values, count * 8);
+#if __THRIFT_BYTE_ORDER != __THRIFT_LITTLE_ENDIAN
+  for (uint32_t i = 0; i < count; ++i) {
+    values[i] = bitwise_cast<double>(letohll(bitwise_cast<uint64_t>(values[i])));
+  }
+#endif
+  return count * 8;
+}
+
 /**
  * Read an i32 from the wire as a varint. The MSB of each byte is set
  * if there is another byte to follow. This can read up to 5 bytes.
  */
 template <class Transport_>
 uint32_t TCompactProtocolT<Transport_>::readVarint32(int32_t& i32) {
-  int64_t val;
-  uint32_t rsize = readVarint64(val);
-  i32 = (int32_t)val;
-  return rsize;
+  uint32_t rsize = 0;
+  uint32_t val = 0;
+  int shift = 0;
+  uint8_t buf[5];  // 32 bits / (7 bits/byte) = 5 bytes.
+  uint32_t buf_size = sizeof(buf);
+  const uint8_t* borrowed = trans_->borrow(buf, &buf_size);
+
+  // Fast path.
+  if (borrowed != NULL) {
+    const uint8_t* end = decodeVarint32(borrowed, val);
+    rsize = (uint32_t)(end - borrowed);
+    trans_->consume(rsize);
+    i32 = (int32_t)val;
+    return rsize;
+  }
+
+  // Slow path.
+  else {
+    while (true) {
+      uint8_t byte;
+      rsize += trans_->readAll(&byte, 1);
+      val |= (uint32_t)(byte & 0x7f) << shift;
+      shift += 7;
+      if (!(byte & 0x80)) {
+        i32 = (int32_t)val;
+        return rsize;
+      }
+      if (UNLIKELY(rsize >= sizeof(buf))) {
+        throw TProtocolException(TProtocolException::INVALID_DATA, "Variable-length int over 5 bytes.");
+      }
+    }
+  }
 }
 
 /**
@@ -770,6 +1154,44 @@ uint32_t TCompactProtocolT<Transport_>::readVarint64(int64_t& i64) {
   }
 }
 
+/**
+ * Decode a 32-bit varint from a buffer that is known to hold at least 5
+ * bytes, returning the position just past it.
+ */
+template <class Transport_>
+const uint8_t* TCompactProtocolT<Transport_>::decodeVarint32(const uint8_t* buf,
+                                                            uint32_t& val) {
+  uint32_t result = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    uint8_t byte = *buf++;
+    result |= (uint32_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      val = result;
+      return buf;
+    }
+  }
+  throw TProtocolException(TProtocolException::INVALID_DATA, "Variable-length int over 5 bytes.");
+}
+
+/**
+ * Decode a varint from a buffer that is known to hold at least 10 bytes,
+ * returning the position just past it.
+ */
+template <class Transport_>
+const uint8_t* TCompactProtocolT<Transport_>::decodeVarint64(const uint8_t* buf,
+                                                            uint64_t& val) {
+  uint64_t result = 0;
+  for (int shift = 0; shift < 70; shift += 7) {
+    uint8_t byte = *buf++;
+    result |= (uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      val = result;
+      return buf;
+    }
+  }
+  throw TProtocolException(TProtocolException::INVALID_DATA, "Variable-length int over 10 bytes.");
+}
+
 /**
  * Convert from zigzag int to int.
  */
@@ -819,6 +1241,32 @@ TType TCompactProtocolT<Transport_>::getTType(int8_t type) {
   }
 }
 
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readRaw(TType type,
+                                               std::string& raw) {
+  using transport::TRecordingTransport;
+  if (type == T_BOOL) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "bool values cannot be read raw.");
+  }
+  boost::shared_ptr<TRecordingTransport> recorder(
+    new TRecordingTransport(this->getTransport(), &raw));
+  TCompactProtocolT<TRecordingTransport> prot(recorder, string_limit_,
+                                              container_limit_);
+  return ::apache::thrift::protocol::skip(prot, type);
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeRaw(const std::string& raw) {
+  if (booleanField_.name != NULL) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "bool values cannot be written raw.");
+  }
+  uint32_t size = static_cast<uint32_t>(raw.size());
+  trans_->write(reinterpret_cast<const uint8_t*>(raw.data()), size);
+  return size;
+}
+
 }}} // apache::thrift::protocol
 
 #endif // _THRIFT_PROTOCOL_TCOMPACTPROTOCOL_TCC_
@@ -0,0 +1,213 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/protocol/TDeadlineProtocol.h>
+#include <thrift/concurrency/Util.h>
+
+#include <cstdio>
+
+namespace apache { namespace thrift { namespace protocol {
+
+using apache::thrift::concurrency::Util;
+
+namespace {
+
+#ifdef _WIN32
+__declspec(thread) int64_t arrivalTime = 0;
+#else
+__thread int64_t arrivalTime = 0;
+#endif
+
+/// Budgets longer than this are taken as no deadline at all
+const int64_t MAX_BUDGET = (int64_t)1 << 40;
+
+}
+
+void TDeadlineProtocol::setArrivalTime(int64_t arrival) {
+  arrivalTime = arrival;
+}
+
+bool TDeadlineProtocol::stripDeadline(std::string& name, int64_t& deadline) {
+  int64_t arrival = arrivalTime;
+  arrivalTime = 0;
+
+  std::string::size_type pos = name.rfind(SEPARATOR);
+  if (pos == std::string::npos || pos + 1 == name.size()) {
+    return false;
+  }
+
+  int64_t budget = 0;
+  for (std::string::size_type i = pos + 1; i < name.size(); ++i) {
+    char c = name[i];
+    if (c < '0' || c > '9') {
+      return false;
+    }
+    if (budget < MAX_BUDGET) {
+      budget = budget * 10 + (c - '0');
+    }
+  }
+  name.resize(pos);
+
+  if (budget >= MAX_BUDGET) {
+    deadline = 0;
+  } else {
+    deadline = (arrival != 0 ? arrival : Util::currentTime()) + budget;
+  }
+  return true;
+}
+
+bool TDeadlineProtocol::isExpired(int64_t deadline) {
+  return deadline != 0 && Util::currentTime() > deadline;
+}
+
+uint32_t TDeadlineProtocol::writeMessageBegin_virt(
+    const std::string& name,
+    const TMessageType messageType,
+    const int32_t seqid) {
+  if ((messageType == T_CALL || messageType == T_ONEWAY) && timeout_ > 0) {
+    char budget[24];
+    sprintf(budget, "%c%lld", SEPARATOR, (long long)timeout_);
+    return TProtocolDecorator::writeMessageBegin_virt(name + budget,
+                                                      messageType, seqid);
+  }
+  if ((messageType == T_REPLY || messageType == T_EXCEPTION) &&
+      isExpired(deadline_)) {
+    discarding_ = true;
+    return 0;
+  }
+  return TProtocolDecorator::writeMessageBegin_virt(name, messageType, seqid);
+}
+
+uint32_t TDeadlineProtocol::writeMessageEnd_virt() {
+  if (discarding_) {
+    discarding_ = false;
+    return 0;
+  }
+  return TProtocolDecorator::writeMessageEnd_virt();
+}
+
+uint32_t TDeadlineProtocol::writeStructBegin_virt(const char* name) {
+  return discarding_ ? 0 : TProtocolDecorator::writeStructBegin_virt(name);
+}
+
+uint32_t TDeadlineProtocol::writeStructEnd_virt() {
+  return discarding_ ? 0 : TProtocolDecorator::writeStructEnd_virt();
+}
+
+uint32_t TDeadlineProtocol::writeFieldBegin_virt(const char* name,
+                                                 const TType fieldType,
+                                                 const int16_t fieldId) {
+  return discarding_ ? 0 :
+    TProtocolDecorator::writeFieldBegin_virt(name, fieldType, fieldId);
+}
+
+uint32_t TDeadlineProtocol::writeFieldEnd_virt() {
+  return discarding_ ? 0 : TProtocolDecorator::writeFieldEnd_virt();
+}
+
+uint32_t TDeadlineProtocol::writeFieldStop_virt() {
+  return discarding_ ? 0 : TProtocolDecorator::writeFieldStop_virt();
+}
+
+uint32_t TDeadlineProtocol::writeMapBegin_virt(const TType keyType,
+                                               const TType valType,
+                                               const uint32_t size) {
+  return discarding_ ? 0 :
+    TProtocolDecorator::writeMapBegin_virt(keyType, valType, size);
+}
+
+uint32_t TDeadlineProtocol::writeMapEnd_virt() {
+  return discarding_ ? 0 : TProtocolDecorator::writeMapEnd_virt();
+}
+
+uint32_t TDeadlineProtocol::writeListBegin_virt(const TType elemType,
+                                                const uint32_t size) {
+  return discarding_ ? 0 :
+    TProtocolDecorator::writeListBegin_virt(elemType, size);
+}
+
+uint32_t TDeadlineProtocol::writeListEnd_virt() {
+  return discarding_ ? 0 : TProtocolDecorator::writeListEnd_virt();
+}
+
+uint32_t TDeadlineProtocol::writeSetBegin_virt(const TType elemType,
+                                               const uint32_t size) {
+  return discarding_ ? 0 :
+    TProtocolDecorator::writeSetBegin_virt(elemType, size);
+}
+
+uint32_t TDeadlineProtocol::writeSetEnd_virt() {
+  return discarding_ ? 0 : TProtocolDecorator::writeSetEnd_virt();
+}
+
+uint32_t TDeadlineProtocol::writeBool_virt(const bool value) {
+  return discarding_ ? 0 : TProtocolDecorator::writeBool_virt(value);
+}
+
+uint32_t TDeadlineProtocol::writeByte_virt(const int8_t byte) {
+  return discarding_ ? 0 : TProtocolDecorator::writeByte_virt(byte);
+}
+
+uint32_t TDeadlineProtocol::writeI16_virt(const int16_t i16) {
+  return discarding_ ? 0 : TProtocolDecorator::writeI16_virt(i16);
+}
+
+uint32_t TDeadlineProtocol::writeI32_virt(const int32_t i32) {
+  return discarding_ ? 0 : TProtocolDecorator::writeI32_virt(i32);
+}
+
+uint32_t TDeadlineProtocol::writeI64_virt(const int64_t i64) {
+  return discarding_ ? 0 : TProtocolDecorator::writeI64_virt(i64);
+}
+
+uint32_t TDeadlineProtocol::writeDouble_virt(const double dub) {
+  return discarding_ ? 0 : TProtocolDecorator::writeDouble_virt(dub);
+}
+
+uint32_t TDeadlineProtocol::writeString_virt(const std::string& str) {
+  return discarding_ ? 0 : TProtocolDecorator::writeString_virt(str);
+}
+
+uint32_t TDeadlineProtocol::writeBinary_virt(const std::string& str) {
+  return discarding_ ? 0 : TProtocolDecorator::writeBinary_virt(str);
+}
+
+uint32_t TDeadlineProtocol::writeI32Array_virt(const int32_t* values,
+                                               const uint32_t count) {
+  return discarding_ ? 0 :
+    TProtocolDecorator::writeI32Array_virt(values, count);
+}
+
+uint32_t TDeadlineProtocol::writeI64Array_virt(const int64_t* values,
+                                               const uint32_t count) {
+  return discarding_ ? 0 :
+    TProtocolDecorator::writeI64Array_virt(values, count);
+}
+
+uint32_t TDeadlineProtocol::writeDoubleArray_virt(const double* values,
+                                                  const uint32_t count) {
+  return discarding_ ? 0 :
+    TProtocolDecorator::writeDoubleArray_virt(values, count);
+}
+
+uint32_t TDeadlineProtocol::writeRaw_virt(const std::string& raw) {
+  return discarding_ ? 0 : TProtocolDecorator::writeRaw_virt(raw);
+}
+
+}}} // apache::thrift::protocol
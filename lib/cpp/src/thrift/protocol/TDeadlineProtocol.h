@@ -0,0 +1,152 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROTOCOL_TDEADLINEPROTOCOL_H_
+#define _THRIFT_PROTOCOL_TDEADLINEPROTOCOL_H_ 1
+
+#include <thrift/protocol/TProtocolDecorator.h>
+
+#include <string>
+
+namespace apache { namespace thrift { namespace protocol {
+
+/**
+ * Carries a per-call deadline from client to server.
+ *
+ * On the client, setTimeout() makes every following call carry its time
+ * budget, appended to the method name as "@<milliseconds>".  Method names
+ * in an IDL cannot contain '@', so servers that know nothing of deadlines
+ * just answer "unknown method" instead of misrouting the call.  The
+ * decorator stacks with TMultiplexedProtocol in either order.
+ *
+ * On the server, TDispatchProcessor strips the budget with stripDeadline()
+ * and drops calls whose deadline passed while they were queued, without
+ * decoding their arguments or calling the handler.  Calls still in time
+ * are answered through a TDeadlineProtocol that discards the reply if the
+ * handler overran, since the client has given up on it by then.  Either
+ * way the client sees nothing and runs into its own timeout.
+ *
+ * Deadlines are measured on the server clock from the time the request
+ * arrived, so only the network transit is not accounted for.
+ */
+class TDeadlineProtocol : public TProtocolDecorator {
+ public:
+  static const char SEPARATOR = '@';
+
+  explicit TDeadlineProtocol(boost::shared_ptr<TProtocol> protocol)
+    : TProtocolDecorator(protocol),
+      timeout_(0),
+      deadline_(0),
+      discarding_(false) {}
+
+  virtual ~TDeadlineProtocol() {}
+
+  /**
+   * Sets the budget sent with each following call.
+   *
+   * @param timeout Budget in milliseconds, or 0 to send none
+   */
+  void setTimeout(int64_t timeout) {
+    timeout_ = timeout;
+  }
+
+  int64_t getTimeout() const {
+    return timeout_;
+  }
+
+  /**
+   * Sets the time after which replies are discarded.
+   *
+   * @param deadline Absolute time in milliseconds as returned by
+   *                 concurrency::Util::currentTime(), or 0 for none
+   */
+  void setDeadline(int64_t deadline) {
+    deadline_ = deadline;
+  }
+
+  int64_t getDeadline() const {
+    return deadline_;
+  }
+
+  /**
+   * Records when the request about to be processed on this thread arrived.
+   * Servers that queue requests call this before TProcessor::process() so
+   * that the time spent queued counts against the budget; otherwise it is
+   * measured from the time the call is processed.  The next stripDeadline()
+   * on this thread consumes it.
+   */
+  static void setArrivalTime(int64_t arrival);
+
+  /**
+   * Removes a budget appended by a client from a received method name.
+   *
+   * @param name     Method name as read from the message header
+   * @param deadline Set to the absolute deadline if the name carried one
+   * @return true if the name carried a budget
+   */
+  static bool stripDeadline(std::string& name, int64_t& deadline);
+
+  /**
+   * @return true if the deadline is set and has passed
+   */
+  static bool isExpired(int64_t deadline);
+
+  uint32_t writeMessageBegin_virt(const std::string& name,
+                                  const TMessageType messageType,
+                                  const int32_t seqid);
+  uint32_t writeMessageEnd_virt();
+
+  uint32_t writeStructBegin_virt(const char* name);
+  uint32_t writeStructEnd_virt();
+  uint32_t writeFieldBegin_virt(const char* name,
+                                const TType fieldType,
+                                const int16_t fieldId);
+  uint32_t writeFieldEnd_virt();
+  uint32_t writeFieldStop_virt();
+  uint32_t writeMapBegin_virt(const TType keyType,
+                              const TType valType,
+                              const uint32_t size);
+  uint32_t writeMapEnd_virt();
+  uint32_t writeListBegin_virt(const TType elemType, const uint32_t size);
+  uint32_t writeListEnd_virt();
+  uint32_t writeSetBegin_virt(const TType elemType, const uint32_t size);
+  uint32_t writeSetEnd_virt();
+  uint32_t writeBool_virt(const bool value);
+  uint32_t writeByte_virt(const int8_t byte);
+  uint32_t writeI16_virt(const int16_t i16);
+  uint32_t writeI32_virt(const int32_t i32);
+  uint32_t writeI64_virt(const int64_t i64);
+  uint32_t writeDouble_virt(const double dub);
+  uint32_t writeString_virt(const std::string& str);
+  uint32_t writeBinary_virt(const std::string& str);
+  uint32_t writeI32Array_virt(const int32_t* values, const uint32_t count);
+  uint32_t writeI64Array_virt(const int64_t* values, const uint32_t count);
+  uint32_t writeDoubleArray_virt(const double* values, const uint32_t count);
+  uint32_t writeRaw_virt(const std::string& raw);
+
+ private:
+  int64_t timeout_;
+  int64_t deadline_;
+  /// set between writeMessageBegin() and writeMessageEnd() of a late reply
+  bool discarding_;
+};
+
+}}} // apache::thrift::protocol
+
+#endif // #ifndef _THRIFT_PROTOCOL_TDEADLINEPROTOCOL_H_
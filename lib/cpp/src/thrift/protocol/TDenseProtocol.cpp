@@ -458,6 +458,33 @@ uint32_t TDenseProtocol::writeBinary(const std::string& str) {
   return TDenseProtocol::writeString(str);
 }
 
+uint32_t TDenseProtocol::writeI32Array(const int32_t* values,
+                                       const uint32_t count) {
+  uint32_t xfer = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    xfer += writeI32(values[i]);
+  }
+  return xfer;
+}
+
+uint32_t TDenseProtocol::writeI64Array(const int64_t* values,
+                                       const uint32_t count) {
+  uint32_t xfer = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    xfer += writeI64(values[i]);
+  }
+  return xfer;
+}
+
+uint32_t TDenseProtocol::writeDoubleArray(const double* values,
+                                          const uint32_t count) {
+  uint32_t xfer = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    xfer += writeDouble(values[i]);
+  }
+  return xfer;
+}
+
 inline uint32_t TDenseProtocol::subWriteI32(const int32_t i32) {
   return vlqWrite(i32);
 }
@@ -745,6 +772,30 @@ uint32_t TDenseProtocol::readBinary(std::string& str) {
   return TDenseProtocol::readString(str);
 }
 
+uint32_t TDenseProtocol::readI32Array(int32_t* values, uint32_t count) {
+  uint32_t xfer = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    xfer += readI32(values[i]);
+  }
+  return xfer;
+}
+
+uint32_t TDenseProtocol::readI64Array(int64_t* values, uint32_t count) {
+  uint32_t xfer = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    xfer += readI64(values[i]);
+  }
+  return xfer;
+}
+
+uint32_t TDenseProtocol::readDoubleArray(double* values, uint32_t count) {
+  uint32_t xfer = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    xfer += readDouble(values[i]);
+  }
+  return xfer;
+}
+
 uint32_t TDenseProtocol::subReadI32(int32_t& i32) {
   uint64_t u64;
   uint32_t rv = vlqRead(u64);
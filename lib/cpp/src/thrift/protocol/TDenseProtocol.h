@@ -139,6 +139,61 @@ class TDenseProtocol
 
   uint32_t writeBinary(const std::string& str);
 
+  /*
+   * Every element goes through the state machine, so these cannot use
+   * TBinaryProtocol's bulk versions.
+   */
+  uint32_t writeI32Array(const int32_t* values, const uint32_t count);
+
+  uint32_t writeI64Array(const int64_t* values, const uint32_t count);
+
+  uint32_t writeDoubleArray(const double* values, const uint32_t count);
+
+  /*
+   * TBinaryProtocol's sizes do not hold for the dense encoding.  Sizing
+   * always starts with a message or a struct, so refusing those is enough.
+   */
+  bool hasSerializedSize() const {
+    return false;
+  }
+
+  uint32_t serializedSizeMessageBegin(const std::string& name,
+                                      const TMessageType messageType,
+                                      const int32_t seqid) {
+    (void) name;
+    (void) messageType;
+    (void) seqid;
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "TDenseProtocol does not support size calculation.");
+  }
+
+  uint32_t serializedSizeStructBegin(const char* name) {
+    (void) name;
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "TDenseProtocol does not support size calculation.");
+  }
+
+  /*
+   * The dense encoding depends on the type being read, which raw bytes do
+   * not carry, so none of TBinaryProtocol's raw functions apply.
+   */
+  TRawFormat getRawFormat() const {
+    return T_RAW_NONE;
+  }
+
+  uint32_t readRaw(TType type, std::string& raw) {
+    (void) type;
+    (void) raw;
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "TDenseProtocol does not support raw values.");
+  }
+
+  uint32_t writeRaw(const std::string& raw) {
+    (void) raw;
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "TDenseProtocol does not support raw values.");
+  }
+
 
   /*
    * Helper writing functions (don't do state transitions).
@@ -206,6 +261,25 @@ class TDenseProtocol
 
   uint32_t readBinary(std::string& str);
 
+  /*
+   * TBinaryProtocol's versions would misread the dense encoding.
+   */
+  uint32_t readStringView(TStringView& str) {
+    (void) str;
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "TDenseProtocol does not support string views.");
+  }
+
+  uint32_t readBinaryView(TStringView& str) {
+    return readStringView(str);
+  }
+
+  uint32_t readI32Array(int32_t* values, uint32_t count);
+
+  uint32_t readI64Array(int64_t* values, uint32_t count);
+
+  uint32_t readDoubleArray(double* values, uint32_t count);
+
   /*
    * Helper reading functions (don't do state transitions).
    */
@@ -0,0 +1,51 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/protocol/TFieldDispatch.h>
+#include <thrift/concurrency/Atomic.h>
+
+namespace apache { namespace thrift { namespace protocol {
+
+using apache::thrift::concurrency::atomicAdd;
+using apache::thrift::concurrency::atomicCompareAndSwap;
+
+static TFieldStats* volatile fieldStatsHead = NULL;
+
+TFieldStats* field_stats_list() {
+  return fieldStatsHead;
+}
+
+void field_stats_count(TFieldStats* stats, volatile long* counter) {
+  atomicAdd(counter, 1);
+  // Only the first count writes listed, so later ones just read it
+  if (stats->listed == 0 && atomicCompareAndSwap(&stats->listed, 0L, 1L) == 0) {
+    // First count: push it onto the list
+    TFieldStats* head = fieldStatsHead;
+    while (true) {
+      stats->next = head;
+      TFieldStats* seen = atomicCompareAndSwap(&fieldStatsHead, head, stats);
+      if (seen == head) {
+        break;
+      }
+      head = seen;
+    }
+  }
+}
+
+}}} // apache::thrift::protocol
@@ -0,0 +1,106 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROTOCOL_TFIELDDISPATCH_H_
+#define _THRIFT_PROTOCOL_TFIELDDISPATCH_H_ 1
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace apache { namespace thrift { namespace protocol {
+
+// Field lookup for generated read() methods.  Each struct lists its field
+// ids in ascending order and switches on the index of the field it reads,
+// which compiles to a jump table however sparse the ids are.
+
+/**
+ * Counts of the fields a generated read() found out of order or did not
+ * know, kept per struct when the generated code is built with
+ * THRIFT_FIELD_STATS defined.  Generated code initializes it statically
+ * with all counts zero, so it lives as long as the program; it is added to
+ * the list returned by field_stats_list() the first time it counts
+ * something.
+ */
+struct TFieldStats {
+  const char* name;
+  volatile long outOfOrder;
+  volatile long unknown;
+  volatile long listed;
+  TFieldStats* next;
+};
+
+/**
+ * The TFieldStats that have counted something, linked through next, most
+ * recent first.
+ */
+TFieldStats* field_stats_list();
+
+/**
+ * Adds one to a counter of stats, putting stats on the list if it is the
+ * first thing it counts.
+ */
+void field_stats_count(TFieldStats* stats, volatile long* counter);
+
+/**
+ * Returns the index of fid in ids, which holds count field ids in ascending
+ * order, or count if fid is not among them.
+ *
+ * next is the index the field is expected at, one past the previous field,
+ * and is checked before anything else; it is moved past the field found.
+ * Fields are almost always written in order of id, so that is usually all
+ * it takes.
+ *
+ * @param stats Where to count fields that are out of order or unknown, or
+ *              NULL
+ */
+inline uint32_t field_index(const int16_t* ids, uint32_t count, int16_t fid,
+                            uint32_t& next, TFieldStats* stats) {
+  if (next < count && ids[next] == fid) {
+    return next++;
+  }
+
+  uint32_t low = 0;
+  uint32_t high = count;
+  while (low < high) {
+    uint32_t mid = low + (high - low) / 2;
+    if (ids[mid] < fid) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  if (low == count || ids[low] != fid) {
+    if (stats != NULL) {
+      field_stats_count(stats, &stats->unknown);
+    }
+    return count;
+  }
+
+  // Later than expected is still in order: the fields between were absent
+  if (stats != NULL && low < next) {
+    field_stats_count(stats, &stats->outOfOrder);
+  }
+  next = low + 1;
+  return low;
+}
+
+}}} // apache::thrift::protocol
+
+#endif // #ifndef _THRIFT_PROTOCOL_TFIELDDISPATCH_H_
@@ -20,10 +20,16 @@
 #include <thrift/protocol/TJSONProtocol.h>
 
 #include <math.h>
-#include <boost/lexical_cast.hpp>
+#include <string.h>
+#include <limits>
 #include <thrift/protocol/TBase64Utils.h>
+#include <thrift/protocol/TNumberUtils.h>
 #include <thrift/transport/TTransportException.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 using namespace apache::thrift::transport;
 
 namespace apache { namespace thrift { namespace protocol {
@@ -47,6 +53,10 @@ static const std::string kJSONEscapePrefix("\\u00");
 
 static const uint32_t kThriftVersion1 = 1;
 
+// Longest number readJSONNumericChars() accepts.  A double never needs more
+// than 17 significant digits and an exponent.
+static const uint32_t kMaxJSONNumericChars = 64;
+
 static const std::string kThriftNan("NaN");
 static const std::string kThriftInfinity("Infinity");
 static const std::string kThriftNegativeInfinity("-Infinity");
@@ -215,6 +225,41 @@ static uint8_t hexChar(uint8_t val) {
   }
 }
 
+// Return the number of characters at the start of str, up to len, that are
+// neither a quote nor a backslash, nor if controls is set a control
+// character.  Those are the characters written to a JSON string as they
+// are, and with controls clear, read from one as they are.
+static uint32_t plainJSONRun(const uint8_t *str, uint32_t len, bool controls) {
+  uint32_t pos = 0;
+#ifdef __SSE2__
+  // 16 characters at a time; a character c <= 0x1F has max(c, 0x1F) == 0x1F
+  const __m128i quote = _mm_set1_epi8(kJSONStringDelimiter);
+  const __m128i backslash = _mm_set1_epi8(kJSONBackslash);
+  const __m128i control = _mm_set1_epi8(0x1F);
+  for (; pos + 16 <= len; pos += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(str + pos));
+    __m128i special = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                                   _mm_cmpeq_epi8(chunk, backslash));
+    if (controls) {
+      special = _mm_or_si128(special,
+                             _mm_cmpeq_epi8(_mm_max_epu8(chunk, control), control));
+    }
+    int mask = _mm_movemask_epi8(special);
+    if (mask != 0) {
+      return pos + __builtin_ctz(mask);
+    }
+  }
+#endif
+  for (; pos < len; ++pos) {
+    uint8_t ch = str[pos];
+    if (ch == kJSONStringDelimiter || ch == kJSONBackslash ||
+        (controls && ch < 0x20)) {
+      break;
+    }
+  }
+  return pos;
+}
+
 // Return true if the character ch is in [-+0-9.Ee]; false otherwise
 static bool isJSONNumeric(uint8_t ch) {
   switch (ch) {
@@ -425,10 +470,22 @@ uint32_t TJSONProtocol::writeJSONString(const std::string &str) {
   uint32_t result = context_->write(*trans_);
   result += 2; // For quotes
   trans_->write(&kJSONStringDelimiter, 1);
-  std::string::const_iterator iter(str.begin());
-  std::string::const_iterator end(str.end());
-  while (iter != end) {
-    result += writeJSONChar(*iter++);
+  if(str.length() > (std::numeric_limits<uint32_t>::max)())
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  const uint8_t *bytes = (const uint8_t *)str.data();
+  uint32_t len = static_cast<uint32_t>(str.length());
+  // Write runs that need no escaping in one go
+  uint32_t pos = 0;
+  while (pos < len) {
+    uint32_t run = plainJSONRun(bytes + pos, len - pos, true);
+    if (run > 0) {
+      trans_->write(bytes + pos, run);
+      result += run;
+      pos += run;
+    }
+    if (pos < len) {
+      result += writeJSONChar(bytes[pos++]);
+    }
   }
   trans_->write(&kJSONStringDelimiter, 1);
   return result;
@@ -467,64 +524,55 @@ uint32_t TJSONProtocol::writeJSONBase64(const std::string &str) {
 template <typename NumberType>
 uint32_t TJSONProtocol::writeJSONInteger(NumberType num) {
   uint32_t result = context_->write(*trans_);
-  std::string val(boost::lexical_cast<std::string>(num));
+  // Room for the quotes around the digits
+  char buf[kMaxNumberChars + 2];
+  uint32_t len = 0;
   bool escapeNum = context_->escapeNum();
   if (escapeNum) {
-    trans_->write(&kJSONStringDelimiter, 1);
-    result += 1;
+    buf[len++] = kJSONStringDelimiter;
   }
-  if(val.length() > (std::numeric_limits<uint32_t>::max)())
-    throw TProtocolException(TProtocolException::SIZE_LIMIT);
-  trans_->write((const uint8_t *)val.c_str(), static_cast<uint32_t>(val.length()));
-  result += static_cast<uint32_t>(val.length());
+  len += number_format_integer(static_cast<int64_t>(num), buf + len);
   if (escapeNum) {
-    trans_->write(&kJSONStringDelimiter, 1);
-    result += 1;
+    buf[len++] = kJSONStringDelimiter;
   }
-  return result;
+  trans_->write((const uint8_t *)buf, len);
+  return result + len;
 }
 
 // Convert the given double to a JSON string, which is either the number,
 // "NaN" or "Infinity" or "-Infinity".
 uint32_t TJSONProtocol::writeJSONDouble(double num) {
   uint32_t result = context_->write(*trans_);
-  std::string val(boost::lexical_cast<std::string>(num));
-
-  // Normalize output of boost::lexical_cast for NaNs and Infinities
-  bool special = false;
-  switch (val[0]) {
-  case 'N':
-  case 'n':
-    val = kThriftNan;
-    special = true;
-    break;
-  case 'I':
-  case 'i':
-    val = kThriftInfinity;
-    special = true;
-    break;
-  case '-':
-    if ((val[1] == 'I') || (val[1] == 'i')) {
-      val = kThriftNegativeInfinity;
-      special = true;
-    }
-    break;
+  char buf[kMaxNumberChars + 2];
+  uint32_t len = 0;
+
+  const std::string *special = NULL;
+  if (num != num) {
+    special = &kThriftNan;
+  }
+  else if (num == HUGE_VAL) {
+    special = &kThriftInfinity;
+  }
+  else if (num == -HUGE_VAL) {
+    special = &kThriftNegativeInfinity;
   }
 
-  bool escapeNum = special || context_->escapeNum();
+  bool escapeNum = (special != NULL) || context_->escapeNum();
   if (escapeNum) {
-    trans_->write(&kJSONStringDelimiter, 1);
-    result += 1;
+    buf[len++] = kJSONStringDelimiter;
+  }
+  if (special != NULL) {
+    special->copy(buf + len, special->length());
+    len += static_cast<uint32_t>(special->length());
+  }
+  else {
+    len += number_format_double(num, buf + len);
   }
-  if(val.length() > (std::numeric_limits<uint32_t>::max)())
-    throw TProtocolException(TProtocolException::SIZE_LIMIT);
-  trans_->write((const uint8_t *)val.c_str(), static_cast<uint32_t>(val.length()));
-  result += static_cast<uint32_t>(val.length());
   if (escapeNum) {
-    trans_->write(&kJSONStringDelimiter, 1);
-    result += 1;
+    buf[len++] = kJSONStringDelimiter;
   }
-  return result;
+  trans_->write((const uint8_t *)buf, len);
+  return result + len;
 }
 
 uint32_t TJSONProtocol::writeJSONObjectStart() {
@@ -639,9 +687,7 @@ uint32_t TJSONProtocol::writeBool(const bool value) {
 }
 
 uint32_t TJSONProtocol::writeByte(const int8_t byte) {
-  // writeByte() must be handled specially becuase boost::lexical cast sees
-  // int8_t as a text type instead of an integer type
-  return writeJSONInteger((int16_t)byte);
+  return writeJSONInteger(byte);
 }
 
 uint32_t TJSONProtocol::writeI16(const int16_t i16) {
@@ -696,6 +742,20 @@ uint32_t TJSONProtocol::readJSONString(std::string &str, bool skipContext) {
   uint8_t ch;
   str.clear();
   while (true) {
+    // Append characters that need no unescaping straight from the
+    // transport's buffer, when it has one
+    uint32_t avail;
+    const uint8_t *buf = reader_.borrow(avail);
+    if (buf != NULL) {
+      uint32_t run = plainJSONRun(buf, avail, false);
+      str.append((const char *)buf, run);
+      reader_.consume(run);
+      result += run;
+      if (run == avail) {
+        continue;
+      }
+    }
+
     ch = reader_.read();
     ++result;
     if (ch == kJSONStringDelimiter) {
@@ -724,43 +784,110 @@ uint32_t TJSONProtocol::readJSONString(std::string &str, bool skipContext) {
 
 // Reads a block of base64 characters, decoding it, and returns via str
 uint32_t TJSONProtocol::readJSONBase64(std::string &str) {
-  std::string tmp;
-  uint32_t result = readJSONString(tmp);
-  uint8_t *b = (uint8_t *)tmp.c_str();
-  if(tmp.length() > (std::numeric_limits<uint32_t>::max)())
+  uint32_t result = readJSONString(str);
+  if(str.length() > (std::numeric_limits<uint32_t>::max)())
     throw TProtocolException(TProtocolException::SIZE_LIMIT);
-  uint32_t len = static_cast<uint32_t>(tmp.length());
-  str.clear();
-  while (len >= 4) {
-    base64_decode(b, 4);
-    str.append((const char *)b, 3);
-    b += 4;
-    len -= 4;
+  uint32_t len = static_cast<uint32_t>(str.length());
+  if (len == 0) {
+    return result;
+  }
+  // Decode in place: each 4 characters become 3 bytes, written behind them
+  uint8_t *b = (uint8_t *)&str[0];
+  uint32_t in = 0;
+  uint32_t out = 0;
+  while (len - in >= 4) {
+    base64_decode(b + in, 4);
+    memmove(b + out, b + in, 3);
+    in += 4;
+    out += 3;
   }
   // Don't decode if we hit the end or got a single leftover byte (invalid
   // base64 but legal for skip of regular string type)
-  if (len > 1) {
-    base64_decode(b, len);
-    str.append((const char *)b, len - 1);
+  if (len - in > 1) {
+    base64_decode(b + in, len - in);
+    memmove(b + out, b + in, len - in - 1);
+    out += len - in - 1;
   }
+  str.resize(out);
   return result;
 }
 
 // Reads a sequence of characters, stopping at the first one that is not
-// a valid JSON numeric character.
-uint32_t TJSONProtocol::readJSONNumericChars(std::string &str) {
-  uint32_t result = 0;
-  str.clear();
+// a valid JSON numeric character, into buf.  Returns the number of
+// characters read.
+uint32_t TJSONProtocol::readJSONNumericChars(char *buf, uint32_t size) {
+  uint32_t len = 0;
   while (true) {
+    uint32_t avail;
+    const uint8_t *bytes = reader_.borrow(avail);
+    if (bytes != NULL) {
+      uint32_t run = 0;
+      while (run < avail && len + run < size && isJSONNumeric(bytes[run])) {
+        buf[len + run] = bytes[run];
+        ++run;
+      }
+      reader_.consume(run);
+      len += run;
+      if (run == avail) {
+        continue;
+      }
+      if (len < size) {
+        break;
+      }
+    }
+
     uint8_t ch = reader_.peek();
     if (!isJSONNumeric(ch)) {
       break;
     }
+    if (len == size) {
+      throw TProtocolException(TProtocolException::INVALID_DATA,
+                               "Numeric value too long: \"" +
+                               std::string(buf, len) + "...\"");
+    }
     reader_.read();
-    str += ch;
-    ++result;
+    buf[len++] = ch;
   }
-  return result;
+  return len;
+}
+
+// Parses the decimal integer in str, of len characters, into num.  Returns
+// false if it is not an integer or is out of the range of NumberType.
+template <typename NumberType>
+static bool parseJSONInteger(const char *str, uint32_t len, NumberType &num) {
+  uint32_t pos = 0;
+  bool negative = false;
+  if (pos < len && (str[pos] == '-' || str[pos] == '+')) {
+    negative = (str[pos] == '-');
+    ++pos;
+  }
+  if (pos == len) {
+    return false;
+  }
+
+  uint64_t magnitude = 0;
+  for (; pos < len; ++pos) {
+    if (str[pos] < '0' || str[pos] > '9') {
+      return false;
+    }
+    uint64_t digit = str[pos] - '0';
+    if (magnitude > ((std::numeric_limits<uint64_t>::max)() - digit) / 10) {
+      return false;
+    }
+    magnitude = magnitude * 10 + digit;
+  }
+
+  uint64_t limit = static_cast<uint64_t>((std::numeric_limits<NumberType>::max)());
+  if (negative) {
+    // The most negative value of a signed type is one past max()
+    limit = std::numeric_limits<NumberType>::is_signed ? limit + 1 : 0;
+    // Two's complement negation, as the magnitude may not fit NumberType
+    num = static_cast<NumberType>(~magnitude + 1);
+  }
+  else {
+    num = static_cast<NumberType>(magnitude);
+  }
+  return magnitude <= limit;
 }
 
 // Reads a sequence of characters and assembles them into a number,
@@ -771,15 +898,13 @@ uint32_t TJSONProtocol::readJSONInteger(NumberType &num) {
   if (context_->escapeNum()) {
     result += readJSONSyntaxChar(kJSONStringDelimiter);
   }
-  std::string str;
-  result += readJSONNumericChars(str);
-  try {
-    num = boost::lexical_cast<NumberType>(str);
-  }
-  catch (boost::bad_lexical_cast e) {
-    throw new TProtocolException(TProtocolException::INVALID_DATA,
-                                 "Expected numeric value; got \"" + str +
-                                  "\"");
+  char buf[kMaxJSONNumericChars];
+  uint32_t len = readJSONNumericChars(buf, kMaxJSONNumericChars);
+  result += len;
+  if (!parseJSONInteger(buf, len, num)) {
+    throw TProtocolException(TProtocolException::INVALID_DATA,
+                             "Expected numeric value; got \"" +
+                             std::string(buf, len) + "\"");
   }
   if (context_->escapeNum()) {
     result += readJSONSyntaxChar(kJSONStringDelimiter);
@@ -790,8 +915,8 @@ uint32_t TJSONProtocol::readJSONInteger(NumberType &num) {
 // Reads a JSON number or string and interprets it as a double.
 uint32_t TJSONProtocol::readJSONDouble(double &num) {
   uint32_t result = context_->read(reader_);
-  std::string str;
   if (reader_.peek() == kJSONStringDelimiter) {
+    std::string str;
     result += readJSONString(str, true);
     // Check for NaN, Infinity and -Infinity
     if (str == kThriftNan) {
@@ -806,16 +931,14 @@ uint32_t TJSONProtocol::readJSONDouble(double &num) {
     else {
       if (!context_->escapeNum()) {
         // Throw exception -- we should not be in a string in this case
-        throw new TProtocolException(TProtocolException::INVALID_DATA,
-                                     "Numeric data unexpectedly quoted");
+        throw TProtocolException(TProtocolException::INVALID_DATA,
+                                 "Numeric data unexpectedly quoted");
       }
-      try {
-        num = boost::lexical_cast<double>(str);
-      }
-      catch (boost::bad_lexical_cast e) {
-        throw new TProtocolException(TProtocolException::INVALID_DATA,
-                                     "Expected numeric value; got \"" + str +
-                                     "\"");
+      if (str.length() > (std::numeric_limits<uint32_t>::max)() ||
+          !number_parse_double(str.data(), static_cast<uint32_t>(str.length()), num)) {
+        throw TProtocolException(TProtocolException::INVALID_DATA,
+                                 "Expected numeric value; got \"" + str +
+                                 "\"");
       }
     }
   }
@@ -824,14 +947,13 @@ uint32_t TJSONProtocol::readJSONDouble(double &num) {
       // This will throw - we should have had a quote if escapeNum == true
       readJSONSyntaxChar(kJSONStringDelimiter);
     }
-    result += readJSONNumericChars(str);
-    try {
-      num = boost::lexical_cast<double>(str);
-    }
-    catch (boost::bad_lexical_cast e) {
-      throw new TProtocolException(TProtocolException::INVALID_DATA,
-                                   "Expected numeric value; got \"" + str +
-                                   "\"");
+    char buf[kMaxJSONNumericChars];
+    uint32_t len = readJSONNumericChars(buf, kMaxJSONNumericChars);
+    result += len;
+    if (!number_parse_double(buf, len, num)) {
+      throw TProtocolException(TProtocolException::INVALID_DATA,
+                               "Expected numeric value; got \"" +
+                               std::string(buf, len) + "\"");
     }
   }
   return result;
@@ -986,14 +1108,8 @@ uint32_t TJSONProtocol::readBool(bool& value) {
   return readJSONInteger(value);
 }
 
-// readByte() must be handled properly becuase boost::lexical cast sees int8_t
-// as a text type instead of an integer type
 uint32_t TJSONProtocol::readByte(int8_t& byte) {
-  int16_t tmp = (int16_t) byte;
-  uint32_t result =  readJSONInteger(tmp);
-  assert(tmp < 256);
-  byte = (int8_t)tmp;
-  return result;
+  return readJSONInteger(byte);
 }
 
 uint32_t TJSONProtocol::readI16(int16_t& i16) {
@@ -129,7 +129,7 @@ class TJSONProtocol : public TVirtualProtocol<TJSONProtocol> {
 
   uint32_t readJSONBase64(std::string &str);
 
-  uint32_t readJSONNumericChars(std::string &str);
+  uint32_t readJSONNumericChars(char *buf, uint32_t size);
 
   template <typename NumberType>
   uint32_t readJSONInteger(NumberType &num);
@@ -282,6 +282,26 @@ class TJSONProtocol : public TVirtualProtocol<TJSONProtocol> {
       return data_;
     }
 
+    /**
+     * Returns the bytes that follow, still in the transport's read buffer,
+     * setting len to how many there are.  Returns NULL if a byte has been
+     * peeked or the transport has nothing buffered to lend.
+     */
+    const uint8_t* borrow(uint32_t &len) {
+      if (hasData_) {
+        return NULL;
+      }
+      len = 1;
+      return trans_->borrow(NULL, &len);
+    }
+
+    /// Consumes len bytes of what borrow() returned
+    void consume(uint32_t len) {
+      if (len > 0) {
+        trans_->consume(len);
+      }
+    }
+
    private:
     TTransport *trans_;
     bool hasData_;
@@ -41,6 +41,21 @@ namespace apache
                     return TProtocolDecorator::writeMessageBegin_virt(_name, _type, _seqid);
                 }
             }
+
+            uint32_t TMultiplexedProtocol::serializedSizeMessageBegin_virt(
+                const std::string& _name,
+                const TMessageType _type,
+                const int32_t _seqid)
+            {
+                if( _type == T_CALL || _type == T_ONEWAY )
+                {
+                    return TProtocolDecorator::serializedSizeMessageBegin_virt( serviceName + separator + _name, _type, _seqid );
+                }
+                else
+                {
+                    return TProtocolDecorator::serializedSizeMessageBegin_virt(_name, _type, _seqid);
+                }
+            }
         }
     }
 }
@@ -91,6 +91,15 @@ namespace apache
                     const std::string& _name, 
                     const TMessageType _type, 
                     const int32_t _seqid);
+
+                /**
+                 * Sizes the message header with the same prefixed name that
+                 * writeMessageBegin_virt() writes.
+                 */
+                uint32_t serializedSizeMessageBegin_virt(
+                    const std::string& _name,
+                    const TMessageType _type,
+                    const int32_t _seqid);
             private:
                 const std::string serviceName;
                 const std::string separator;
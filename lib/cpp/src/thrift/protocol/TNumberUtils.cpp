@@ -0,0 +1,531 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/protocol/TNumberUtils.h>
+
+#include <errno.h>
+#include <locale.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+namespace apache { namespace thrift { namespace protocol {
+
+// Powers of ten a double holds exactly
+static const double kExactPowersOfTen[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+static const int kMaxExactPowerOfTen = 22;
+
+// Integers up to 2^53 convert to double exactly
+static const uint64_t kMaxExactInteger = (static_cast<uint64_t>(1) << 53);
+
+static inline bool isDigit(char ch) {
+  return ch >= '0' && ch <= '9';
+}
+
+uint32_t number_format_integer(int64_t value, char *buf) {
+  // Negate as unsigned so that the most negative value works too
+  uint64_t magnitude = static_cast<uint64_t>(value);
+  uint32_t len = 0;
+  if (value < 0) {
+    magnitude = ~magnitude + 1;
+    buf[len++] = '-';
+  }
+
+  char digits[20];
+  uint32_t count = 0;
+  do {
+    digits[count++] = static_cast<char>('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude != 0);
+
+  while (count > 0) {
+    buf[len++] = digits[--count];
+  }
+  return len;
+}
+
+/*
+ * Shortest round-trip formatting of doubles with Florian Loitsch's Grisu2
+ * ("Printing Floating-Point Numbers Quickly and Accurately with Integers",
+ * PLDI 2010).  It finds the digits with 64 bit integer arithmetic alone,
+ * and they always read back as the same double; in rare cases there is a
+ * shorter string that would too.
+ */
+
+// A floating point number f * 2^e with a 64 bit significand
+struct DiyFp {
+  DiyFp() : f(0), e(0) {}
+  DiyFp(uint64_t fp, int exp) : f(fp), e(exp) {}
+
+  uint64_t f;
+  int e;
+};
+
+static const uint64_t kDoubleHiddenBit = (static_cast<uint64_t>(1) << 52);
+static const uint64_t kDoubleSignificandMask = kDoubleHiddenBit - 1;
+static const int kDoubleExponentBias = 0x3FF + 52;
+
+// Normalized powers 10^-348, 10^-340, ... 10^340, rounded
+static const struct {
+  uint64_t f;
+  int e;
+} kCachedPowers[] = {
+  { 0xfa8fd5a0081c0288ull, -1220 }, // 1e-348
+  { 0xbaaee17fa23ebf76ull, -1193 }, // 1e-340
+  { 0x8b16fb203055ac76ull, -1166 }, // 1e-332
+  { 0xcf42894a5dce35eaull, -1140 }, // 1e-324
+  { 0x9a6bb0aa55653b2dull, -1113 }, // 1e-316
+  { 0xe61acf033d1a45dfull, -1087 }, // 1e-308
+  { 0xab70fe17c79ac6caull, -1060 }, // 1e-300
+  { 0xff77b1fcbebcdc4full, -1034 }, // 1e-292
+  { 0xbe5691ef416bd60cull, -1007 }, // 1e-284
+  { 0x8dd01fad907ffc3cull,  -980 }, // 1e-276
+  { 0xd3515c2831559a83ull,  -954 }, // 1e-268
+  { 0x9d71ac8fada6c9b5ull,  -927 }, // 1e-260
+  { 0xea9c227723ee8bcbull,  -901 }, // 1e-252
+  { 0xaecc49914078536dull,  -874 }, // 1e-244
+  { 0x823c12795db6ce57ull,  -847 }, // 1e-236
+  { 0xc21094364dfb5637ull,  -821 }, // 1e-228
+  { 0x9096ea6f3848984full,  -794 }, // 1e-220
+  { 0xd77485cb25823ac7ull,  -768 }, // 1e-212
+  { 0xa086cfcd97bf97f4ull,  -741 }, // 1e-204
+  { 0xef340a98172aace5ull,  -715 }, // 1e-196
+  { 0xb23867fb2a35b28eull,  -688 }, // 1e-188
+  { 0x84c8d4dfd2c63f3bull,  -661 }, // 1e-180
+  { 0xc5dd44271ad3cdbaull,  -635 }, // 1e-172
+  { 0x936b9fcebb25c996ull,  -608 }, // 1e-164
+  { 0xdbac6c247d62a584ull,  -582 }, // 1e-156
+  { 0xa3ab66580d5fdaf6ull,  -555 }, // 1e-148
+  { 0xf3e2f893dec3f126ull,  -529 }, // 1e-140
+  { 0xb5b5ada8aaff80b8ull,  -502 }, // 1e-132
+  { 0x87625f056c7c4a8bull,  -475 }, // 1e-124
+  { 0xc9bcff6034c13053ull,  -449 }, // 1e-116
+  { 0x964e858c91ba2655ull,  -422 }, // 1e-108
+  { 0xdff9772470297ebdull,  -396 }, // 1e-100
+  { 0xa6dfbd9fb8e5b88full,  -369 }, // 1e-92
+  { 0xf8a95fcf88747d94ull,  -343 }, // 1e-84
+  { 0xb94470938fa89bcfull,  -316 }, // 1e-76
+  { 0x8a08f0f8bf0f156bull,  -289 }, // 1e-68
+  { 0xcdb02555653131b6ull,  -263 }, // 1e-60
+  { 0x993fe2c6d07b7facull,  -236 }, // 1e-52
+  { 0xe45c10c42a2b3b06ull,  -210 }, // 1e-44
+  { 0xaa242499697392d3ull,  -183 }, // 1e-36
+  { 0xfd87b5f28300ca0eull,  -157 }, // 1e-28
+  { 0xbce5086492111aebull,  -130 }, // 1e-20
+  { 0x8cbccc096f5088ccull,  -103 }, // 1e-12
+  { 0xd1b71758e219652cull,   -77 }, // 1e-4
+  { 0x9c40000000000000ull,   -50 }, // 1e4
+  { 0xe8d4a51000000000ull,   -24 }, // 1e12
+  { 0xad78ebc5ac620000ull,     3 }, // 1e20
+  { 0x813f3978f8940984ull,    30 }, // 1e28
+  { 0xc097ce7bc90715b3ull,    56 }, // 1e36
+  { 0x8f7e32ce7bea5c70ull,    83 }, // 1e44
+  { 0xd5d238a4abe98068ull,   109 }, // 1e52
+  { 0x9f4f2726179a2245ull,   136 }, // 1e60
+  { 0xed63a231d4c4fb27ull,   162 }, // 1e68
+  { 0xb0de65388cc8ada8ull,   189 }, // 1e76
+  { 0x83c7088e1aab65dbull,   216 }, // 1e84
+  { 0xc45d1df942711d9aull,   242 }, // 1e92
+  { 0x924d692ca61be758ull,   269 }, // 1e100
+  { 0xda01ee641a708deaull,   295 }, // 1e108
+  { 0xa26da3999aef774aull,   322 }, // 1e116
+  { 0xf209787bb47d6b85ull,   348 }, // 1e124
+  { 0xb454e4a179dd1877ull,   375 }, // 1e132
+  { 0x865b86925b9bc5c2ull,   402 }, // 1e140
+  { 0xc83553c5c8965d3dull,   428 }, // 1e148
+  { 0x952ab45cfa97a0b3ull,   455 }, // 1e156
+  { 0xde469fbd99a05fe3ull,   481 }, // 1e164
+  { 0xa59bc234db398c25ull,   508 }, // 1e172
+  { 0xf6c69a72a3989f5cull,   534 }, // 1e180
+  { 0xb7dcbf5354e9beceull,   561 }, // 1e188
+  { 0x88fcf317f22241e2ull,   588 }, // 1e196
+  { 0xcc20ce9bd35c78a5ull,   614 }, // 1e204
+  { 0x98165af37b2153dfull,   641 }, // 1e212
+  { 0xe2a0b5dc971f303aull,   667 }, // 1e220
+  { 0xa8d9d1535ce3b396ull,   694 }, // 1e228
+  { 0xfb9b7cd9a4a7443cull,   720 }, // 1e236
+  { 0xbb764c4ca7a44410ull,   747 }, // 1e244
+  { 0x8bab8eefb6409c1aull,   774 }, // 1e252
+  { 0xd01fef10a657842cull,   800 }, // 1e260
+  { 0x9b10a4e5e9913129ull,   827 }, // 1e268
+  { 0xe7109bfba19c0c9dull,   853 }, // 1e276
+  { 0xac2820d9623bf429ull,   880 }, // 1e284
+  { 0x80444b5e7aa7cf85ull,   907 }, // 1e292
+  { 0xbf21e44003acdd2dull,   933 }, // 1e300
+  { 0x8e679c2f5e44ff8full,   960 }, // 1e308
+  { 0xd433179d9c8cb841ull,   986 }, // 1e316
+  { 0x9e19db92b4e31ba9ull,  1013 }, // 1e324
+  { 0xeb96bf6ebadf77d9ull,  1039 }, // 1e332
+  { 0xaf87023b9bf0ee6bull,  1066 }, // 1e340
+};
+
+static const uint32_t kPowersOfTen32[] = {
+  1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+// The product rounded to 64 bits
+static DiyFp multiply(const DiyFp& x, const DiyFp& y) {
+  const uint64_t mask32 = 0xFFFFFFFFu;
+  uint64_t a = x.f >> 32, b = x.f & mask32;
+  uint64_t c = y.f >> 32, d = y.f & mask32;
+  uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+  uint64_t mid = (bd >> 32) + (ad & mask32) + (bc & mask32);
+  mid += static_cast<uint64_t>(1) << 31;
+  return DiyFp(ac + (ad >> 32) + (bc >> 32) + (mid >> 32), x.e + y.e + 64);
+}
+
+static DiyFp normalize(DiyFp x) {
+  while ((x.f & (static_cast<uint64_t>(1) << 63)) == 0) {
+    x.f <<= 1;
+    x.e--;
+  }
+  return x;
+}
+
+/**
+ * Sets minus and plus to the halfway points between value, a positive
+ * finite double, and its neighbours, with the same exponent as
+ * normalize(value).
+ */
+static DiyFp boundaries(double value, DiyFp& minus, DiyFp& plus) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  int biased = static_cast<int>((bits >> 52) & 0x7FF);
+  DiyFp v(bits & kDoubleSignificandMask, 1 - kDoubleExponentBias);
+  if (biased != 0) {
+    v.f += kDoubleHiddenBit;
+    v.e = biased - kDoubleExponentBias;
+  }
+
+  plus = normalize(DiyFp((v.f << 1) + 1, v.e - 1));
+  // The gap below a power of two is half the gap above it
+  if (v.f == kDoubleHiddenBit) {
+    minus = DiyFp((v.f << 2) - 1, v.e - 2);
+  } else {
+    minus = DiyFp((v.f << 1) - 1, v.e - 1);
+  }
+  minus.f <<= minus.e - plus.e;
+  minus.e = plus.e;
+  return normalize(v);
+}
+
+/**
+ * Returns the cached power c = 10^-k that brings a number with binary
+ * exponent e to an exponent in [-60, -32] once multiplied, setting k.
+ */
+static DiyFp cachedPower(int e, int& k) {
+  // log10(2), to estimate the decimal exponent
+  double dk = (-61 - e) * 0.30102999566398114 + 347;
+  int ik = static_cast<int>(dk);
+  if (dk - ik > 0.0) {
+    ++ik;
+  }
+  unsigned index = static_cast<unsigned>((ik >> 3) + 1);
+  k = -(-348 + static_cast<int>(index) * 8);
+  return DiyFp(kCachedPowers[index].f, kCachedPowers[index].e);
+}
+
+static int countDigits(uint32_t n) {
+  int count = 1;
+  while (count < 10 && n >= kPowersOfTen32[count]) {
+    ++count;
+  }
+  return count;
+}
+
+/**
+ * Moves the last digit towards the scaled value w, which is distance away
+ * from the upper bound, while the digits stay inside the bounds.
+ */
+static void roundWeed(char* digits, int len, uint64_t delta, uint64_t rest,
+                      uint64_t tenKappa, uint64_t distance) {
+  while (rest < distance && delta - rest >= tenKappa &&
+         (rest + tenKappa < distance ||
+          distance - rest > rest + tenKappa - distance)) {
+    digits[len - 1]--;
+    rest += tenKappa;
+  }
+}
+
+/**
+ * Writes the fewest digits of a number between the scaled bounds, within
+ * delta below plus, adding the decimal exponent of the last digit to k.
+ * Returns the number of digits.
+ */
+static int generateDigits(const DiyFp& w, const DiyFp& plus, uint64_t delta,
+                          char* digits, int& k) {
+  const DiyFp one(static_cast<uint64_t>(1) << -plus.e, plus.e);
+  const uint64_t distance = plus.f - w.f;
+  uint32_t integral = static_cast<uint32_t>(plus.f >> -one.e);
+  uint64_t fraction = plus.f & (one.f - 1);
+  int kappa = countDigits(integral);
+  int len = 0;
+
+  while (kappa > 0) {
+    uint32_t digit = integral / kPowersOfTen32[kappa - 1];
+    integral %= kPowersOfTen32[kappa - 1];
+    if (digit != 0 || len != 0) {
+      digits[len++] = static_cast<char>('0' + digit);
+    }
+    --kappa;
+    uint64_t rest = (static_cast<uint64_t>(integral) << -one.e) + fraction;
+    if (rest <= delta) {
+      k += kappa;
+      roundWeed(digits, len, delta, rest,
+                static_cast<uint64_t>(kPowersOfTen32[kappa]) << -one.e, distance);
+      return len;
+    }
+  }
+
+  while (true) {
+    fraction *= 10;
+    delta *= 10;
+    char digit = static_cast<char>(fraction >> -one.e);
+    if (digit != 0 || len != 0) {
+      digits[len++] = static_cast<char>('0' + digit);
+    }
+    fraction &= one.f - 1;
+    --kappa;
+    if (fraction < delta) {
+      k += kappa;
+      int index = -kappa;
+      roundWeed(digits, len, delta, fraction, one.f,
+                distance * (index < 10 ? kPowersOfTen32[index] : 0));
+      return len;
+    }
+  }
+}
+
+// Digits of a positive finite value, which is digits * 10^k
+static int shortestDigits(double value, char* digits, int& k) {
+  DiyFp minus, plus;
+  DiyFp v = boundaries(value, minus, plus);
+  DiyFp c = cachedPower(plus.e, k);
+  DiyFp w = multiply(v, c);
+  DiyFp wPlus = multiply(plus, c);
+  DiyFp wMinus = multiply(minus, c);
+  // Shrink the bounds by the multiplication error, so anything in between
+  // is certain to read back as value
+  wMinus.f++;
+  wPlus.f--;
+  return generateDigits(w, wPlus, wPlus.f - wMinus.f, digits, k);
+}
+
+uint32_t number_format_double(double value, char *buf) {
+  uint32_t pos = 0;
+  if (value < 0 || (value == 0 && 1 / value < 0)) {
+    buf[pos++] = '-';
+    value = -value;
+  }
+  if (value == 0) {
+    buf[pos++] = '0';
+    return pos;
+  }
+
+  // Integral values print as integers
+  if (value == floor(value) && value < static_cast<double>(kMaxExactInteger)) {
+    return pos + number_format_integer(static_cast<int64_t>(value), buf + pos);
+  }
+
+  char digits[18];
+  int k = 0;
+  int len = shortestDigits(value, digits, k);
+  // Where the decimal point goes, counted in digits from the first one
+  int point = len + k;
+
+  if (point >= len && point <= 17) {
+    // 123 followed by zeros
+    memcpy(buf + pos, digits, len);
+    pos += len;
+    for (int i = len; i < point; ++i) {
+      buf[pos++] = '0';
+    }
+  } else if (point > 0 && point <= 17) {
+    // 12.3
+    memcpy(buf + pos, digits, point);
+    pos += point;
+    buf[pos++] = '.';
+    memcpy(buf + pos, digits + point, len - point);
+    pos += len - point;
+  } else if (point > -4 && point <= 0) {
+    // 0.00123
+    buf[pos++] = '0';
+    buf[pos++] = '.';
+    for (int i = point; i < 0; ++i) {
+      buf[pos++] = '0';
+    }
+    memcpy(buf + pos, digits, len);
+    pos += len;
+  } else {
+    // 1.23e+45, with at least two exponent digits as printf writes them
+    buf[pos++] = digits[0];
+    if (len > 1) {
+      buf[pos++] = '.';
+      memcpy(buf + pos, digits + 1, len - 1);
+      pos += len - 1;
+    }
+    int exp = point - 1;
+    buf[pos++] = 'e';
+    buf[pos++] = (exp < 0) ? '-' : '+';
+    if (exp < 0) {
+      exp = -exp;
+    }
+    if (exp >= 100) {
+      buf[pos++] = static_cast<char>('0' + exp / 100);
+    }
+    buf[pos++] = static_cast<char>('0' + exp / 10 % 10);
+    buf[pos++] = static_cast<char>('0' + exp % 10);
+  }
+  return pos;
+}
+
+/**
+ * Falls back to strtod for the values the fast path cannot convert
+ * exactly.  str has already been checked to hold a number.
+ */
+static bool parseDoubleSlow(const char *str, uint32_t len, double &value) {
+  char tmp[64];
+  std::string big;
+  char *copy = tmp;
+  if (len >= sizeof(tmp)) {
+    big.resize(len + 1);
+    copy = &big[0];
+  }
+
+  // strtod expects the locale's decimal point, which is a single byte in
+  // every locale that matters
+  char point = '.';
+  struct lconv *conv = localeconv();
+  if (conv != NULL && conv->decimal_point != NULL && conv->decimal_point[0] != '\0') {
+    point = conv->decimal_point[0];
+  }
+  for (uint32_t i = 0; i < len; ++i) {
+    copy[i] = (str[i] == '.') ? point : str[i];
+  }
+  copy[len] = '\0';
+
+  char *end;
+  errno = 0;
+  double result = strtod(copy, &end);
+  if (end != copy + len) {
+    return false;
+  }
+  if (errno == ERANGE && (result == HUGE_VAL || result == -HUGE_VAL)) {
+    return false;
+  }
+  value = result;
+  return true;
+}
+
+bool number_parse_double(const char *str, uint32_t len, double &value) {
+  uint32_t pos = 0;
+  bool negative = false;
+  if (pos < len && (str[pos] == '-' || str[pos] == '+')) {
+    negative = (str[pos] == '-');
+    ++pos;
+  }
+
+  // Collect up to 19 significant digits, which fit in a uint64_t
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int significant = 0;
+  int exponent = 0;
+  bool exact = true;
+  for (; pos < len && isDigit(str[pos]); ++pos, ++digits) {
+    if (mantissa == 0 && str[pos] == '0') {
+      continue;
+    }
+    if (significant < 19) {
+      mantissa = mantissa * 10 + (str[pos] - '0');
+      ++significant;
+    } else {
+      ++exponent;
+      exact = false;
+    }
+  }
+  if (pos < len && str[pos] == '.') {
+    ++pos;
+    for (; pos < len && isDigit(str[pos]); ++pos, ++digits) {
+      if (mantissa == 0 && str[pos] == '0') {
+        --exponent;
+        continue;
+      }
+      if (significant < 19) {
+        mantissa = mantissa * 10 + (str[pos] - '0');
+        ++significant;
+        --exponent;
+      } else {
+        exact = false;
+      }
+    }
+  }
+  if (digits == 0) {
+    return false;
+  }
+
+  if (pos < len && (str[pos] == 'e' || str[pos] == 'E')) {
+    ++pos;
+    bool negativeExp = false;
+    if (pos < len && (str[pos] == '-' || str[pos] == '+')) {
+      negativeExp = (str[pos] == '-');
+      ++pos;
+    }
+    if (pos == len) {
+      return false;
+    }
+    int exp = 0;
+    for (; pos < len && isDigit(str[pos]); ++pos) {
+      // Far beyond the range of a double, but no overflow
+      if (exp < 100000) {
+        exp = exp * 10 + (str[pos] - '0');
+      }
+    }
+    exponent += negativeExp ? -exp : exp;
+  }
+  if (pos != len) {
+    return false;
+  }
+
+  if (mantissa == 0) {
+    value = negative ? -0.0 : 0.0;
+    return true;
+  }
+
+  // Both the mantissa and the power of ten are exact doubles, so a single
+  // multiplication or division rounds correctly
+  if (exact && mantissa <= kMaxExactInteger &&
+      exponent >= -kMaxExactPowerOfTen && exponent <= kMaxExactPowerOfTen) {
+    double result = static_cast<double>(mantissa);
+    if (exponent < 0) {
+      result /= kExactPowersOfTen[-exponent];
+    } else {
+      result *= kExactPowersOfTen[exponent];
+    }
+    value = negative ? -result : result;
+    return true;
+  }
+
+  return parseDoubleSlow(str, len, value);
+}
+
+}}} // apache::thrift::protocol
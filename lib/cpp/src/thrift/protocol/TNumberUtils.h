@@ -0,0 +1,47 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROTOCOL_TNUMBERUTILS_H_
+#define _THRIFT_PROTOCOL_TNUMBERUTILS_H_
+
+#include <stdint.h>
+
+namespace apache { namespace thrift { namespace protocol {
+
+// Text conversions for numbers in text protocols.  They always use '.' as
+// the decimal point, whatever the current C locale, and do not allocate.
+
+// buf must hold at least kMaxNumberChars bytes; no NUL is written
+static const uint32_t kMaxNumberChars = 32;
+
+// Writes value in decimal and returns the number of characters
+uint32_t number_format_integer(int64_t value, char *buf);
+
+// Writes the shortest decimal text that reads back as exactly value, in
+// the style of printf's %g, and returns the number of characters.
+// value must be finite.
+uint32_t number_format_double(double value, char *buf);
+
+// Parses len characters of JSON number syntax at str into value.
+// Returns false if the text is not a number or overflows a double.
+bool number_parse_double(const char *str, uint32_t len, double &value);
+
+}}} // apache::thrift::protocol
+
+#endif // #define _THRIFT_PROTOCOL_TNUMBERUTILS_H_
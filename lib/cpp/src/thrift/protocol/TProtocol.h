@@ -20,6 +20,7 @@
 #ifndef _THRIFT_PROTOCOL_TPROTOCOL_H_
 #define _THRIFT_PROTOCOL_TPROTOCOL_H_ 1
 
+#include <thrift/TStringView.h>
 #include <thrift/transport/TTransport.h>
 #include <thrift/protocol/TProtocolException.h>
 
@@ -177,6 +178,16 @@ enum TMessageType {
   T_ONEWAY     = 4
 };
 
+/**
+ * Encodings whose serialized values can be copied verbatim from one message
+ * into another, see TProtocol::readRaw().
+ */
+enum TRawFormat {
+  T_RAW_NONE    = 0,
+  T_RAW_BINARY  = 1,
+  T_RAW_COMPACT = 2
+};
+
 
 /**
  * Helper template for implementing TProtocol::skip().
@@ -358,6 +369,15 @@ class TProtocol {
 
   virtual uint32_t writeBinary_virt(const std::string& str) = 0;
 
+  virtual uint32_t writeI32Array_virt(const int32_t* values,
+                                      const uint32_t count) = 0;
+
+  virtual uint32_t writeI64Array_virt(const int64_t* values,
+                                      const uint32_t count) = 0;
+
+  virtual uint32_t writeDoubleArray_virt(const double* values,
+                                         const uint32_t count) = 0;
+
   uint32_t writeMessageBegin(const std::string& name,
                              const TMessageType messageType,
                              const int32_t seqid) {
@@ -470,6 +490,26 @@ class TProtocol {
     return writeBinary_virt(str);
   }
 
+  /**
+   * Writes the elements of a list of numbers, between writeListBegin() and
+   * writeListEnd().  The result is the same as writing each element on its
+   * own, but protocols with a fixed or simple encoding do it in bulk.
+   */
+  uint32_t writeI32Array(const int32_t* values, const uint32_t count) {
+    T_VIRTUAL_CALL();
+    return writeI32Array_virt(values, count);
+  }
+
+  uint32_t writeI64Array(const int64_t* values, const uint32_t count) {
+    T_VIRTUAL_CALL();
+    return writeI64Array_virt(values, count);
+  }
+
+  uint32_t writeDoubleArray(const double* values, const uint32_t count) {
+    T_VIRTUAL_CALL();
+    return writeDoubleArray_virt(values, count);
+  }
+
   /**
    * Reading functions
    */
@@ -524,6 +564,16 @@ class TProtocol {
 
   virtual uint32_t readBinary_virt(std::string& str) = 0;
 
+  virtual uint32_t readStringView_virt(TStringView& str) = 0;
+
+  virtual uint32_t readBinaryView_virt(TStringView& str) = 0;
+
+  virtual uint32_t readI32Array_virt(int32_t* values, uint32_t count) = 0;
+
+  virtual uint32_t readI64Array_virt(int64_t* values, uint32_t count) = 0;
+
+  virtual uint32_t readDoubleArray_virt(double* values, uint32_t count) = 0;
+
   uint32_t readMessageBegin(std::string& name,
                             TMessageType& messageType,
                             int32_t& seqid) {
@@ -628,6 +678,46 @@ class TProtocol {
     return readBinary_virt(str);
   }
 
+  /**
+   * Reads a string without copying it out of the transport's buffer.
+   * Only protocols whose strings are stored verbatim support this, and only
+   * over a transport that holds the whole string in its buffer, such as
+   * TMemoryBuffer or TFramedTransport; see TStringView for how long the
+   * result stays valid.
+   *
+   * @throws TProtocolException NOT_IMPLEMENTED if the string cannot be
+   *         viewed in place
+   */
+  uint32_t readStringView(TStringView& str) {
+    T_VIRTUAL_CALL();
+    return readStringView_virt(str);
+  }
+
+  /// As readStringView(), for binary fields
+  uint32_t readBinaryView(TStringView& str) {
+    T_VIRTUAL_CALL();
+    return readBinaryView_virt(str);
+  }
+
+  /**
+   * Reads count list elements into values, which must have room for them.
+   * The counterpart of writeI32Array() and friends.
+   */
+  uint32_t readI32Array(int32_t* values, uint32_t count) {
+    T_VIRTUAL_CALL();
+    return readI32Array_virt(values, count);
+  }
+
+  uint32_t readI64Array(int64_t* values, uint32_t count) {
+    T_VIRTUAL_CALL();
+    return readI64Array_virt(values, count);
+  }
+
+  uint32_t readDoubleArray(double* values, uint32_t count) {
+    T_VIRTUAL_CALL();
+    return readDoubleArray_virt(values, count);
+  }
+
   /*
    * std::vector is specialized for bool, and its elements are individual bits
    * rather than bools.   We need to define a different version of readBool()
@@ -649,6 +739,202 @@ class TProtocol {
     return ::apache::thrift::protocol::skip(*this, type);
   }
 
+  /**
+   * Size calculation functions.
+   *
+   * Each returns how many bytes the matching write call would produce,
+   * without writing anything, so that an output buffer can be sized before
+   * serializing into it.  There are no counterparts for the ends of
+   * messages, fields and containers: protocols that support sizing put
+   * nothing on the wire for them.  Structs still need serializedSizeStructEnd()
+   * for protocols that track state per struct.
+   *
+   * Only call these when hasSerializedSize() is true; otherwise they throw
+   * TProtocolException NOT_IMPLEMENTED.
+   */
+  virtual bool hasSerializedSize() const {
+    return false;
+  }
+
+  virtual uint32_t serializedSizeMessageBegin_virt(const std::string& name,
+                                                   const TMessageType messageType,
+                                                   const int32_t seqid) = 0;
+
+  virtual uint32_t serializedSizeStructBegin_virt(const char* name) = 0;
+
+  virtual uint32_t serializedSizeStructEnd_virt() = 0;
+
+  virtual uint32_t serializedSizeFieldBegin_virt(const char* name,
+                                                 const TType fieldType,
+                                                 const int16_t fieldId) = 0;
+
+  virtual uint32_t serializedSizeFieldStop_virt() = 0;
+
+  virtual uint32_t serializedSizeMapBegin_virt(const TType keyType,
+                                               const TType valType,
+                                               const uint32_t size) = 0;
+
+  virtual uint32_t serializedSizeListBegin_virt(const TType elemType,
+                                                const uint32_t size) = 0;
+
+  virtual uint32_t serializedSizeSetBegin_virt(const TType elemType,
+                                               const uint32_t size) = 0;
+
+  virtual uint32_t serializedSizeBool_virt(const bool value) = 0;
+
+  virtual uint32_t serializedSizeByte_virt(const int8_t byte) = 0;
+
+  virtual uint32_t serializedSizeI16_virt(const int16_t i16) = 0;
+
+  virtual uint32_t serializedSizeI32_virt(const int32_t i32) = 0;
+
+  virtual uint32_t serializedSizeI64_virt(const int64_t i64) = 0;
+
+  virtual uint32_t serializedSizeDouble_virt(const double dub) = 0;
+
+  virtual uint32_t serializedSizeString_virt(const std::string& str) = 0;
+
+  virtual uint32_t serializedSizeBinary_virt(const std::string& str) = 0;
+
+  virtual uint32_t serializedSizeI32Array_virt(const int32_t* values,
+                                               const uint32_t count) = 0;
+
+  virtual uint32_t serializedSizeI64Array_virt(const int64_t* values,
+                                               const uint32_t count) = 0;
+
+  virtual uint32_t serializedSizeDoubleArray_virt(const double* values,
+                                                  const uint32_t count) = 0;
+
+  uint32_t serializedSizeMessageBegin(const std::string& name,
+                                      const TMessageType messageType,
+                                      const int32_t seqid) {
+    T_VIRTUAL_CALL();
+    return serializedSizeMessageBegin_virt(name, messageType, seqid);
+  }
+
+  uint32_t serializedSizeStructBegin(const char* name) {
+    T_VIRTUAL_CALL();
+    return serializedSizeStructBegin_virt(name);
+  }
+
+  uint32_t serializedSizeStructEnd() {
+    T_VIRTUAL_CALL();
+    return serializedSizeStructEnd_virt();
+  }
+
+  uint32_t serializedSizeFieldBegin(const char* name,
+                                    const TType fieldType,
+                                    const int16_t fieldId) {
+    T_VIRTUAL_CALL();
+    return serializedSizeFieldBegin_virt(name, fieldType, fieldId);
+  }
+
+  uint32_t serializedSizeFieldStop() {
+    T_VIRTUAL_CALL();
+    return serializedSizeFieldStop_virt();
+  }
+
+  uint32_t serializedSizeMapBegin(const TType keyType,
+                                  const TType valType,
+                                  const uint32_t size) {
+    T_VIRTUAL_CALL();
+    return serializedSizeMapBegin_virt(keyType, valType, size);
+  }
+
+  uint32_t serializedSizeListBegin(const TType elemType, const uint32_t size) {
+    T_VIRTUAL_CALL();
+    return serializedSizeListBegin_virt(elemType, size);
+  }
+
+  uint32_t serializedSizeSetBegin(const TType elemType, const uint32_t size) {
+    T_VIRTUAL_CALL();
+    return serializedSizeSetBegin_virt(elemType, size);
+  }
+
+  uint32_t serializedSizeBool(const bool value) {
+    T_VIRTUAL_CALL();
+    return serializedSizeBool_virt(value);
+  }
+
+  uint32_t serializedSizeByte(const int8_t byte) {
+    T_VIRTUAL_CALL();
+    return serializedSizeByte_virt(byte);
+  }
+
+  uint32_t serializedSizeI16(const int16_t i16) {
+    T_VIRTUAL_CALL();
+    return serializedSizeI16_virt(i16);
+  }
+
+  uint32_t serializedSizeI32(const int32_t i32) {
+    T_VIRTUAL_CALL();
+    return serializedSizeI32_virt(i32);
+  }
+
+  uint32_t serializedSizeI64(const int64_t i64) {
+    T_VIRTUAL_CALL();
+    return serializedSizeI64_virt(i64);
+  }
+
+  uint32_t serializedSizeDouble(const double dub) {
+    T_VIRTUAL_CALL();
+    return serializedSizeDouble_virt(dub);
+  }
+
+  uint32_t serializedSizeString(const std::string& str) {
+    T_VIRTUAL_CALL();
+    return serializedSizeString_virt(str);
+  }
+
+  uint32_t serializedSizeBinary(const std::string& str) {
+    T_VIRTUAL_CALL();
+    return serializedSizeBinary_virt(str);
+  }
+
+  uint32_t serializedSizeI32Array(const int32_t* values, const uint32_t count) {
+    T_VIRTUAL_CALL();
+    return serializedSizeI32Array_virt(values, count);
+  }
+
+  uint32_t serializedSizeI64Array(const int64_t* values, const uint32_t count) {
+    T_VIRTUAL_CALL();
+    return serializedSizeI64Array_virt(values, count);
+  }
+
+  uint32_t serializedSizeDoubleArray(const double* values,
+                                     const uint32_t count) {
+    T_VIRTUAL_CALL();
+    return serializedSizeDoubleArray_virt(values, count);
+  }
+
+  /**
+   * Raw value functions.
+   *
+   * readRaw() reads one value of the given type and appends its encoding,
+   * byte for byte, to raw.  writeRaw() puts such bytes back on the wire
+   * unchanged, in place of the value.  Raw bytes are only meaningful to a
+   * protocol with the same getRawFormat(), so compare formats first.
+   * Protocols that cannot lift a value out of its message return
+   * T_RAW_NONE, and their raw functions throw NOT_IMPLEMENTED.
+   */
+  virtual TRawFormat getRawFormat() const {
+    return T_RAW_NONE;
+  }
+
+  virtual uint32_t readRaw_virt(TType type, std::string& raw) = 0;
+
+  virtual uint32_t writeRaw_virt(const std::string& raw) = 0;
+
+  uint32_t readRaw(TType type, std::string& raw) {
+    T_VIRTUAL_CALL();
+    return readRaw_virt(type, raw);
+  }
+
+  uint32_t writeRaw(const std::string& raw) {
+    T_VIRTUAL_CALL();
+    return writeRaw_virt(raw);
+  }
+
   inline boost::shared_ptr<TTransport> getTransport() {
     return ptrans_;
   }
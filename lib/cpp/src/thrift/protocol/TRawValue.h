@@ -0,0 +1,122 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROTOCOL_TRAWVALUE_H_
+#define _THRIFT_PROTOCOL_TRAWVALUE_H_ 1
+
+#include <string>
+#include <boost/shared_ptr.hpp>
+
+#include <thrift/protocol/TProtocol.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+
+namespace apache { namespace thrift { namespace protocol {
+
+/**
+ * The still-encoded bytes of one value, as captured by TProtocol::readRaw().
+ *
+ * Generated structs keep one of these beside each field annotated with
+ * cpp.lazy.  The field is decoded from it on first access, and if it is
+ * never accessed the bytes are written back out unchanged whenever the
+ * output protocol uses the same encoding.
+ *
+ * Decoding on first access writes to the struct even through its const
+ * get_ accessor, and nothing locks it.  A struct with lazy fields must not
+ * be read from several threads at once, const or not, unless every lazy
+ * field has already been decoded.
+ */
+class TRawValue {
+ public:
+  TRawValue() : format_(T_RAW_NONE) {}
+
+  /// Replaces the contents with the next value of the given type
+  uint32_t read(TProtocol* iprot, TType type) {
+    bytes_.clear();
+    format_ = T_RAW_NONE;
+    uint32_t xfer = iprot->readRaw(type, bytes_);
+    format_ = iprot->getRawFormat();
+    return xfer;
+  }
+
+  void clear() {
+    std::string().swap(bytes_);
+    format_ = T_RAW_NONE;
+  }
+
+  /// True while the value has not been decoded
+  bool isRaw() const {
+    return format_ != T_RAW_NONE;
+  }
+
+  /// True if oprot->writeRaw() would reproduce the value
+  bool matches(TProtocol* oprot) const {
+    return format_ != T_RAW_NONE && format_ == oprot->getRawFormat();
+  }
+
+  TRawFormat getFormat() const {
+    return format_;
+  }
+
+  const std::string& bytes() const {
+    return bytes_;
+  }
+
+  uint32_t size() const {
+    return static_cast<uint32_t>(bytes_.size());
+  }
+
+  /**
+   * Returns a protocol that reads the value back from the bytes, which
+   * must stay unchanged while it is in use.
+   */
+  boost::shared_ptr<TProtocol> decoder() const {
+    using transport::TMemoryBuffer;
+    boost::shared_ptr<TMemoryBuffer> buf(
+      new TMemoryBuffer(reinterpret_cast<uint8_t*>(const_cast<char*>(bytes_.data())),
+                        static_cast<uint32_t>(bytes_.size())));
+    switch (format_) {
+    case T_RAW_BINARY:
+      return boost::shared_ptr<TProtocol>(new TBinaryProtocolT<TMemoryBuffer>(buf));
+    case T_RAW_COMPACT:
+      return boost::shared_ptr<TProtocol>(new TCompactProtocolT<TMemoryBuffer>(buf));
+    default:
+      throw TProtocolException(TProtocolException::INVALID_DATA,
+                               "TRawValue holds no raw value.");
+    }
+  }
+
+  void swap(TRawValue& other) {
+    bytes_.swap(other.bytes_);
+    std::swap(format_, other.format_);
+  }
+
+ private:
+  std::string bytes_;
+  TRawFormat format_;
+};
+
+inline void swap(TRawValue& a, TRawValue& b) {
+  a.swap(b);
+}
+
+}}} // apache::thrift::protocol
+
+#endif // #ifndef _THRIFT_PROTOCOL_TRAWVALUE_H_
@@ -0,0 +1,57 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/protocol/TTableCodec.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+
+#include <typeinfo>
+
+namespace apache { namespace thrift { namespace protocol {
+
+// The exact type is compared rather than using dynamic_cast, so that a
+// subclass overriding some of the _virt methods still has them called
+
+uint32_t table_read(TProtocol* prot, const TStructTable& table, void* obj) {
+  const std::type_info& type = typeid(*prot);
+  if (type == typeid(TBinaryProtocol)) {
+    return TTableCodec<TBinaryProtocol>::read(
+      static_cast<TBinaryProtocol*>(prot), table, obj);
+  }
+  if (type == typeid(TCompactProtocol)) {
+    return TTableCodec<TCompactProtocol>::read(
+      static_cast<TCompactProtocol*>(prot), table, obj);
+  }
+  return TTableCodec<TProtocol>::read(prot, table, obj);
+}
+
+uint32_t table_write(TProtocol* prot, const TStructTable& table, const void* obj) {
+  const std::type_info& type = typeid(*prot);
+  if (type == typeid(TBinaryProtocol)) {
+    return TTableCodec<TBinaryProtocol>::write(
+      static_cast<TBinaryProtocol*>(prot), table, obj);
+  }
+  if (type == typeid(TCompactProtocol)) {
+    return TTableCodec<TCompactProtocol>::write(
+      static_cast<TCompactProtocol*>(prot), table, obj);
+  }
+  return TTableCodec<TProtocol>::write(prot, table, obj);
+}
+
+}}} // apache::thrift::protocol
@@ -0,0 +1,369 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROTOCOL_TTABLECODEC_H_
+#define _THRIFT_PROTOCOL_TTABLECODEC_H_ 1
+
+#include <thrift/protocol/TProtocol.h>
+
+#include <string>
+#include <vector>
+
+/**
+ * Table-driven serialization, used by structs generated with the cpp:tables
+ * option.  Instead of a read() and write() body of its own, each struct gets
+ * a static TStructTable describing its fields, and one shared codec walks
+ * the table.  That trades a little speed for much less generated code.
+ */
+
+/**
+ * Offset of a member in a generated struct.  offsetof() is only defined for
+ * standard-layout (in C++98, POD) types, and generated structs, with their
+ * constructors and virtual destructors, never are.  So the offset is
+ * measured on a real, default-constructed instance instead.
+ */
+#define THRIFT_FIELD_OFFSET(Type_, member_)                                   \
+  static_cast<uint32_t>(                                                      \
+    reinterpret_cast<const char*>(                                            \
+      &::apache::thrift::protocol::tableLayoutInstance<Type_>().member_) -    \
+    reinterpret_cast<const char*>(                                            \
+      &::apache::thrift::protocol::tableLayoutInstance<Type_>()))
+
+namespace apache { namespace thrift { namespace protocol {
+
+/**
+ * The instance THRIFT_FIELD_OFFSET measures a struct on.  It is built the
+ * first time a table of the struct is initialized.
+ */
+template <class Type_>
+const Type_& tableLayoutInstance() {
+  static const Type_ instance;
+  return instance;
+}
+
+struct TStructTable;
+struct TContainerTable;
+
+/**
+ * How a value is held in memory and serialized.  Base types are held as
+ * the matching C++ type, with enums as int32_t and strings and binaries as
+ * std::string.
+ */
+struct TValueTable {
+  TType type;
+
+  /// For T_STRING, whether the value is binary
+  bool binary;
+
+  /// For T_STRUCT, the table of the struct
+  const TStructTable* structTable;
+
+  /// For T_LIST, T_SET and T_MAP, the table of the container
+  const TContainerTable* containerTable;
+};
+
+/// Flags of a TFieldTable
+enum TFieldFlags {
+  /// The field must be present when reading
+  T_FIELD_REQUIRED = 1,
+  /// The field is only written if its __isset flag is
+  T_FIELD_WRITE_IF_SET = 2
+};
+
+struct TFieldTable {
+  int16_t id;
+  const char* name;
+  TValueTable value;
+
+  /// TFieldFlags
+  uint8_t flags;
+
+  /// Offset of the member in the struct
+  uint32_t offset;
+
+  /// Offset of the member's bool __isset flag, or -1 for required fields
+  int32_t issetOffset;
+};
+
+struct TStructTable {
+  const char* name;
+
+  /// The fields, in order of id
+  const TFieldTable* fields;
+  uint32_t numFields;
+};
+
+/// Called by TContainerOps::read() for each element, with value NULL for
+/// lists and sets
+typedef void (*TElementReader)(void* key, void* value, void* ctx);
+
+/// Called by TContainerOps::write() for each element, with value NULL for
+/// lists and sets
+typedef void (*TElementWriter)(const void* key, const void* value, void* ctx);
+
+/**
+ * The operations the codec needs on a container, instantiated for each
+ * container type by TListOps, TSetOps and TMapOps.
+ */
+struct TContainerOps {
+  uint32_t (*size)(const void* container);
+
+  /// Replaces the contents with size elements, each filled in by reader
+  void (*read)(void* container, uint32_t size, TElementReader reader, void* ctx);
+
+  /// Passes every element to writer, in order
+  void (*write)(const void* container, TElementWriter writer, void* ctx);
+
+  /// Resizes a vector and returns its elements, or NULL if it is empty
+  void* (*array)(void* container, uint32_t size);
+
+  /// The elements of a vector, or NULL if it is empty
+  const void* (*data)(const void* container);
+};
+
+struct TContainerTable {
+  /// List and set elements, or map keys
+  TValueTable elem;
+
+  /// Map values, with type T_STOP for lists and sets
+  TValueTable value;
+
+  const TContainerOps* ops;
+
+  /**
+   * True for vectors of int32_t, int64_t or double, which are read and
+   * written with the protocol's array calls.
+   */
+  bool bulk;
+};
+
+template <class List_>
+struct TListOps {
+  static uint32_t size(const void* container) {
+    return static_cast<uint32_t>(static_cast<const List_*>(container)->size());
+  }
+
+  static void read(void* container, uint32_t size, TElementReader reader, void* ctx) {
+    List_& list = *static_cast<List_*>(container);
+    list.clear();
+    list.resize(size);
+    for (uint32_t i = 0; i < size; ++i) {
+      reader(&list[i], NULL, ctx);
+    }
+  }
+
+  static void write(const void* container, TElementWriter writer, void* ctx) {
+    const List_& list = *static_cast<const List_*>(container);
+    for (typename List_::const_iterator it = list.begin(); it != list.end(); ++it) {
+      writer(&*it, NULL, ctx);
+    }
+  }
+
+  static void* array(void* container, uint32_t size) {
+    List_& list = *static_cast<List_*>(container);
+    list.clear();
+    list.resize(size);
+    return size > 0 ? &list[0] : NULL;
+  }
+
+  static const void* data(const void* container) {
+    const List_& list = *static_cast<const List_*>(container);
+    return list.empty() ? NULL : &list[0];
+  }
+
+  static const TContainerOps ops;
+};
+
+template <class List_>
+const TContainerOps TListOps<List_>::ops = {
+  &TListOps<List_>::size,
+  &TListOps<List_>::read,
+  &TListOps<List_>::write,
+  &TListOps<List_>::array,
+  &TListOps<List_>::data
+};
+
+// std::vector<bool> elements have no address, so they go through a bool
+template <class Alloc_>
+struct TListOps<std::vector<bool, Alloc_> > {
+  typedef std::vector<bool, Alloc_> List_;
+
+  static uint32_t size(const void* container) {
+    return static_cast<uint32_t>(static_cast<const List_*>(container)->size());
+  }
+
+  static void read(void* container, uint32_t size, TElementReader reader, void* ctx) {
+    List_& list = *static_cast<List_*>(container);
+    list.clear();
+    list.reserve(size);
+    for (uint32_t i = 0; i < size; ++i) {
+      bool elem = false;
+      reader(&elem, NULL, ctx);
+      list.push_back(elem);
+    }
+  }
+
+  static void write(const void* container, TElementWriter writer, void* ctx) {
+    const List_& list = *static_cast<const List_*>(container);
+    for (typename List_::const_iterator it = list.begin(); it != list.end(); ++it) {
+      bool elem = *it;
+      writer(&elem, NULL, ctx);
+    }
+  }
+
+  static const TContainerOps ops;
+};
+
+template <class Alloc_>
+const TContainerOps TListOps<std::vector<bool, Alloc_> >::ops = {
+  &TListOps<std::vector<bool, Alloc_> >::size,
+  &TListOps<std::vector<bool, Alloc_> >::read,
+  &TListOps<std::vector<bool, Alloc_> >::write,
+  NULL,
+  NULL
+};
+
+template <class Set_>
+struct TSetOps {
+  static uint32_t size(const void* container) {
+    return static_cast<uint32_t>(static_cast<const Set_*>(container)->size());
+  }
+
+  static void read(void* container, uint32_t size, TElementReader reader, void* ctx) {
+    Set_& set = *static_cast<Set_*>(container);
+    set.clear();
+    for (uint32_t i = 0; i < size; ++i) {
+      typename Set_::value_type elem;
+      reader(&elem, NULL, ctx);
+      set.insert(elem);
+    }
+  }
+
+  static void write(const void* container, TElementWriter writer, void* ctx) {
+    const Set_& set = *static_cast<const Set_*>(container);
+    for (typename Set_::const_iterator it = set.begin(); it != set.end(); ++it) {
+      writer(&*it, NULL, ctx);
+    }
+  }
+
+  static const TContainerOps ops;
+};
+
+template <class Set_>
+const TContainerOps TSetOps<Set_>::ops = {
+  &TSetOps<Set_>::size,
+  &TSetOps<Set_>::read,
+  &TSetOps<Set_>::write,
+  NULL,
+  NULL
+};
+
+template <class Map_>
+struct TMapOps {
+  static uint32_t size(const void* container) {
+    return static_cast<uint32_t>(static_cast<const Map_*>(container)->size());
+  }
+
+  static void read(void* container, uint32_t size, TElementReader reader, void* ctx) {
+    Map_& map = *static_cast<Map_*>(container);
+    map.clear();
+    for (uint32_t i = 0; i < size; ++i) {
+      // The value is read straight into the map, as generated code does
+      typename Map_::key_type key;
+      reader(&key, NULL, ctx);
+      reader(NULL, &map[key], ctx);
+    }
+  }
+
+  static void write(const void* container, TElementWriter writer, void* ctx) {
+    const Map_& map = *static_cast<const Map_*>(container);
+    for (typename Map_::const_iterator it = map.begin(); it != map.end(); ++it) {
+      writer(&it->first, &it->second, ctx);
+    }
+  }
+
+  static const TContainerOps ops;
+};
+
+template <class Map_>
+const TContainerOps TMapOps<Map_>::ops = {
+  &TMapOps<Map_>::size,
+  &TMapOps<Map_>::read,
+  &TMapOps<Map_>::write,
+  NULL,
+  NULL
+};
+
+/**
+ * Reads and writes structs described by a TStructTable through Protocol_,
+ * with static calls into it when it is a concrete protocol.
+ */
+template <class Protocol_>
+class TTableCodec {
+ public:
+  static uint32_t read(Protocol_* prot, const TStructTable& table, void* obj);
+
+  static uint32_t write(Protocol_* prot, const TStructTable& table, const void* obj);
+
+ private:
+  struct ElementContext {
+    Protocol_* prot;
+    const TContainerTable* table;
+    uint32_t xfer;
+  };
+
+  static uint32_t readValue(Protocol_* prot, const TValueTable& value, void* ptr);
+
+  static uint32_t writeValue(Protocol_* prot, const TValueTable& value, const void* ptr);
+
+  static uint32_t readContainer(Protocol_* prot, const TContainerTable& table,
+                                TType type, void* ptr);
+
+  static uint32_t writeContainer(Protocol_* prot, const TContainerTable& table,
+                                 TType type, const void* ptr);
+
+  static void readElement(void* key, void* value, void* ctx);
+
+  static void writeElement(const void* key, const void* value, void* ctx);
+};
+
+/**
+ * Reads a struct through its table.  Through a TProtocol that is really a
+ * TBinaryProtocol or TCompactProtocol, the codec for that protocol is used,
+ * avoiding a virtual call per value.
+ */
+uint32_t table_read(TProtocol* prot, const TStructTable& table, void* obj);
+
+uint32_t table_write(TProtocol* prot, const TStructTable& table, const void* obj);
+
+template <class Protocol_>
+uint32_t table_read(Protocol_* prot, const TStructTable& table, void* obj) {
+  return TTableCodec<Protocol_>::read(prot, table, obj);
+}
+
+template <class Protocol_>
+uint32_t table_write(Protocol_* prot, const TStructTable& table, const void* obj) {
+  return TTableCodec<Protocol_>::write(prot, table, obj);
+}
+
+}}} // apache::thrift::protocol
+
+#include <thrift/protocol/TTableCodec.tcc>
+
+#endif // #ifndef _THRIFT_PROTOCOL_TTABLECODEC_H_
@@ -0,0 +1,310 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROTOCOL_TTABLECODEC_TCC_
+#define _THRIFT_PROTOCOL_TTABLECODEC_TCC_ 1
+
+#include <thrift/protocol/TTableCodec.h>
+
+namespace apache { namespace thrift { namespace protocol {
+
+template <class Protocol_>
+uint32_t TTableCodec<Protocol_>::read(Protocol_* prot,
+                                     const TStructTable& table,
+                                     void* obj) {
+  char* base = static_cast<char*>(obj);
+  uint32_t xfer = 0;
+  std::string fname;
+  TType ftype;
+  int16_t fid;
+
+  // Required fields have no __isset flag, so they are tracked here by index
+  uint64_t seen = 0;
+  std::vector<bool> seenMore;
+  if (table.numFields > 64) {
+    seenMore.resize(table.numFields - 64);
+  }
+
+  xfer += prot->readStructBegin(fname);
+
+  uint32_t next = 0;
+  while (true) {
+    xfer += prot->readFieldBegin(fname, ftype, fid);
+    if (ftype == T_STOP) {
+      break;
+    }
+
+    // Fields usually arrive in order of id, so try the one after the last
+    // before searching
+    uint32_t index = next;
+    if (index >= table.numFields || table.fields[index].id != fid) {
+      uint32_t low = 0;
+      uint32_t high = table.numFields;
+      while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (table.fields[mid].id < fid) {
+          low = mid + 1;
+        } else {
+          high = mid;
+        }
+      }
+      index = low;
+    }
+
+    if (index < table.numFields && table.fields[index].id == fid &&
+        table.fields[index].value.type == ftype) {
+      const TFieldTable& field = table.fields[index];
+      xfer += readValue(prot, field.value, base + field.offset);
+      if (field.issetOffset >= 0) {
+        *reinterpret_cast<bool*>(base + field.issetOffset) = true;
+      } else if (index < 64) {
+        seen |= static_cast<uint64_t>(1) << index;
+      } else {
+        seenMore[index - 64] = true;
+      }
+      next = index + 1;
+    } else {
+      xfer += prot->skip(ftype);
+    }
+    xfer += prot->readFieldEnd();
+  }
+
+  xfer += prot->readStructEnd();
+
+  for (uint32_t i = 0; i < table.numFields; ++i) {
+    if ((table.fields[i].flags & T_FIELD_REQUIRED) != 0 &&
+        !(i < 64 ? ((seen >> i) & 1) != 0 : seenMore[i - 64])) {
+      throw TProtocolException(TProtocolException::INVALID_DATA);
+    }
+  }
+  return xfer;
+}
+
+template <class Protocol_>
+uint32_t TTableCodec<Protocol_>::write(Protocol_* prot,
+                                      const TStructTable& table,
+                                      const void* obj) {
+  const char* base = static_cast<const char*>(obj);
+  uint32_t xfer = 0;
+
+  prot->incrementRecursionDepth();
+  xfer += prot->writeStructBegin(table.name);
+
+  for (uint32_t i = 0; i < table.numFields; ++i) {
+    const TFieldTable& field = table.fields[i];
+    if ((field.flags & T_FIELD_WRITE_IF_SET) != 0 &&
+        !*reinterpret_cast<const bool*>(base + field.issetOffset)) {
+      continue;
+    }
+    xfer += prot->writeFieldBegin(field.name, field.value.type, field.id);
+    xfer += writeValue(prot, field.value, base + field.offset);
+    xfer += prot->writeFieldEnd();
+  }
+
+  xfer += prot->writeFieldStop();
+  xfer += prot->writeStructEnd();
+  prot->decrementRecursionDepth();
+  return xfer;
+}
+
+template <class Protocol_>
+uint32_t TTableCodec<Protocol_>::readValue(Protocol_* prot,
+                                          const TValueTable& value,
+                                          void* ptr) {
+  switch (value.type) {
+  case T_BOOL:
+    return prot->readBool(*static_cast<bool*>(ptr));
+  case T_BYTE:
+    return prot->readByte(*static_cast<int8_t*>(ptr));
+  case T_I16:
+    return prot->readI16(*static_cast<int16_t*>(ptr));
+  case T_I32:
+    return prot->readI32(*static_cast<int32_t*>(ptr));
+  case T_I64:
+    return prot->readI64(*static_cast<int64_t*>(ptr));
+  case T_DOUBLE:
+    return prot->readDouble(*static_cast<double*>(ptr));
+  case T_STRING:
+    if (value.binary) {
+      return prot->readBinary(*static_cast<std::string*>(ptr));
+    }
+    return prot->readString(*static_cast<std::string*>(ptr));
+  case T_STRUCT:
+    return read(prot, *value.structTable, ptr);
+  case T_MAP:
+  case T_SET:
+  case T_LIST:
+    return readContainer(prot, *value.containerTable, value.type, ptr);
+  default:
+    throw TProtocolException(TProtocolException::INVALID_DATA,
+                             "TTableCodec: bad type in table");
+  }
+}
+
+template <class Protocol_>
+uint32_t TTableCodec<Protocol_>::writeValue(Protocol_* prot,
+                                           const TValueTable& value,
+                                           const void* ptr) {
+  switch (value.type) {
+  case T_BOOL:
+    return prot->writeBool(*static_cast<const bool*>(ptr));
+  case T_BYTE:
+    return prot->writeByte(*static_cast<const int8_t*>(ptr));
+  case T_I16:
+    return prot->writeI16(*static_cast<const int16_t*>(ptr));
+  case T_I32:
+    return prot->writeI32(*static_cast<const int32_t*>(ptr));
+  case T_I64:
+    return prot->writeI64(*static_cast<const int64_t*>(ptr));
+  case T_DOUBLE:
+    return prot->writeDouble(*static_cast<const double*>(ptr));
+  case T_STRING:
+    if (value.binary) {
+      return prot->writeBinary(*static_cast<const std::string*>(ptr));
+    }
+    return prot->writeString(*static_cast<const std::string*>(ptr));
+  case T_STRUCT:
+    return write(prot, *value.structTable, ptr);
+  case T_MAP:
+  case T_SET:
+  case T_LIST:
+    return writeContainer(prot, *value.containerTable, value.type, ptr);
+  default:
+    throw TProtocolException(TProtocolException::INVALID_DATA,
+                             "TTableCodec: bad type in table");
+  }
+}
+
+template <class Protocol_>
+uint32_t TTableCodec<Protocol_>::readContainer(Protocol_* prot,
+                                              const TContainerTable& table,
+                                              TType type,
+                                              void* ptr) {
+  uint32_t xfer = 0;
+  uint32_t size;
+  TType etype;
+  TType vtype;
+  if (type == T_MAP) {
+    xfer += prot->readMapBegin(etype, vtype, size);
+  } else if (type == T_SET) {
+    xfer += prot->readSetBegin(etype, size);
+  } else {
+    xfer += prot->readListBegin(etype, size);
+  }
+
+  if (table.bulk) {
+    // Lists of numbers are read in one call, straight into the vector
+    void* data = table.ops->array(ptr, size);
+    if (size > 0) {
+      switch (table.elem.type) {
+      case T_I32:
+        xfer += prot->readI32Array(static_cast<int32_t*>(data), size);
+        break;
+      case T_I64:
+        xfer += prot->readI64Array(static_cast<int64_t*>(data), size);
+        break;
+      default:
+        xfer += prot->readDoubleArray(static_cast<double*>(data), size);
+        break;
+      }
+    }
+  } else {
+    ElementContext ctx = { prot, &table, 0 };
+    table.ops->read(ptr, size, &readElement, &ctx);
+    xfer += ctx.xfer;
+  }
+
+  if (type == T_MAP) {
+    xfer += prot->readMapEnd();
+  } else if (type == T_SET) {
+    xfer += prot->readSetEnd();
+  } else {
+    xfer += prot->readListEnd();
+  }
+  return xfer;
+}
+
+template <class Protocol_>
+uint32_t TTableCodec<Protocol_>::writeContainer(Protocol_* prot,
+                                               const TContainerTable& table,
+                                               TType type,
+                                               const void* ptr) {
+  uint32_t xfer = 0;
+  uint32_t size = table.ops->size(ptr);
+  if (type == T_MAP) {
+    xfer += prot->writeMapBegin(table.elem.type, table.value.type, size);
+  } else if (type == T_SET) {
+    xfer += prot->writeSetBegin(table.elem.type, size);
+  } else {
+    xfer += prot->writeListBegin(table.elem.type, size);
+  }
+
+  if (table.bulk) {
+    const void* data = table.ops->data(ptr);
+    if (size > 0) {
+      switch (table.elem.type) {
+      case T_I32:
+        xfer += prot->writeI32Array(static_cast<const int32_t*>(data), size);
+        break;
+      case T_I64:
+        xfer += prot->writeI64Array(static_cast<const int64_t*>(data), size);
+        break;
+      default:
+        xfer += prot->writeDoubleArray(static_cast<const double*>(data), size);
+        break;
+      }
+    }
+  } else {
+    ElementContext ctx = { prot, &table, 0 };
+    table.ops->write(ptr, &writeElement, &ctx);
+    xfer += ctx.xfer;
+  }
+
+  if (type == T_MAP) {
+    xfer += prot->writeMapEnd();
+  } else if (type == T_SET) {
+    xfer += prot->writeSetEnd();
+  } else {
+    xfer += prot->writeListEnd();
+  }
+  return xfer;
+}
+
+template <class Protocol_>
+void TTableCodec<Protocol_>::readElement(void* key, void* value, void* ctx) {
+  ElementContext* context = static_cast<ElementContext*>(ctx);
+  if (key != NULL) {
+    context->xfer += readValue(context->prot, context->table->elem, key);
+  } else {
+    context->xfer += readValue(context->prot, context->table->value, value);
+  }
+}
+
+template <class Protocol_>
+void TTableCodec<Protocol_>::writeElement(const void* key, const void* value, void* ctx) {
+  ElementContext* context = static_cast<ElementContext*>(ctx);
+  context->xfer += writeValue(context->prot, context->table->elem, key);
+  if (value != NULL) {
+    context->xfer += writeValue(context->prot, context->table->value, value);
+  }
+}
+
+}}} // apache::thrift::protocol
+
+#endif // #ifndef _THRIFT_PROTOCOL_TTABLECODEC_TCC_
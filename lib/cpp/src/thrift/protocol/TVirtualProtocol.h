@@ -171,6 +171,46 @@ class TProtocolDefaults : public TProtocol {
                              "this protocol does not support reading (yet).");
   }
 
+  uint32_t readStringView(TStringView& str) {
+    (void) str;
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support string views.");
+  }
+
+  uint32_t readBinaryView(TStringView& str) {
+    (void) str;
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support string views.");
+  }
+
+  /*
+   * The array methods fall back to one virtual call per element, which is
+   * right for any protocol that does not override them.
+   */
+  uint32_t readI32Array(int32_t* values, uint32_t count) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      xfer += TProtocol::readI32(values[i]);
+    }
+    return xfer;
+  }
+
+  uint32_t readI64Array(int64_t* values, uint32_t count) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      xfer += TProtocol::readI64(values[i]);
+    }
+    return xfer;
+  }
+
+  uint32_t readDoubleArray(double* values, uint32_t count) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      xfer += TProtocol::readDouble(values[i]);
+    }
+    return xfer;
+  }
+
   uint32_t writeMessageBegin(const std::string& name,
                              const TMessageType messageType,
                              const int32_t seqid) {
@@ -305,6 +345,154 @@ class TProtocolDefaults : public TProtocol {
                              "this protocol does not support writing (yet).");
   }
 
+  uint32_t writeI32Array(const int32_t* values, const uint32_t count) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      xfer += TProtocol::writeI32(values[i]);
+    }
+    return xfer;
+  }
+
+  uint32_t writeI64Array(const int64_t* values, const uint32_t count) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      xfer += TProtocol::writeI64(values[i]);
+    }
+    return xfer;
+  }
+
+  uint32_t writeDoubleArray(const double* values, const uint32_t count) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      xfer += TProtocol::writeDouble(values[i]);
+    }
+    return xfer;
+  }
+
+  uint32_t serializedSizeMessageBegin(const std::string& name,
+                                      const TMessageType messageType,
+                                      const int32_t seqid) {
+    (void) name;
+    (void) messageType;
+    (void) seqid;
+    return noSerializedSize();
+  }
+
+  uint32_t serializedSizeStructBegin(const char* name) {
+    (void) name;
+    return noSerializedSize();
+  }
+
+  uint32_t serializedSizeStructEnd() {
+    return noSerializedSize();
+  }
+
+  uint32_t serializedSizeFieldBegin(const char* name,
+                                    const TType fieldType,
+                                    const int16_t fieldId) {
+    (void) name;
+    (void) fieldType;
+    (void) fieldId;
+    return noSerializedSize();
+  }
+
+  uint32_t serializedSizeFieldStop() {
+    return noSerializedSize();
+  }
+
+  uint32_t serializedSizeMapBegin(const TType keyType,
+                                  const TType valType,
+                                  const uint32_t size) {
+    (void) keyType;
+    (void) valType;
+    (void) size;
+    return noSerializedSize();
+  }
+
+  uint32_t serializedSizeListBegin(const TType elemType, const uint32_t size) {
+    (void) elemType;
+    (void) size;
+    return noSerializedSize();
+  }
+
+  uint32_t serializedSizeSetBegin(const TType elemType, const uint32_t size) {
+    (void) elemType;
+    (void) size;
+    return noSerializedSize();
+  }
+
+  uint32_t serializedSizeBool(const bool value) {
+    (void) value;
+    return noSerializedSize();
+  }
+
+  uint32_t serializedSizeByte(const int8_t byte) {
+    (void) byte;
+    return noSerializedSize();
+  }
+
+  uint32_t serializedSizeI16(const int16_t i16) {
+    (void) i16;
+    return noSerializedSize();
+  }
+
+  uint32_t serializedSizeI32(const int32_t i32) {
+    (void) i32;
+    return noSerializedSize();
+  }
+
+  uint32_t serializedSizeI64(const int64_t i64) {
+    (void) i64;
+    return noSerializedSize();
+  }
+
+  uint32_t serializedSizeDouble(const double dub) {
+    (void) dub;
+    return noSerializedSize();
+  }
+
+  uint32_t serializedSizeString(const std::string& str) {
+    (void) str;
+    return noSerializedSize();
+  }
+
+  uint32_t serializedSizeBinary(const std::string& str) {
+    (void) str;
+    return noSerializedSize();
+  }
+
+  uint32_t serializedSizeI32Array(const int32_t* values, const uint32_t count) {
+    (void) values;
+    (void) count;
+    return noSerializedSize();
+  }
+
+  uint32_t serializedSizeI64Array(const int64_t* values, const uint32_t count) {
+    (void) values;
+    (void) count;
+    return noSerializedSize();
+  }
+
+  uint32_t serializedSizeDoubleArray(const double* values,
+                                     const uint32_t count) {
+    (void) values;
+    (void) count;
+    return noSerializedSize();
+  }
+
+  uint32_t readRaw(TType type, std::string& raw) {
+    (void) type;
+    (void) raw;
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support raw values.");
+  }
+
+  uint32_t writeRaw(const std::string& raw) {
+    (void) raw;
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support raw values.");
+  }
+
   uint32_t skip(TType type) {
     return ::apache::thrift::protocol::skip(*this, type);
   }
@@ -313,6 +501,11 @@ class TProtocolDefaults : public TProtocol {
   TProtocolDefaults(boost::shared_ptr<TTransport> ptrans)
     : TProtocol(ptrans)
   {}
+
+  uint32_t noSerializedSize() {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support size calculation.");
+  }
 };
 
 /**
@@ -421,6 +614,21 @@ class TVirtualProtocol : public Super_ {
     return static_cast<Protocol_*>(this)->writeBinary(str);
   }
 
+  virtual uint32_t writeI32Array_virt(const int32_t* values,
+                                      const uint32_t count) {
+    return static_cast<Protocol_*>(this)->writeI32Array(values, count);
+  }
+
+  virtual uint32_t writeI64Array_virt(const int64_t* values,
+                                      const uint32_t count) {
+    return static_cast<Protocol_*>(this)->writeI64Array(values, count);
+  }
+
+  virtual uint32_t writeDoubleArray_virt(const double* values,
+                                         const uint32_t count) {
+    return static_cast<Protocol_*>(this)->writeDoubleArray(values, count);
+  }
+
   /**
    * Reading functions
    */
@@ -519,6 +727,121 @@ class TVirtualProtocol : public Super_ {
     return static_cast<Protocol_*>(this)->readBinary(str);
   }
 
+  virtual uint32_t readStringView_virt(TStringView& str) {
+    return static_cast<Protocol_*>(this)->readStringView(str);
+  }
+
+  virtual uint32_t readBinaryView_virt(TStringView& str) {
+    return static_cast<Protocol_*>(this)->readBinaryView(str);
+  }
+
+  virtual uint32_t readI32Array_virt(int32_t* values, uint32_t count) {
+    return static_cast<Protocol_*>(this)->readI32Array(values, count);
+  }
+
+  virtual uint32_t readI64Array_virt(int64_t* values, uint32_t count) {
+    return static_cast<Protocol_*>(this)->readI64Array(values, count);
+  }
+
+  virtual uint32_t readDoubleArray_virt(double* values, uint32_t count) {
+    return static_cast<Protocol_*>(this)->readDoubleArray(values, count);
+  }
+
+  virtual uint32_t serializedSizeMessageBegin_virt(const std::string& name,
+                                                   const TMessageType messageType,
+                                                   const int32_t seqid) {
+    return static_cast<Protocol_*>(this)->serializedSizeMessageBegin(name, messageType, seqid);
+  }
+
+  virtual uint32_t serializedSizeStructBegin_virt(const char* name) {
+    return static_cast<Protocol_*>(this)->serializedSizeStructBegin(name);
+  }
+
+  virtual uint32_t serializedSizeStructEnd_virt() {
+    return static_cast<Protocol_*>(this)->serializedSizeStructEnd();
+  }
+
+  virtual uint32_t serializedSizeFieldBegin_virt(const char* name,
+                                                 const TType fieldType,
+                                                 const int16_t fieldId) {
+    return static_cast<Protocol_*>(this)->serializedSizeFieldBegin(name, fieldType, fieldId);
+  }
+
+  virtual uint32_t serializedSizeFieldStop_virt() {
+    return static_cast<Protocol_*>(this)->serializedSizeFieldStop();
+  }
+
+  virtual uint32_t serializedSizeMapBegin_virt(const TType keyType,
+                                               const TType valType,
+                                               const uint32_t size) {
+    return static_cast<Protocol_*>(this)->serializedSizeMapBegin(keyType, valType, size);
+  }
+
+  virtual uint32_t serializedSizeListBegin_virt(const TType elemType,
+                                                const uint32_t size) {
+    return static_cast<Protocol_*>(this)->serializedSizeListBegin(elemType, size);
+  }
+
+  virtual uint32_t serializedSizeSetBegin_virt(const TType elemType,
+                                               const uint32_t size) {
+    return static_cast<Protocol_*>(this)->serializedSizeSetBegin(elemType, size);
+  }
+
+  virtual uint32_t serializedSizeBool_virt(const bool value) {
+    return static_cast<Protocol_*>(this)->serializedSizeBool(value);
+  }
+
+  virtual uint32_t serializedSizeByte_virt(const int8_t byte) {
+    return static_cast<Protocol_*>(this)->serializedSizeByte(byte);
+  }
+
+  virtual uint32_t serializedSizeI16_virt(const int16_t i16) {
+    return static_cast<Protocol_*>(this)->serializedSizeI16(i16);
+  }
+
+  virtual uint32_t serializedSizeI32_virt(const int32_t i32) {
+    return static_cast<Protocol_*>(this)->serializedSizeI32(i32);
+  }
+
+  virtual uint32_t serializedSizeI64_virt(const int64_t i64) {
+    return static_cast<Protocol_*>(this)->serializedSizeI64(i64);
+  }
+
+  virtual uint32_t serializedSizeDouble_virt(const double dub) {
+    return static_cast<Protocol_*>(this)->serializedSizeDouble(dub);
+  }
+
+  virtual uint32_t serializedSizeString_virt(const std::string& str) {
+    return static_cast<Protocol_*>(this)->serializedSizeString(str);
+  }
+
+  virtual uint32_t serializedSizeBinary_virt(const std::string& str) {
+    return static_cast<Protocol_*>(this)->serializedSizeBinary(str);
+  }
+
+  virtual uint32_t serializedSizeI32Array_virt(const int32_t* values,
+                                               const uint32_t count) {
+    return static_cast<Protocol_*>(this)->serializedSizeI32Array(values, count);
+  }
+
+  virtual uint32_t serializedSizeI64Array_virt(const int64_t* values,
+                                               const uint32_t count) {
+    return static_cast<Protocol_*>(this)->serializedSizeI64Array(values, count);
+  }
+
+  virtual uint32_t serializedSizeDoubleArray_virt(const double* values,
+                                                  const uint32_t count) {
+    return static_cast<Protocol_*>(this)->serializedSizeDoubleArray(values, count);
+  }
+
+  virtual uint32_t readRaw_virt(TType type, std::string& raw) {
+    return static_cast<Protocol_*>(this)->readRaw(type, raw);
+  }
+
+  virtual uint32_t writeRaw_virt(const std::string& raw) {
+    return static_cast<Protocol_*>(this)->writeRaw(raw);
+  }
+
   virtual uint32_t skip_virt(TType type) {
     return static_cast<Protocol_*>(this)->skip(type);
   }
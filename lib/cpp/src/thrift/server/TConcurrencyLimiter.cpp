@@ -0,0 +1,109 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/server/TConcurrencyLimiter.h>
+#include <thrift/concurrency/Util.h>
+
+namespace apache { namespace thrift { namespace server {
+
+using apache::thrift::concurrency::Guard;
+using apache::thrift::concurrency::Util;
+
+const size_t TConcurrencyLimiter::INITIAL_LIMIT;
+
+TConcurrencyLimiter::TConcurrencyLimiter(int64_t targetQueueDelayUsec,
+                                         size_t minLimit,
+                                         size_t maxLimit) :
+  targetQueueDelayUsec_(targetQueueDelayUsec),
+  minLimit_(minLimit > 0 ? minLimit : 1),
+  maxLimit_(maxLimit > minLimit_ ? maxLimit : minLimit_),
+  backoffRatio_(0.9),
+  limit_((double)INITIAL_LIMIT),
+  inFlight_(0),
+  rejected_(0),
+  lastDecrease_(0) {
+  if (limit_ < minLimit_) {
+    limit_ = (double)minLimit_;
+  } else if (limit_ > maxLimit_) {
+    limit_ = (double)maxLimit_;
+  }
+}
+
+bool TConcurrencyLimiter::acquire() {
+  Guard g(mutex_);
+  if (inFlight_ >= (size_t)limit_) {
+    ++rejected_;
+    return false;
+  }
+  ++inFlight_;
+  return true;
+}
+
+void TConcurrencyLimiter::release(int64_t queueDelayUsec) {
+  Guard g(mutex_);
+  size_t inFlight = inFlight_;
+  if (inFlight_ > 0) {
+    --inFlight_;
+  }
+  if (queueDelayUsec < 0) {
+    return;
+  }
+
+  if (queueDelayUsec > targetQueueDelayUsec_) {
+    int64_t now = Util::currentTimeUsec();
+    if (now - lastDecrease_ >= queueDelayUsec) {
+      lastDecrease_ = now;
+      limit_ *= backoffRatio_;
+      if (limit_ < minLimit_) {
+        limit_ = (double)minLimit_;
+      }
+    }
+  } else if (2 * inFlight >= (size_t)limit_) {
+    // Only grow a limit that is actually being used, or an idle server
+    // would end up with no limit at all
+    limit_ += 1.0 / limit_;
+    if (limit_ > maxLimit_) {
+      limit_ = (double)maxLimit_;
+    }
+  }
+}
+
+size_t TConcurrencyLimiter::getLimit() const {
+  Guard g(mutex_);
+  return (size_t)limit_;
+}
+
+size_t TConcurrencyLimiter::getInFlight() const {
+  Guard g(mutex_);
+  return inFlight_;
+}
+
+uint64_t TConcurrencyLimiter::getRejectedCount() const {
+  Guard g(mutex_);
+  return rejected_;
+}
+
+void TConcurrencyLimiter::setBackoffRatio(double ratio) {
+  if (ratio > 0.0 && ratio < 1.0) {
+    Guard g(mutex_);
+    backoffRatio_ = ratio;
+  }
+}
+
+}}} // apache::thrift::server
@@ -0,0 +1,122 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_SERVER_TCONCURRENCYLIMITER_H_
+#define _THRIFT_SERVER_TCONCURRENCYLIMITER_H_ 1
+
+#include <thrift/concurrency/Mutex.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace apache { namespace thrift { namespace server {
+
+/**
+ * Adaptive limit on the number of requests a server has in flight.
+ *
+ * The limit follows the time requests spend queued before a worker picks
+ * them up, using additive increase / multiplicative decrease.  While the
+ * queueing delay stays under the target and the limit is being used, it
+ * grows by one for every limit requests that complete.  When a request
+ * waited longer than the target, the limit shrinks by the backoff ratio,
+ * at most once per such delay so that one backlog is only paid for once.
+ *
+ * A server calls acquire() before queueing a request and turns the request
+ * away cheaply if it fails, then calls release() with the measured queueing
+ * delay once the request is done.
+ */
+class TConcurrencyLimiter {
+ public:
+  /// Limit before the first adjustment
+  static const size_t INITIAL_LIMIT = 20;
+
+  /**
+   * @param targetQueueDelayUsec Queueing delay above which the limit shrinks
+   * @param minLimit Lower bound of the limit
+   * @param maxLimit Upper bound of the limit
+   */
+  TConcurrencyLimiter(int64_t targetQueueDelayUsec = 5000,
+                      size_t minLimit = 1,
+                      size_t maxLimit = 1024);
+
+  /**
+   * Admits a request if fewer than the current limit are in flight.
+   *
+   * @return true if admitted; release() must then follow
+   */
+  bool acquire();
+
+  /**
+   * Ends an admitted request.
+   *
+   * @param queueDelayUsec Time the request spent queued, or a negative
+   *                       value if it was not measured
+   */
+  void release(int64_t queueDelayUsec);
+
+  /// Current limit
+  size_t getLimit() const;
+
+  /// Number of admitted requests not yet released
+  size_t getInFlight() const;
+
+  /// Number of requests turned away since the limiter was created
+  uint64_t getRejectedCount() const;
+
+  /**
+   * Sets the factor the limit is multiplied by when queueing delay exceeds
+   * the target.
+   *
+   * @param ratio value in (0, 1); the default is 0.9
+   */
+  void setBackoffRatio(double ratio);
+
+  double getBackoffRatio() const {
+    return backoffRatio_;
+  }
+
+  int64_t getTargetQueueDelay() const {
+    return targetQueueDelayUsec_;
+  }
+
+  size_t getMinLimit() const {
+    return minLimit_;
+  }
+
+  size_t getMaxLimit() const {
+    return maxLimit_;
+  }
+
+ private:
+  const int64_t targetQueueDelayUsec_;
+  const size_t minLimit_;
+  const size_t maxLimit_;
+  double backoffRatio_;
+
+  concurrency::Mutex mutex_;
+  double limit_;
+  size_t inFlight_;
+  uint64_t rejected_;
+  /// Time of the last decrease, in microseconds
+  int64_t lastDecrease_;
+};
+
+}}} // apache::thrift::server
+
+#endif // #ifndef _THRIFT_SERVER_TCONCURRENCYLIMITER_H_
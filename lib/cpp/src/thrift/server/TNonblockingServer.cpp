@@ -22,11 +22,17 @@
 #include <thrift/thrift-config.h>
 
 #include <thrift/server/TNonblockingServer.h>
+#include <thrift/TApplicationException.h>
+#include <thrift/concurrency/Atomic.h>
 #include <thrift/concurrency/Exception.h>
 #include <thrift/transport/TSocket.h>
 #include <thrift/concurrency/PlatformThreadFactory.h>
+#include <thrift/concurrency/Util.h>
+#include <thrift/protocol/TDeadlineProtocol.h>
 #include <thrift/transport/PlatformSocket.h>
 
+#include <boost/scoped_ptr.hpp>
+#include <deque>
 #include <iostream>
 
 #ifdef HAVE_SYS_SOCKET_H
@@ -56,6 +62,27 @@
 #include <sched.h>
 #endif
 
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
+
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
+
+#ifdef HAVE_LINUX_ERRQUEUE_H
+#include <linux/errqueue.h>
+#endif
+
+#if defined(HAVE_SYS_UIO_H) && defined(HAVE_LINUX_ERRQUEUE_H) \
+    && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#define THRIFT_NB_ZEROCOPY 1
+#endif
+
 #ifndef AF_LOCAL
 #define AF_LOCAL AF_UNIX
 #endif
@@ -75,6 +102,169 @@ using apache::thrift::transport::TSocket;
 using apache::thrift::transport::TTransportException;
 using boost::shared_ptr;
 
+/**
+ * Reads the MSG_ZEROCOPY completions queued on a socket, advancing done
+ * towards sent, without blocking.
+ */
+static void readZeroCopyCompletions(THRIFT_SOCKET socket, uint32_t sent, uint32_t& done) {
+#ifdef THRIFT_NB_ZEROCOPY
+  while (done != sent) {
+    char control[256];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(socket, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+      break;
+    }
+    for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)) {
+      if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+          && !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+        continue;
+      }
+      struct sock_extended_err* err =
+        reinterpret_cast<struct sock_extended_err*>(CMSG_DATA(cm));
+      if (err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+        continue;
+      }
+      // [ee_info, ee_data] is a range of sends that completed, in order
+      if (static_cast<int32_t>(err->ee_data + 1 - done) > 0) {
+        done = err->ee_data + 1;
+      }
+    }
+  }
+#else
+  (void)socket;
+  done = sent;
+#endif
+}
+
+class TNonblockingIOThread::ZeroCopyDrain {
+ public:
+  /**
+   * @param socket   a duplicate of the closed connection's socket, which
+   *                 keeps its error queue readable; owned by the drain
+   * @param sent     MSG_ZEROCOPY sends issued on the socket
+   * @param done     and completed so far
+   */
+  ZeroCopyDrain(THRIFT_SOCKET socket, uint32_t sent, uint32_t done)
+    : socket_(socket), sent_(sent), done_(done) {}
+
+  ~ZeroCopyDrain() {
+    if (socket_ != THRIFT_INVALID_SOCKET) {
+      ::THRIFT_CLOSESOCKET(socket_);
+    }
+  }
+
+  void hold(const shared_ptr<TMemoryBuffer>& buffer) {
+    buffers_.push_back(buffer);
+  }
+
+  /// Whether all the sends have completed, and the buffers are free to go
+  bool complete() {
+    readZeroCopyCompletions(socket_, sent_, done_);
+    return done_ == sent_;
+  }
+
+ private:
+  THRIFT_SOCKET socket_;
+  uint32_t sent_;
+  uint32_t done_;
+  std::vector<shared_ptr<TMemoryBuffer> > buffers_;
+};
+
+TNonblockingBufferPool::TNonblockingBufferPool()
+  : hits_(0), misses_(0), bytesCached_(0) {
+  freeLists_.resize(classIndex(MAX_CLASS_SIZE) + 1);
+}
+
+TNonblockingBufferPool::~TNonblockingBufferPool() {
+  for (uint32_t c = classIndex(MAX_SLAB_CLASS_SIZE) + 1; c < freeLists_.size(); ++c) {
+    for (size_t i = 0; i < freeLists_[c].size(); ++i) {
+      std::free(freeLists_[c][i]);
+    }
+  }
+  for (size_t i = 0; i < slabs_.size(); ++i) {
+    std::free(slabs_[i]);
+  }
+}
+
+uint32_t TNonblockingBufferPool::classIndex(uint32_t size) {
+  uint32_t index = 0;
+  uint32_t classSize = MIN_CLASS_SIZE;
+  while (classSize < size) {
+    classSize <<= 1;
+    ++index;
+  }
+  return index;
+}
+
+uint8_t* TNonblockingBufferPool::allocate(uint32_t want, uint32_t& size) {
+  if (want > MAX_CLASS_SIZE) {
+    uint8_t* buffer = static_cast<uint8_t*>(std::malloc(want));
+    if (buffer == NULL) {
+      throw std::bad_alloc();
+    }
+    ++misses_;
+    size = want;
+    return buffer;
+  }
+
+  uint32_t index = classIndex(want);
+  uint32_t classSize = MIN_CLASS_SIZE << index;
+  std::vector<uint8_t*>& freeList = freeLists_[index];
+  size = classSize;
+
+  if (!freeList.empty()) {
+    uint8_t* buffer = freeList.back();
+    freeList.pop_back();
+    bytesCached_ -= classSize;
+    ++hits_;
+    return buffer;
+  }
+
+  ++misses_;
+  if (classSize <= MAX_SLAB_CLASS_SIZE) {
+    // carve a new slab; we hand out its first buffer and keep the others
+    uint8_t* slab = static_cast<uint8_t*>(std::malloc(SLAB_SIZE));
+    if (slab == NULL) {
+      throw std::bad_alloc();
+    }
+    slabs_.push_back(slab);
+    for (uint32_t offset = SLAB_SIZE - classSize; offset > 0; offset -= classSize) {
+      freeList.push_back(slab + offset);
+      bytesCached_ += classSize;
+    }
+    return slab;
+  }
+
+  uint8_t* buffer = static_cast<uint8_t*>(std::malloc(classSize));
+  if (buffer == NULL) {
+    throw std::bad_alloc();
+  }
+  return buffer;
+}
+
+void TNonblockingBufferPool::release(uint8_t* buffer, uint32_t size) {
+  if (buffer == NULL) {
+    return;
+  }
+  if (size > MAX_CLASS_SIZE) {
+    std::free(buffer);
+    return;
+  }
+
+  uint32_t index = classIndex(size);
+  std::vector<uint8_t*>& freeList = freeLists_[index];
+  if (size > MAX_SLAB_CLASS_SIZE
+      && (freeList.size() + 1) * size > MAX_CACHED_BYTES_PER_CLASS) {
+    std::free(buffer);
+    return;
+  }
+  freeList.push_back(buffer);
+  bytesCached_ += size;
+}
+
 /// Three states for sockets: recv frame size, recv data, and send mode
 enum TSocketState {
   SOCKET_RECV_FRAMING,
@@ -105,9 +295,29 @@ enum TAppState {
  */
 class TNonblockingServer::TConnection {
  private:
-  /// Server IO Thread handling this connection
+  /**
+   * TMemoryBuffer whose storage can be traded with another one, so that a
+   * response the kernel may still be reading after a MSG_ZEROCOPY send can
+   * be set aside while the connection carries on with fresh storage.
+   */
+  class OutputBuffer : public TMemoryBuffer {
+   public:
+    explicit OutputBuffer(uint32_t size) : TMemoryBuffer(size) {}
+
+    void swapStorage(OutputBuffer& that) {
+      swap(that);
+    }
+  };
+
+  /// Server IO Thread handling this connection (NULL once closed)
   TNonblockingIOThread* ioThread_;
 
+  /// IO thread whose pools this object belongs to, for its whole life
+  TNonblockingIOThread* homeThread_;
+
+  /// Position in homeThread_'s list of active connections
+  size_t activeIndex_;
+
   /// Server handle
   TNonblockingServer* server_;
 
@@ -120,9 +330,24 @@ class TNonblockingServer::TConnection {
   /// Libevent object
   struct event event_;
 
-  /// Libevent flags
+  /// Libevent flags (with T_IO_BACKEND_EPOLL: the interest we want armed)
   short eventFlags_;
 
+  /// Whether the socket has been added to the IO thread's epoll set
+  bool epollRegistered_;
+
+  /// Whether our one-shot epoll registration is currently armed
+  bool epollArmed_;
+
+  /// Set while epollReady() is driving the socket
+  bool epollDispatching_;
+
+  /// Set by workSocket() when the socket had nothing more to give or take
+  bool wouldBlock_;
+
+  /// Next connection while we sit in an IO thread's completion queue
+  TConnection* notifyNext_;
+
   /// Socket mode
   TSocketState socketState_;
 
@@ -141,15 +366,29 @@ class TNonblockingServer::TConnection {
   /// Read buffer size
   uint32_t readBufferSize_;
 
-  /// Write buffer
+  /// Frame size of the response, sent in front of writeBuffer_
+  uint8_t frameHeader_[4];
+
+  /// Write buffer (the response without its frame size)
   uint8_t* writeBuffer_;
 
   /// Write buffer size
   uint32_t writeBufferSize_;
 
-  /// How far through writing are we?
+  /// How far through writing frameHeader_ and writeBuffer_ are we?
   uint32_t writeBufferPos_;
 
+  /// Whether SO_ZEROCOPY could be enabled on the socket
+  bool zeroCopy_;
+
+  /// MSG_ZEROCOPY sends issued and completed on this socket (these wrap)
+  uint32_t zeroCopySent_;
+  uint32_t zeroCopyDone_;
+
+  /// Old response buffers, each with the send count that has to complete
+  /// before the kernel is done with it
+  std::deque<std::pair<uint32_t, boost::shared_ptr<OutputBuffer> > > zeroCopyHeld_;
+
   /// Largest size of write buffer seen since buffer was constructed
   size_t largestWriteBufferSize_;
 
@@ -160,7 +399,7 @@ class TNonblockingServer::TConnection {
   boost::shared_ptr<TMemoryBuffer> inputTransport_;
 
   /// Transport that processor writes to
-  boost::shared_ptr<TMemoryBuffer> outputTransport_;
+  boost::shared_ptr<OutputBuffer> outputTransport_;
 
   /// extra transport generated by transport factory (e.g. BufferedRouterTransport)
   boost::shared_ptr<TTransport> factoryInputTransport_;
@@ -178,6 +417,9 @@ class TNonblockingServer::TConnection {
   /// Thrift call context, if any
   void *connectionContext_;
 
+  /// Request arena, created on first use if the server asks for one
+  boost::scoped_ptr<TArena> arena_;
+
   /// Go into read mode
   void setRead() {
     setFlags(EV_READ | EV_PERSIST);
@@ -200,6 +442,17 @@ class TNonblockingServer::TConnection {
    */
   void setFlags(short eventFlags);
 
+  /**
+   * T_IO_BACKEND_EPOLL version of setFlags().  Records the wanted interest
+   * and, unless epollReady() is already running, acts on it right away.
+   *
+   * @param eventFlags EV_READ and/or EV_WRITE, or 0 for idle.
+   */
+  void setEpollFlags(short eventFlags);
+
+  /// (Re-)arm the one-shot epoll registration for eventFlags_.
+  void armEpoll();
+
   /**
    * Libevent handler called (via our static wrapper) when the connection
    * socket had something happen.  Rather than use the flags libevent passed,
@@ -208,6 +461,23 @@ class TNonblockingServer::TConnection {
    */
   void workSocket();
 
+  /**
+   * Send what is left of frameHeader_ and writeBuffer_, with a single
+   * gather write where the platform has one.
+   *
+   * @return the number of bytes sent, 0 if the socket would block.
+   */
+  uint32_t writeResponse();
+
+  /// Collect MSG_ZEROCOPY completions and free the buffers they release.
+  void reapZeroCopy();
+
+  /// Move the output storage aside if a zero-copy send may still use it.
+  void holdZeroCopyBuffer();
+
+  /// Answer a request over the concurrency limit without processing it.
+  void rejectRequest();
+
  public:
 
   class Task;
@@ -219,19 +489,21 @@ class TNonblockingServer::TConnection {
     readBufferSize_ = 0;
 
     ioThread_ = ioThread;
+    homeThread_ = ioThread;
+    activeIndex_ = 0;
     server_ = ioThread->getServer();
 
     // Allocate input and output transports these only need to be allocated
     // once per TConnection (they don't need to be reallocated on init() call)
     inputTransport_.reset(new TMemoryBuffer(readBuffer_, readBufferSize_));
     outputTransport_.reset(
-      new TMemoryBuffer(static_cast<uint32_t>(server_->getWriteBufferDefaultSize())));
+      new OutputBuffer(static_cast<uint32_t>(server_->getWriteBufferDefaultSize())));
     tSocket_.reset(new TSocket());
     init(socket, ioThread, addr, addrLen);
   }
 
   ~TConnection() {
-    std::free(readBuffer_);
+    homeThread_->getBufferPool()->release(readBuffer_, readBufferSize_);
   }
 
   /// Close this connection and free or reset its resources.
@@ -269,6 +541,14 @@ class TNonblockingServer::TConnection {
     ((TConnection*)v)->workSocket();
   }
 
+  /**
+   * Called by a T_IO_BACKEND_EPOLL IO thread when our one-shot registration
+   * fired.  Because the registration is edge-triggered we keep working the
+   * socket until it would block or the state machine stops wanting I/O, then
+   * re-arm only if more I/O is wanted.
+   */
+  void epollReady();
+
   /**
    * Notification to server that processing has ended on this request.
    * Can be called either when processing is completed or when a waiting
@@ -282,6 +562,29 @@ class TNonblockingServer::TConnection {
     return ioThread_->notify(this);
   }
 
+  /// The IO thread this object is cached on between connections.
+  TNonblockingIOThread* getHomeThread() const {
+    return homeThread_;
+  }
+
+  /// Index bookkeeping for TNonblockingIOThread's active connections.
+  size_t getActiveIndex() const {
+    return activeIndex_;
+  }
+
+  void setActiveIndex(size_t index) {
+    activeIndex_ = index;
+  }
+
+  /// Link used by TNonblockingIOThread's completion queue.
+  TConnection* getNotifyNext() const {
+    return notifyNext_;
+  }
+
+  void setNotifyNext(TConnection* next) {
+    notifyNext_ = next;
+  }
+
   /*
    * Returns the number of this connection's currently assigned IO
    * thread.
@@ -294,7 +597,7 @@ class TNonblockingServer::TConnection {
   void forceClose() {
     appState_ = APP_CLOSE_CONNECTION;
     if (!notifyIOThread()) {
-      throw TException("TConnection::forceClose: failed write on notify pipe");
+      throw TException("TConnection::forceClose: failed to wake IO thread");
     }
   }
 
@@ -323,6 +626,14 @@ class TNonblockingServer::TConnection {
     return connectionContext_;
   }
 
+  /// Arena to make current while processing, NULL if the server has none
+  TArena* getRequestArena() {
+    if (arena_.get() == NULL && server_->getRequestArenaBlockSize() > 0) {
+      arena_.reset(new TArena(server_->getRequestArenaBlockSize()));
+    }
+    return arena_.get();
+  }
+
 };
 
 class TNonblockingServer::TConnection::Task: public Runnable {
@@ -336,16 +647,29 @@ class TNonblockingServer::TConnection::Task: public Runnable {
     output_(output),
     connection_(connection),
     serverEventHandler_(connection_->getServerEventHandler()),
-    connectionContext_(connection_->getConnectionContext()) {}
+    connectionContext_(connection_->getConnectionContext()),
+    arrivalTime_(Util::currentTimeUsec()) {}
 
   void run() {
+    int64_t queueDelay = Util::currentTimeUsec() - arrivalTime_;
+    // Let client deadlines count the time this task spent queued
+    TDeadlineProtocol::setArrivalTime(arrivalTime_ / 1000);
+    TArena* arena = connection_->getRequestArena();
+
     try {
       for (;;) {
         if (serverEventHandler_) {
           serverEventHandler_->processContext(connectionContext_, connection_->getTSocket());
         }
-        if (!processor_->process(input_, output_, connectionContext_) ||
-            !input_->getTransport()->peek()) {
+        bool more;
+        {
+          TArena::Scope arenaScope(arena);
+          more = processor_->process(input_, output_, connectionContext_);
+        }
+        if (arena != NULL) {
+          arena->reset();
+        }
+        if (!more || !input_->getTransport()->peek()) {
           break;
         }
       }
@@ -361,10 +685,12 @@ class TNonblockingServer::TConnection::Task: public Runnable {
       GlobalOutput.printf(
         "TNonblockingServer: unknown exception while processing.");
     }
+    TDeadlineProtocol::setArrivalTime(0);
+    connection_->getServer()->releaseTask(queueDelay);
 
-    // Signal completion back to the libevent thread via a pipe
+    // Signal completion back to the IO thread via its completion queue
     if (!connection_->notifyIOThread()) {
-      throw TException("TNonblockingServer::Task::run: failed write on notify pipe");
+      throw TException("TNonblockingServer::Task::run: failed to wake IO thread");
     }
   }
 
@@ -372,6 +698,11 @@ class TNonblockingServer::TConnection::Task: public Runnable {
     return connection_;
   }
 
+  /// Time the task was created, in microseconds
+  int64_t getArrivalTime() const {
+    return arrivalTime_;
+  }
+
  private:
   boost::shared_ptr<TProcessor> processor_;
   boost::shared_ptr<TProtocol> input_;
@@ -379,6 +710,7 @@ class TNonblockingServer::TConnection::Task: public Runnable {
   TConnection* connection_;
   boost::shared_ptr<TServerEventHandler> serverEventHandler_;
   void* connectionContext_;
+  int64_t arrivalTime_;
 };
 
 void TNonblockingServer::TConnection::init(THRIFT_SOCKET socket,
@@ -388,10 +720,17 @@ void TNonblockingServer::TConnection::init(THRIFT_SOCKET socket,
   tSocket_->setSocketFD(socket);
   tSocket_->setCachedAddress(addr, addrLen);
 
+  // cached objects are only handed out by their own IO thread
+  assert(ioThread == homeThread_);
   ioThread_ = ioThread;
   server_ = ioThread->getServer();
   appState_ = APP_INIT;
   eventFlags_ = 0;
+  epollRegistered_ = false;
+  epollArmed_ = false;
+  epollDispatching_ = false;
+  wouldBlock_ = false;
+  notifyNext_ = NULL;
 
   readBufferPos_ = 0;
   readWant_ = 0;
@@ -401,6 +740,18 @@ void TNonblockingServer::TConnection::init(THRIFT_SOCKET socket,
   writeBufferPos_ = 0;
   largestWriteBufferSize_ = 0;
 
+  // close() handed anything still held to the IO thread to drain
+  assert(zeroCopyHeld_.empty());
+  zeroCopy_ = false;
+  zeroCopySent_ = 0;
+  zeroCopyDone_ = 0;
+#ifdef THRIFT_NB_ZEROCOPY
+  if (server_->getZeroCopyThreshold() > 0) {
+    int one = 1;
+    zeroCopy_ = setsockopt(socket, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+  }
+#endif
+
   socketState_ = SOCKET_RECV_FRAMING;
   callsForResize_ = 0;
 
@@ -433,6 +784,15 @@ void TNonblockingServer::TConnection::workSocket() {
   int got=0, left=0, sent=0;
   uint32_t fetch = 0;
 
+  // Pending zero-copy completions keep the socket signalling an error
+  // condition until they are read.  That condition is also what may have
+  // woken us, in which case there need not be anything to read.
+  bool mayBeSpurious = epollDispatching_;
+  if (zeroCopyDone_ != zeroCopySent_) {
+    reapZeroCopy();
+    mayBeSpurious = true;
+  }
+
   switch (socketState_) {
   case SOCKET_RECV_FRAMING:
     union {
@@ -454,6 +814,11 @@ void TNonblockingServer::TConnection::workSocket() {
       }
       readBufferPos_ += fetch;
     } catch (TTransportException& te) {
+      if (mayBeSpurious && te.getType() == TTransportException::TIMED_OUT) {
+        // EAGAIN: the edge has been consumed, wait for the next one
+        wouldBlock_ = true;
+        return;
+      }
       GlobalOutput.printf("TConnection::workSocket(): %s", te.what());
       close();
 
@@ -463,6 +828,8 @@ void TNonblockingServer::TConnection::workSocket() {
     if (readBufferPos_ < sizeof(framing.size)) {
       // more needed before frame size is known -- save what we have so far
       readWant_ = framing.size;
+      // a short read means the socket has been drained
+      wouldBlock_ = true;
       return;
     }
 
@@ -493,6 +860,10 @@ void TNonblockingServer::TConnection::workSocket() {
       got = tSocket_->read(readBuffer_ + readBufferPos_, fetch);
     }
     catch (TTransportException& te) {
+      if (mayBeSpurious && te.getType() == TTransportException::TIMED_OUT) {
+        wouldBlock_ = true;
+        return;
+      }
       GlobalOutput.printf("TConnection::workSocket(): %s", te.what());
       close();
 
@@ -509,6 +880,8 @@ void TNonblockingServer::TConnection::workSocket() {
       // We are done reading, move onto the next state
       if (readBufferPos_ == readWant_) {
         transition();
+      } else {
+        wouldBlock_ = true;
       }
       return;
     }
@@ -520,18 +893,18 @@ void TNonblockingServer::TConnection::workSocket() {
 
   case SOCKET_SEND:
     // Should never have position past size
-    assert(writeBufferPos_ <= writeBufferSize_);
+    assert(writeBufferPos_ <= sizeof(frameHeader_) + writeBufferSize_);
 
     // If there is no data to send, then let us move on
-    if (writeBufferPos_ == writeBufferSize_) {
+    if (writeBufferPos_ == sizeof(frameHeader_) + writeBufferSize_) {
       GlobalOutput("WARNING: Send state with no data to send\n");
       transition();
       return;
     }
 
     try {
-      left = writeBufferSize_ - writeBufferPos_;
-      sent = tSocket_->write_partial(writeBuffer_ + writeBufferPos_, left);
+      left = sizeof(frameHeader_) + writeBufferSize_ - writeBufferPos_;
+      sent = writeResponse();
     }
     catch (TTransportException& te) {
       GlobalOutput.printf("TConnection::workSocket(): %s ", te.what());
@@ -540,12 +913,16 @@ void TNonblockingServer::TConnection::workSocket() {
     }
 
     writeBufferPos_ += sent;
+    if (sent < left) {
+      // the socket's send buffer is full
+      wouldBlock_ = true;
+    }
 
     // Did we overdo it?
-    assert(writeBufferPos_ <= writeBufferSize_);
+    assert(writeBufferPos_ <= sizeof(frameHeader_) + writeBufferSize_);
 
     // We are done!
-    if (writeBufferPos_ == writeBufferSize_) {
+    if (writeBufferPos_ == sizeof(frameHeader_) + writeBufferSize_) {
       transition();
     }
 
@@ -557,6 +934,122 @@ void TNonblockingServer::TConnection::workSocket() {
   }
 }
 
+uint32_t TNonblockingServer::TConnection::writeResponse() {
+  const uint32_t headerSize = sizeof(frameHeader_);
+#ifdef HAVE_SYS_UIO_H
+  struct iovec iov[2];
+  int iovcnt;
+  if (writeBufferPos_ < headerSize) {
+    iov[0].iov_base = frameHeader_ + writeBufferPos_;
+    iov[0].iov_len = headerSize - writeBufferPos_;
+    iov[1].iov_base = writeBuffer_;
+    iov[1].iov_len = writeBufferSize_;
+    iovcnt = 2;
+  } else {
+    iov[0].iov_base = writeBuffer_ + (writeBufferPos_ - headerSize);
+    iov[0].iov_len = writeBufferSize_ - (writeBufferPos_ - headerSize);
+    iovcnt = 1;
+  }
+
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov;
+  msg.msg_iovlen = iovcnt;
+
+  int flags = 0;
+#ifdef MSG_NOSIGNAL
+  // as in TSocket::write_partial(), we handle THRIFT_EPIPE ourselves
+  flags |= MSG_NOSIGNAL;
+#endif
+  bool zeroCopy = false;
+#ifdef THRIFT_NB_ZEROCOPY
+  if (zeroCopy_ && writeBufferSize_ >= server_->getZeroCopyThreshold()) {
+    zeroCopy = true;
+    flags |= MSG_ZEROCOPY;
+  }
+#endif
+
+  ssize_t b = sendmsg(tSocket_->getSocketFD(), &msg, flags);
+#ifdef THRIFT_NB_ZEROCOPY
+  if (b < 0 && zeroCopy && THRIFT_GET_SOCKET_ERROR == ENOBUFS) {
+    // out of option memory for completions, copy this one instead
+    zeroCopy = false;
+    b = sendmsg(tSocket_->getSocketFD(), &msg, flags & ~MSG_ZEROCOPY);
+  }
+#endif
+  if (b < 0) {
+    if (THRIFT_GET_SOCKET_ERROR == THRIFT_EWOULDBLOCK || THRIFT_GET_SOCKET_ERROR == THRIFT_EAGAIN) {
+      return 0;
+    }
+    int errno_copy = THRIFT_GET_SOCKET_ERROR;
+    GlobalOutput.perror("TConnection::writeResponse() sendmsg() ", errno_copy);
+    if (errno_copy == THRIFT_EPIPE || errno_copy == THRIFT_ECONNRESET || errno_copy == THRIFT_ENOTCONN) {
+      throw TTransportException(TTransportException::NOT_OPEN, "sendmsg()", errno_copy);
+    }
+    throw TTransportException(TTransportException::UNKNOWN, "sendmsg()", errno_copy);
+  }
+  if (zeroCopy) {
+    ++zeroCopySent_;
+  }
+  return static_cast<uint32_t>(b);
+#else
+  uint32_t sent = 0;
+  if (writeBufferPos_ < headerSize) {
+    sent = tSocket_->write_partial(frameHeader_ + writeBufferPos_,
+                                   headerSize - writeBufferPos_);
+    if (writeBufferPos_ + sent < headerSize) {
+      return sent;
+    }
+  }
+  uint32_t bodyPos = writeBufferPos_ + sent - headerSize;
+  return sent + tSocket_->write_partial(writeBuffer_ + bodyPos,
+                                        writeBufferSize_ - bodyPos);
+#endif
+}
+
+void TNonblockingServer::TConnection::reapZeroCopy() {
+  readZeroCopyCompletions(tSocket_->getSocketFD(), zeroCopySent_, zeroCopyDone_);
+
+  while (!zeroCopyHeld_.empty()
+         && static_cast<int32_t>(zeroCopyDone_ - zeroCopyHeld_.front().first) >= 0) {
+    zeroCopyHeld_.pop_front();
+  }
+}
+
+void TNonblockingServer::TConnection::rejectRequest() {
+  std::string name;
+  TMessageType type;
+  int32_t seqid;
+  inputProtocol_->readMessageBegin(name, type, seqid);
+  if (type == T_ONEWAY) {
+    return;
+  }
+
+  // Answer with the method name the client called, without its budget
+  int64_t deadline = 0;
+  TDeadlineProtocol::stripDeadline(name, deadline);
+
+  TApplicationException x(TApplicationException::INTERNAL_ERROR,
+                           "TNonblockingServer: over concurrency limit");
+  outputProtocol_->writeMessageBegin(name, T_EXCEPTION, seqid);
+  x.write(outputProtocol_.get());
+  outputProtocol_->writeMessageEnd();
+  outputProtocol_->getTransport()->writeEnd();
+}
+
+void TNonblockingServer::TConnection::holdZeroCopyBuffer() {
+  if (zeroCopyDone_ == zeroCopySent_) {
+    return;
+  }
+  reapZeroCopy();
+  if (zeroCopyDone_ != zeroCopySent_) {
+    boost::shared_ptr<OutputBuffer> held(
+      new OutputBuffer(static_cast<uint32_t>(server_->getWriteBufferDefaultSize())));
+    outputTransport_->swapStorage(*held);
+    zeroCopyHeld_.push_back(std::make_pair(zeroCopySent_, held));
+  }
+}
+
 /**
  * This is called when the application transitions from one state into
  * another. This means that it has finished writing the data that it needed
@@ -574,15 +1067,24 @@ void TNonblockingServer::TConnection::transition() {
     // We are done reading the request, package the read buffer into transport
     // and get back some data from the dispatch function
     inputTransport_->resetBuffer(readBuffer_, readBufferPos_);
+    // The frame size goes out separately (see writeResponse()), so the
+    // processor writes straight into an empty buffer
+    holdZeroCopyBuffer();
     outputTransport_->resetBuffer();
-    // Prepend four bytes of blank space to the buffer so we can
-    // write the frame size there later.
-    outputTransport_->getWritePtr(4);
-    outputTransport_->wroteBytes(4);
 
     server_->incrementActiveProcessors();
 
-    if (server_->isThreadPoolProcessing()) {
+    if (server_->isThreadPoolProcessing() && !server_->admitTask()) {
+      try {
+        rejectRequest();
+      } catch (const TException& tx) {
+        GlobalOutput.printf("TNonblockingServer: error rejecting request: %s",
+                            tx.what());
+        server_->decrementActiveProcessors();
+        close();
+        return;
+      }
+    } else if (server_->isThreadPoolProcessing()) {
       // We are setting up a Task to do this work and we will wait on it
 
       // Create task and dispatch to the thread manager
@@ -595,10 +1097,11 @@ void TNonblockingServer::TConnection::transition() {
       appState_ = APP_WAIT_TASK;
 
         try {
-          server_->addTask(task);
+          homeThread_->addTask(task);
         } catch (IllegalStateException & ise) {
           // The ThreadManager is not ready to handle any more tasks (it's probably shutting down).
           GlobalOutput.printf("IllegalStateException: Server::process() %s", ise.what());
+          server_->releaseTask(-1);
           close();
         }
 
@@ -614,8 +1117,15 @@ void TNonblockingServer::TConnection::transition() {
                                               getTSocket());
         }
         // Invoke the processor
-        processor_->process(inputProtocol_, outputProtocol_,
-                            connectionContext_);
+        TArena* arena = getRequestArena();
+        {
+          TArena::Scope arenaScope(arena);
+          processor_->process(inputProtocol_, outputProtocol_,
+                              connectionContext_);
+        }
+        if (arena != NULL) {
+          arena->reset();
+        }
       } catch (const TTransportException &ttx) {
         GlobalOutput.printf("TNonblockingServer transport error in "
                             "process(): %s", ttx.what());
@@ -650,16 +1160,15 @@ void TNonblockingServer::TConnection::transition() {
 
     // If the function call generated return data, then move into the send
     // state and get going
-    // 4 bytes were reserved for frame size
-    if (writeBufferSize_ > 4) {
+    if (writeBufferSize_ > 0) {
 
       // Move into write state
       writeBufferPos_ = 0;
       socketState_ = SOCKET_SEND;
 
-      // Put the frame size into the write buffer
-      int32_t frameSize = (int32_t)htonl(writeBufferSize_ - 4);
-      memcpy(writeBuffer_, &frameSize, 4);
+      // Put the frame size in front of the write buffer
+      int32_t frameSize = (int32_t)htonl(writeBufferSize_);
+      memcpy(frameHeader_, &frameSize, sizeof(frameHeader_));
 
       // Socket into write mode
       appState_ = APP_SEND_RESULT;
@@ -713,21 +1222,13 @@ void TNonblockingServer::TConnection::transition() {
 
   case APP_READ_FRAME_SIZE:
     // We just read the request length
-    // Double the buffer size until it is big enough
+    // Swap in a pooled buffer big enough for it; nothing in the old one
+    // needs to be kept
     if (readWant_ > readBufferSize_) {
-      if (readBufferSize_ == 0) {
-        readBufferSize_ = 1;
-      }
-      uint32_t newSize = readBufferSize_;
-      while (readWant_ > newSize) {
-        newSize *= 2;
-      }
-
-      uint8_t* newBuffer = (uint8_t*)std::realloc(readBuffer_, newSize);
-      if (newBuffer == NULL) {
-        // nothing else to be done...
-        throw std::bad_alloc();
-      }
+      TNonblockingBufferPool* pool = homeThread_->getBufferPool();
+      uint32_t newSize;
+      uint8_t* newBuffer = pool->allocate(readWant_, newSize);
+      pool->release(readBuffer_, readBufferSize_);
       readBuffer_ = newBuffer;
       readBufferSize_ = newSize;
     }
@@ -755,6 +1256,11 @@ void TNonblockingServer::TConnection::transition() {
 }
 
 void TNonblockingServer::TConnection::setFlags(short eventFlags) {
+  if (ioThread_->getIOBackend() == T_IO_BACKEND_EPOLL) {
+    setEpollFlags(eventFlags);
+    return;
+  }
+
   // Catch the do nothing case
   if (eventFlags_ == eventFlags) {
     return;
@@ -813,12 +1319,86 @@ void TNonblockingServer::TConnection::setFlags(short eventFlags) {
   }
 }
 
+void TNonblockingServer::TConnection::setEpollFlags(short eventFlags) {
+  eventFlags_ = eventFlags & (EV_READ | EV_WRITE);
+
+  if (epollDispatching_) {
+    // epollReady() re-arms once workSocket() unwinds
+    return;
+  }
+
+  if (eventFlags_ & EV_WRITE) {
+    // A finished task is handing us a response; the socket is almost always
+    // writable, so try to send it now rather than waiting a loop iteration.
+    epollReady();
+  } else if (eventFlags_ && !epollArmed_) {
+    armEpoll();
+  }
+}
+
+void TNonblockingServer::TConnection::armEpoll() {
+#ifdef HAVE_SYS_EPOLL_H
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLET | EPOLLONESHOT;
+  if (eventFlags_ & EV_READ) {
+    ev.events |= EPOLLIN;
+  }
+  if (eventFlags_ & EV_WRITE) {
+    ev.events |= EPOLLOUT;
+  }
+  ev.data.ptr = this;
+
+  // Re-arming a one-shot registration re-checks readiness, so nothing that
+  // arrived while we were disarmed is lost.
+  int op = epollRegistered_ ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+  if (epoll_ctl(ioThread_->getEpollFD(), op, tSocket_->getSocketFD(), &ev) == -1) {
+    GlobalOutput.perror("TConnection::armEpoll() epoll_ctl ", THRIFT_GET_SOCKET_ERROR);
+    return;
+  }
+  epollRegistered_ = true;
+  epollArmed_ = true;
+#endif
+}
+
+void TNonblockingServer::TConnection::epollReady() {
+  // One-shot registrations are disarmed by the kernel when they fire.
+  epollArmed_ = false;
+  epollDispatching_ = true;
+
+  // Bound the work done per wakeup so one busy client can't starve the rest.
+  for (int i = 0; i < 16; ++i) {
+    wouldBlock_ = false;
+    workSocket();
+    if (ioThread_ == NULL) {
+      // Closed; the IO thread returns us to the server after this batch.
+      return;
+    }
+    if (wouldBlock_ || eventFlags_ == 0) {
+      break;
+    }
+  }
+
+  epollDispatching_ = false;
+  if (eventFlags_ != 0) {
+    armEpoll();
+  }
+}
+
 /**
  * Closes a connection
  */
 void TNonblockingServer::TConnection::close() {
-  // Delete the registered libevent
-  if (event_del(&event_) == -1) {
+  TNonblockingIOThread* ioThread = ioThread_;
+  bool deferReturn = false;
+
+  if (ioThread->getIOBackend() == T_IO_BACKEND_EPOLL) {
+    // Closing the socket removes it from the epoll set.  If we are inside
+    // epollReady() it still needs this object after we return, so the IO
+    // thread hands us back to the server once its batch is done.
+    deferReturn = epollDispatching_;
+  } else if (event_del(&event_) == -1) {
+    // Delete the registered libevent
     GlobalOutput.perror("TConnection::close() event_del", THRIFT_GET_SOCKET_ERROR);
   }
 
@@ -827,7 +1407,39 @@ void TNonblockingServer::TConnection::close() {
   }
   ioThread_ = NULL;
 
-  // Close the socket
+  // Once the socket is closed we can't learn about completions any more,
+  // and TCP may go on sending from what is held for a while yet.  A
+  // duplicate of the socket keeps its error queue readable, and the IO
+  // thread keeps the buffers until it reports them done, so that neither
+  // this object's reuse nor anything else can write over them.
+  holdZeroCopyBuffer();
+#ifdef THRIFT_NB_ZEROCOPY
+  if (!zeroCopyHeld_.empty()) {
+#ifdef HAVE_SYS_EPOLL_H
+    // Only closing every descriptor of the socket leaves the epoll set
+    if (epollRegistered_) {
+      epoll_ctl(ioThread->getEpollFD(), EPOLL_CTL_DEL, tSocket_->getSocketFD(), NULL);
+      epollRegistered_ = false;
+    }
+#endif
+    THRIFT_SOCKET dupSocket = ::dup(tSocket_->getSocketFD());
+    if (dupSocket < 0) {
+      // Without it the buffers are kept until the server is destroyed
+      GlobalOutput.perror("TConnection::close() dup ", THRIFT_GET_SOCKET_ERROR);
+      dupSocket = THRIFT_INVALID_SOCKET;
+    }
+    TNonblockingIOThread::ZeroCopyDrain* drain =
+      new TNonblockingIOThread::ZeroCopyDrain(dupSocket, zeroCopySent_, zeroCopyDone_);
+    for (size_t i = 0; i < zeroCopyHeld_.size(); ++i) {
+      drain->hold(zeroCopyHeld_[i].second);
+    }
+    zeroCopyHeld_.clear();
+    homeThread_->addZeroCopyDrain(drain);
+  }
+#endif
+
+  // Close the socket (shutting it down sends the FIN even while a
+  // duplicate is open)
   tSocket_->close();
 
   // close any factory produced transports
@@ -837,20 +1449,31 @@ void TNonblockingServer::TConnection::close() {
   // release processor and handler
   processor_.reset();
 
+  // A request that threw may have left its allocations behind
+  if (arena_.get() != NULL) {
+    arena_->reset();
+  }
+
   // Give this object back to the server that owns it
-  server_->returnConnection(this);
+  if (deferReturn) {
+    ioThread->deferReturnConnection(this);
+  } else {
+    server_->returnConnection(this);
+  }
 }
 
 void TNonblockingServer::TConnection::checkIdleBufferMemLimit(
     size_t readLimit,
     size_t writeLimit) {
   if (readLimit > 0 && readBufferSize_ > readLimit) {
-    free(readBuffer_);
+    homeThread_->getBufferPool()->release(readBuffer_, readBufferSize_);
     readBuffer_ = NULL;
     readBufferSize_ = 0;
   }
 
-  if (writeLimit > 0 && largestWriteBufferSize_ > writeLimit) {
+  // (storage a zero-copy send may still use is replaced on the next request)
+  if (writeLimit > 0 && largestWriteBufferSize_ > writeLimit
+      && zeroCopyDone_ == zeroCopySent_) {
     // just start over
     outputTransport_->resetBuffer(static_cast<uint32_t>(server_->getWriteBufferDefaultSize()));
     largestWriteBufferSize_ = 0;
@@ -858,15 +1481,15 @@ void TNonblockingServer::TConnection::checkIdleBufferMemLimit(
 }
 
 TNonblockingServer::~TNonblockingServer() {
-  // Close any active connections (moves them to the idle connection stack)
-  while (activeConnections_.size()) {
-	  activeConnections_.front()->close();
-  }
-  // Clean up unused TConnection objects in connectionStack_
-  while (!connectionStack_.empty()) {
-    TConnection* connection = connectionStack_.top();
-    connectionStack_.pop();
-    delete connection;
+  // Our own workers finish what they are running before the connections go
+  std::map<int, shared_ptr<ThreadManager> >::iterator it;
+  for (it = numaThreadManagers_.begin(); it != numaThreadManagers_.end(); ++it) {
+    it->second->stop();
+  }
+
+  // Close any active connections and clean up the cached TConnection objects
+  for (size_t i = 0; i < ioThreads_.size(); ++i) {
+    ioThreads_[i]->destroyConnections();
   }
   // The TNonblockingIOThread objects have shared_ptrs to the Thread
   // objects and the Thread objects have shared_ptrs to the TNonblockingIOThread
@@ -879,61 +1502,63 @@ TNonblockingServer::~TNonblockingServer() {
 }
 
 /**
- * Creates a new connection either by reusing an object off the stack or
- * by allocating a new one entirely
+ * Picks an IO thread for a new connection, which then either reuses an
+ * object from its cache or allocates a new one entirely
  */
 TNonblockingServer::TConnection* TNonblockingServer::createConnection(
     THRIFT_SOCKET socket, const sockaddr* addr, socklen_t addrLen) {
-  // Check the stack
-  Guard g(connMutex_);
-
   // pick an IO thread to handle this connection -- currently round robin
   assert(nextIOThread_ < ioThreads_.size());
   int selectedThreadIdx = nextIOThread_;
   nextIOThread_ = static_cast<uint32_t>((nextIOThread_ + 1) % ioThreads_.size());
 
-  TNonblockingIOThread* ioThread = ioThreads_[selectedThreadIdx].get();
-
-  // Check the connection stack to see if we can re-use
-  TConnection* result = NULL;
-  if (connectionStack_.empty()) {
-    result = new TConnection(socket, ioThread, addr, addrLen);
-    ++numTConnections_;
-  } else {
-    result = connectionStack_.top();
-    connectionStack_.pop();
-    result->init(socket, ioThread, addr, addrLen);
-  }
-  activeConnections_.push_back(result);
-  return result;
+  return ioThreads_[selectedThreadIdx]->createConnection(socket, addr, addrLen);
 }
 
 /**
- * Returns a connection to the stack
+ * Returns a connection to the cache of the IO thread it belongs to
  */
 void TNonblockingServer::returnConnection(TConnection* connection) {
-  Guard g(connMutex_);
+  connection->getHomeThread()->returnConnection(connection);
+}
 
-  activeConnections_.erase(std::remove(activeConnections_.begin(), activeConnections_.end(), connection), activeConnections_.end());
+size_t TNonblockingServer::getNumConnections() const {
+  size_t count = 0;
+  for (size_t i = 0; i < ioThreads_.size(); ++i) {
+    count += ioThreads_[i]->getNumConnections();
+  }
+  return count;
+}
 
-  if (connectionStackLimit_ &&
-      (connectionStack_.size() >= connectionStackLimit_)) {
-    delete connection;
-    --numTConnections_;
-  } else {
-    connection->checkIdleBufferMemLimit(idleReadBufferLimit_, idleWriteBufferLimit_);
-    connectionStack_.push(connection);
+size_t TNonblockingServer::getNumActiveConnections() const {
+  return getNumConnections() - getNumIdleConnections();
+}
+
+size_t TNonblockingServer::getNumIdleConnections() const {
+  size_t count = 0;
+  for (size_t i = 0; i < ioThreads_.size(); ++i) {
+    count += ioThreads_[i]->getNumIdleConnections();
+  }
+  return count;
+}
+
+TNonblockingPoolStats TNonblockingServer::getPoolStats() const {
+  TNonblockingPoolStats stats;
+  for (size_t i = 0; i < ioThreads_.size(); ++i) {
+    ioThreads_[i]->addPoolStats(stats);
   }
+  return stats;
 }
 
 /**
  * Server socket had something happen.  We accept all waiting client
  * connections on fd and assign TConnection objects to handle those requests.
  */
-void TNonblockingServer::handleEvent(THRIFT_SOCKET fd, short which) {
+void TNonblockingServer::handleEvent(THRIFT_SOCKET fd, short which,
+                                     TNonblockingIOThread* acceptor) {
   (void) which;
   // Make sure that libevent didn't mess up the socket handles
-  assert(fd == serverSocket_);
+  assert(fd == acceptor->getListenSocket());
 
   // Server socket accepted a new connection
   socklen_t addrLen;
@@ -974,8 +1599,10 @@ void TNonblockingServer::handleEvent(THRIFT_SOCKET fd, short which) {
       return;
     }
 
-    // Create a new TConnection for this client socket.
-    TConnection* clientConnection =
+    // Create a new TConnection for this client socket.  With SO_REUSEPORT
+    // the kernel already picked the IO thread by picking the listen socket.
+    TConnection* clientConnection = reusePort_ ?
+      acceptor->createConnection(clientSocket, addrp, addrLen) :
       createConnection(clientSocket, addrp, addrLen);
 
     // Fail fast if we could not create a TConnection object
@@ -990,14 +1617,10 @@ void TNonblockingServer::handleEvent(THRIFT_SOCKET fd, short which) {
      * start processing, or if it is us, we'll just ask this
      * connection to do its initial state change here.
      *
-     * (We need to avoid writing to our own notification pipe, to
-     * avoid possible deadlocks if the pipe is full.)
-     *
-     * The IO thread #0 is the only one that handles these listen
-     * events, so unless the connection has been assigned to thread #0
-     * we know it's not on our thread.
+     * (Queueing it to ourselves would only delay it until the next
+     * wakeup of our own loop.)
      */
-    if (clientConnection->getIOThreadNumber() == 0) {
+    if (clientConnection->getIOThreadNumber() == acceptor->getThreadNumber()) {
       clientConnection->transition();
     } else {
       clientConnection->notifyIOThread();
@@ -1019,6 +1642,15 @@ void TNonblockingServer::handleEvent(THRIFT_SOCKET fd, short which) {
  * Creates a socket to listen on and binds it to the local port.
  */
 void TNonblockingServer::createAndListenOnSocket() {
+  serverSocket_ = createListenSocket();
+}
+
+/**
+ * Creates, binds and prepares one listen socket.  In SO_REUSEPORT mode this
+ * is called once per IO thread, so an ephemeral port picked by the first
+ * bind is stored in port_ for the others.
+ */
+THRIFT_SOCKET TNonblockingServer::createListenSocket() {
   THRIFT_SOCKET s;
 
   struct addrinfo hints, *res, *res0;
@@ -1067,19 +1699,51 @@ void TNonblockingServer::createAndListenOnSocket() {
   // Set THRIFT_NO_SOCKET_CACHING to avoid 2MSL delay on server restart
   setsockopt(s, SOL_SOCKET, THRIFT_NO_SOCKET_CACHING, const_cast_sockopt(&one), sizeof(one));
 
+  if (reusePort_) {
+#ifdef SO_REUSEPORT
+    if (-1 == setsockopt(s, SOL_SOCKET, SO_REUSEPORT, const_cast_sockopt(&one), sizeof(one))) {
+      int errno_copy = THRIFT_GET_SOCKET_ERROR;
+      ::THRIFT_CLOSESOCKET(s);
+      freeaddrinfo(res0);
+      throw TTransportException(TTransportException::NOT_OPEN,
+                                "TNonblockingServer::serve() SO_REUSEPORT",
+                                errno_copy);
+    }
+#else
+    ::THRIFT_CLOSESOCKET(s);
+    freeaddrinfo(res0);
+    throw TException("TNonblockingServer::serve() SO_REUSEPORT is not "
+                     "supported on this platform");
+#endif
+  }
+
   if (::bind(s, res->ai_addr, static_cast<int>(res->ai_addrlen)) == -1) {
+    int errno_copy = THRIFT_GET_SOCKET_ERROR;
     ::THRIFT_CLOSESOCKET(s);
     freeaddrinfo(res0);
     throw TTransportException(TTransportException::NOT_OPEN,
                               "TNonblockingServer::serve() bind",
-                              THRIFT_GET_SOCKET_ERROR);
+                              errno_copy);
   }
 
   // Done with the addr info
   freeaddrinfo(res0);
 
+  if (port_ == 0) {
+    sockaddr_storage addr;
+    socklen_t addrLen = sizeof(addr);
+    if (::getsockname(s, reinterpret_cast<sockaddr*>(&addr), &addrLen) == 0) {
+      if (addr.ss_family == AF_INET6) {
+        port_ = ntohs(reinterpret_cast<sockaddr_in6*>(&addr)->sin6_port);
+      } else {
+        port_ = ntohs(reinterpret_cast<sockaddr_in*>(&addr)->sin_port);
+      }
+    }
+  }
+
   // Set up this file descriptor for listening
-  listenSocket(s);
+  prepareListenSocket(s);
+  return s;
 }
 
 /**
@@ -1087,6 +1751,13 @@ void TNonblockingServer::createAndListenOnSocket() {
  * to prepare for use in the server.
  */
 void TNonblockingServer::listenSocket(THRIFT_SOCKET s) {
+  prepareListenSocket(s);
+
+  // Cool, this socket is good to go, set it as the serverSocket_
+  serverSocket_ = s;
+}
+
+void TNonblockingServer::prepareListenSocket(THRIFT_SOCKET s) {
   // Set socket to nonblocking mode
   int flags;
   if ((flags = THRIFT_FCNTL(s, THRIFT_F_GETFL, 0)) < 0 ||
@@ -1120,9 +1791,6 @@ void TNonblockingServer::listenSocket(THRIFT_SOCKET s) {
     ::THRIFT_CLOSESOCKET(s);
     throw TException("TNonblockingServer::serve() listen");
   }
-
-  // Cool, this socket is good to go, set it as the serverSocket_
-  serverSocket_ = s;
 }
 
 void TNonblockingServer::setThreadManager(boost::shared_ptr<ThreadManager> threadManager) {
@@ -1136,7 +1804,7 @@ void TNonblockingServer::setThreadManager(boost::shared_ptr<ThreadManager> threa
 }
 
 bool  TNonblockingServer::serverOverloaded() {
-  size_t activeConnections = numTConnections_ - connectionStack_.size();
+  size_t activeConnections = getNumActiveConnections();
   if (numActiveProcessors_ > maxActiveProcessors_ ||
       activeConnections > maxConnections_) {
     if (!overloaded_) {
@@ -1161,11 +1829,16 @@ bool  TNonblockingServer::serverOverloaded() {
 bool TNonblockingServer::drainPendingTask() {
   if (threadManager_) {
     boost::shared_ptr<Runnable> task = threadManager_->removeNextPending();
+    std::map<int, shared_ptr<ThreadManager> >::iterator it = numaThreadManagers_.begin();
+    for (; !task && it != numaThreadManagers_.end(); ++it) {
+      task = it->second->removeNextPending();
+    }
     if (task) {
-      TConnection* connection =
-        static_cast<TConnection::Task*>(task.get())->getTConnection();
+      TConnection::Task* t = static_cast<TConnection::Task*>(task.get());
+      TConnection* connection = t->getTConnection();
       assert(connection && connection->getServer()
              && connection->getState() == APP_WAIT_TASK);
+      releaseTask(Util::currentTimeUsec() - t->getArrivalTime());
       connection->forceClose();
       return true;
     }
@@ -1174,10 +1847,12 @@ bool TNonblockingServer::drainPendingTask() {
 }
 
 void TNonblockingServer::expireClose(boost::shared_ptr<Runnable> task) {
-  TConnection* connection =
-    static_cast<TConnection::Task*>(task.get())->getTConnection();
+  TConnection::Task* t = static_cast<TConnection::Task*>(task.get());
+  TConnection* connection = t->getTConnection();
   assert(connection && connection->getServer() &&
          connection->getState() == APP_WAIT_TASK);
+  // An expired task waited too long by definition; let the limit back off
+  releaseTask(Util::currentTimeUsec() - t->getArrivalTime());
   connection->forceClose();
 }
 
@@ -1192,8 +1867,12 @@ void TNonblockingServer::registerEvents(event_base* user_event_base) {
   userEventBase_ = user_event_base;
 
   // init listen socket
-  if (serverSocket_ == THRIFT_INVALID_SOCKET)
+  if (serverSocket_ == THRIFT_INVALID_SOCKET) {
     createAndListenOnSocket();
+  } else if (reusePort_) {
+    throw TException("TNonblockingServer::serve() SO_REUSEPORT mode needs "
+                     "to create its own listen sockets");
+  }
 
   // set up the IO threads
   assert(ioThreads_.empty());
@@ -1202,14 +1881,68 @@ void TNonblockingServer::registerEvents(event_base* user_event_base) {
   }
 
   for (uint32_t id = 0; id < numIOThreads_; ++id) {
-    // the first IO thread also does the listening on server socket
-    THRIFT_SOCKET listenFd = (id == 0 ? serverSocket_ : THRIFT_INVALID_SOCKET);
+    // the first IO thread also does the listening on server socket; with
+    // SO_REUSEPORT every other one gets a socket of its own
+    THRIFT_SOCKET listenFd = THRIFT_INVALID_SOCKET;
+    if (id == 0) {
+      listenFd = serverSocket_;
+    } else if (reusePort_) {
+      listenFd = createListenSocket();
+    }
 
     shared_ptr<TNonblockingIOThread> thread(
       new TNonblockingIOThread(this, id, listenFd, useHighPriorityIOThreads_));
     ioThreads_.push_back(thread);
   }
 
+  // work out the placement of pinned IO threads and their workers
+  if (!ioThreadCpus_.empty()) {
+    cpuNodes_.clear();
+    for (int node = 0; node < 64; ++node) {
+      std::vector<int> cpus = Util::getNumaNodeCpus(node);
+      for (size_t i = 0; i < cpus.size(); ++i) {
+        if (static_cast<size_t>(cpus[i]) >= cpuNodes_.size()) {
+          cpuNodes_.resize(cpus[i] + 1, -1);
+        }
+        cpuNodes_[cpus[i]] = node;
+      }
+    }
+
+    for (uint32_t id = 0; id < ioThreads_.size(); ++id) {
+      int cpu = ioThreadCpus_[id % ioThreadCpus_.size()];
+      int node = -1;
+      if (cpu >= 0 && static_cast<size_t>(cpu) < cpuNodes_.size()) {
+        node = cpuNodes_[cpu];
+      }
+      ioThreads_[id]->setCpu(cpu, node);
+    }
+
+    // and give each node's IO threads workers that are created on it
+    if (numaWorkerThreads_ > 0 && threadPoolProcessing_) {
+      for (uint32_t id = 0; id < ioThreads_.size(); ++id) {
+        int node = ioThreads_[id]->getNumaNode();
+        if (node < 0) {
+          continue;
+        }
+        shared_ptr<ThreadManager>& threadManager = numaThreadManagers_[node];
+        if (!threadManager) {
+          shared_ptr<PlatformThreadFactory> threadFactory(new PlatformThreadFactory());
+#if !defined(USE_BOOST_THREAD) && !defined(USE_STD_THREAD)
+          threadFactory->setCpuSet(Util::getNumaNodeCpus(node));
+#endif
+          threadManager = ThreadManager::newSimpleThreadManager(numaWorkerThreads_);
+          threadManager->threadFactory(threadFactory);
+          threadManager->setExpireCallback(
+            apache::thrift::stdcxx::bind(&TNonblockingServer::expireClose,
+                                         this,
+                                         apache::thrift::stdcxx::placeholders::_1));
+          threadManager->start();
+        }
+        ioThreads_[id]->setThreadManager(threadManager);
+      }
+    }
+  }
+
   // Notify handler of the preServe event
   if (eventHandler_) {
     eventHandler_->preServe();
@@ -1275,8 +2008,17 @@ TNonblockingIOThread::TNonblockingIOThread(TNonblockingServer* server,
       , number_(number)
       , listenSocket_(listenSocket)
       , useHighPriority_(useHighPriority)
+      , cpu_(-1)
+      , numaNode_(-1)
+      , ioBackend_(server->getIOBackend())
+      , epollFD_(-1)
+      , epollLoopBreak_(false)
       , eventBase_(NULL)
-      , ownEventBase_(false) {
+      , ownEventBase_(false)
+      , numConnections_(0)
+      , connectionHits_(0)
+      , connectionMisses_(0)
+      , completedHead_(NULL) {
   notificationPipeFDs_[0] = -1;
   notificationPipeFDs_[1] = -1;
 }
@@ -1290,6 +2032,11 @@ TNonblockingIOThread::~TNonblockingIOThread() {
     ownEventBase_ = false;
   }
 
+  if (epollFD_ >= 0) {
+    ::close(epollFD_);
+    epollFD_ = -1;
+  }
+
   if (listenSocket_ >= 0) {
     if (0 != ::THRIFT_CLOSESOCKET(listenSocket_)) {
       GlobalOutput.perror("TNonblockingIOThread listenSocket_ close(): ",
@@ -1298,6 +2045,10 @@ TNonblockingIOThread::~TNonblockingIOThread() {
     listenSocket_ = THRIFT_INVALID_SOCKET;
   }
 
+  // an eventfd is both ends at once
+  if (notificationPipeFDs_[1] == notificationPipeFDs_[0]) {
+    notificationPipeFDs_[1] = THRIFT_INVALID_SOCKET;
+  }
   for (int i = 0; i < 2; ++i) {
     if (notificationPipeFDs_[i] >= 0) {
       if (0 != ::THRIFT_CLOSESOCKET(notificationPipeFDs_[i])) {
@@ -1309,7 +2060,115 @@ TNonblockingIOThread::~TNonblockingIOThread() {
   }
 }
 
+TNonblockingServer::TConnection* TNonblockingIOThread::createConnection(
+    THRIFT_SOCKET socket, const sockaddr* addr, socklen_t addrLen) {
+  Guard g(connMutex_);
+
+  TNonblockingServer::TConnection* result = NULL;
+  if (connectionCache_.empty()) {
+    result = new TNonblockingServer::TConnection(socket, this, addr, addrLen);
+    ++numConnections_;
+    ++connectionMisses_;
+  } else {
+    result = connectionCache_.back();
+    connectionCache_.pop_back();
+    result->init(socket, this, addr, addrLen);
+    ++connectionHits_;
+  }
+  result->setActiveIndex(activeConnections_.size());
+  activeConnections_.push_back(result);
+  return result;
+}
+
+void TNonblockingIOThread::addZeroCopyDrain(ZeroCopyDrain* drain) {
+  Guard g(connMutex_);
+  zeroCopyDrains_.push_back(drain);
+}
+
+void TNonblockingIOThread::reapZeroCopyDrains() {
+  size_t kept = 0;
+  for (size_t i = 0; i < zeroCopyDrains_.size(); ++i) {
+    if (zeroCopyDrains_[i]->complete()) {
+      delete zeroCopyDrains_[i];
+    } else {
+      zeroCopyDrains_[kept++] = zeroCopyDrains_[i];
+    }
+  }
+  zeroCopyDrains_.resize(kept);
+}
+
+void TNonblockingIOThread::returnConnection(TNonblockingServer::TConnection* connection) {
+  // the server's limit is shared evenly between the IO threads
+  size_t limit = server_->getConnectionStackLimit();
+  size_t numThreads = server_->getNumIOThreads();
+  if (limit && numThreads > 1) {
+    limit = (limit + numThreads - 1) / numThreads;
+  }
+
+  Guard g(connMutex_);
+
+  // Connections come and go often enough to check on the drains here
+  if (!zeroCopyDrains_.empty()) {
+    reapZeroCopyDrains();
+  }
+
+  size_t index = connection->getActiveIndex();
+  assert(index < activeConnections_.size() && activeConnections_[index] == connection);
+  activeConnections_[index] = activeConnections_.back();
+  activeConnections_[index]->setActiveIndex(index);
+  activeConnections_.pop_back();
+
+  if (limit && connectionCache_.size() >= limit) {
+    delete connection;
+    --numConnections_;
+  } else {
+    connection->checkIdleBufferMemLimit(server_->getIdleReadBufferLimit(),
+                                        server_->getIdleWriteBufferLimit());
+    connectionCache_.push_back(connection);
+  }
+}
+
+void TNonblockingIOThread::destroyConnections() {
+  // close() hands each connection back through returnConnection()
+  while (!activeConnections_.empty()) {
+    activeConnections_.back()->close();
+  }
+
+  Guard g(connMutex_);
+  for (size_t i = 0; i < connectionCache_.size(); ++i) {
+    delete connectionCache_[i];
+  }
+  numConnections_ -= connectionCache_.size();
+  connectionCache_.clear();
+
+  // The server is going away; whatever the kernel has not sent by now, its
+  // buffers go with it
+  for (size_t i = 0; i < zeroCopyDrains_.size(); ++i) {
+    delete zeroCopyDrains_[i];
+  }
+  zeroCopyDrains_.clear();
+}
+
+void TNonblockingIOThread::addPoolStats(TNonblockingPoolStats& stats) const {
+  stats.connectionHits += connectionHits_;
+  stats.connectionMisses += connectionMisses_;
+  stats.bufferHits += bufferPool_.getHits();
+  stats.bufferMisses += bufferPool_.getMisses();
+  stats.bufferBytesCached += bufferPool_.getBytesCached();
+}
+
 void TNonblockingIOThread::createNotificationPipe() {
+#ifdef HAVE_SYS_EVENTFD_H
+  // A single eventfd is cheaper than a socket pair and can't fill up
+  int efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (efd >= 0) {
+    notificationPipeFDs_[0] = efd;
+    notificationPipeFDs_[1] = efd;
+    return;
+  }
+  GlobalOutput.perror("TNonblockingServer::createNotificationPipe eventfd ",
+                      THRIFT_GET_SOCKET_ERROR);
+#endif
   if(evutil_socketpair(AF_LOCAL, SOCK_STREAM, 0, notificationPipeFDs_) == -1) {
     GlobalOutput.perror("TNonblockingServer::createNotificationPipe ", EVUTIL_SOCKET_ERROR());
     throw TException("can't create notification pipe");
@@ -1342,6 +2201,11 @@ void TNonblockingIOThread::createNotificationPipe() {
 void TNonblockingIOThread::registerEvents() {
   threadId_ = Thread::get_current();
 
+  if (ioBackend_ == T_IO_BACKEND_EPOLL) {
+    registerEpollEvents();
+    return;
+  }
+
   assert(eventBase_ == 0);
   eventBase_ = getServer()->getUserEventBase();
   if (eventBase_ == NULL) {
@@ -1362,7 +2226,7 @@ void TNonblockingIOThread::registerEvents() {
               listenSocket_,
               EV_READ | EV_PERSIST,
               TNonblockingIOThread::listenHandler,
-              server_);
+              this);
     event_base_set(eventBase_, &serverEvent_);
 
     // Add the event and start up the server
@@ -1395,14 +2259,143 @@ void TNonblockingIOThread::registerEvents() {
                       number_);
 }
 
+/**
+ * Set up the epoll set for T_IO_BACKEND_EPOLL.  The listen and notification
+ * sockets are level-triggered; connection sockets add themselves one-shot and
+ * edge-triggered the first time they want I/O (see TConnection::armEpoll()).
+ */
+void TNonblockingIOThread::registerEpollEvents() {
+#ifdef HAVE_SYS_EPOLL_H
+  assert(epollFD_ < 0);
+  if (getServer()->getUserEventBase() != NULL) {
+    throw TException("TNonblockingServer: a user event base cannot be used "
+                     "with the epoll IO backend");
+  }
+
+  epollFD_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epollFD_ == -1) {
+    GlobalOutput.perror("TNonblockingIOThread::registerEpollEvents() epoll_create1 ",
+                        THRIFT_GET_SOCKET_ERROR);
+    throw TException("TNonblockingServer::serve(): epoll_create1() failed");
+  }
+
+  if (number_ == 0) {
+    GlobalOutput.printf("TNonblockingServer: using native epoll");
+  }
+
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+
+  if (listenSocket_ >= 0) {
+    // Listen events are told apart from connections by their data pointer
+    ev.data.ptr = &listenSocket_;
+    if (-1 == epoll_ctl(epollFD_, EPOLL_CTL_ADD, listenSocket_, &ev)) {
+      throw TException("TNonblockingServer::serve(): "
+                       "epoll_ctl() failed on server listen event");
+    }
+    GlobalOutput.printf("TNonblocking: IO thread #%d registered for listen.",
+                        number_);
+  }
+
+  createNotificationPipe();
+
+  ev.data.ptr = this;
+  if (-1 == epoll_ctl(epollFD_, EPOLL_CTL_ADD, getNotificationRecvFD(), &ev)) {
+    throw TException("TNonblockingServer::serve(): "
+                     "epoll_ctl() failed on task-done notification event");
+  }
+  GlobalOutput.printf("TNonblocking: IO thread #%d registered for notify.",
+                      number_);
+#else
+  throw TException("TNonblockingServer: the epoll IO backend is not "
+                   "available on this platform");
+#endif
+}
+
+void TNonblockingIOThread::runEpollLoop() {
+#ifdef HAVE_SYS_EPOLL_H
+  const int kMaxEvents = 256;
+  struct epoll_event events[kMaxEvents];
+
+  while (!epollLoopBreak_) {
+    int n = epoll_wait(epollFD_, events, kMaxEvents, -1);
+    if (n == -1) {
+      if (THRIFT_GET_SOCKET_ERROR == THRIFT_EINTR) {
+        continue;
+      }
+      GlobalOutput.perror("TNonblockingIOThread::runEpollLoop() epoll_wait ",
+                          THRIFT_GET_SOCKET_ERROR);
+      breakLoop(true);
+    }
+
+    for (int i = 0; i < n; ++i) {
+      void* data = events[i].data.ptr;
+      if (data == this) {
+        notifyHandler(getNotificationRecvFD(), EV_READ, this);
+      } else if (data == &listenSocket_) {
+        server_->handleEvent(listenSocket_, EV_READ, this);
+      } else {
+        static_cast<TNonblockingServer::TConnection*>(data)->epollReady();
+      }
+    }
+
+    // Nothing in this batch refers to these any more
+    for (size_t i = 0; i < closedConnections_.size(); ++i) {
+      server_->returnConnection(closedConnections_[i]);
+    }
+    closedConnections_.clear();
+  }
+#endif
+}
+
+/**
+ * Completed connections are pushed onto a lock-free stack which the IO
+ * thread takes over in one exchange, so a burst of completions costs a
+ * single wakeup rather than a write and a read per connection.  Only the
+ * producer that finds the stack empty has to wake the IO thread: anything
+ * pushed on top of it will be picked up by the same drain.
+ */
 bool TNonblockingIOThread::notify(TNonblockingServer::TConnection* conn) {
+  if (conn != NULL) {
+    TNonblockingServer::TConnection* head = completedHead_;
+    TNonblockingServer::TConnection* seen;
+    for (;;) {
+      conn->setNotifyNext(head);
+      seen = atomicCompareAndSwap(&completedHead_, head, conn);
+      if (seen == head) {
+        break;
+      }
+      head = seen;
+    }
+    if (head != NULL) {
+      return true;
+    }
+  }
+
+  return wakeUp();
+}
+
+bool TNonblockingIOThread::wakeUp() {
   THRIFT_SOCKET fd = getNotificationSendFD();
   if (fd < 0) {
     return false;
   }
 
-  const int kSize = sizeof(conn);
-  if (send(fd, const_cast_sockopt(&conn), kSize, 0) != kSize) {
+  if (fd == getNotificationRecvFD()) {
+#ifdef HAVE_SYS_EVENTFD_H
+    uint64_t one = 1;
+    if (::write(fd, &one, sizeof(one)) != sizeof(one) && errno != EAGAIN) {
+      return false;
+    }
+#endif
+    return true;
+  }
+
+  // If the pipe is full the IO thread has a wakeup pending already
+  char byte = 0;
+  if (send(fd, &byte, 1, 0) != 1 && THRIFT_GET_SOCKET_ERROR != THRIFT_EWOULDBLOCK
+      && THRIFT_GET_SOCKET_ERROR != THRIFT_EAGAIN) {
     return false;
   }
 
@@ -1415,37 +2408,58 @@ void TNonblockingIOThread::notifyHandler(evutil_socket_t fd, short which, void*
   assert(ioThread);
   (void)which;
 
-  while (true) {
-    TNonblockingServer::TConnection* connection = 0;
-    const int kSize = sizeof(connection);
-    long nBytes = recv(fd, cast_sockopt(&connection), kSize, 0);
-    if (nBytes == kSize) {
-      if (connection == NULL) {
-        // this is the command to stop our thread, exit the handler!
-        return;
-      }
-      connection->transition();
-    } else if (nBytes > 0) {
-      // throw away these bytes and hope that next time we get a solid read
-      GlobalOutput.printf("notifyHandler: Bad read of %d bytes, wanted %d",
-                          nBytes, kSize);
+  // Clear the wakeup before taking the queue: a producer that finds the
+  // queue empty after our exchange will wake us again.
+  if (fd == ioThread->getNotificationSendFD()) {
+#ifdef HAVE_SYS_EVENTFD_H
+    uint64_t count;
+    if (::read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+      GlobalOutput.perror(
+        "TNonblocking: notifyHandler read() failed: ", THRIFT_GET_SOCKET_ERROR);
       ioThread->breakLoop(true);
       return;
-    } else if (nBytes == 0) {
-      GlobalOutput.printf("notifyHandler: Notify socket closed!");
-      // exit the loop
-      break;
-    } else { // nBytes < 0
-      if (THRIFT_GET_SOCKET_ERROR != THRIFT_EWOULDBLOCK && THRIFT_GET_SOCKET_ERROR != THRIFT_EAGAIN) {
-          GlobalOutput.perror(
-            "TNonblocking: notifyHandler read() failed: ", THRIFT_GET_SOCKET_ERROR);
-          ioThread->breakLoop(true);
-          return;
+    }
+#endif
+  } else {
+    char buf[256];
+    while (true) {
+      long nBytes = recv(fd, buf, sizeof(buf), 0);
+      if (nBytes > 0) {
+        continue;
+      } else if (nBytes == 0) {
+        GlobalOutput.printf("notifyHandler: Notify socket closed!");
+        break;
+      } else { // nBytes < 0
+        if (THRIFT_GET_SOCKET_ERROR != THRIFT_EWOULDBLOCK && THRIFT_GET_SOCKET_ERROR != THRIFT_EAGAIN) {
+            GlobalOutput.perror(
+              "TNonblocking: notifyHandler read() failed: ", THRIFT_GET_SOCKET_ERROR);
+            ioThread->breakLoop(true);
+            return;
+        }
+        break;
       }
-      // exit the loop
-      break;
     }
   }
+
+  TNonblockingServer::TConnection* head =
+    atomicExchange(&ioThread->completedHead_,
+                   static_cast<TNonblockingServer::TConnection*>(NULL));
+
+  // The stack is newest first; reverse it to complete in arrival order
+  TNonblockingServer::TConnection* connection = NULL;
+  while (head != NULL) {
+    TNonblockingServer::TConnection* next = head->getNotifyNext();
+    head->setNotifyNext(connection);
+    connection = head;
+    head = next;
+  }
+
+  while (connection != NULL) {
+    TNonblockingServer::TConnection* next = connection->getNotifyNext();
+    connection->setNotifyNext(NULL);
+    connection->transition();
+    connection = next;
+  }
 }
 
 void TNonblockingIOThread::breakLoop(bool error) {
@@ -1459,16 +2473,19 @@ void TNonblockingIOThread::breakLoop(bool error) {
   }
 
   // sets a flag so that the loop exits on the next event
-  event_base_loopbreak(eventBase_);
+  if (ioBackend_ == T_IO_BACKEND_EPOLL) {
+    epollLoopBreak_ = true;
+  } else {
+    event_base_loopbreak(eventBase_);
+  }
 
   // event_base_loopbreak() only causes the loop to exit the next time
   // it wakes up.  We need to force it to wake up, in case there are
   // no real events it needs to process.
   //
-  // If we're running in the same thread, we can't use the notify(0)
-  // mechanism to stop the thread, but happily if we're running in the
-  // same thread, this means the thread can't be blocking in the event
-  // loop either.
+  // If we're running in the same thread there's no need for the
+  // notify(0) wakeup: if we're running in the same thread, this means
+  // the thread can't be blocking in the event loop either.
   if (!Thread::is_current(threadId_)) {
     notify(NULL);
   }
@@ -1505,8 +2522,37 @@ void TNonblockingIOThread::setCurrentThreadHighPriority(bool value) {
 #endif
 }
 
+void TNonblockingIOThread::setCpu(int cpu, int numaNode) {
+  cpu_ = cpu;
+  numaNode_ = numaNode;
+}
+
+void TNonblockingIOThread::addTask(boost::shared_ptr<Runnable> task) {
+  if (threadManager_) {
+    threadManager_->add(task, 0LL, server_->getTaskExpireTime());
+  } else {
+    server_->addTask(task);
+  }
+}
+
 void TNonblockingIOThread::run() {
-  if (eventBase_ == NULL)
+  // Pin before anything is allocated, so that memory is first touched on
+  // our own NUMA node.  The first IO thread runs on the caller's thread,
+  // whose affinity is restored on the way out.
+  std::vector<int> savedCpus;
+  bool pinned = false;
+  if (cpu_ >= 0) {
+    Util::getCurrentThreadCpus(savedCpus);
+    pinned = Util::setCurrentThreadCpus(std::vector<int>(1, cpu_));
+    if (pinned) {
+      GlobalOutput.printf("TNonblocking: IO thread #%d pinned to CPU %d",
+                          number_, cpu_);
+    } else {
+      GlobalOutput.perror("TNonblocking: sched_setaffinity(): ", THRIFT_GET_SOCKET_ERROR);
+    }
+  }
+
+  if (eventBase_ == NULL && epollFD_ < 0)
     registerEvents();
 
   GlobalOutput.printf("TNonblockingServer: IO thread #%d entering loop...",
@@ -1516,8 +2562,12 @@ void TNonblockingIOThread::run() {
     setCurrentThreadHighPriority(true);
   }
 
-  // Run libevent engine, never returns, invokes calls to eventHandler
-  event_base_loop(eventBase_, 0);
+  if (ioBackend_ == T_IO_BACKEND_EPOLL) {
+    runEpollLoop();
+  } else {
+    // Run libevent engine, never returns, invokes calls to eventHandler
+    event_base_loop(eventBase_, 0);
+  }
 
   if (useHighPriority_) {
     setCurrentThreadHighPriority(false);
@@ -1526,11 +2576,20 @@ void TNonblockingIOThread::run() {
   // cleans up our registered events
   cleanupEvents();
 
+  if (pinned) {
+    Util::setCurrentThreadCpus(savedCpus);
+  }
+
   GlobalOutput.printf("TNonblockingServer: IO thread #%d run() done!",
     number_);
 }
 
 void TNonblockingIOThread::cleanupEvents() {
+  if (ioBackend_ == T_IO_BACKEND_EPOLL) {
+    // the epoll set goes away with epollFD_
+    return;
+  }
+
   // stop the listen socket, if any
   if (listenSocket_ >= 0) {
     if (event_del(&serverEvent_) == -1) {
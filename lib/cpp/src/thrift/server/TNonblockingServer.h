@@ -21,7 +21,9 @@
 #define _THRIFT_SERVER_TNONBLOCKINGSERVER_H_ 1
 
 #include <thrift/Thrift.h>
+#include <thrift/TArena.h>
 #include <thrift/server/TServer.h>
+#include <thrift/server/TConcurrencyLimiter.h>
 #include <thrift/transport/PlatformSocket.h>
 #include <thrift/transport/TBufferTransports.h>
 #include <thrift/transport/TSocket.h>
@@ -30,6 +32,7 @@
 #include <thrift/concurrency/Thread.h>
 #include <thrift/concurrency/PlatformThreadFactory.h>
 #include <thrift/concurrency/Mutex.h>
+#include <map>
 #include <stack>
 #include <vector>
 #include <string>
@@ -107,6 +110,88 @@ enum TOverloadAction {
   T_OVERLOAD_DRAIN_TASK_QUEUE  ///< Drop some tasks from head of task queue */
 };
 
+/// Readiness notification mechanism used by the IO threads.
+enum TNonblockingIOBackend {
+  T_IO_BACKEND_LIBEVENT,       ///< libevent event_base (default) */
+  T_IO_BACKEND_EPOLL           ///< Native edge-triggered epoll (Linux only) */
+};
+
+/// Counters for the connection and read buffer pools, see getPoolStats().
+struct TNonblockingPoolStats {
+  TNonblockingPoolStats()
+    : connectionHits(0), connectionMisses(0),
+      bufferHits(0), bufferMisses(0), bufferBytesCached(0) {}
+
+  /// Connections reused from an IO thread's cache
+  uint64_t connectionHits;
+
+  /// Connections that had to be allocated
+  uint64_t connectionMisses;
+
+  /// Read buffers taken from a free list
+  uint64_t bufferHits;
+
+  /// Read buffers that needed fresh memory
+  uint64_t bufferMisses;
+
+  /// Bytes currently sitting in the buffer free lists
+  size_t bufferBytesCached;
+};
+
+/**
+ * Size-classed allocator for connection read buffers, one per IO thread.
+ * Requests are rounded up to a power of two between MIN_CLASS_SIZE and
+ * MAX_CLASS_SIZE and served from that class's free list.  Classes up to
+ * MAX_SLAB_CLASS_SIZE are carved out of SLAB_SIZE chunks which are only
+ * freed with the pool; larger classes are malloc'd one at a time and at most
+ * MAX_CACHED_BYTES_PER_CLASS of each is kept.  Anything bigger than
+ * MAX_CLASS_SIZE goes straight to malloc()/free().
+ *
+ * Not thread safe: only the owning IO thread may use it.
+ */
+class TNonblockingBufferPool {
+ public:
+  static const uint32_t MIN_CLASS_SIZE = 256;
+  static const uint32_t MAX_CLASS_SIZE = 1024 * 1024;
+  static const uint32_t MAX_SLAB_CLASS_SIZE = 16 * 1024;
+  static const uint32_t SLAB_SIZE = 64 * 1024;
+  static const size_t MAX_CACHED_BYTES_PER_CLASS = 4 * 1024 * 1024;
+
+  TNonblockingBufferPool();
+  ~TNonblockingBufferPool();
+
+  /**
+   * Get a buffer of at least want bytes.
+   *
+   * @param want the number of bytes needed.
+   * @param size set to the usable size of the returned buffer.
+   * @return the buffer; throws std::bad_alloc if out of memory.
+   */
+  uint8_t* allocate(uint32_t want, uint32_t& size);
+
+  /**
+   * Give back a buffer obtained from allocate().
+   *
+   * @param buffer the buffer, may be NULL.
+   * @param size the size allocate() reported for it.
+   */
+  void release(uint8_t* buffer, uint32_t size);
+
+  uint64_t getHits() const { return hits_; }
+  uint64_t getMisses() const { return misses_; }
+  size_t getBytesCached() const { return bytesCached_; }
+
+ private:
+  /// Index of the smallest class holding size bytes.
+  static uint32_t classIndex(uint32_t size);
+
+  std::vector<std::vector<uint8_t*> > freeLists_;
+  std::vector<uint8_t*> slabs_;
+  uint64_t hits_;
+  uint64_t misses_;
+  size_t bytesCached_;
+};
+
 class TNonblockingIOThread;
 
 class TNonblockingServer : public TServer {
@@ -151,9 +236,27 @@ class TNonblockingServer : public TServer {
   /// Whether to set high scheduling priority for IO threads
   bool useHighPriorityIOThreads_;
 
+  /// CPUs the IO threads are pinned to, round robin; empty for no pinning
+  std::vector<int> ioThreadCpus_;
+
+  /// NUMA node of every CPU (-1 if unknown), filled in when pinning
+  std::vector<int> cpuNodes_;
+
+  /// Workers per NUMA node of the pinned IO threads, 0 for none
+  size_t numaWorkerThreads_;
+
+  /// Thread pools of those workers by NUMA node, started by serve()
+  std::map<int, boost::shared_ptr<ThreadManager> > numaThreadManagers_;
+
+  /// Readiness backend used by the IO threads
+  TNonblockingIOBackend ioBackend_;
+
   /// Server socket file descriptor
   THRIFT_SOCKET serverSocket_;
 
+  /// Whether every IO thread accepts on its own SO_REUSEPORT socket
+  bool reusePort_;
+
   /// Port server runs on
   int port_;
 
@@ -166,6 +269,9 @@ class TNonblockingServer : public TServer {
   /// Is thread pool processing?
   bool threadPoolProcessing_;
 
+  /// Adaptive limit on queued and running tasks, may be NULL
+  boost::shared_ptr<TConcurrencyLimiter> concurrencyLimiter_;
+
   // Factory to create the IO threads
   boost::shared_ptr<PlatformThreadFactory> ioThreadFactory_;
 
@@ -175,16 +281,13 @@ class TNonblockingServer : public TServer {
   // Index of next IO Thread to be used (for round-robin)
   uint32_t nextIOThread_;
 
-  // Synchronizes access to connection stack and similar data
+  // Synchronizes access to the processor count and overload state
   Mutex connMutex_;
 
-  /// Number of TConnection object we've created
-  size_t numTConnections_;
-
   /// Number of Connections processing or waiting to process
   size_t numActiveProcessors_;
 
-  /// Limit for how many TConnection objects to cache
+  /// Limit for how many TConnection objects to cache (over all IO threads)
   size_t connectionStackLimit_;
 
   /// Limit for number of connections processing or waiting to process
@@ -217,15 +320,15 @@ class TNonblockingServer : public TServer {
 
   /**
    * Max read buffer size for an idle TConnection.  When we place an idle
-   * TConnection into connectionStack_ or on every resizeBufferEveryN_ calls,
-   * we will free the buffer (such that it will be reinitialized by the next
-   * received frame) if it has exceeded this limit.  0 disables this check.
+   * TConnection into its IO thread's cache or on every resizeBufferEveryN_ calls,
+   * we will give the buffer back to the pool (such that it will be
+   * reinitialized by the next received frame) if it has exceeded this limit.  0 disables this check.
    */
   size_t idleReadBufferLimit_;
 
   /**
    * Max write buffer size for an idle connection.  When we place an idle
-   * TConnection into connectionStack_ or on every resizeBufferEveryN_ calls,
+   * TConnection into its IO thread's cache or on every resizeBufferEveryN_ calls,
    * we insure that its write buffer is <= to this size; otherwise we
    * replace it with a new one of writeBufferDefaultSize_ bytes to insure that
    * idle connections don't hog memory. 0 disables this check.
@@ -238,6 +341,12 @@ class TNonblockingServer : public TServer {
    */
   int32_t resizeBufferEveryN_;
 
+  /// Responses of at least this many bytes are sent with MSG_ZEROCOPY
+  size_t zeroCopyThreshold_;
+
+  /// Block size of each connection's request arena, 0 for no arena
+  size_t requestArenaBlockSize_;
+
   /// Set if we are currently in an overloaded state.
   bool overloaded_;
 
@@ -247,22 +356,6 @@ class TNonblockingServer : public TServer {
   /// Count of connections dropped on overload since server started
   uint64_t nTotalConnectionsDropped_;
 
-  /**
-   * This is a stack of all the objects that have been created but that
-   * are NOT currently in use. When we close a connection, we place it on this
-   * stack so that the object can be reused later, rather than freeing the
-   * memory and reallocating a new object later.
-   */
-  std::stack<TConnection*> connectionStack_;
-
-  /**
-   * This container holds pointers to all active connections. This container
-   * allows the server to clean up unlcosed connection objects at destruction,
-   * which in turn allows their transports, protocols, processors and handlers
-   * to deallocate and clean up correctly.
-   */
-  std::vector<TConnection*> activeConnections_;
-
   /**
    * Called when server socket had something happen.  We accept all waiting
    * client connections on listen socket fd and assign TConnection objects
@@ -270,18 +363,22 @@ class TNonblockingServer : public TServer {
    *
    * @param fd the listen socket.
    * @param which the event flag that triggered the handler.
+   * @param acceptor the IO thread that owns the listen socket.
    */
-  void handleEvent(THRIFT_SOCKET fd, short which);
+  void handleEvent(THRIFT_SOCKET fd, short which,
+                   TNonblockingIOThread* acceptor);
 
   void init(int port) {
     serverSocket_ = THRIFT_INVALID_SOCKET;
+    reusePort_ = false;
     numIOThreads_ = DEFAULT_IO_THREADS;
     nextIOThread_ = 0;
     useHighPriorityIOThreads_ = false;
+    numaWorkerThreads_ = 0;
+    ioBackend_ = T_IO_BACKEND_LIBEVENT;
     port_ = port;
     userEventBase_ = NULL;
     threadPoolProcessing_ = false;
-    numTConnections_ = 0;
     numActiveProcessors_ = 0;
     connectionStackLimit_ = CONNECTION_STACK_LIMIT;
     maxActiveProcessors_ = MAX_ACTIVE_PROCESSORS;
@@ -294,6 +391,8 @@ class TNonblockingServer : public TServer {
     idleReadBufferLimit_ = IDLE_READ_BUFFER_LIMIT;
     idleWriteBufferLimit_ = IDLE_WRITE_BUFFER_LIMIT;
     resizeBufferEveryN_ = RESIZE_BUFFER_EVERY_N;
+    zeroCopyThreshold_ = 0;
+    requestArenaBlockSize_ = 0;
     overloaded_ = false;
     nConnectionsDropped_ = 0;
     nTotalConnectionsDropped_ = 0;
@@ -403,6 +502,24 @@ class TNonblockingServer : public TServer {
     return threadManager_;
   }
 
+  /**
+   * Sets an adaptive limit on the number of requests queued on or running in
+   * the thread manager.  Requests over the limit are answered from the IO
+   * thread with a TApplicationException, without decoding their arguments;
+   * oneway requests are dropped.  Has no effect without a thread manager.
+   * Set before serve().
+   *
+   * @param limiter the limiter, or NULL to admit every request
+   */
+  void setConcurrencyLimiter(boost::shared_ptr<TConcurrencyLimiter> limiter) {
+    concurrencyLimiter_ = limiter;
+  }
+
+  /// Get the concurrency limiter, for its limit and counters
+  boost::shared_ptr<TConcurrencyLimiter> getConcurrencyLimiter() const {
+    return concurrencyLimiter_;
+  }
+
   /**
    * Sets the number of IO threads used by this server. Can only be used before
    * the call to serve() and has no effect afterwards.  We always use a
@@ -423,11 +540,93 @@ class TNonblockingServer : public TServer {
     useHighPriorityIOThreads_ = val;
   }
 
+  /** Return the CPUs the IO threads are pinned to. */
+  const std::vector<int>& getIOThreadCpus() const {
+    return ioThreadCpus_;
+  }
+
+  /**
+   * Pin IO thread #i to cpus[i % cpus.size()].  Can only be used before the
+   * call to serve() and has no effect afterwards.
+   *
+   * A pinned IO thread carves the read buffers of its connections after it
+   * has been pinned, so they land on its own NUMA node.  The connections
+   * themselves, with their output buffers, are created by the thread that
+   * accepts them, which is IO thread #0 unless setReusePort() is used.  To
+   * keep the workers that run its tasks on its node too, see
+   * setNumaWorkerThreads().  Where thread affinity is not supported this is
+   * ignored.
+   *
+   * @param cpus CPU numbers; empty (the default) disables pinning
+   */
+  void setIOThreadCpus(const std::vector<int>& cpus) {
+    ioThreadCpus_ = cpus;
+  }
+
+  /** Return the number of workers started per NUMA node. */
+  size_t getNumaWorkerThreads() const {
+    return numaWorkerThreads_;
+  }
+
+  /**
+   * With pinned IO threads (see setIOThreadCpus()), start a ThreadManager
+   * of this many workers for each NUMA node they are on, its threads
+   * created restricted to the node's CPUs, and run each connection's tasks
+   * on the pool of its IO thread's node.  Workers are pinned once, when
+   * they are created.  The ThreadManager given to the server still turns on
+   * thread pool processing, and runs the tasks of IO threads whose node is
+   * not known; its threads are left where they are.  Can only be used
+   * before the call to serve() and has no effect afterwards.
+   *
+   * @param numThreads workers per node; 0 (the default) for none
+   */
+  void setNumaWorkerThreads(size_t numThreads) {
+    numaWorkerThreads_ = numThreads;
+  }
+
   /** Return the number of IO threads used by this server. */
   size_t getNumIOThreads() const {
     return numIOThreads_;
   }
 
+  /** Return the readiness backend the IO threads will use. */
+  TNonblockingIOBackend getIOBackend() const {
+    return ioBackend_;
+  }
+
+  /**
+   * Select the readiness backend used by the IO threads.  Can only be used
+   * before the call to serve() and has no effect afterwards.
+   *
+   * T_IO_BACKEND_EPOLL drives connection sockets with one-shot,
+   * edge-triggered epoll registrations: a socket is registered once and
+   * re-armed only when the connection needs more I/O, so a connection
+   * waiting on its handler costs no syscalls at all.  It is only available
+   * where <sys/epoll.h> exists and cannot be combined with a user-provided
+   * event base.
+   */
+  void setIOBackend(TNonblockingIOBackend backend) {
+    ioBackend_ = backend;
+  }
+
+  /** Return whether each IO thread accepts on its own listen socket. */
+  bool getReusePort() const {
+    return reusePort_;
+  }
+
+  /**
+   * Give every IO thread its own listen socket bound to the server port
+   * with SO_REUSEPORT, so the kernel spreads incoming connections over the
+   * IO threads and each thread keeps the connections it accepts.  Without
+   * it IO thread #0 accepts everything and hands connections out round
+   * robin.  Can only be used before the call to serve(), cannot be combined
+   * with a listen socket set up by the caller, and throws from serve() where
+   * SO_REUSEPORT is not available.
+   */
+  void setReusePort(bool reusePort) {
+    reusePort_ = reusePort;
+  }
+
   /**
    * Get the maximum number of unused TConnection we will hold in reserve.
    *
@@ -439,6 +638,7 @@ class TNonblockingServer : public TServer {
 
   /**
    * Set the maximum number of unused TConnection we will hold in reserve.
+   * Each IO thread keeps its own cache and gets an equal share of this.
    *
    * @param sz the new limit for TConnection pool size.
    */
@@ -459,27 +659,30 @@ class TNonblockingServer : public TServer {
    *
    * @return count of connected sockets.
    */
-  size_t getNumConnections() const {
-    return numTConnections_;
-  }
+  size_t getNumConnections() const;
 
   /**
    * Return the count of sockets currently connected to.
    *
    * @return count of connected sockets.
    */
-  size_t getNumActiveConnections() const {
-    return getNumConnections() - getNumIdleConnections();
-  }
+  size_t getNumActiveConnections() const;
 
   /**
    * Return the count of connection objects allocated but not in use.
    *
    * @return count of idle connection objects.
    */
-  size_t getNumIdleConnections() const {
-    return connectionStack_.size();
-  }
+  size_t getNumIdleConnections() const;
+
+  /**
+   * Return the connection and read buffer pool counters, summed over all
+   * IO threads.  The values are read without locking and may be slightly
+   * stale.
+   *
+   * @return the pool counters.
+   */
+  TNonblockingPoolStats getPoolStats() const;
 
   /**
    * Return count of number of connections which are currently processing.
@@ -507,6 +710,26 @@ class TNonblockingServer : public TServer {
     }
   }
 
+  /**
+   * Ask the concurrency limiter, if any, whether a task may be queued.
+   *
+   * @return true if the task may be queued; releaseTask() must then follow.
+   */
+  bool admitTask() {
+    return !concurrencyLimiter_ || concurrencyLimiter_->acquire();
+  }
+
+  /**
+   * Tell the concurrency limiter that an admitted task is done.
+   *
+   * @param queueDelayUsec how long the task was queued, negative if unknown.
+   */
+  void releaseTask(int64_t queueDelayUsec) {
+    if (concurrencyLimiter_) {
+      concurrencyLimiter_->release(queueDelayUsec);
+    }
+  }
+
   /**
    * Get the maximum # of connections allowed before overload.
    *
@@ -746,6 +969,53 @@ class TNonblockingServer : public TServer {
     resizeBufferEveryN_ = count;
   }
 
+  /**
+   * Get the response size from which MSG_ZEROCOPY is used.
+   *
+   * @return the threshold in bytes, 0 if zero-copy sends are disabled.
+   */
+  size_t getZeroCopyThreshold() const {
+    return zeroCopyThreshold_;
+  }
+
+  /**
+   * Send responses of at least this many bytes with MSG_ZEROCOPY, so the
+   * kernel transmits them from the output buffer instead of copying them.
+   * Only available on Linux 4.14 or later, elsewhere (or if the socket
+   * refuses SO_ZEROCOPY) responses are copied as usual.  Pinning the pages
+   * and reading back the completion costs more than copying small
+   * responses, so this only pays off for payloads of tens of KB or more.
+   *
+   * @param threshold size in bytes, or 0 to disable (the default).
+   */
+  void setZeroCopyThreshold(size_t threshold) {
+    zeroCopyThreshold_ = threshold;
+  }
+
+  /**
+   * Get the block size of the per-connection request arenas.
+   *
+   * @return block size in bytes, 0 if requests are not given an arena.
+   */
+  size_t getRequestArenaBlockSize() const {
+    return requestArenaBlockSize_;
+  }
+
+  /**
+   * Give each connection a TArena that is current while the processor runs
+   * and is reset after every call.  Containers in structs generated with
+   * cpp:arena are then allocated by pointer bump and freed all at once,
+   * instead of node by node on the heap.  Handlers must not keep anything
+   * they allocated during the call past its end; wrap such values in a
+   * TArena::Scope(NULL) so they come from the heap.  Debug builds assert
+   * at the reset if anything from the arena is still alive.
+   *
+   * @param size block size in bytes, or 0 to disable (the default).
+   */
+  void setRequestArenaBlockSize(size_t size) {
+    requestArenaBlockSize_ = size;
+  }
+
   /**
    * Main workhorse function, starts up the server listening on a port and
    * loops over the libevent handler.
@@ -785,6 +1055,12 @@ class TNonblockingServer : public TServer {
   event_base* getUserEventBase() const { return userEventBase_; }
 
  private:
+  /// Creates, binds and prepares a listen socket on port_.
+  THRIFT_SOCKET createListenSocket();
+
+  /// Sets the listen options on fd and starts listening, closing it on error.
+  void prepareListenSocket(THRIFT_SOCKET fd);
+
   /**
    * Callback function that the threadmanager calls when a task reaches
    * its expiration time.  It is needed to clean up the expired connection.
@@ -794,9 +1070,9 @@ class TNonblockingServer : public TServer {
   void expireClose(boost::shared_ptr<Runnable> task);
 
   /**
-   * Return an initialized connection object.  Creates or recovers from
-   * pool a TConnection and initializes it with the provided socket FD
-   * and flags.
+   * Return an initialized connection object.  Picks an IO thread, then
+   * creates or recovers from that thread's pool a TConnection and
+   * initializes it with the provided socket FD and flags.
    *
    * @param socket FD of socket associated with this connection.
    * @param addr the sockaddr of the client
@@ -807,9 +1083,8 @@ class TNonblockingServer : public TServer {
                                             socklen_t addrLen);
 
   /**
-   * Returns a connection to pool or deletion.  If the connection pool
-   * (a stack) isn't full, place the connection object on it, otherwise
-   * just delete it.
+   * Returns a connection to its IO thread's pool or deletion.  If the pool
+   * isn't full, place the connection object on it, otherwise just delete it.
    *
    * @param connection the TConection being returned.
    */
@@ -831,17 +1106,85 @@ class TNonblockingIOThread : public Runnable {
   // Returns the event-base for this thread.
   event_base* getEventBase() const { return eventBase_; }
 
+  // Returns the readiness backend used by this thread.
+  TNonblockingIOBackend getIOBackend() const { return ioBackend_; }
+
+  // Returns the epoll descriptor (T_IO_BACKEND_EPOLL only, else -1).
+  int getEpollFD() const { return epollFD_; }
+
+  // Hands a connection closed inside an epoll dispatch back to the server
+  // once the current batch of events has been processed.
+  void deferReturnConnection(TNonblockingServer::TConnection* conn) {
+    closedConnections_.push_back(conn);
+  }
+
   // Returns the server for this thread.
   TNonblockingServer* getServer() const { return server_; }
 
+  // Takes a TConnection from this thread's cache, or allocates one, and
+  // adds it to the thread's active connections.
+  TNonblockingServer::TConnection* createConnection(THRIFT_SOCKET socket,
+                                                    const sockaddr* addr,
+                                                    socklen_t addrLen);
+
+  // Removes a closed connection from the active ones and caches it, or
+  // deletes it if the cache is full.
+  void returnConnection(TNonblockingServer::TConnection* connection);
+
+  // Closes all active connections and deletes the cached ones.  The thread
+  // must not be running.
+  void destroyConnections();
+
+  // Response buffers of a closed connection that MSG_ZEROCOPY sends may
+  // still be reading, kept with a duplicate of its socket until the kernel
+  // reports them complete.
+  class ZeroCopyDrain;
+
+  // Takes ownership of drain, and frees it once its sends complete.
+  void addZeroCopyDrain(ZeroCopyDrain* drain);
+
+  // Returns the number of closed connections still draining.
+  size_t getNumZeroCopyDrains() const { return zeroCopyDrains_.size(); }
+
+  // Returns the number of TConnection objects owned by this thread.
+  size_t getNumConnections() const { return numConnections_; }
+
+  // Returns the number of cached, unused TConnection objects.
+  size_t getNumIdleConnections() const { return connectionCache_.size(); }
+
+  // Adds this thread's pool counters to stats.
+  void addPoolStats(TNonblockingPoolStats& stats) const;
+
+  // Returns the read buffer pool; only for use on this thread.
+  TNonblockingBufferPool* getBufferPool() { return &bufferPool_; }
+
   // Returns the number of this IO thread.
   int getThreadNumber() const { return number_; }
 
+  // Pins this thread to cpu, of NUMA node numaNode (-1 if unknown), once it
+  // runs.
+  void setCpu(int cpu, int numaNode);
+
+  // Returns the NUMA node of this thread's CPU, or -1.
+  int getNumaNode() const { return numaNode_; }
+
+  // Runs this thread's tasks on threadManager rather than the server's.
+  void setThreadManager(boost::shared_ptr<ThreadManager> threadManager) {
+    threadManager_ = threadManager;
+  }
+
+  // Queues a task for one of this thread's connections.
+  void addTask(boost::shared_ptr<Runnable> task);
+
+  // Returns the socket this thread accepts on, if any.
+  THRIFT_SOCKET getListenSocket() const { return listenSocket_; }
+
   // Returns the thread id associated with this object.  This should
   // only be called after the thread has been started.
   Thread::id_t getThreadId() const { return threadId_; }
 
-  // Returns the send-fd for task complete notifications.
+  // Returns the send-fd for task complete notifications.  (With eventfd
+  // this is the same descriptor as the read-fd.)
   evutil_socket_t getNotificationSendFD() const { return notificationPipeFDs_[1]; }
 
   // Returns the read-fd for task complete notifications.
@@ -854,6 +1197,8 @@ class TNonblockingIOThread : public Runnable {
   void setThread(const boost::shared_ptr<Thread>& t) { thread_ = t; }
 
   // Used by TConnection objects to indicate processing has finished.
+  // Queues the connection and wakes the IO thread if the queue was empty;
+  // notify(NULL) only wakes it.  Safe to call from any thread.
   bool notify(TNonblockingServer::TConnection* conn);
 
   // Enters the event loop and does not return until a call to stop().
@@ -871,9 +1216,9 @@ class TNonblockingIOThread : public Runnable {
  private:
   /**
    * C-callable event handler for signaling task completion.  Provides a
-   * callback that libevent can understand that will read a connection
-   * object's address from a pipe and call connection->transition() for
-   * that object.
+   * callback that libevent can understand that will clear the wakeup,
+   * take every connection queued by notify() and call
+   * connection->transition() for each in the order they were queued.
    *
    * @param fd the descriptor the event occurred on.
    */
@@ -885,18 +1230,28 @@ class TNonblockingIOThread : public Runnable {
    *
    * @param fd the descriptor the event occured on.
    * @param which the flags associated with the event.
-   * @param v void* callback arg where we placed TNonblockingServer's "this".
+   * @param v void* callback arg where we placed TNonblockingIOThread's "this".
    */
   static void listenHandler(evutil_socket_t fd, short which, void* v) {
-    ((TNonblockingServer*)v)->handleEvent(fd, which);
+    TNonblockingIOThread* ioThread = static_cast<TNonblockingIOThread*>(v);
+    ioThread->server_->handleEvent(fd, which, ioThread);
   }
 
   /// Exits the loop ASAP in case of shutdown or error.
   void breakLoop(bool error);
 
-  /// Create the pipe used to notify I/O process of task completion.
+  /// Create the eventfd (or pipe) used to wake the I/O thread.
   void createNotificationPipe();
 
+  /// Makes the notification descriptor readable.
+  bool wakeUp();
+
+  /// Registers the notification & listen sockets with a new epoll set.
+  void registerEpollEvents();
+
+  /// Runs the epoll dispatch loop until breakLoop() is called.
+  void runEpollLoop();
+
   /// Unregisters our events for notification and listen sockets.
   void cleanupEvents();
 
@@ -919,6 +1274,27 @@ class TNonblockingIOThread : public Runnable {
   /// Sets a high scheduling priority when running
   bool useHighPriority_;
 
+  /// CPU to pin to when running, or -1
+  int cpu_;
+
+  /// NUMA node of cpu_, or -1
+  int numaNode_;
+
+  /// Workers on numaNode_ for our tasks, or null for the server's
+  boost::shared_ptr<ThreadManager> threadManager_;
+
+  /// Readiness backend, copied from the server at construction
+  TNonblockingIOBackend ioBackend_;
+
+  /// epoll descriptor when using T_IO_BACKEND_EPOLL
+  int epollFD_;
+
+  /// Set by breakLoop() to make the epoll loop exit on its next wakeup
+  volatile bool epollLoopBreak_;
+
+  /// Connections closed during the current epoll batch, returned afterwards
+  std::vector<TNonblockingServer::TConnection*> closedConnections_;
+
   /// pointer to eventbase to be used for looping
   event_base* eventBase_;
 
@@ -935,6 +1311,36 @@ class TNonblockingIOThread : public Runnable {
  /// File descriptors for pipe used for task completion notification.
   evutil_socket_t notificationPipeFDs_[2];
 
+  /// Guards connectionCache_, activeConnections_, zeroCopyDrains_ and the
+  /// connection counters
+  Mutex connMutex_;
+
+  /// Closed connections available for reuse
+  std::vector<TNonblockingServer::TConnection*> connectionCache_;
+
+  /// Connections in use; each one knows its index for O(1) removal
+  std::vector<TNonblockingServer::TConnection*> activeConnections_;
+
+  /// Closed connections whose zero-copy sends have not completed
+  std::vector<ZeroCopyDrain*> zeroCopyDrains_;
+
+  // Frees the drains whose sends have completed; connMutex_ must be held.
+  void reapZeroCopyDrains();
+
+  /// Number of TConnection objects we've created and not deleted
+  size_t numConnections_;
+
+  /// Connection cache hits and misses
+  uint64_t connectionHits_;
+  uint64_t connectionMisses_;
+
+  /// Read buffers for our connections
+  TNonblockingBufferPool bufferPool_;
+
+  /// Connections whose tasks completed, most recent first.  Pushed with a
+  /// compare-and-swap by any thread, taken all at once by this one.
+  TNonblockingServer::TConnection* volatile completedHead_;
+
   /// Actual IO Thread
   boost::shared_ptr<Thread> thread_;
 };
@@ -19,6 +19,7 @@
 
 #include <cassert>
 #include <algorithm>
+#include <limits>
 
 #include <thrift/transport/TBufferTransports.h>
 
@@ -223,6 +224,27 @@ void TFramedTransport::writeSlow(const uint8_t* buf, uint32_t len) {
   while (new_size < len + have) {
     new_size = new_size > 0 ? new_size * 2 : 1;
   }
+  resizeWriteBuffer(new_size);
+
+  // Copy the data into the new buffer.
+  memcpy(wBase_, buf, len);
+  wBase_ += len;
+}
+
+void TFramedTransport::reserveWrite(uint32_t len) {
+  if (len <= static_cast<uint32_t>(wBound_ - wBase_)) {
+    return;
+  }
+  uint32_t have = static_cast<uint32_t>(wBase_ - wBuf_.get());
+  if (len + have < have /* overflow */ || len + have > 0x7fffffff) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+        "Attempted to write over 2 GB to TFramedTransport.");
+  }
+  resizeWriteBuffer(len + have);
+}
+
+void TFramedTransport::resizeWriteBuffer(uint32_t new_size) {
+  uint32_t have = static_cast<uint32_t>(wBase_ - wBuf_.get());
 
   // TODO(dreiss): Consider modifying this class to use malloc/free
   // so we can use realloc here.
@@ -238,10 +260,6 @@ void TFramedTransport::writeSlow(const uint8_t* buf, uint32_t len) {
   wBufSize_ = new_size;
   wBase_ = wBuf_.get() + have;
   wBound_ = wBuf_.get() + wBufSize_;
-
-  // Copy the data into the new buffer.
-  memcpy(wBase_, buf, len);
-  wBase_ += len;
 }
 
 void TFramedTransport::flush()  {
@@ -365,7 +383,22 @@ void TMemoryBuffer::ensureCanWrite(uint32_t len) {
     new_size = new_size > 0 ? new_size * 2 : 1;
     avail = available_write() + (new_size - bufferSize_);
   }
+  resizeBuffer(new_size);
+}
+
+void TMemoryBuffer::reserveWrite(uint32_t len) {
+  uint32_t avail = available_write();
+  if (len <= avail || !owner_) {
+    return;
+  }
+  if (len - avail > std::numeric_limits<uint32_t>::max() - bufferSize_) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "Attempted to reserve over 4 GB in TMemoryBuffer.");
+  }
+  resizeBuffer(bufferSize_ + (len - avail));
+}
 
+void TMemoryBuffer::resizeBuffer(uint32_t new_size) {
   // Allocate into a new pointer so we don't bork ours if it fails.
   void* new_buffer = std::realloc(buffer_, new_size);
   if (new_buffer == NULL) {
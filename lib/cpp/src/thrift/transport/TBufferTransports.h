@@ -379,6 +379,12 @@ class TFramedTransport
 
   uint32_t writeEnd();
 
+  /**
+   * Grows the frame buffer to exactly what the frame so far plus len needs,
+   * if it is not big enough already.
+   */
+  void reserveWrite(uint32_t len);
+
   const uint8_t* borrowSlow(uint8_t* buf, uint32_t* len);
 
   boost::shared_ptr<TTransport> getUnderlyingTransport() {
@@ -402,6 +408,9 @@ class TFramedTransport
    */
   bool readFrame();
 
+  // Moves the frame written so far into a new buffer of the given size.
+  void resizeWriteBuffer(uint32_t new_size);
+
   void initPointers() {
     setReadBuffer(NULL, 0);
     setWriteBuffer(wBuf_.get(), wBufSize_);
@@ -687,6 +696,10 @@ class TMemoryBuffer : public TVirtualTransport<TMemoryBuffer, TBufferBase> {
   // that had been provided by getWritePtr().
   void wroteBytes(uint32_t len);
 
+  // Grows an owned buffer to exactly what is needed for 'len' more bytes,
+  // rather than doubling, if it does not have room for them already.
+  void reserveWrite(uint32_t len);
+
   /*
    * TVirtualTransport provides a default implementation of readAll().
    * We want to use the TBufferBase version instead.
@@ -712,6 +725,9 @@ class TMemoryBuffer : public TVirtualTransport<TMemoryBuffer, TBufferBase> {
   // Make sure there's at least 'len' bytes available for writing.
   void ensureCanWrite(uint32_t len);
 
+  // Reallocate the buffer to new_size, keeping its contents.
+  void resizeBuffer(uint32_t new_size);
+
   // Compute the position and available data for reading.
   void computeRead(uint32_t len, uint8_t** out_start, uint32_t* out_give);
 
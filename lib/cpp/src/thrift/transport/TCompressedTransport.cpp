@@ -0,0 +1,198 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <cassert>
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#include <thrift/transport/TCompressedTransport.h>
+
+namespace apache { namespace thrift { namespace transport {
+
+uint32_t TCompressedTransport::readSlow(uint8_t* buf, uint32_t len) {
+  uint32_t want = len;
+  uint32_t have = static_cast<uint32_t>(rBound_ - rBase_);
+
+  // We should only take the slow path if we can't satisfy the read
+  // with the data already in the buffer.
+  assert(have < want);
+
+  // If we have some data in the buffer, copy it out and return it.
+  // We have to return it without attempting to read more, since we aren't
+  // guaranteed that the underlying transport actually has more data, so
+  // attempting to read from it could block.
+  if (have > 0) {
+    memcpy(buf, rBase_, have);
+    setReadBuffer(rBuf_.get(), 0);
+    return have;
+  }
+
+  // Read another block.
+  if (!readBlock()) {
+    // EOF.  No block available.
+    return 0;
+  }
+
+  // Hand over whatever we have.
+  uint32_t give = (std::min)(want, static_cast<uint32_t>(rBound_ - rBase_));
+  memcpy(buf, rBase_, give);
+  rBase_ += give;
+  want -= give;
+
+  return (len - want);
+}
+
+bool TCompressedTransport::readBlock() {
+  // Read the header of the next block.  As with TFramedTransport, EOF is
+  // only an error after part of it.
+  uint8_t header[HEADER_SIZE];
+  uint32_t header_bytes_read = 0;
+  while (header_bytes_read < HEADER_SIZE) {
+    uint32_t bytes_read = transport_->read(header + header_bytes_read,
+                                           HEADER_SIZE - header_bytes_read);
+    if (bytes_read == 0) {
+      if (header_bytes_read == 0) {
+        // EOF before any data was read.
+        return false;
+      } else {
+        // EOF after a partial block header.  Raise an exception.
+        throw TTransportException(TTransportException::END_OF_FILE,
+                                  "No more data to read after "
+                                  "partial block header.");
+      }
+    }
+    header_bytes_read += bytes_read;
+  }
+
+  uint8_t codecId = header[0];
+  uint32_t size;
+  uint32_t compressedSize;
+  memcpy(&size, header + 1, sizeof(size));
+  memcpy(&compressedSize, header + 5, sizeof(compressedSize));
+  size = ntohl(size);
+  compressedSize = ntohl(compressedSize);
+
+  if (size > maxBlockSize_ || compressedSize > maxBlockSize_) {
+    throw TTransportException(TTransportException::CORRUPTED_DATA,
+                              "Compressed block is larger than the maximum block size");
+  }
+  if (size > rBufSize_) {
+    rBuf_.reset(new uint8_t[size]);
+    rBufSize_ = size;
+  }
+
+  if (codecId == TCompressionCodec::CODEC_NONE) {
+    if (compressedSize != size) {
+      throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                "Stored block sizes do not match");
+    }
+    transport_->readAll(rBuf_.get(), size);
+  } else {
+    if (!codec_ || codecId != codec_->getId()) {
+      std::ostringstream msg;
+      msg << "Block compressed with codec " << static_cast<int>(codecId)
+          << ", which this transport does not have";
+      throw TTransportException(TTransportException::CORRUPTED_DATA, msg.str());
+    }
+    reserveCompressed(compressedSize);
+    transport_->readAll(cBuf_.get(), compressedSize);
+    codec_->decompress(cBuf_.get(), compressedSize, rBuf_.get(), size);
+  }
+
+  setReadBuffer(rBuf_.get(), size);
+  return true;
+}
+
+void TCompressedTransport::writeSlow(const uint8_t* buf, uint32_t len) {
+  // Double buffer size until sufficient.
+  uint32_t have = static_cast<uint32_t>(wBase_ - wBuf_.get());
+  uint32_t new_size = wBufSize_;
+  if (len + have < have /* overflow */ || len + have > 0x7fffffff) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+        "Attempted to write over 2 GB to TCompressedTransport.");
+  }
+  while (new_size < len + have) {
+    new_size = new_size > 0 ? new_size * 2 : 1;
+  }
+
+  // Allocate new buffer, and copy the block so far to it.
+  uint8_t* new_buf = new uint8_t[new_size];
+  memcpy(new_buf, wBuf_.get(), have);
+  wBuf_.reset(new_buf);
+  wBufSize_ = new_size;
+  wBase_ = wBuf_.get() + have;
+  wBound_ = wBuf_.get() + wBufSize_;
+
+  // Copy the data into the new buffer.
+  memcpy(wBase_, buf, len);
+  wBase_ += len;
+}
+
+void TCompressedTransport::reserveCompressed(uint32_t len) {
+  if (len > cBufSize_) {
+    cBuf_.reset(new uint8_t[len]);
+    cBufSize_ = len;
+  }
+}
+
+void TCompressedTransport::flush() {
+  uint8_t* data = wBuf_.get() + HEADER_SIZE;
+  uint32_t size = static_cast<uint32_t>(wBase_ - data);
+
+  if (size > 0) {
+    // Reset wBase_ before the underlying write, so that the buffer is in a
+    // sane state if it throws, as TFramedTransport does
+    wBase_ = data;
+
+    // Stored blocks are written from in front of the data, compressed ones
+    // from the compression buffer
+    uint8_t* block = wBuf_.get();
+    uint32_t blockSize = size;
+    uint8_t codecId = TCompressionCodec::CODEC_NONE;
+    if (codec_ && size >= minCompressSize_) {
+      reserveCompressed(HEADER_SIZE + codec_->compressBound(size));
+      uint32_t compressedSize = codec_->compress(data, size, cBuf_.get() + HEADER_SIZE);
+      if (compressedSize < size) {
+        block = cBuf_.get();
+        blockSize = compressedSize;
+        codecId = codec_->getId();
+      }
+    }
+
+    uint32_t size_nbo = htonl(size);
+    uint32_t blockSize_nbo = htonl(blockSize);
+    block[0] = codecId;
+    memcpy(block + 1, &size_nbo, sizeof(size_nbo));
+    memcpy(block + 5, &blockSize_nbo, sizeof(blockSize_nbo));
+    transport_->write(block, HEADER_SIZE + blockSize);
+  }
+
+  // Flush the underlying transport.
+  transport_->flush();
+}
+
+const uint8_t* TCompressedTransport::borrowSlow(uint8_t* buf, uint32_t* len) {
+  (void) buf;
+  (void) len;
+  // As with TFramedTransport, borrows do not cross blocks
+  return NULL;
+}
+
+}}} // apache::thrift::transport
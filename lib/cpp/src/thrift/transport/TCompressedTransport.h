@@ -0,0 +1,271 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_TCOMPRESSEDTRANSPORT_H_
+#define _THRIFT_TRANSPORT_TCOMPRESSEDTRANSPORT_H_ 1
+
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/cxxfunctional.h>
+
+#include <string>
+#include <boost/scoped_array.hpp>
+
+namespace apache { namespace thrift { namespace transport {
+
+/**
+ * A block compression algorithm for TCompressedTransport.
+ *
+ * Codecs keep their compression state from block to block, so an instance
+ * must not be used by more than one thread at a time.  Both ends of a
+ * connection must use the same codec, with the same dictionary if any.
+ */
+class TCompressionCodec {
+ public:
+  /**
+   * Ids that blocks are tagged with.  Ids up to 127 are reserved for codecs
+   * that come with Thrift.
+   */
+  enum {
+    CODEC_NONE = 0,
+    CODEC_LZ4 = 1,
+    CODEC_ZSTD = 2
+  };
+
+  virtual ~TCompressionCodec() {}
+
+  /// Id of the blocks this codec compresses
+  virtual uint8_t getId() const = 0;
+
+  virtual const char* getName() const = 0;
+
+  /// Most bytes that compressing len bytes can take
+  virtual uint32_t compressBound(uint32_t len) = 0;
+
+  /**
+   * Compresses len bytes of in into out, which holds compressBound(len)
+   * bytes.
+   *
+   * @return the compressed size
+   */
+  virtual uint32_t compress(const uint8_t* in, uint32_t len, uint8_t* out) = 0;
+
+  /**
+   * Decompresses len bytes of in into out, which they must fill exactly.
+   *
+   * @throws TTransportException CORRUPTED_DATA if they do not
+   */
+  virtual void decompress(const uint8_t* in, uint32_t len, uint8_t* out, uint32_t outLen) = 0;
+};
+
+/**
+ * Compresses the data written between flush() calls as one block, which is
+ * sent framed with the id of its codec and its sizes.  Each block is
+ * compressed independently, so for RPC, where a message is flushed at a
+ * time, every message is a block.  Blocks smaller than the minimum
+ * compression size, and blocks that do not compress, are sent as they are.
+ *
+ * The frame is a byte of codec id, followed by the uncompressed and the
+ * compressed sizes in four bytes each, in network order.
+ */
+class TCompressedTransport
+  : public TVirtualTransport<TCompressedTransport, TBufferBase> {
+ public:
+  static const uint32_t HEADER_SIZE = 9;
+  static const uint32_t DEFAULT_BUFFER_SIZE = 512;
+  static const uint32_t DEFAULT_MIN_COMPRESS_SIZE = 128;
+  static const uint32_t DEFAULT_MAX_BLOCK_SIZE = 256 * 1024 * 1024;
+
+  /**
+   * @param transport the transport to read and write blocks through
+   * @param codec compresses the blocks written, and decompresses those read;
+   *              blocks are only stored if it is null
+   * @param minCompressSize blocks smaller than this are stored
+   */
+  TCompressedTransport(boost::shared_ptr<TTransport> transport,
+                       boost::shared_ptr<TCompressionCodec> codec,
+                       uint32_t minCompressSize = DEFAULT_MIN_COMPRESS_SIZE)
+    : transport_(transport)
+    , codec_(codec)
+    , minCompressSize_(minCompressSize)
+    , maxBlockSize_(DEFAULT_MAX_BLOCK_SIZE)
+    , rBufSize_(0)
+    , wBufSize_(DEFAULT_BUFFER_SIZE)
+    , cBufSize_(0)
+    , rBuf_()
+    , wBuf_(new uint8_t[wBufSize_])
+    , cBuf_()
+  {
+    initPointers();
+  }
+
+  void open() {
+    transport_->open();
+  }
+
+  bool isOpen() {
+    return transport_->isOpen();
+  }
+
+  bool peek() {
+    return (rBase_ < rBound_) || transport_->peek();
+  }
+
+  void close() {
+    flush();
+    transport_->close();
+  }
+
+  uint32_t readSlow(uint8_t* buf, uint32_t len);
+
+  void writeSlow(const uint8_t* buf, uint32_t len);
+
+  void flush();
+
+  const uint8_t* borrowSlow(uint8_t* buf, uint32_t* len);
+
+  /*
+   * TVirtualTransport provides a default implementation of readAll().
+   * We want to use the TBufferBase version instead.
+   */
+  uint32_t readAll(uint8_t* buf, uint32_t len) {
+    return TBufferBase::readAll(buf, len);
+  }
+
+  boost::shared_ptr<TTransport> getUnderlyingTransport() {
+    return transport_;
+  }
+
+  boost::shared_ptr<TCompressionCodec> getCodec() {
+    return codec_;
+  }
+
+  void setMinCompressSize(uint32_t minCompressSize) {
+    minCompressSize_ = minCompressSize;
+  }
+  uint32_t getMinCompressSize() {
+    return minCompressSize_;
+  }
+
+  /**
+   * Sets the largest uncompressed block that will be read, so that a bad
+   * frame cannot make the transport allocate without bound.
+   */
+  void setMaxBlockSize(uint32_t maxBlockSize) {
+    if (maxBlockSize) {
+      maxBlockSize_ = maxBlockSize;
+    }
+  }
+  uint32_t getMaxBlockSize() {
+    return maxBlockSize_;
+  }
+
+ protected:
+  /**
+   * Reads and decompresses a block from the underlying transport.
+   *
+   * Returns true if a block was read, or false on EOF before any of one.
+   */
+  bool readBlock();
+
+  // Makes room for len more bytes in the given buffer
+  void reserveCompressed(uint32_t len);
+
+  void initPointers() {
+    setReadBuffer(NULL, 0);
+    setWriteBuffer(wBuf_.get(), wBufSize_);
+
+    // Leave room to write the header in front of a stored block
+    wBase_ += HEADER_SIZE;
+  }
+
+  boost::shared_ptr<TTransport> transport_;
+  boost::shared_ptr<TCompressionCodec> codec_;
+  uint32_t minCompressSize_;
+  uint32_t maxBlockSize_;
+
+  uint32_t rBufSize_;
+  uint32_t wBufSize_;
+  uint32_t cBufSize_;
+  boost::scoped_array<uint8_t> rBuf_;
+  boost::scoped_array<uint8_t> wBuf_;
+
+  // compressed blocks, as written or read
+  boost::scoped_array<uint8_t> cBuf_;
+};
+
+/**
+ * Wraps transports into compressed ones.  Each gets a codec of its own, as
+ * codecs keep state.
+ */
+template <class Codec_>
+class TCompressedTransportFactory : public TTransportFactory {
+ public:
+  /// Makes a new codec for each transport
+  typedef apache::thrift::stdcxx::function<
+    boost::shared_ptr<TCompressionCodec>()> codec_func_t;
+
+  /// Gives each transport a default-constructed Codec_
+  TCompressedTransportFactory(
+      uint32_t minCompressSize = TCompressedTransport::DEFAULT_MIN_COMPRESS_SIZE)
+    : makeCodec_(&TCompressedTransportFactory::newCodec),
+      minCompressSize_(minCompressSize) {}
+
+  /**
+   * Gives each transport a Codec_(param, dictionary).  For the codecs that
+   * come with Thrift param is the level or acceleration.
+   */
+  TCompressedTransportFactory(
+      int param,
+      const std::string& dictionary,
+      uint32_t minCompressSize = TCompressedTransport::DEFAULT_MIN_COMPRESS_SIZE)
+    : makeCodec_(apache::thrift::stdcxx::bind(
+                   &TCompressedTransportFactory::newCodecWith, param, dictionary)),
+      minCompressSize_(minCompressSize) {}
+
+  /// Gives each transport a codec made by makeCodec, for any other setup
+  TCompressedTransportFactory(
+      const codec_func_t& makeCodec,
+      uint32_t minCompressSize = TCompressedTransport::DEFAULT_MIN_COMPRESS_SIZE)
+    : makeCodec_(makeCodec),
+      minCompressSize_(minCompressSize) {}
+
+  virtual ~TCompressedTransportFactory() {}
+
+  virtual boost::shared_ptr<TTransport> getTransport(boost::shared_ptr<TTransport> trans) {
+    return boost::shared_ptr<TTransport>(
+        new TCompressedTransport(trans, makeCodec_(), minCompressSize_));
+  }
+
+ private:
+  static boost::shared_ptr<TCompressionCodec> newCodec() {
+    return boost::shared_ptr<TCompressionCodec>(new Codec_());
+  }
+
+  static boost::shared_ptr<TCompressionCodec> newCodecWith(int param,
+                                                           const std::string& dictionary) {
+    return boost::shared_ptr<TCompressionCodec>(new Codec_(param, dictionary));
+  }
+
+  codec_func_t makeCodec_;
+  uint32_t minCompressSize_;
+};
+
+}}} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_TCOMPRESSEDTRANSPORT_H_
@@ -22,7 +22,9 @@
 #include <thrift/transport/TFileTransport.h>
 #include <thrift/transport/TTransportUtils.h>
 #include <thrift/transport/PlatformSocket.h>
+#include <thrift/concurrency/Atomic.h>
 #include <thrift/concurrency/FunctionRunner.h>
+#include <thrift/concurrency/Util.h>
 
 #ifdef HAVE_SYS_TIME_H
 #include <sys/time.h>
@@ -36,13 +38,19 @@
 #ifdef HAVE_STRINGS_H
 #include <strings.h>
 #endif
+#include <algorithm>
+#include <cassert>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
 #include <iostream>
 #include <limits>
 #ifdef HAVE_SYS_STAT_H
 #include <sys/stat.h>
 #endif
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
 
 #ifdef _WIN32
 #include <io.h>
@@ -56,6 +64,67 @@ using namespace std;
 using namespace apache::thrift::protocol;
 using namespace apache::thrift::concurrency;
 
+namespace {
+
+// Most events the writer thread writes at once in group commit mode
+const size_t GROUP_COMMIT_MAX_BATCH = 256;
+
+// Group commit tickets wrap around, so they are compared by difference
+long nextTicket(long ticket) {
+  return static_cast<long>(static_cast<unsigned long>(ticket) + 1);
+}
+
+// How much processParallel() reads from the file at once
+const uint32_t REPLAY_READ_SIZE = 64 * 1024;
+
+// Key order lanes per worker, so that a busy key holds up few others
+const size_t REPLAY_LANES_PER_WORKER = 4;
+
+bool ticketBefore(long a, long b) {
+  return static_cast<long>(static_cast<unsigned long>(a) - static_cast<unsigned long>(b)) < 0;
+}
+
+// Writes out count whole events, with one writev() where there is one
+bool writeEvents(int fd, eventInfo* const* events, size_t count) {
+#ifdef HAVE_SYS_UIO_H
+  struct iovec iov[GROUP_COMMIT_MAX_BATCH];
+  assert(count <= GROUP_COMMIT_MAX_BATCH);
+  for (size_t i = 0; i < count; ++i) {
+    iov[i].iov_base = events[i]->eventBuff_;
+    iov[i].iov_len = events[i]->eventSize_;
+  }
+  struct iovec* next = iov;
+  int left = static_cast<int>(count);
+  while (left > 0) {
+    ssize_t written = ::writev(fd, next, left);
+    if (written < 0) {
+      if (THRIFT_ERRNO == THRIFT_EINTR) {
+        continue;
+      }
+      return false;
+    }
+    while (left > 0 && static_cast<size_t>(written) >= next->iov_len) {
+      written -= next->iov_len;
+      ++next;
+      --left;
+    }
+    if (left > 0) {
+      next->iov_base = static_cast<uint8_t*>(next->iov_base) + written;
+      next->iov_len -= written;
+    }
+  }
+#else
+  for (size_t i = 0; i < count; ++i) {
+    if (-1 == ::THRIFT_WRITE(fd, events[i]->eventBuff_, events[i]->eventSize_)) {
+      return false;
+    }
+  }
+#endif
+  return true;
+}
+
+}
+
 TFileTransport::TFileTransport(string path, bool readOnly)
   : readState_()
   , readBuff_(NULL)
@@ -78,6 +147,17 @@ TFileTransport::TFileTransport(string path, bool readOnly)
   , closing_(false)
   , flushed_(&mutex_)
   , forceFlush_(false)
+  , groupCommit_(false)
+  , ring_(NULL)
+  , ringMask_(0)
+  , enqueueTicket_(0)
+  , writerIdle_(0)
+  , fullWaiters_(0)
+  , flushTicket_(0)
+  , syncedTicket_(0)
+  , syncMode_(SYNC_FSYNC)
+  , preallocatedTo_(0)
+  , preallocate_(true)
   , filename_(path)
   , fd_(0)
   , bufferAndThreadInitialized_(false)
@@ -93,6 +173,7 @@ TFileTransport::TFileTransport(string path, bool readOnly)
 void TFileTransport::resetOutputFile(int fd, string filename, off_t offset) {
   filename_ = filename;
   offset_ = offset;
+  preallocatedTo_ = 0;
 
   // check if current file is still open
   if (fd_ > 0) {
@@ -121,12 +202,16 @@ void TFileTransport::resetOutputFile(int fd, string filename, off_t offset) {
 TFileTransport::~TFileTransport() {
   // flush the buffer if a writer thread is active
   if(writerThread_.get()) {
-    // set state to closing
-    closing_ = true;
+    {
+      Guard g(mutex_);
 
-    // wake up the writer thread
-    // Since closing_ is true, it will attempt to flush all data, then exit.
-    notEmpty_.notify();
+      // set state to closing
+      closing_ = true;
+
+      // wake up the writer thread
+      // Since closing_ is true, it will attempt to flush all data, then exit.
+      notEmpty_.notify();
+    }
 
     writerThread_->join();
     writerThread_.reset();
@@ -142,6 +227,15 @@ TFileTransport::~TFileTransport() {
     enqueueBuffer_ = NULL;
   }
 
+  if (ring_) {
+    // events left behind if the writer thread gave up on an IO error
+    for (unsigned long i = 0; i <= ringMask_; ++i) {
+      delete ring_[i].event;
+    }
+    delete[] ring_;
+    ring_ = NULL;
+  }
+
   if (readBuff_) {
     delete[] readBuff_;
     readBuff_ = NULL;
@@ -169,14 +263,32 @@ bool TFileTransport::initBufferAndWriteThread() {
     return false;
   }
 
+  if (groupCommit_) {
+    // The writer thread takes events from the ring without the mutex, so it
+    // has to be there first
+    unsigned long size = 1;
+    while (size < eventBufferSize_) {
+      size <<= 1;
+    }
+    GroupCommitSlot* ring = new GroupCommitSlot[size];
+    for (unsigned long i = 0; i < size; ++i) {
+      ring[i].seq = static_cast<long>(i);
+      ring[i].event = NULL;
+    }
+    ringMask_ = size - 1;
+    atomicExchange(&ring_, ring);
+  }
+
   if(!writerThread_.get()) {
     writerThread_ = threadFactory_.newThread(
       apache::thrift::concurrency::FunctionRunner::create(startWriterThread, this));
     writerThread_->start();
   }
 
-  dequeueBuffer_ = new TFileTransportBuffer(eventBufferSize_);
-  enqueueBuffer_ = new TFileTransportBuffer(eventBufferSize_);
+  if (!groupCommit_) {
+    dequeueBuffer_ = new TFileTransportBuffer(eventBufferSize_);
+    enqueueBuffer_ = new TFileTransportBuffer(eventBufferSize_);
+  }
   bufferAndThreadInitialized_ = true;
 
   return true;
@@ -219,6 +331,11 @@ void TFileTransport::enqueueEvent(const uint8_t* buf, uint32_t eventLen) {
   memcpy(toEnqueue->eventBuff_ + 4, buf, eventLen);
   toEnqueue->eventSize_ = eventLen + 4;
 
+  if (groupCommit_) {
+    enqueueGroupCommit(toEnqueue);
+    return;
+  }
+
   // lock mutex
   Guard g(mutex_);
 
@@ -254,6 +371,38 @@ void TFileTransport::enqueueEvent(const uint8_t* buf, uint32_t eventLen) {
   // it is probably a non-factor for the time being
 }
 
+void TFileTransport::enqueueGroupCommit(eventInfo* event) {
+  if (ring_ == NULL) {
+    Guard g(mutex_);
+    if (!bufferAndThreadInitialized_ && !initBufferAndWriteThread()) {
+      delete event;
+      return;
+    }
+  }
+
+  long ticket = atomicAdd(&enqueueTicket_, 1) - 1;
+  GroupCommitSlot& slot = ring_[ticket & ringMask_];
+  if (atomicLoad(&slot.seq) != ticket) {
+    // The ring is full, so wait for the writer thread to free the slot
+    Guard g(mutex_);
+    atomicAdd(&fullWaiters_, 1);
+    while (atomicLoad(&slot.seq) != ticket) {
+      notFull_.wait();
+    }
+    atomicAdd(&fullWaiters_, -1);
+  }
+
+  slot.event = event;
+  atomicAdd(&slot.seq, 1);
+
+  // The writer thread sets writerIdle_ before it checks the ring for the
+  // last time, so either it sees this event or this sees it idle
+  if (atomicLoad(&writerIdle_) != 0) {
+    Guard g(mutex_);
+    notEmpty_.notify();
+  }
+}
+
 bool TFileTransport::swapEventBuffers(struct timeval* deadline) {
   bool swap;
   Guard g(mutex_);
@@ -322,6 +471,11 @@ void TFileTransport::writerThread() {
     }
   }
 
+  if (groupCommit_) {
+    groupCommitWriterThread(hasIOError);
+    return;
+  }
+
   // Figure out the next time by which a flush must take place
   struct timeval ts_next_flush;
   getNextFlushTime(&ts_next_flush);
@@ -336,7 +490,7 @@ void TFileTransport::writerThread() {
 
       // Try to empty buffers before exit
       if (enqueueBuffer_->isEmpty() && dequeueBuffer_->isEmpty()) {
-		::THRIFT_FSYNC(fd_);
+        syncFile();
         if (-1 == ::THRIFT_CLOSE(fd_)) {
           int errno_copy = THRIFT_ERRNO;
           GlobalOutput.perror("TFileTransport: writerThread() ::close() ", errno_copy);
@@ -356,25 +510,12 @@ void TFileTransport::writerThread() {
         // will: (1) sleep for a short while; (2) try to reopen the file; (3) if successful then start writing
         // from the end.
 
-        while (hasIOError) {
-          T_ERROR("TFileTransport: writer thread going to sleep for %d microseconds due to IO errors", writerThreadIOErrorSleepTime_);
-          THRIFT_SLEEP_USEC(writerThreadIOErrorSleepTime_);
-          if (closing_) {
+        if (hasIOError) {
+          if (!reopenAfterIOError()) {
             return;
           }
-          if (!fd_) {
-            ::THRIFT_CLOSE(fd_);
-            fd_ = 0;
-          }
-          try {
-            openLogFile();
-            seekToEnd();
-            unflushed = 0;
-            hasIOError = false;
-            T_LOG_OPER("TFileTransport: log file %s reopened by writer thread during error recovery", filename_.c_str());
-          } catch (...) {
-            T_ERROR("TFileTransport: unable to reopen log file %s during error recovery", filename_.c_str());
-          }
+          unflushed = 0;
+          hasIOError = false;
         }
 
         // sanity check on event
@@ -481,7 +622,7 @@ void TFileTransport::writerThread() {
 
     if (flush) {
       // sync (force flush) file to disk
-	  THRIFT_FSYNC(fd_);
+      syncFile();
       unflushed = 0;
       getNextFlushTime(&ts_next_flush);
 
@@ -497,11 +638,235 @@ void TFileTransport::writerThread() {
   }
 }
 
+void TFileTransport::groupCommitWriterThread(bool hasIOError) {
+  GroupCommitSlot* ring = ring_;
+  std::vector<eventInfo*> batch;
+  batch.reserve(GROUP_COMMIT_MAX_BATCH);
+  long head = 0;
+
+  struct timeval ts_next_flush;
+  getNextFlushTime(&ts_next_flush);
+  uint32_t unflushed = 0;
+
+  while (1) {
+    // Take the events producers have finished enqueueing, in ticket order
+    bool freed = false;
+    while (batch.size() < GROUP_COMMIT_MAX_BATCH) {
+      GroupCommitSlot& slot = ring[head & ringMask_];
+      if (atomicLoad(&slot.seq) != nextTicket(head)) {
+        break;
+      }
+      eventInfo* event = slot.event;
+      slot.event = NULL;
+      atomicAdd(&slot.seq, static_cast<long>(ringMask_));
+      head = nextTicket(head);
+      freed = true;
+
+      if (event->eventSize_ > chunkSize_) {
+        T_ERROR("TFileTransport: event size(%u) > chunk size(%u): skipping event", event->eventSize_, chunkSize_);
+        delete event;
+        continue;
+      }
+      batch.push_back(event);
+    }
+    if (freed && atomicLoad(&fullWaiters_) != 0) {
+      Guard g(mutex_);
+      notFull_.notifyAll();
+    }
+
+    bool wrote = !batch.empty();
+    if (wrote) {
+      // As in the default mode, events that fail to be written are dropped
+      if (hasIOError && !reopenAfterIOError()) {
+        for (size_t i = 0; i < batch.size(); ++i) {
+          delete batch[i];
+        }
+        return;
+      }
+      if (hasIOError) {
+        unflushed = 0;
+        hasIOError = false;
+      }
+      hasIOError = !writeBatch(batch, unflushed);
+      for (size_t i = 0; i < batch.size(); ++i) {
+        delete batch[i];
+      }
+      batch.clear();
+    }
+
+    bool forced;
+    bool done;
+    {
+      Guard g(mutex_);
+      forced = ticketBefore(syncedTicket_, flushTicket_) && !ticketBefore(head, flushTicket_);
+      done = closing_ && head == atomicLoad(&enqueueTicket_);
+    }
+    if (closing_ && hasIOError) {
+      return;
+    }
+
+    struct timeval current_time;
+    THRIFT_GETTIMEOFDAY(&current_time, NULL);
+    bool timedOut = current_time.tv_sec > ts_next_flush.tv_sec ||
+      (current_time.tv_sec == ts_next_flush.tv_sec &&
+       current_time.tv_usec > ts_next_flush.tv_usec);
+
+    // One sync covers everything written so far, so every flush() waiting
+    // for those events is done with it
+    bool flush = !hasIOError && unflushed > 0 &&
+      (forced || done || timedOut || unflushed > flushMaxBytes_);
+    if (flush) {
+      syncFile();
+      unflushed = 0;
+    }
+    if (flush || timedOut) {
+      getNextFlushTime(&ts_next_flush);
+    }
+    if (flush || forced) {
+      Guard g(mutex_);
+      syncedTicket_ = head;
+      flushed_.notifyAll();
+    }
+
+    if (done) {
+      if (-1 == ::THRIFT_CLOSE(fd_)) {
+        int errno_copy = THRIFT_ERRNO;
+        GlobalOutput.perror("TFileTransport: writerThread() ::close() ", errno_copy);
+      } else {
+        //fd successfully closed
+        fd_ = 0;
+      }
+      return;
+    }
+
+    if (!wrote) {
+      Guard g(mutex_);
+      atomicAdd(&writerIdle_, 1);
+      bool ready = atomicLoad(&ring[head & ringMask_].seq) == nextTicket(head);
+      bool flushReady = ticketBefore(syncedTicket_, flushTicket_) &&
+        !ticketBefore(head, flushTicket_);
+      if (!ready && !flushReady && !closing_) {
+        notEmpty_.waitForTime(&ts_next_flush);
+      }
+      atomicAdd(&writerIdle_, -1);
+    }
+  }
+}
+
+bool TFileTransport::writeBatch(const std::vector<eventInfo*>& batch, uint32_t& unflushed) {
+  // Events are written in runs that stay within a chunk.  The end of a
+  // chunk is padded by extending the file, which reads back as zeros.
+  size_t start = 0;
+  off_t end = offset_;
+  for (size_t i = 0; i <= batch.size(); ++i) {
+    bool crosses = i < batch.size() &&
+      end / chunkSize_ != (end + batch[i]->eventSize_ - 1) / chunkSize_;
+    if (i == batch.size() || crosses) {
+      if (i > start && !writeEvents(fd_, &batch[start], i - start)) {
+        int errno_copy = THRIFT_ERRNO;
+        GlobalOutput.perror("TFileTransport: error while writing events ", errno_copy);
+        return false;
+      }
+      unflushed += static_cast<uint32_t>(end - offset_);
+      offset_ = end;
+      start = i;
+    }
+    if (crosses) {
+      // The seek is for files from resetOutputFile(), which may not have
+      // been opened with O_APPEND
+      end = (end / chunkSize_ + 1) * chunkSize_;
+      if (-1 == THRIFT_FTRUNCATE(fd_, end) || -1 == THRIFT_LSEEK(fd_, end, SEEK_SET)) {
+        int errno_copy = THRIFT_ERRNO;
+        GlobalOutput.perror("TFileTransport: writerThread() error while padding chunk ", errno_copy);
+        return false;
+      }
+      offset_ = end;
+    }
+    if (i < batch.size()) {
+      end += batch[i]->eventSize_;
+    }
+  }
+
+  preallocateChunks();
+  return true;
+}
+
+void TFileTransport::preallocateChunks() {
+#if defined(HAVE_FALLOCATE) && defined(FALLOC_FL_KEEP_SIZE)
+  // Keep the current chunk and the next allocated, without changing the
+  // size of the file, so that readers still see its end
+  off_t want = (offset_ / chunkSize_ + 2) * chunkSize_;
+  if (!preallocate_ || want <= preallocatedTo_) {
+    return;
+  }
+  off_t from = (std::max)(preallocatedTo_, offset_);
+  if (-1 == ::fallocate(fd_, FALLOC_FL_KEEP_SIZE, from, want - from)) {
+    // Most likely the filesystem does not support it
+    int errno_copy = THRIFT_ERRNO;
+    GlobalOutput.perror("TFileTransport: fallocate() ", errno_copy);
+    preallocate_ = false;
+    return;
+  }
+  preallocatedTo_ = want;
+#endif
+}
+
+bool TFileTransport::reopenAfterIOError() {
+  // Sleep and try to reopen the file until it works, or the transport closes
+  while (1) {
+    T_ERROR("TFileTransport: writer thread going to sleep for %d microseconds due to IO errors", writerThreadIOErrorSleepTime_);
+    THRIFT_SLEEP_USEC(writerThreadIOErrorSleepTime_);
+    if (closing_) {
+      return false;
+    }
+    if (fd_ > 0) {
+      ::THRIFT_CLOSE(fd_);
+      fd_ = 0;
+    }
+    try {
+      openLogFile();
+      seekToEnd();
+      T_LOG_OPER("TFileTransport: log file %s reopened by writer thread during error recovery", filename_.c_str());
+      return true;
+    } catch (...) {
+      T_ERROR("TFileTransport: unable to reopen log file %s during error recovery", filename_.c_str());
+    }
+  }
+}
+
+void TFileTransport::syncFile() {
+  if (syncMode_ == SYNC_NONE) {
+    return;
+  }
+#ifdef HAVE_FDATASYNC
+  if (syncMode_ == SYNC_FDATASYNC) {
+    ::fdatasync(fd_);
+    return;
+  }
+#endif
+  ::THRIFT_FSYNC(fd_);
+}
+
 void TFileTransport::flush() {
   // file must be open for writing for any flushing to take place
   if (!writerThread_.get()) {
     return;
   }
+
+  if (groupCommit_) {
+    // Wait for everything enqueued so far, and wake the writer thread if it
+    // is waiting for more
+    Guard g(mutex_);
+    long ticket = atomicLoad(&enqueueTicket_);
+    if (ticketBefore(flushTicket_, ticket)) {
+      flushTicket_ = ticket;
+    }
+    notEmpty_.notify();
+    while (ticketBefore(syncedTicket_, ticket)) {
+      flushed_.wait();
+    }
+    return;
+  }
   // wait for flush to take place
   Guard g(mutex_);
 
@@ -592,7 +957,14 @@ eventInfo* TFileTransport::readEvent() {
     if (readState_.bufferPtr_ == readState_.bufferLen_) {
       // advance the offset pointer
       offset_ += readState_.bufferLen_;
-	  readState_.bufferLen_ = static_cast<uint32_t>(::THRIFT_READ(fd_, readBuff_, readBuffSize_));
+      // stop the buffer at the end of the chunk, so getCurChunk() is the
+      // chunk of every event in it
+      uint32_t readLen = readBuffSize_;
+      uint32_t chunkLeft = static_cast<uint32_t>(chunkSize_ - offset_ % chunkSize_);
+      if (chunkLeft < readLen) {
+        readLen = chunkLeft;
+      }
+	  readState_.bufferLen_ = static_cast<uint32_t>(::THRIFT_READ(fd_, readBuff_, readLen));
       //       if (readState_.bufferLen_) {
       //         T_DEBUG_L(1, "Amount read: %u (offset: %lu)", readState_.bufferLen_, offset_);
       //       }
@@ -875,6 +1247,7 @@ void TFileTransport::openLogFile() {
 #endif
   fd_ = ::THRIFT_OPEN(filename_.c_str(), flags, mode);
   offset_ = 0;
+  preallocatedTo_ = 0;
 
   // make sure open call was successful
   if(fd_ == -1) {
@@ -967,7 +1340,16 @@ TFileProcessor::TFileProcessor(shared_ptr<TProcessor> processor,
   processor_(processor),
   inputProtocolFactory_(protocolFactory),
   outputProtocolFactory_(protocolFactory),
-  inputTransport_(inputTransport) {
+  inputTransport_(inputTransport),
+  maxPendingChunks_(0),
+  replayPending_(0),
+  replayChunksRead_(0),
+  replayChunksDone_(0),
+  replayMessages_(0),
+  replayBytes_(0),
+  replayFailures_(0),
+  replayStart_(0),
+  replayEnd_(0) {
 
   // default the output transport to a null transport (common case)
   outputTransport_ = shared_ptr<TNullTransport>(new TNullTransport());
@@ -980,7 +1362,16 @@ TFileProcessor::TFileProcessor(shared_ptr<TProcessor> processor,
   processor_(processor),
   inputProtocolFactory_(inputProtocolFactory),
   outputProtocolFactory_(outputProtocolFactory),
-  inputTransport_(inputTransport) {
+  inputTransport_(inputTransport),
+  maxPendingChunks_(0),
+  replayPending_(0),
+  replayChunksRead_(0),
+  replayChunksDone_(0),
+  replayMessages_(0),
+  replayBytes_(0),
+  replayFailures_(0),
+  replayStart_(0),
+  replayEnd_(0) {
 
   // default the output transport to a null transport (common case)
   outputTransport_ = shared_ptr<TNullTransport>(new TNullTransport());
@@ -994,7 +1385,16 @@ TFileProcessor::TFileProcessor(shared_ptr<TProcessor> processor,
   inputProtocolFactory_(protocolFactory),
   outputProtocolFactory_(protocolFactory),
   inputTransport_(inputTransport),
-  outputTransport_(outputTransport) {}
+  outputTransport_(outputTransport),
+  maxPendingChunks_(0),
+  replayPending_(0),
+  replayChunksRead_(0),
+  replayChunksDone_(0),
+  replayMessages_(0),
+  replayBytes_(0),
+  replayFailures_(0),
+  replayStart_(0),
+  replayEnd_(0) {}
 
 void TFileProcessor::process(uint32_t numEvents, bool tail) {
   shared_ptr<TProtocol> inputProtocol = inputProtocolFactory_->getProtocol(inputTransport_);
@@ -1057,4 +1457,312 @@ void TFileProcessor::processChunk() {
   }
 }
 
+/*
+ * Messages read by processParallel() for one worker to process in order:
+ * those of a chunk, or of a key lane within a chunk.
+ */
+struct TFileProcessor::ReplayWork {
+  boost::shared_ptr<std::string> messages;
+  std::vector<uint32_t> sizes;
+
+  // the parts of the chunk that are still to be processed, shared by them
+  boost::shared_ptr<volatile long> partsLeft;
+};
+
+/*
+ * Work of a set of keys, processed by one worker at a time
+ */
+struct TFileProcessor::ReplayLane {
+  ReplayLane() : running(false) {}
+
+  Mutex mutex;
+  std::deque<ReplayWork> queue;
+  bool running;
+};
+
+void TFileProcessor::processParallel(shared_ptr<ThreadManager> threadManager,
+                                     ReplayOrder order,
+                                     ReplayKeyFunction key) {
+  if (order == REPLAY_KEY_ORDER && !key) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "TFileProcessor: key order replay needs a key function");
+  }
+
+  size_t numWorkers = (std::max)(threadManager->workerCount(), static_cast<size_t>(1));
+  uint32_t maxPending = maxPendingChunks_;
+  if (maxPending == 0) {
+    maxPending = static_cast<uint32_t>(2 * numWorkers);
+  }
+  std::vector<shared_ptr<ReplayLane> > lanes;
+  if (order == REPLAY_KEY_ORDER) {
+    for (size_t i = 0; i < numWorkers * REPLAY_LANES_PER_WORKER; ++i) {
+      lanes.push_back(shared_ptr<ReplayLane>(new ReplayLane()));
+    }
+  }
+
+  {
+    Synchronized s(replayMonitor_);
+    replayChunksRead_ = 0;
+    replayChunksDone_ = 0;
+    replayMessages_ = 0;
+    replayBytes_ = 0;
+    replayFailures_ = 0;
+    replayStart_ = Util::currentTime();
+    replayEnd_ = 0;
+  }
+
+  int32_t oldReadTimeout = inputTransport_->getReadTimeout();
+  inputTransport_->setReadTimeout(TFileTransport::NO_TAIL_READ_TIMEOUT);
+
+  // bytes read and not yet split up into messages, which a message that
+  // runs over into the next chunk is left in
+  std::string unread;
+  // the start of the first event of the next chunk, read with the last one
+  std::string nextChunk;
+  std::vector<uint8_t> buf(REPLAY_READ_SIZE);
+  shared_ptr<TMemoryBuffer> splitBuffer(new TMemoryBuffer());
+  shared_ptr<TProtocol> splitProtocol = inputProtocolFactory_->getProtocol(splitBuffer);
+  std::vector<ReplayWork> parts(order == REPLAY_KEY_ORDER ? lanes.size() : 1);
+
+  try {
+    bool eof = false;
+    while (!eof) {
+      // Read up to the end of the chunk.  The chunk only moves on in a read
+      // that starts an event, so the bytes of the read that moves it are
+      // the start of the next chunk, and are kept for it.
+      uint32_t chunk = inputTransport_->getCurChunk();
+      size_t start = unread.size();
+      unread.append(nextChunk);
+      nextChunk.clear();
+      try {
+        while (true) {
+          uint32_t got = inputTransport_->read(&buf[0], REPLAY_READ_SIZE);
+          if (got == 0) {
+            eof = true;
+            break;
+          }
+          if (inputTransport_->getCurChunk() != chunk) {
+            nextChunk.assign(reinterpret_cast<char*>(&buf[0]), got);
+            break;
+          }
+          unread.append(reinterpret_cast<char*>(&buf[0]), got);
+        }
+      } catch (TException& te) {
+        cerr << te.what() << endl;
+        eof = true;
+      }
+      if (unread.size() == start) {
+        continue;
+      }
+
+      // Split up the messages, by key if need be
+      for (size_t i = 0; i < parts.size(); ++i) {
+        parts[i].messages.reset(new std::string());
+        parts[i].sizes.clear();
+      }
+      splitBuffer->resetBuffer(reinterpret_cast<uint8_t*>(&unread[0]),
+                               static_cast<uint32_t>(unread.size()));
+      uint32_t used = 0;
+      while (used < unread.size()) {
+        std::string name;
+        TMessageType type;
+        int32_t seqid;
+        try {
+          splitProtocol->readMessageBegin(name, type, seqid);
+          splitProtocol->skip(T_STRUCT);
+          splitProtocol->readMessageEnd();
+        } catch (TTransportException& te) {
+          // END_OF_FILE leaves the rest of the message for the next chunk
+          if (te.getType() != TTransportException::END_OF_FILE) {
+            cerr << te.what() << endl;
+            eof = true;
+          }
+          break;
+        } catch (TException& te) {
+          cerr << te.what() << endl;
+          eof = true;
+          break;
+        }
+        uint32_t end = static_cast<uint32_t>(unread.size()) - splitBuffer->available_read();
+        const uint8_t* message = reinterpret_cast<const uint8_t*>(unread.data()) + used;
+        ReplayWork& part = order == REPLAY_KEY_ORDER
+          ? parts[key(name, message, end - used) % parts.size()]
+          : parts[0];
+        part.messages->append(reinterpret_cast<const char*>(message), end - used);
+        part.sizes.push_back(end - used);
+        used = end;
+      }
+      unread.erase(0, used);
+
+      shared_ptr<volatile long> partsLeft(new long(0));
+      for (size_t i = 0; i < parts.size(); ++i) {
+        if (!parts[i].sizes.empty()) {
+          ++*partsLeft;
+        }
+      }
+      atomicAdd(&replayChunksRead_, 1);
+      if (*partsLeft == 0) {
+        atomicAdd(&replayChunksDone_, 1);
+        continue;
+      }
+
+      {
+        Synchronized s(replayMonitor_);
+        while (replayPending_ >= maxPending) {
+          replayMonitor_.wait();
+        }
+        ++replayPending_;
+      }
+      for (size_t i = 0; i < parts.size(); ++i) {
+        if (parts[i].sizes.empty()) {
+          continue;
+        }
+        parts[i].partsLeft = partsLeft;
+        if (order == REPLAY_KEY_ORDER) {
+          submitReplayLane(threadManager.get(), lanes[i], parts[i]);
+        } else {
+          submitReplayWork(threadManager.get(), parts[i]);
+        }
+      }
+    }
+  } catch (...) {
+    // The workers use lanes and the transports, so wait for them either way
+    Synchronized s(replayMonitor_);
+    while (replayPending_ > 0) {
+      replayMonitor_.wait();
+    }
+    replayEnd_ = Util::currentTime();
+    inputTransport_->setReadTimeout(oldReadTimeout);
+    throw;
+  }
+
+  Synchronized s(replayMonitor_);
+  while (replayPending_ > 0) {
+    replayMonitor_.wait();
+  }
+  replayEnd_ = Util::currentTime();
+  inputTransport_->setReadTimeout(oldReadTimeout);
+}
+
+TFileProcessor::ReplayStats TFileProcessor::getReplayStats() {
+  ReplayStats stats;
+  stats.chunksRead = static_cast<uint64_t>(atomicLoad(&replayChunksRead_));
+  stats.chunksDone = static_cast<uint64_t>(atomicLoad(&replayChunksDone_));
+  stats.messages = static_cast<uint64_t>(atomicLoad(&replayMessages_));
+  stats.bytes = static_cast<uint64_t>(atomicLoad(&replayBytes_));
+  stats.failures = static_cast<uint64_t>(atomicLoad(&replayFailures_));
+
+  int64_t elapsed;
+  {
+    Synchronized s(replayMonitor_);
+    if (replayStart_ == 0) {
+      elapsed = 0;
+    } else {
+      elapsed = (replayEnd_ ? replayEnd_ : Util::currentTime()) - replayStart_;
+    }
+  }
+  stats.seconds = elapsed / 1000.0;
+  stats.messagesPerSecond = elapsed > 0 ? stats.messages / stats.seconds : 0;
+  stats.bytesPerSecond = elapsed > 0 ? stats.bytes / stats.seconds : 0;
+  return stats;
+}
+
+void TFileProcessor::submitReplayWork(ThreadManager* threadManager, const ReplayWork& work) {
+  try {
+    threadManager->add(FunctionRunner::create(
+        apache::thrift::stdcxx::bind(&TFileProcessor::replay, this, work)));
+  } catch (...) {
+    finishReplayWork(work);
+    throw;
+  }
+}
+
+void TFileProcessor::submitReplayLane(ThreadManager* threadManager,
+                                      const shared_ptr<ReplayLane>& lane,
+                                      const ReplayWork& work) {
+  {
+    Guard g(lane->mutex);
+    lane->queue.push_back(work);
+    if (lane->running) {
+      return;
+    }
+    lane->running = true;
+  }
+  try {
+    threadManager->add(FunctionRunner::create(
+        apache::thrift::stdcxx::bind(&TFileProcessor::runReplayLane, this, lane)));
+  } catch (...) {
+    std::deque<ReplayWork> dropped;
+    {
+      Guard g(lane->mutex);
+      dropped.swap(lane->queue);
+      lane->running = false;
+    }
+    for (size_t i = 0; i < dropped.size(); ++i) {
+      finishReplayWork(dropped[i]);
+    }
+    throw;
+  }
+}
+
+void TFileProcessor::runReplayLane(shared_ptr<ReplayLane> lane) {
+  while (true) {
+    ReplayWork work;
+    {
+      Guard g(lane->mutex);
+      if (lane->queue.empty()) {
+        lane->running = false;
+        return;
+      }
+      work = lane->queue.front();
+      lane->queue.pop_front();
+    }
+    replay(work);
+  }
+}
+
+void TFileProcessor::replay(const ReplayWork& work) {
+  shared_ptr<TMemoryBuffer> input(new TMemoryBuffer());
+  shared_ptr<TMemoryBuffer> output(new TMemoryBuffer());
+  shared_ptr<TProtocol> inputProtocol = inputProtocolFactory_->getProtocol(input);
+  shared_ptr<TProtocol> outputProtocol = outputProtocolFactory_->getProtocol(output);
+
+  uint8_t* message = reinterpret_cast<uint8_t*>(&(*work.messages)[0]);
+  for (size_t i = 0; i < work.sizes.size(); ++i) {
+    input->resetBuffer(message, work.sizes[i]);
+    try {
+      processor_->process(inputProtocol, outputProtocol, NULL);
+    } catch (TException& te) {
+      cerr << te.what() << endl;
+      atomicAdd(&replayFailures_, 1);
+    }
+    atomicAdd(&replayMessages_, static_cast<int64_t>(1));
+    atomicAdd(&replayBytes_, static_cast<int64_t>(work.sizes[i]));
+    message += work.sizes[i];
+  }
+
+  if (output->available_read() > 0) {
+    uint8_t* data;
+    uint32_t len;
+    output->getBuffer(&data, &len);
+    try {
+      Guard g(outputMutex_);
+      outputTransport_->write(data, len);
+      outputTransport_->flush();
+    } catch (TException& te) {
+      cerr << te.what() << endl;
+    }
+  }
+  finishReplayWork(work);
+}
+
+void TFileProcessor::finishReplayWork(const ReplayWork& work) {
+  if (atomicAdd(work.partsLeft.get(), -1) == 0) {
+    atomicAdd(&replayChunksDone_, 1);
+    Synchronized s(replayMonitor_);
+    --replayPending_;
+    replayMonitor_.notifyAll();
+  }
+}
+
 }}} // apache::thrift::transport
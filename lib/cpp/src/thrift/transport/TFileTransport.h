@@ -25,6 +25,7 @@
 #include <thrift/TProcessor.h>
 
 #include <string>
+#include <vector>
 #include <stdio.h>
 
 #include <boost/scoped_ptr.hpp>
@@ -34,6 +35,7 @@
 #include <thrift/concurrency/Monitor.h>
 #include <thrift/concurrency/PlatformThreadFactory.h>
 #include <thrift/concurrency/Thread.h>
+#include <thrift/concurrency/ThreadManager.h>
 
 namespace apache { namespace thrift { namespace transport {
 
@@ -283,6 +285,44 @@ class TFileTransport : public TFileReaderTransport,
     return eofSleepTime_;
   }
 
+  // how the writer thread makes written events durable when it flushes
+  enum SyncMode {
+    // fsync(), the default
+    SYNC_FSYNC,
+    // fdatasync() where there is one, which skips metadata such as mtime
+    SYNC_FDATASYNC,
+    // no sync at all: events are written and the OS flushes them in its time
+    SYNC_NONE
+  };
+
+  void setSyncMode(SyncMode syncMode) {
+    syncMode_ = syncMode;
+  }
+  SyncMode getSyncMode() {
+    return syncMode_;
+  }
+
+  /**
+   * Turns group commit on or off, before the first write.
+   *
+   * With group commit, write() enqueues events into a ring without taking a
+   * lock, and the writer thread writes everything queued with one writev().
+   * flush() waits for the events written before it to be synced, sharing the
+   * sync with any other flush() calls, and does not hold up writers.  Chunks
+   * are padded by extending the file rather than writing zeros, and are
+   * preallocated with fallocate() where it is available.
+   */
+  void setGroupCommit(bool groupCommit) {
+    if (bufferAndThreadInitialized_) {
+      GlobalOutput("Cannot change group commit after writer thread started");
+      return;
+    }
+    groupCommit_ = groupCommit;
+  }
+  bool getGroupCommit() {
+    return groupCommit_;
+  }
+
   /*
    * Override TTransport *_virt() functions to invoke our implementations.
    * We cannot use TVirtualTransport to provide these, since we need to inherit
@@ -311,6 +351,16 @@ class TFileTransport : public TFileReaderTransport,
   }
   void writerThread();
 
+  // helper functions for group commit
+  void enqueueGroupCommit(eventInfo* event);
+  void groupCommitWriterThread(bool hasIOError);
+  bool writeBatch(const std::vector<eventInfo*>& batch, uint32_t& unflushed);
+  void preallocateChunks();
+
+  // helper functions for the writer thread
+  bool reopenAfterIOError();
+  void syncFile();
+
   // helper functions for reading from a file
   eventInfo* readEvent();
 
@@ -389,6 +439,33 @@ class TFileTransport : public TFileReaderTransport,
   // Mutex that is grabbed when enqueueing and swapping the read/write buffers
   Mutex mutex_;
 
+  // Group commit ring.  Producers take consecutive tickets, and the event
+  // with ticket t goes in slot t & ringMask_.  A slot's seq is t while it is
+  // free for ticket t and t + 1 once that event is in it.
+  struct GroupCommitSlot {
+    volatile long seq;
+    eventInfo* event;
+  };
+  bool groupCommit_;
+  GroupCommitSlot* volatile ring_;
+  unsigned long ringMask_;
+  volatile long enqueueTicket_;
+
+  // set while the writer thread waits for events, and producers wait for a slot
+  volatile long writerIdle_;
+  volatile long fullWaiters_;
+
+  // flush() waits until the events before flushTicket_ are synced; both are
+  // guarded by mutex_
+  long flushTicket_;
+  long syncedTicket_;
+
+  SyncMode syncMode_;
+
+  // end of the space preallocated for the file, and whether to keep going
+  off_t preallocatedTo_;
+  bool preallocate_;
+
   // File information
   std::string filename_;
   int fd_;
@@ -460,12 +537,109 @@ class TFileProcessor {
    */
   void processChunk();
 
+  /**
+   * How processParallel() orders the messages it replays
+   */
+  enum ReplayOrder {
+    // the messages of each chunk in order, with chunks processed at once
+    REPLAY_CHUNK_ORDER,
+    // the messages of each key in order, whatever chunk they are in
+    REPLAY_KEY_ORDER
+  };
+
+  /**
+   * Gives the key of a message for REPLAY_KEY_ORDER, from its name and its
+   * serialized bytes in the input protocol, message header included.
+   */
+  typedef apache::thrift::stdcxx::function<
+    uint64_t(const std::string& name, const uint8_t* message, uint32_t len)> ReplayKeyFunction;
+
+  /**
+   * Progress of processParallel(), so far or at the end
+   */
+  struct ReplayStats {
+    uint64_t chunksRead;
+    uint64_t chunksDone;
+    uint64_t messages;
+    uint64_t bytes;
+    uint64_t failures;
+    double seconds;
+    double messagesPerSecond;
+    double bytesPerSecond;
+  };
+
+  /**
+   * Processes the events from the current position to the end of the file
+   * on the threads of threadManager, which must have been started.
+   *
+   * The calling thread reads the file and splits it up into messages chunk
+   * by chunk, and the workers process them, each message into its own
+   * output.  Messages that fail to process are counted and skipped, rather
+   * than ending the replay.  The file is not tailed.
+   *
+   * @param threadManager runs the processing
+   * @param order what processing order to keep
+   * @param key the key of each message, for REPLAY_KEY_ORDER
+   */
+  void processParallel(boost::shared_ptr<apache::thrift::concurrency::ThreadManager> threadManager,
+                       ReplayOrder order = REPLAY_CHUNK_ORDER,
+                       ReplayKeyFunction key = ReplayKeyFunction());
+
+  /**
+   * Progress of the current or last processParallel() call.  Safe to call
+   * from any thread while it runs.
+   */
+  ReplayStats getReplayStats();
+
+  /**
+   * Sets how many chunks processParallel() may have read ahead of the
+   * workers, 0 for twice the number of workers.
+   */
+  void setMaxPendingChunks(uint32_t maxPendingChunks) {
+    maxPendingChunks_ = maxPendingChunks;
+  }
+  uint32_t getMaxPendingChunks() {
+    return maxPendingChunks_;
+  }
+
  private:
+  struct ReplayWork;
+  struct ReplayLane;
+
+  // helper functions for parallel replay
+  void submitReplayWork(apache::thrift::concurrency::ThreadManager* threadManager,
+                        const ReplayWork& work);
+  void submitReplayLane(apache::thrift::concurrency::ThreadManager* threadManager,
+                        const boost::shared_ptr<ReplayLane>& lane,
+                        const ReplayWork& work);
+  void runReplayLane(boost::shared_ptr<ReplayLane> lane);
+  void replay(const ReplayWork& work);
+  void finishReplayWork(const ReplayWork& work);
+
   boost::shared_ptr<TProcessor> processor_;
   boost::shared_ptr<TProtocolFactory> inputProtocolFactory_;
   boost::shared_ptr<TProtocolFactory> outputProtocolFactory_;
   boost::shared_ptr<TFileReaderTransport> inputTransport_;
   boost::shared_ptr<TTransport> outputTransport_;
+
+  // serializes writes of replayed output to outputTransport_
+  Mutex outputMutex_;
+
+  uint32_t maxPendingChunks_;
+
+  // chunks read by processParallel() and not yet processed
+  Monitor replayMonitor_;
+  uint32_t replayPending_;
+
+  // progress of processParallel(), in milliseconds for the times.  The
+  // message and byte counts are 64 bits even where long is 32.
+  volatile long replayChunksRead_;
+  volatile long replayChunksDone_;
+  volatile int64_t replayMessages_;
+  volatile int64_t replayBytes_;
+  volatile long replayFailures_;
+  int64_t replayStart_;
+  int64_t replayEnd_;
 };
 
 
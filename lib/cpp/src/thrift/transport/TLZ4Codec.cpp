@@ -0,0 +1,122 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <cstring>
+#include <new>
+
+#include <thrift/transport/TLZ4Codec.h>
+
+#include <lz4.h>
+
+namespace apache { namespace thrift { namespace transport {
+
+namespace {
+
+// LZ4 only looks back this far, so no more of a dictionary is of use
+const size_t LZ4_MAX_DICTIONARY_SIZE = 64 * 1024;
+
+}
+
+TLZ4Codec::TLZ4Codec(int acceleration, const std::string& dictionary)
+  : acceleration_(acceleration)
+  , dictStream_(NULL)
+  , stream_(NULL)
+{
+  if (dictionary.size() > LZ4_MAX_DICTIONARY_SIZE) {
+    dictionary_ = dictionary.substr(dictionary.size() - LZ4_MAX_DICTIONARY_SIZE);
+  } else {
+    dictionary_ = dictionary;
+  }
+
+  dictStream_ = LZ4_createStream();
+  stream_ = LZ4_createStream();
+  if (dictStream_ == NULL || stream_ == NULL) {
+    LZ4_freeStream(dictStream_);
+    LZ4_freeStream(stream_);
+    throw std::bad_alloc();
+  }
+  if (!dictionary_.empty()) {
+    // The loaded stream refers to dictionary_, which must stay put
+    LZ4_loadDict(dictStream_, dictionary_.data(), static_cast<int>(dictionary_.size()));
+  }
+}
+
+TLZ4Codec::~TLZ4Codec() {
+  LZ4_freeStream(dictStream_);
+  LZ4_freeStream(stream_);
+}
+
+uint32_t TLZ4Codec::compressBound(uint32_t len) {
+  int bound = LZ4_compressBound(static_cast<int>(len));
+  if (bound <= 0) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "TLZ4Codec: block too large to compress");
+  }
+  return static_cast<uint32_t>(bound);
+}
+
+uint32_t TLZ4Codec::compress(const uint8_t* in, uint32_t len, uint8_t* out) {
+  int compressed;
+  if (dictionary_.empty()) {
+    compressed = LZ4_compress_fast_extState(stream_,
+                                            reinterpret_cast<const char*>(in),
+                                            reinterpret_cast<char*>(out),
+                                            static_cast<int>(len),
+                                            static_cast<int>(compressBound(len)),
+                                            acceleration_);
+  } else {
+    // Starting from a copy of the loaded dictionary is much cheaper than
+    // loading it for every block
+    memcpy(stream_, dictStream_, sizeof(*stream_));
+    compressed = LZ4_compress_fast_continue(stream_,
+                                            reinterpret_cast<const char*>(in),
+                                            reinterpret_cast<char*>(out),
+                                            static_cast<int>(len),
+                                            static_cast<int>(compressBound(len)),
+                                            acceleration_);
+  }
+  if (compressed <= 0) {
+    throw TTransportException(TTransportException::INTERNAL_ERROR,
+                              "TLZ4Codec: compression failed");
+  }
+  return static_cast<uint32_t>(compressed);
+}
+
+void TLZ4Codec::decompress(const uint8_t* in, uint32_t len, uint8_t* out, uint32_t outLen) {
+  int decompressed;
+  if (dictionary_.empty()) {
+    decompressed = LZ4_decompress_safe(reinterpret_cast<const char*>(in),
+                                       reinterpret_cast<char*>(out),
+                                       static_cast<int>(len),
+                                       static_cast<int>(outLen));
+  } else {
+    decompressed = LZ4_decompress_safe_usingDict(reinterpret_cast<const char*>(in),
+                                                 reinterpret_cast<char*>(out),
+                                                 static_cast<int>(len),
+                                                 static_cast<int>(outLen),
+                                                 dictionary_.data(),
+                                                 static_cast<int>(dictionary_.size()));
+  }
+  if (decompressed < 0 || static_cast<uint32_t>(decompressed) != outLen) {
+    throw TTransportException(TTransportException::CORRUPTED_DATA,
+                              "TLZ4Codec: corrupt block");
+  }
+}
+
+}}} // apache::thrift::transport
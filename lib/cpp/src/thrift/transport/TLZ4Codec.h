@@ -0,0 +1,74 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_TLZ4CODEC_H_
+#define _THRIFT_TRANSPORT_TLZ4CODEC_H_ 1
+
+#include <thrift/transport/TCompressedTransport.h>
+
+#include <string>
+
+union LZ4_stream_u;
+
+namespace apache { namespace thrift { namespace transport {
+
+/**
+ * LZ4 block compression, for when speed matters more than ratio.
+ *
+ * A dictionary of typical messages helps small messages compress, which
+ * otherwise have too little data for LZ4 to find matches in.  Only its last
+ * 64KB are used.
+ */
+class TLZ4Codec : public TCompressionCodec {
+ public:
+  static const int DEFAULT_ACCELERATION = 1;
+
+  /**
+   * @param acceleration higher is faster, with a worse ratio
+   * @param dictionary   the dictionary to compress with, if not empty
+   */
+  TLZ4Codec(int acceleration = DEFAULT_ACCELERATION,
+            const std::string& dictionary = std::string());
+  ~TLZ4Codec();
+
+  uint8_t getId() const {
+    return CODEC_LZ4;
+  }
+
+  const char* getName() const {
+    return "lz4";
+  }
+
+  uint32_t compressBound(uint32_t len);
+  uint32_t compress(const uint8_t* in, uint32_t len, uint8_t* out);
+  void decompress(const uint8_t* in, uint32_t len, uint8_t* out, uint32_t outLen);
+
+ private:
+  int acceleration_;
+  std::string dictionary_;
+
+  // the state compression starts from, with the dictionary loaded into it
+  // if there is one
+  union LZ4_stream_u* dictStream_;
+  union LZ4_stream_u* stream_;
+};
+
+}}} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_TLZ4CODEC_H_
@@ -0,0 +1,516 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/thrift-config.h>
+
+#include <thrift/transport/TMappedFileTransport.h>
+#include <thrift/transport/PlatformSocket.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <limits>
+#include <sstream>
+
+namespace apache { namespace thrift { namespace transport {
+
+namespace {
+
+/*
+ * Header of an index cache file, which is followed by the offset of every
+ * event as a uint64_t.  It is all in host byte order, like the event sizes
+ * in the log.
+ */
+struct IndexHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t chunkSize;
+  uint32_t reserved;
+  uint64_t dev;
+  uint64_t inode;
+  uint64_t indexedTo;
+  uint64_t numEvents;
+
+  // hash of the first bytes of the first event of every chunk
+  uint64_t fingerprint;
+};
+
+const char INDEX_MAGIC[4] = { 'T', 'F', 'I', 'X' };
+const uint32_t INDEX_VERSION = 2;
+
+// How much of the start of each chunk's first event goes into the
+// fingerprint, size included
+const uint32_t FINGERPRINT_BYTES = 64;
+
+// 64-bit FNV-1a
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
+uint64_t fnv1a(uint64_t hash, const uint8_t* data, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    hash = (hash ^ data[i]) * FNV_PRIME;
+  }
+  return hash;
+}
+
+}
+
+TMappedFileTransport::TMappedFileTransport(const std::string& path,
+                                           uint32_t chunkSize,
+                                           bool cacheIndex)
+  : path_(path)
+  , fd_(-1)
+  , chunkSize_(chunkSize ? chunkSize : DEFAULT_CHUNK_SIZE)
+  , cacheIndex_(cacheIndex)
+  , data_(NULL)
+  , size_(0)
+  , dev_(0)
+  , inode_(0)
+  , indexedTo_(0)
+  , savedTo_(0)
+  , readPos_(0)
+  , readEnd_(0)
+  , nextEvent_(0)
+  , readTimeout_(TFileTransport::NO_TAIL_READ_TIMEOUT)
+  , eofSleepTime_(DEFAULT_EOF_SLEEP_TIME_US)
+{
+  fd_ = ::open(path_.c_str(), O_RDONLY);
+  if (fd_ == -1) {
+    int errno_copy = errno;
+    GlobalOutput.perror("TMappedFileTransport: open() file: " + path_, errno_copy);
+    throw TTransportException(TTransportException::NOT_OPEN, path_, errno_copy);
+  }
+
+  try {
+    struct stat info;
+    if (::fstat(fd_, &info) == -1) {
+      int errno_copy = errno;
+      throw TTransportException(TTransportException::UNKNOWN,
+                                "TMappedFileTransport: fstat()", errno_copy);
+    }
+    dev_ = static_cast<uint64_t>(info.st_dev);
+    inode_ = static_cast<uint64_t>(info.st_ino);
+
+    remap();
+    if (cacheIndex_ && loadIndex()) {
+      savedTo_ = indexedTo_;
+    }
+    indexEvents();
+  } catch (...) {
+    if (data_ != NULL) {
+      ::munmap(const_cast<uint8_t*>(data_), static_cast<size_t>(size_));
+    }
+    ::close(fd_);
+    throw;
+  }
+
+  if (cacheIndex_ && indexedTo_ != savedTo_) {
+    saveIndex();
+  }
+}
+
+TMappedFileTransport::~TMappedFileTransport() {
+  // save what was indexed while tailing the log
+  if (cacheIndex_ && indexedTo_ != savedTo_) {
+    saveIndex();
+  }
+  if (data_ != NULL) {
+    ::munmap(const_cast<uint8_t*>(data_), static_cast<size_t>(size_));
+  }
+  ::close(fd_);
+}
+
+bool TMappedFileTransport::remap() {
+  struct stat info;
+  if (::fstat(fd_, &info) == -1) {
+    int errno_copy = errno;
+    throw TTransportException(TTransportException::UNKNOWN,
+                              "TMappedFileTransport: fstat()", errno_copy);
+  }
+  uint64_t size = static_cast<uint64_t>(info.st_size);
+  if (size == size_) {
+    return false;
+  }
+  if (size > (std::numeric_limits<size_t>::max)()) {
+    throw TTransportException("TMappedFileTransport: file too large to map");
+  }
+
+  if (data_ != NULL) {
+    ::munmap(const_cast<uint8_t*>(data_), static_cast<size_t>(size_));
+    data_ = NULL;
+  }
+  size_ = 0;
+  if (size > 0) {
+    void* data = ::mmap(NULL, static_cast<size_t>(size), PROT_READ, MAP_SHARED, fd_, 0);
+    if (data == MAP_FAILED) {
+      int errno_copy = errno;
+      GlobalOutput.perror("TMappedFileTransport: mmap() file: " + path_, errno_copy);
+      throw TTransportException(TTransportException::UNKNOWN,
+                                "TMappedFileTransport: mmap()", errno_copy);
+    }
+    data_ = static_cast<const uint8_t*>(data);
+    size_ = size;
+  }
+
+  if (size_ < indexedTo_) {
+    // The log was truncated under the index, so start over
+    offsets_.clear();
+    chunkFirstEvent_.clear();
+    indexedTo_ = 0;
+    readPos_ = 0;
+    readEnd_ = 0;
+    nextEvent_ = 0;
+  }
+  return true;
+}
+
+bool TMappedFileTransport::refresh() {
+  if (!remap()) {
+    return false;
+  }
+  size_t numEvents = offsets_.size();
+  indexEvents();
+  return offsets_.size() > numEvents;
+}
+
+void TMappedFileTransport::indexEvents() {
+  // This follows the format TFileTransport writes, and its readEvent()
+  uint64_t pos = indexedTo_;
+  while (pos < size_) {
+    uint64_t chunk = pos / chunkSize_;
+    uint64_t nextChunk = (chunk + 1) * chunkSize_;
+
+    // A size never straddles chunks: the writer pads up to the next one
+    if (pos + 4 > nextChunk) {
+      if (nextChunk > size_) {
+        break;
+      }
+      pos = nextChunk;
+      continue;
+    }
+    if (pos + 4 > size_) {
+      break;
+    }
+
+    uint32_t eventSize;
+    memcpy(&eventSize, data_ + pos, 4);
+    if (eventSize == 0) {
+      // padding
+      pos += 4;
+      continue;
+    }
+
+    if (pos + 4 + eventSize > nextChunk) {
+      // Corrupt, so go on from the next chunk as TFileTransport does, once
+      // there is one
+      if (nextChunk > size_) {
+        break;
+      }
+      T_ERROR("TMappedFileTransport: corrupt event at offset %lu of %s, skipping to the next chunk",
+              static_cast<unsigned long>(pos), path_.c_str());
+      pos = nextChunk;
+      continue;
+    }
+    if (pos + 4 + eventSize > size_) {
+      // still being written
+      break;
+    }
+
+    offsets_.push_back(pos);
+    pos += 4 + eventSize;
+  }
+  indexedTo_ = pos;
+
+  // Chunks that indexing has reached have all their events indexed
+  while (static_cast<uint64_t>(chunkFirstEvent_.size()) * chunkSize_ <= indexedTo_) {
+    uint64_t chunkStart = static_cast<uint64_t>(chunkFirstEvent_.size()) * chunkSize_;
+    chunkFirstEvent_.push_back(
+      std::lower_bound(offsets_.begin(), offsets_.end(), chunkStart) - offsets_.begin());
+  }
+}
+
+bool TMappedFileTransport::startNextEvent(bool wait) {
+  int readTries = 0;
+  while (nextEvent_ >= offsets_.size()) {
+    if (!wait) {
+      return false;
+    }
+    if (refresh()) {
+      continue;
+    }
+    if (readTimeout_ == TFileTransport::TAIL_READ_TIMEOUT) {
+      THRIFT_SLEEP_USEC(eofSleepTime_);
+    } else if (readTimeout_ > 0 && readTries == 0) {
+      THRIFT_SLEEP_USEC(readTimeout_ * 1000);
+      readTries++;
+    } else {
+      return false;
+    }
+  }
+
+  uint64_t offset = offsets_[nextEvent_++];
+  uint32_t eventSize;
+  memcpy(&eventSize, data_ + offset, 4);
+  readPos_ = offset + 4;
+  readEnd_ = readPos_ + eventSize;
+  return true;
+}
+
+bool TMappedFileTransport::peek() {
+  return readPos_ < readEnd_ || startNextEvent(true);
+}
+
+uint32_t TMappedFileTransport::read(uint8_t* buf, uint32_t len) {
+  if (readPos_ == readEnd_ && !startNextEvent(true)) {
+    return 0;
+  }
+  uint32_t give = static_cast<uint32_t>((std::min)(static_cast<uint64_t>(len),
+                                                   readEnd_ - readPos_));
+  memcpy(buf, data_ + readPos_, give);
+  readPos_ += give;
+  return give;
+}
+
+uint32_t TMappedFileTransport::readAll(uint8_t* buf, uint32_t len) {
+  uint32_t have = 0;
+  while (have < len) {
+    uint32_t get = read(buf + have, len - have);
+    if (get == 0) {
+      throw TEOFException();
+    }
+    have += get;
+  }
+  return have;
+}
+
+const uint8_t* TMappedFileTransport::borrow(uint8_t* /* buf */, uint32_t* len) {
+  // Only events already indexed, so that borrowing never waits
+  if (readPos_ == readEnd_ && !startNextEvent(false)) {
+    return NULL;
+  }
+  uint64_t available = readEnd_ - readPos_;
+  if (*len <= available) {
+    *len = static_cast<uint32_t>(available);
+    return data_ + readPos_;
+  }
+  return NULL;
+}
+
+void TMappedFileTransport::consume(uint32_t len) {
+  if (len > readEnd_ - readPos_) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "consume did not follow a borrow.");
+  }
+  readPos_ += len;
+}
+
+uint32_t TMappedFileTransport::getNumChunks() {
+  refresh();
+  if (size_ == 0) {
+    return 0;
+  }
+  uint64_t numChunks = size_ / chunkSize_ + 1;
+  if (numChunks > (std::numeric_limits<uint32_t>::max)()) {
+    throw TTransportException("Too many chunks");
+  }
+  return static_cast<uint32_t>(numChunks);
+}
+
+uint32_t TMappedFileTransport::getCurChunk() {
+  uint64_t pos;
+  if (readPos_ < readEnd_) {
+    pos = readPos_;
+  } else if (nextEvent_ < offsets_.size()) {
+    pos = offsets_[nextEvent_];
+  } else {
+    pos = indexedTo_;
+  }
+  return static_cast<uint32_t>(pos / chunkSize_);
+}
+
+uint64_t TMappedFileTransport::getCurEvent() {
+  return readPos_ < readEnd_ ? nextEvent_ - 1 : nextEvent_;
+}
+
+void TMappedFileTransport::seekToChunk(int32_t chunk) {
+  int64_t numChunks = getNumChunks();
+
+  // file is empty, seeking to chunk is pointless
+  if (numChunks == 0) {
+    return;
+  }
+
+  // negative indicates reverse seek (from the end)
+  int64_t target = chunk;
+  if (target < 0) {
+    target += numChunks;
+  }
+  if (target < 0) {
+    target = 0;
+  }
+
+  readPos_ = 0;
+  readEnd_ = 0;
+  if (static_cast<uint64_t>(target) < chunkFirstEvent_.size()) {
+    nextEvent_ = chunkFirstEvent_[static_cast<size_t>(target)];
+  } else {
+    nextEvent_ = offsets_.size();
+  }
+}
+
+void TMappedFileTransport::seekToEnd() {
+  refresh();
+  readPos_ = 0;
+  readEnd_ = 0;
+  nextEvent_ = offsets_.size();
+}
+
+void TMappedFileTransport::seekToEvent(uint64_t event) {
+  readPos_ = 0;
+  readEnd_ = 0;
+  nextEvent_ = (std::min)(event, static_cast<uint64_t>(offsets_.size()));
+}
+
+bool TMappedFileTransport::loadIndex() {
+  FILE* file = fopen(indexPath(path_).c_str(), "rb");
+  if (file == NULL) {
+    return false;
+  }
+
+  IndexHeader header;
+  struct stat info;
+  bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+    memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0 &&
+    header.version == INDEX_VERSION &&
+    header.chunkSize == chunkSize_ &&
+    header.dev == dev_ &&
+    header.inode == inode_ &&
+    header.indexedTo <= size_ &&
+    ::fstat(fileno(file), &info) == 0 &&
+    static_cast<uint64_t>(info.st_size) ==
+      sizeof(header) + header.numEvents * sizeof(uint64_t);
+  if (ok && header.numEvents > 0) {
+    offsets_.resize(static_cast<size_t>(header.numEvents));
+    ok = fread(&offsets_[0], sizeof(uint64_t), offsets_.size(), file) == offsets_.size();
+  }
+  fclose(file);
+
+  // The offsets must be in order, the first event of every chunk and the
+  // last event where the index says, and the log must still start each
+  // chunk with the same bytes.  Checking every event would read the whole
+  // log, which the index is there to avoid.
+  for (size_t i = 1; ok && i < offsets_.size(); ++i) {
+    ok = offsets_[i - 1] + 4 < offsets_[i];
+  }
+  if (ok && !offsets_.empty()) {
+    uint64_t last = offsets_.back();
+    uint32_t eventSize = 0;
+    if (last + 4 <= header.indexedTo) {
+      memcpy(&eventSize, data_ + last, 4);
+    }
+    ok = eventSize > 0 && last + 4 + eventSize <= header.indexedTo;
+  }
+  uint64_t fingerprint;
+  ok = ok && checkChunkStarts(header.indexedTo, fingerprint) &&
+    fingerprint == header.fingerprint;
+
+  if (!ok) {
+    offsets_.clear();
+    return false;
+  }
+  indexedTo_ = header.indexedTo;
+  return true;
+}
+
+void TMappedFileTransport::saveIndex() {
+  // Written to a temporary file first, so that readers of the same log
+  // never see half an index
+  std::string path = indexPath(path_);
+  std::ostringstream tmp;
+  tmp << path << ".tmp." << getpid();
+
+  FILE* file = fopen(tmp.str().c_str(), "wb");
+  if (file == NULL) {
+    // The index is only a cache, and the directory may not be writable
+    T_DEBUG("TMappedFileTransport: cannot write index %s", path.c_str());
+    return;
+  }
+
+  IndexHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+  header.version = INDEX_VERSION;
+  header.chunkSize = chunkSize_;
+  header.dev = dev_;
+  header.inode = inode_;
+  header.indexedTo = indexedTo_;
+  header.numEvents = offsets_.size();
+  checkChunkStarts(indexedTo_, header.fingerprint);
+
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+    (offsets_.empty() ||
+     fwrite(&offsets_[0], sizeof(uint64_t), offsets_.size(), file) == offsets_.size());
+  ok = fclose(file) == 0 && ok;
+  if (ok && rename(tmp.str().c_str(), path.c_str()) == 0) {
+    savedTo_ = indexedTo_;
+  } else {
+    unlink(tmp.str().c_str());
+  }
+}
+
+bool TMappedFileTransport::checkChunkStarts(uint64_t indexedTo,
+                                            uint64_t& fingerprint) const {
+  fingerprint = FNV_OFFSET_BASIS;
+  std::vector<uint64_t>::const_iterator event = offsets_.begin();
+  for (uint64_t start = 0; start < indexedTo; start += chunkSize_) {
+    uint64_t end = (std::min)(start + chunkSize_, indexedTo);
+
+    // indexEvents() skips padding to the first event, and passes over a
+    // chunk whose first event does not fit in it
+    uint64_t pos = start;
+    uint32_t eventSize = 0;
+    while (pos + 4 <= end) {
+      memcpy(&eventSize, data_ + pos, 4);
+      if (eventSize != 0) {
+        break;
+      }
+      pos += 4;
+    }
+    bool found = eventSize != 0 && pos + 4 + eventSize <= end;
+
+    event = std::lower_bound(event, offsets_.end(), start);
+    bool indexed = event != offsets_.end() && *event < start + chunkSize_;
+    if (found != indexed || (found && *event != pos)) {
+      return false;
+    }
+    if (found) {
+      fingerprint = fnv1a(fingerprint, data_ + pos,
+                          (std::min)(FINGERPRINT_BYTES, 4 + eventSize));
+    }
+  }
+  return true;
+}
+
+}}} // apache::thrift::transport
@@ -0,0 +1,185 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_TMAPPEDFILETRANSPORT_H_
+#define _THRIFT_TRANSPORT_TMAPPEDFILETRANSPORT_H_ 1
+
+#include <thrift/transport/TFileTransport.h>
+
+#include <string>
+#include <vector>
+
+namespace apache { namespace thrift { namespace transport {
+
+/**
+ * Reads a log written by TFileTransport through a memory mapping of it.
+ *
+ * The offset of every event is indexed when the file is opened, so seeking
+ * to a chunk or an event takes no scanning, and borrow() hands out event
+ * data straight from the mapping.  The index is cached beside the log, in
+ * indexPath(path), and only the part of the log written since is scanned
+ * when it is opened again.  Events appended while reading are picked up at
+ * the end of the index, with the same read timeout rules as TFileTransport.
+ *
+ * The chunk size must be the one the log was written with.
+ */
+class TMappedFileTransport : public TFileReaderTransport {
+ public:
+  static const uint32_t DEFAULT_CHUNK_SIZE = 16 * 1024 * 1024;
+
+  /**
+   * @param path       the log file
+   * @param chunkSize  chunk size of the log
+   * @param cacheIndex whether to load and save the index beside the log
+   */
+  TMappedFileTransport(const std::string& path,
+                       uint32_t chunkSize = DEFAULT_CHUNK_SIZE,
+                       bool cacheIndex = true);
+  ~TMappedFileTransport();
+
+  bool isOpen() {
+    return true;
+  }
+
+  bool peek();
+
+  /**
+   * Reads from the current event, moving on to the next when it has been
+   * read in full, like TFileTransport::read().
+   */
+  uint32_t read(uint8_t* buf, uint32_t len);
+  uint32_t readAll(uint8_t* buf, uint32_t len);
+
+  /// Borrows from the current event, or the next if it has been read
+  const uint8_t* borrow(uint8_t* buf, uint32_t* len);
+  void consume(uint32_t len);
+
+  int32_t getReadTimeout() {
+    return readTimeout_;
+  }
+  void setReadTimeout(int32_t readTimeout) {
+    readTimeout_ = readTimeout;
+  }
+
+  void setEofSleepTimeUs(uint32_t eofSleepTime) {
+    if (eofSleepTime) {
+      eofSleepTime_ = eofSleepTime;
+    }
+  }
+  uint32_t getEofSleepTimeUs() {
+    return eofSleepTime_;
+  }
+
+  uint32_t getNumChunks();
+  uint32_t getCurChunk();
+  void seekToChunk(int32_t chunk);
+  void seekToEnd();
+
+  /// Number of events indexed so far
+  uint64_t getNumEvents() {
+    return offsets_.size();
+  }
+
+  /// Index of the event the next read() starts, or continues
+  uint64_t getCurEvent();
+
+  /// Moves to an event, or to the end if there are not that many
+  void seekToEvent(uint64_t event);
+
+  /// Where the index of the log at path is cached
+  static std::string indexPath(const std::string& path) {
+    return path + ".index";
+  }
+
+  virtual uint32_t read_virt(uint8_t* buf, uint32_t len) {
+    return this->read(buf, len);
+  }
+  virtual uint32_t readAll_virt(uint8_t* buf, uint32_t len) {
+    return this->readAll(buf, len);
+  }
+  virtual const uint8_t* borrow_virt(uint8_t* buf, uint32_t* len) {
+    return this->borrow(buf, len);
+  }
+  virtual void consume_virt(uint32_t len) {
+    this->consume(len);
+  }
+
+ private:
+  // Maps the file again if its size has changed.  Returns whether it has.
+  bool remap();
+
+  // Maps the file again if it has grown, and indexes its new events.
+  // Returns whether there are new events.
+  bool refresh();
+  void indexEvents();
+
+  // Moves on to the next event, if wait is set waiting for one as the read
+  // timeout says.  Returns whether there is one.
+  bool startNextEvent(bool wait);
+
+  bool loadIndex();
+  void saveIndex();
+
+  // Checks that the first event of each chunk below indexedTo is where
+  // indexEvents() would find it, and hashes the start of each into
+  // fingerprint.  Returns whether they all are.
+  bool checkChunkStarts(uint64_t indexedTo, uint64_t& fingerprint) const;
+
+  std::string path_;
+  int fd_;
+  uint32_t chunkSize_;
+  bool cacheIndex_;
+
+  // the mapping, of the first size_ bytes of the file
+  const uint8_t* data_;
+  uint64_t size_;
+
+  // identify the file, together with a fingerprint of its contents, to the
+  // index cache
+  uint64_t dev_;
+  uint64_t inode_;
+
+  // offset of the size of each event, in order
+  std::vector<uint64_t> offsets_;
+
+  // index in offsets_ of the first event of each chunk that has been
+  // indexed up to
+  std::vector<uint64_t> chunkFirstEvent_;
+
+  // where indexing stopped, at the end of the file or a partly written event
+  uint64_t indexedTo_;
+
+  // indexedTo_ as of the index in the cache file
+  uint64_t savedTo_;
+
+  // the rest of the current event, as offsets into the mapping
+  uint64_t readPos_;
+  uint64_t readEnd_;
+
+  // the event after the current one
+  uint64_t nextEvent_;
+
+  int32_t readTimeout_;
+  uint32_t eofSleepTime_;
+  static const uint32_t DEFAULT_EOF_SLEEP_TIME_US = 500 * 1000;
+};
+
+}}} // apache::thrift::transport
+
+#endif // _THRIFT_TRANSPORT_TMAPPEDFILETRANSPORT_H_
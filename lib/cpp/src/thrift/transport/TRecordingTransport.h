@@ -0,0 +1,95 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_TRECORDINGTRANSPORT_H_
+#define _THRIFT_TRANSPORT_TRECORDINGTRANSPORT_H_ 1
+
+#include <string>
+
+#include <thrift/transport/TTransport.h>
+#include <thrift/transport/TVirtualTransport.h>
+
+namespace apache { namespace thrift { namespace transport {
+
+/**
+ * Reads from another transport and appends every byte consumed to a
+ * string.  Unlike TPipedTransport it never reads ahead, so the source is
+ * left positioned exactly after the recorded bytes.  Used by the protocols
+ * to lift a serialized value out of a message, see TProtocol::readRaw().
+ */
+class TRecordingTransport : public TVirtualTransport<TRecordingTransport> {
+ public:
+  TRecordingTransport(boost::shared_ptr<TTransport> source, std::string* record)
+    : source_(source)
+    , record_(record)
+  {}
+
+  bool isOpen() {
+    return source_->isOpen();
+  }
+
+  bool peek() {
+    return source_->peek();
+  }
+
+  uint32_t read(uint8_t* buf, uint32_t len) {
+    uint32_t got = source_->read(buf, len);
+    record_->append(reinterpret_cast<const char*>(buf), got);
+    return got;
+  }
+
+  uint32_t readAll(uint8_t* buf, uint32_t len) {
+    uint32_t got = source_->readAll(buf, len);
+    record_->append(reinterpret_cast<const char*>(buf), got);
+    return got;
+  }
+
+  void write(const uint8_t* /* buf */, uint32_t /* len */) {
+    throw TTransportException(TTransportException::NOT_OPEN,
+                              "TRecordingTransport is read-only");
+  }
+
+  const uint8_t* borrow(uint8_t* buf, uint32_t* len) {
+    return source_->borrow(buf, len);
+  }
+
+  void consume(uint32_t len) {
+    // Only called after a successful borrow, so the bytes are still there
+    uint32_t have = len;
+    const uint8_t* data = source_->borrow(NULL, &have);
+    if (data == NULL) {
+      throw TTransportException(TTransportException::BAD_ARGS,
+                                "consume() without borrow()");
+    }
+    record_->append(reinterpret_cast<const char*>(data), len);
+    source_->consume(len);
+  }
+
+  boost::shared_ptr<TTransport> getUnderlyingTransport() {
+    return source_;
+  }
+
+ protected:
+  boost::shared_ptr<TTransport> source_;
+  std::string* record_;
+};
+
+}}} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_TRECORDINGTRANSPORT_H_
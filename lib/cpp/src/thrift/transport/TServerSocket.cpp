@@ -86,6 +86,7 @@ TServerSocket::TServerSocket(int port) :
   tcpSendBuffer_(0),
   tcpRecvBuffer_(0),
   keepAlive_(false),
+  reusePort_(false),
   intSock1_(THRIFT_INVALID_SOCKET),
   intSock2_(THRIFT_INVALID_SOCKET)
 {}
@@ -102,6 +103,7 @@ TServerSocket::TServerSocket(int port, int sendTimeout, int recvTimeout) :
   tcpSendBuffer_(0),
   tcpRecvBuffer_(0),
   keepAlive_(false),
+  reusePort_(false),
   intSock1_(THRIFT_INVALID_SOCKET),
   intSock2_(THRIFT_INVALID_SOCKET)
 {}
@@ -119,6 +121,7 @@ TServerSocket::TServerSocket(string path) :
   tcpSendBuffer_(0),
   tcpRecvBuffer_(0),
   keepAlive_(false),
+  reusePort_(false),
   intSock1_(THRIFT_INVALID_SOCKET),
   intSock2_(THRIFT_INVALID_SOCKET)
 {}
@@ -222,6 +225,22 @@ void TServerSocket::listen() {
 #endif
   }
 
+  // Share the port with other SO_REUSEPORT listeners
+  if (reusePort_) {
+#ifdef SO_REUSEPORT
+    if (-1 == setsockopt(serverSocket_, SOL_SOCKET, SO_REUSEPORT,
+                         cast_sockopt(&one), sizeof(one))) {
+      int errno_copy = THRIFT_GET_SOCKET_ERROR;
+      GlobalOutput.perror("TServerSocket::listen() setsockopt() SO_REUSEPORT ", errno_copy);
+      close();
+      throw TTransportException(TTransportException::NOT_OPEN, "Could not set SO_REUSEPORT", errno_copy);
+    }
+#else
+    close();
+    throw TTransportException(TTransportException::NOT_OPEN, "SO_REUSEPORT is not supported on this platform");
+#endif
+  }
+
   // Set TCP buffer sizes
   if (tcpSendBuffer_ > 0) {
     if (-1 == setsockopt(serverSocket_, SOL_SOCKET, SO_SNDBUF,
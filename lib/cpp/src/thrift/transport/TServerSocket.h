@@ -57,6 +57,11 @@ class TServerSocket : public TServerTransport {
 
   void setKeepAlive(bool keepAlive) {keepAlive_ = keepAlive;}
 
+  // With SO_REUSEPORT several sockets (in this or other processes) can
+  // listen on the same port and the kernel spreads new connections over
+  // them.  listen() throws if the platform doesn't support it.
+  void setReusePort(bool reusePort) {reusePort_ = reusePort;}
+
   void setTcpSendBuffer(int tcpSendBuffer);
   void setTcpRecvBuffer(int tcpRecvBuffer);
 
@@ -94,6 +99,7 @@ class TServerSocket : public TServerTransport {
   int tcpSendBuffer_;
   int tcpRecvBuffer_;
   bool keepAlive_;
+  bool reusePort_;
 
   THRIFT_SOCKET intSock1_;
   THRIFT_SOCKET intSock2_;
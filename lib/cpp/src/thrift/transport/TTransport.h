@@ -174,6 +174,18 @@ class TTransport {
     return 0;
   }
 
+  /**
+   * Hints that len more bytes are about to be written, so that a buffering
+   * transport can make room for them in one step instead of growing as the
+   * writes arrive.
+   *
+   * @param len  How many bytes the caller expects to write
+   */
+  virtual void reserveWrite(uint32_t len) {
+    // default behaviour is to do nothing
+    (void) len;
+  }
+
   /**
    * Flushes any pending data to be written. Typically used with buffered
    * transport mechanisms.
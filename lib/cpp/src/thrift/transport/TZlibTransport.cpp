@@ -26,8 +26,146 @@ using std::string;
 
 namespace apache { namespace thrift { namespace transport {
 
+TZlibStreamPool::TZlibStreamPool(size_t maxIdle) :
+  maxIdle_(maxIdle),
+  numCreated_(0) {}
+
+TZlibStreamPool::~TZlibStreamPool() {
+  for (size_t i = 0; i < inflateStreams_.size(); ++i) {
+    endInflateStream(inflateStreams_[i]);
+  }
+  std::map<int, std::vector<z_stream*> >::iterator it;
+  for (it = deflateStreams_.begin(); it != deflateStreams_.end(); ++it) {
+    for (size_t i = 0; i < it->second.size(); ++i) {
+      endDeflateStream(it->second[i]);
+    }
+  }
+}
+
+z_stream* TZlibStreamPool::getInflateStream() {
+  {
+    concurrency::Guard g(mutex_);
+    if (!inflateStreams_.empty()) {
+      z_stream* stream = inflateStreams_.back();
+      inflateStreams_.pop_back();
+      return stream;
+    }
+    ++numCreated_;
+  }
+
+  z_stream* stream = new z_stream;
+  stream->zalloc = Z_NULL;
+  stream->zfree  = Z_NULL;
+  stream->opaque = Z_NULL;
+  stream->next_in  = Z_NULL;
+  stream->avail_in = 0;
+  int rv = inflateInit(stream);
+  if (rv != Z_OK) {
+    TZlibTransportException ex(rv, stream->msg);
+    delete stream;
+    throw ex;
+  }
+  return stream;
+}
+
+z_stream* TZlibStreamPool::getDeflateStream(int comp_level) {
+  {
+    concurrency::Guard g(mutex_);
+    std::vector<z_stream*>& streams = deflateStreams_[comp_level];
+    if (!streams.empty()) {
+      z_stream* stream = streams.back();
+      streams.pop_back();
+      return stream;
+    }
+    ++numCreated_;
+  }
+
+  z_stream* stream = new z_stream;
+  stream->zalloc = Z_NULL;
+  stream->zfree  = Z_NULL;
+  stream->opaque = Z_NULL;
+  int rv = deflateInit(stream, comp_level);
+  if (rv != Z_OK) {
+    TZlibTransportException ex(rv, stream->msg);
+    delete stream;
+    throw ex;
+  }
+  return stream;
+}
+
+void TZlibStreamPool::returnInflateStream(z_stream* stream) {
+  if (inflateReset(stream) == Z_OK) {
+    concurrency::Guard g(mutex_);
+    if (inflateStreams_.size() < maxIdle_) {
+      inflateStreams_.push_back(stream);
+      return;
+    }
+  }
+  endInflateStream(stream);
+}
+
+void TZlibStreamPool::returnDeflateStream(z_stream* stream, int comp_level) {
+  // deflateReset() discards anything written but not flushed, as
+  // deflateEnd() would
+  if (deflateReset(stream) == Z_OK) {
+    concurrency::Guard g(mutex_);
+    std::vector<z_stream*>& streams = deflateStreams_[comp_level];
+    if (streams.size() < maxIdle_) {
+      streams.push_back(stream);
+      return;
+    }
+  }
+  endDeflateStream(stream);
+}
+
+size_t TZlibStreamPool::getIdleCount() {
+  concurrency::Guard g(mutex_);
+  size_t count = inflateStreams_.size();
+  std::map<int, std::vector<z_stream*> >::iterator it;
+  for (it = deflateStreams_.begin(); it != deflateStreams_.end(); ++it) {
+    count += it->second.size();
+  }
+  return count;
+}
+
+uint64_t TZlibStreamPool::getNumCreated() {
+  concurrency::Guard g(mutex_);
+  return numCreated_;
+}
+
+void TZlibStreamPool::endInflateStream(z_stream* stream) {
+  inflateEnd(stream);
+  delete stream;
+}
+
+void TZlibStreamPool::endDeflateStream(z_stream* stream) {
+  // Z_DATA_ERROR only means that unflushed data was discarded
+  deflateEnd(stream);
+  delete stream;
+}
+
 // Don't call this outside of the constructor.
 void TZlibTransport::initZlib() {
+  if (pool_) {
+    rstream_ = pool_->getInflateStream();
+    try {
+      wstream_ = pool_->getDeflateStream(comp_level_);
+    } catch (...) {
+      pool_->returnInflateStream(rstream_);
+      throw;
+    }
+
+    rstream_->next_in   = crbuf_;
+    wstream_->next_in   = uwbuf_;
+    rstream_->next_out  = urbuf_;
+    wstream_->next_out  = cwbuf_;
+    rstream_->avail_in  = 0;
+    wstream_->avail_in  = 0;
+    rstream_->avail_out = urbuf_size_;
+    wstream_->avail_out = cwbuf_size_;
+    return;
+  }
+
   int rv;
   bool r_init = false;
   try {
@@ -86,6 +224,16 @@ inline void TZlibTransport::checkZlibRvNothrow(int status, const char* message)
 }
 
 TZlibTransport::~TZlibTransport() {
+  if (pool_) {
+    pool_->returnInflateStream(rstream_);
+    pool_->returnDeflateStream(wstream_, comp_level_);
+    delete[] urbuf_;
+    delete[] crbuf_;
+    delete[] uwbuf_;
+    delete[] cwbuf_;
+    return;
+  }
+
   int rv;
   rv = inflateEnd(rstream_);
   checkZlibRvNothrow(rv, rstream_->msg);
@@ -203,7 +351,14 @@ bool TZlibTransport::readFromZlib() {
   int zlib_rv = inflate(rstream_, Z_SYNC_FLUSH);
 
   if (zlib_rv == Z_STREAM_END) {
-    input_ended_ = true;
+    if (reset_per_frame_) {
+      // The frame is done, and its checksum verified.  The next starts a
+      // new stream.
+      zlib_rv = inflateReset(rstream_);
+      checkZlibRv(zlib_rv, rstream_->msg);
+    } else {
+      input_ended_ = true;
+    }
   } else {
     checkZlibRv(zlib_rv, rstream_->msg);
   }
@@ -258,6 +413,21 @@ void TZlibTransport::flush()  {
                               "flush() called after finish()");
   }
 
+  if (reset_per_frame_) {
+    if (uwpos_ == 0 && wstream_->total_in == 0) {
+      // Nothing written since the last frame
+      transport_->flush();
+      return;
+    }
+
+    // End the frame's stream, and start the next without deflateInit()
+    flushToTransport(Z_FINISH);
+    int zlib_rv = deflateReset(wstream_);
+    checkZlibRv(zlib_rv, wstream_->msg);
+    output_finished_ = false;
+    return;
+  }
+
   flushToTransport(Z_FULL_FLUSH);
 }
 
@@ -353,6 +523,12 @@ void TZlibTransport::verifyChecksum() {
         "verifyChecksum() called before end of zlib stream");
   }
 
+  // With a stream per frame, each frame's checksum is verified as its end
+  // is read, so the input is complete unless it stops partway through one.
+  if (reset_per_frame_ && rstream_->total_in == 0 && rstream_->avail_in == 0) {
+    return;
+  }
+
   // Reset the rstream fields, in case avail_out is 0.
   // (Since readAvail() is 0, we know there is no unread data in urbuf_)
   rstream_->next_out  = urbuf_;
@@ -383,13 +559,18 @@ void TZlibTransport::verifyChecksum() {
                               "verifyChecksum()");
   }
 
-  // If input_ended_ is true now, the checksum has been verified
+  // If input_ended_ is true now, the checksum has been verified.  A frame
+  // that has ended has been reset, and must be the last of the input.
   if (input_ended_) {
     return;
   }
+  if (reset_per_frame_ && rstream_->total_in == 0 && rstream_->avail_in == 0 &&
+      rstream_->avail_out == urbuf_size_) {
+    return;
+  }
 
   // The caller invoked us before the actual end of the data stream
-  assert(rstream_->avail_out < urbuf_size_);
+  assert(reset_per_frame_ || rstream_->avail_out < urbuf_size_);
   throw TTransportException(TTransportException::CORRUPTED_DATA,
                             "verifyChecksum() called before end of "
                             "zlib stream");
@@ -20,7 +20,10 @@
 #ifndef _THRIFT_TRANSPORT_TZLIBTRANSPORT_H_
 #define _THRIFT_TRANSPORT_TZLIBTRANSPORT_H_ 1
 
+#include <map>
+#include <vector>
 #include <boost/lexical_cast.hpp>
+#include <thrift/concurrency/Mutex.h>
 #include <thrift/transport/TTransport.h>
 #include <thrift/transport/TVirtualTransport.h>
 #include <zlib.h>
@@ -59,6 +62,55 @@ class TZlibTransportException : public TTransportException {
   std::string zlib_msg_;
 };
 
+/**
+ * A cache of initialized zlib streams.
+ *
+ * deflateInit() and inflateInit() allocate the window and state of a stream,
+ * over 256KB for deflate at the default settings.  Transports made with a
+ * pool take their streams from it and give them back, reset, when they are
+ * destroyed, so that servers making a TZlibTransport per connection do not
+ * pay for that setup each time.  A pool may be shared between threads.
+ */
+class TZlibStreamPool {
+ public:
+  static const size_t DEFAULT_MAX_IDLE = 64;
+
+  /**
+   * @param maxIdle  Most streams of each kind (and compression level) kept
+   *                 for reuse; any more given back are freed.
+   */
+  TZlibStreamPool(size_t maxIdle = DEFAULT_MAX_IDLE);
+
+  ~TZlibStreamPool();
+
+  /// Takes an inflate stream from the pool, or initializes a new one.
+  struct z_stream_s* getInflateStream();
+
+  /// Takes a deflate stream at comp_level from the pool, or initializes one.
+  struct z_stream_s* getDeflateStream(int comp_level);
+
+  /// Resets stream and keeps it for reuse, discarding any data in it.
+  void returnInflateStream(struct z_stream_s* stream);
+  void returnDeflateStream(struct z_stream_s* stream, int comp_level);
+
+  /// Number of streams waiting to be reused
+  size_t getIdleCount();
+
+  /// Number of streams initialized, rather than reused, so far
+  uint64_t getNumCreated();
+
+ private:
+  static void endInflateStream(struct z_stream_s* stream);
+  static void endDeflateStream(struct z_stream_s* stream);
+
+  concurrency::Mutex mutex_;
+  size_t maxIdle_;
+  uint64_t numCreated_;
+  std::vector<struct z_stream_s*> inflateStreams_;
+  // deflateReset() keeps the compression level, so streams are kept by it
+  std::map<int, std::vector<struct z_stream_s*> > deflateStreams_;
+};
+
 /**
  * This transport uses zlib to compress on write and decompress on read 
  *
@@ -77,18 +129,24 @@ class TZlibTransport : public TVirtualTransport<TZlibTransport> {
    * @param uwbuf_size   Uncompressed buffer size for writing.
    * @param cwbuf_size   Compressed buffer size for writing.
    * @param comp_level   Compression level (0=none[fast], 6=default, 9=max[slow]).
+   * @param pool         Pool to take the zlib streams from and give them
+   *                     back to, or null to initialize them here.
    */
   TZlibTransport(boost::shared_ptr<TTransport> transport,
                  int urbuf_size = DEFAULT_URBUF_SIZE,
                  int crbuf_size = DEFAULT_CRBUF_SIZE,
                  int uwbuf_size = DEFAULT_UWBUF_SIZE,
                  int cwbuf_size = DEFAULT_CWBUF_SIZE,
-                 int16_t comp_level = Z_DEFAULT_COMPRESSION) :
+                 int16_t comp_level = Z_DEFAULT_COMPRESSION,
+                 boost::shared_ptr<TZlibStreamPool> pool =
+                   boost::shared_ptr<TZlibStreamPool>()) :
     transport_(transport),
+    pool_(pool),
     urpos_(0),
     uwpos_(0),
     input_ended_(false),
     output_finished_(false),
+    reset_per_frame_(false),
     urbuf_size_(urbuf_size),
     crbuf_size_(crbuf_size),
     uwbuf_size_(uwbuf_size),
@@ -175,9 +233,29 @@ class TZlibTransport : public TVirtualTransport<TZlibTransport> {
    *
    * This may only be called after all data has been read.
    * It verifies the checksum that was written by the finish() call.
+   * With setResetPerFrame() every frame's checksum is verified when the end
+   * of the frame is read, so it only checks that the input did not stop
+   * partway through a frame.
    */
   void verifyChecksum();
 
+  /**
+   * Sends each flush() as a zlib stream of its own, and reads a stream after
+   * another.
+   *
+   * After every frame the streams are reset with deflateReset() and
+   * inflateReset(), which keeps their allocations, so a frame can be
+   * decompressed without the ones before it, and each frame's checksum is
+   * verified as it is read.  Both ends must use it, and it must be set
+   * before anything is written or read.
+   */
+  void setResetPerFrame(bool reset_per_frame) {
+    reset_per_frame_ = reset_per_frame;
+  }
+  bool getResetPerFrame() {
+    return reset_per_frame_;
+  }
+
    /**
     * TODO(someone_smart): Choose smart defaults.
     */
@@ -201,6 +279,7 @@ class TZlibTransport : public TVirtualTransport<TZlibTransport> {
   static const uint32_t MIN_DIRECT_DEFLATE_SIZE = 32;
 
   boost::shared_ptr<TTransport> transport_;
+  boost::shared_ptr<TZlibStreamPool> pool_;
 
   int urpos_;
   int uwpos_;
@@ -209,6 +288,8 @@ class TZlibTransport : public TVirtualTransport<TZlibTransport> {
   bool input_ended_;
   /// True iff we have finished the output stream.
   bool output_finished_;
+  /// True iff every flush() is a stream of its own.
+  bool reset_per_frame_;
 
   uint32_t urbuf_size_;
   uint32_t crbuf_size_;
@@ -233,14 +314,86 @@ class TZlibTransport : public TVirtualTransport<TZlibTransport> {
  */
 class TZlibTransportFactory : public TTransportFactory {
  public:
-  TZlibTransportFactory() {}
+  /// Largest buffer that a frame size makes the transports use
+  static const uint32_t MAX_FRAME_BUF_SIZE = 64 * 1024;
+
+  TZlibTransportFactory() :
+    urbuf_size_(TZlibTransport::DEFAULT_URBUF_SIZE),
+    crbuf_size_(TZlibTransport::DEFAULT_CRBUF_SIZE),
+    uwbuf_size_(TZlibTransport::DEFAULT_UWBUF_SIZE),
+    cwbuf_size_(TZlibTransport::DEFAULT_CWBUF_SIZE),
+    comp_level_(Z_DEFAULT_COMPRESSION),
+    reset_per_frame_(false) {}
+
+  /**
+   * Makes transports that take their streams from pool, for servers that
+   * make one per connection.
+   *
+   * @param pool             Pool of zlib streams, shared by the transports.
+   * @param frame_size       Typical size of a message, that the buffers are
+   *                         sized to hold in one go, or 0 for the defaults.
+   * @param comp_level       Compression level.
+   * @param reset_per_frame  Whether the transports reset per frame; see
+   *                         TZlibTransport::setResetPerFrame().
+   */
+  TZlibTransportFactory(boost::shared_ptr<TZlibStreamPool> pool,
+                        uint32_t frame_size = 0,
+                        int16_t comp_level = Z_DEFAULT_COMPRESSION,
+                        bool reset_per_frame = false) :
+    pool_(pool),
+    urbuf_size_(TZlibTransport::DEFAULT_URBUF_SIZE),
+    crbuf_size_(TZlibTransport::DEFAULT_CRBUF_SIZE),
+    uwbuf_size_(TZlibTransport::DEFAULT_UWBUF_SIZE),
+    cwbuf_size_(TZlibTransport::DEFAULT_CWBUF_SIZE),
+    comp_level_(comp_level),
+    reset_per_frame_(reset_per_frame)
+  {
+    if (frame_size > 0) {
+      // A frame's uncompressed bytes in one buffer, and the most they can
+      // compress to in the other
+      // (not std::min and std::max, which would need the constants defined)
+      int size = static_cast<int>(frame_size < MAX_FRAME_BUF_SIZE ? frame_size
+                                                                  : MAX_FRAME_BUF_SIZE);
+      int bound = static_cast<int>(compressBound(size));
+      if (size > urbuf_size_) {
+        urbuf_size_ = size;
+      }
+      if (size > uwbuf_size_) {
+        uwbuf_size_ = size;
+      }
+      if (bound > crbuf_size_) {
+        crbuf_size_ = bound;
+      }
+      if (bound > cwbuf_size_) {
+        cwbuf_size_ = bound;
+      }
+    }
+  }
 
   virtual ~TZlibTransportFactory() {}
 
   virtual boost::shared_ptr<TTransport> getTransport(
                                          boost::shared_ptr<TTransport> trans) {
-    return boost::shared_ptr<TTransport>(new TZlibTransport(trans));
+    boost::shared_ptr<TZlibTransport> zlib_trans(
+      new TZlibTransport(trans,
+                         urbuf_size_,
+                         crbuf_size_,
+                         uwbuf_size_,
+                         cwbuf_size_,
+                         comp_level_,
+                         pool_));
+    zlib_trans->setResetPerFrame(reset_per_frame_);
+    return zlib_trans;
   }
+
+ private:
+  boost::shared_ptr<TZlibStreamPool> pool_;
+  int urbuf_size_;
+  int crbuf_size_;
+  int uwbuf_size_;
+  int cwbuf_size_;
+  int16_t comp_level_;
+  bool reset_per_frame_;
 };
 
 
@@ -0,0 +1,136 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <new>
+
+#include <thrift/transport/TZstdCodec.h>
+
+#include <zstd.h>
+#include <zdict.h>
+
+namespace apache { namespace thrift { namespace transport {
+
+namespace {
+
+void checkZstd(size_t rv, TTransportException::TTransportExceptionType type, const char* what) {
+  if (ZSTD_isError(rv)) {
+    throw TTransportException(type, std::string("TZstdCodec: ") + what + ": " +
+                              ZSTD_getErrorName(rv));
+  }
+}
+
+}
+
+TZstdCodec::TZstdCodec(int level, const std::string& dictionary)
+  : cctx_(ZSTD_createCCtx())
+  , dctx_(ZSTD_createDCtx())
+  , cdict_(NULL)
+  , ddict_(NULL)
+{
+  try {
+    if (cctx_ == NULL || dctx_ == NULL) {
+      throw std::bad_alloc();
+    }
+
+    // Parameters set on the contexts stay for every block
+    checkZstd(ZSTD_CCtx_setParameter(cctx_, ZSTD_c_compressionLevel, level),
+              TTransportException::BAD_ARGS, "compression level");
+    checkZstd(ZSTD_CCtx_setParameter(cctx_, ZSTD_c_contentSizeFlag, 0),
+              TTransportException::INTERNAL_ERROR, "parameters");
+    checkZstd(ZSTD_CCtx_setParameter(cctx_, ZSTD_c_checksumFlag, 0),
+              TTransportException::INTERNAL_ERROR, "parameters");
+    checkZstd(ZSTD_CCtx_setParameter(cctx_, ZSTD_c_dictIDFlag, 0),
+              TTransportException::INTERNAL_ERROR, "parameters");
+
+    if (!dictionary.empty()) {
+      cdict_ = ZSTD_createCDict(dictionary.data(), dictionary.size(), level);
+      ddict_ = ZSTD_createDDict(dictionary.data(), dictionary.size());
+      if (cdict_ == NULL || ddict_ == NULL) {
+        throw TTransportException(TTransportException::BAD_ARGS,
+                                  "TZstdCodec: bad dictionary");
+      }
+      checkZstd(ZSTD_CCtx_refCDict(cctx_, cdict_),
+                TTransportException::INTERNAL_ERROR, "dictionary");
+      checkZstd(ZSTD_DCtx_refDDict(dctx_, ddict_),
+                TTransportException::INTERNAL_ERROR, "dictionary");
+    }
+  } catch (...) {
+    ZSTD_freeCDict(cdict_);
+    ZSTD_freeDDict(ddict_);
+    ZSTD_freeCCtx(cctx_);
+    ZSTD_freeDCtx(dctx_);
+    throw;
+  }
+}
+
+TZstdCodec::~TZstdCodec() {
+  ZSTD_freeCDict(cdict_);
+  ZSTD_freeDDict(ddict_);
+  ZSTD_freeCCtx(cctx_);
+  ZSTD_freeDCtx(dctx_);
+}
+
+uint32_t TZstdCodec::compressBound(uint32_t len) {
+  size_t bound = ZSTD_compressBound(len);
+  if (bound > 0xffffffff) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "TZstdCodec: block too large to compress");
+  }
+  return static_cast<uint32_t>(bound);
+}
+
+uint32_t TZstdCodec::compress(const uint8_t* in, uint32_t len, uint8_t* out) {
+  size_t compressed = ZSTD_compress2(cctx_, out, compressBound(len), in, len);
+  checkZstd(compressed, TTransportException::INTERNAL_ERROR, "compression failed");
+  return static_cast<uint32_t>(compressed);
+}
+
+void TZstdCodec::decompress(const uint8_t* in, uint32_t len, uint8_t* out, uint32_t outLen) {
+  size_t decompressed = ZSTD_decompressDCtx(dctx_, out, outLen, in, len);
+  checkZstd(decompressed, TTransportException::CORRUPTED_DATA, "corrupt block");
+  if (decompressed != outLen) {
+    throw TTransportException(TTransportException::CORRUPTED_DATA,
+                              "TZstdCodec: block is not the size its header says");
+  }
+}
+
+std::string TZstdCodec::trainDictionary(const std::vector<std::string>& samples,
+                                        size_t maxSize) {
+  std::string data;
+  std::vector<size_t> sizes;
+  for (size_t i = 0; i < samples.size(); ++i) {
+    data += samples[i];
+    sizes.push_back(samples[i].size());
+  }
+
+  std::string dictionary(maxSize, '\0');
+  size_t size = ZDICT_trainFromBuffer(&dictionary[0], maxSize,
+                                      data.data(),
+                                      sizes.empty() ? NULL : &sizes[0],
+                                      static_cast<unsigned>(sizes.size()));
+  if (ZDICT_isError(size)) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              std::string("TZstdCodec: cannot train dictionary: ") +
+                              ZDICT_getErrorName(size));
+  }
+  dictionary.resize(size);
+  return dictionary;
+}
+
+}}} // apache::thrift::transport
@@ -0,0 +1,84 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_TZSTDCODEC_H_
+#define _THRIFT_TRANSPORT_TZSTDCODEC_H_ 1
+
+#include <thrift/transport/TCompressedTransport.h>
+
+#include <string>
+#include <vector>
+
+struct ZSTD_CCtx_s;
+struct ZSTD_DCtx_s;
+struct ZSTD_CDict_s;
+struct ZSTD_DDict_s;
+
+namespace apache { namespace thrift { namespace transport {
+
+/**
+ * Zstandard block compression.  Its compression and decompression contexts
+ * are kept from block to block, as are its dictionaries, which are only
+ * digested once.
+ *
+ * Frames are written without the checksum, size and dictionary id fields,
+ * which the block header makes up for or which a block does not need.
+ */
+class TZstdCodec : public TCompressionCodec {
+ public:
+  static const int DEFAULT_LEVEL = 1;
+
+  /**
+   * @param level      compression level, negative for faster than level 1
+   * @param dictionary the dictionary to compress with, if not empty, raw or
+   *                   as made by trainDictionary()
+   */
+  TZstdCodec(int level = DEFAULT_LEVEL,
+             const std::string& dictionary = std::string());
+  ~TZstdCodec();
+
+  uint8_t getId() const {
+    return CODEC_ZSTD;
+  }
+
+  const char* getName() const {
+    return "zstd";
+  }
+
+  uint32_t compressBound(uint32_t len);
+  uint32_t compress(const uint8_t* in, uint32_t len, uint8_t* out);
+  void decompress(const uint8_t* in, uint32_t len, uint8_t* out, uint32_t outLen);
+
+  /**
+   * Trains a dictionary of at most maxSize bytes on sample messages, which
+   * should be many, and like the ones it is to compress.
+   */
+  static std::string trainDictionary(const std::vector<std::string>& samples,
+                                     size_t maxSize);
+
+ private:
+  struct ZSTD_CCtx_s* cctx_;
+  struct ZSTD_DCtx_s* dctx_;
+  struct ZSTD_CDict_s* cdict_;
+  struct ZSTD_DDict_s* ddict_;
+};
+
+}}} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_TZSTDCODEC_H_
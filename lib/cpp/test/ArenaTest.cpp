@@ -0,0 +1,167 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/auto_unit_test.hpp>
+#include <thrift/TArena.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <string.h>
+#include <map>
+#include <vector>
+#include "gen-cpp/ArenaTest_types.h"
+
+using apache::thrift::TArena;
+using apache::thrift::TArenaAllocator;
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::test::ArenaTree;
+using apache::thrift::transport::TMemoryBuffer;
+using boost::shared_ptr;
+
+namespace {
+
+typedef std::vector<int, TArenaAllocator<int> > ArenaVector;
+typedef std::map<int, int, std::less<int>, TArenaAllocator<std::pair<const int, int> > >
+  ArenaMap;
+
+bool inArena(const TArena& arena, size_t before) {
+  return arena.getBytesUsed() > before;
+}
+
+ArenaTree makeTree(int depth) {
+  ArenaTree tree;
+  tree.item = static_cast<int16_t>(depth);
+  tree.tags["depth"].insert(depth);
+  if (depth > 0) {
+    for (int i = 0; i < 3; ++i) {
+      tree.children.push_back(makeTree(depth - 1));
+    }
+  }
+  return tree;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE( ArenaTest )
+
+BOOST_AUTO_TEST_CASE( test_allocate ) {
+  TArena arena(1024);
+  BOOST_CHECK_EQUAL(arena.getBytesUsed(), 0U);
+
+  char* a = static_cast<char*>(arena.allocate(1));
+  char* b = static_cast<char*>(arena.allocate(7));
+  BOOST_CHECK_EQUAL(reinterpret_cast<size_t>(a) % TArena::ALIGNMENT, 0U);
+  BOOST_CHECK_EQUAL(reinterpret_cast<size_t>(b) % TArena::ALIGNMENT, 0U);
+  BOOST_CHECK_EQUAL(b - a, static_cast<ptrdiff_t>(TArena::ALIGNMENT));
+  BOOST_CHECK_EQUAL(arena.getBytesUsed(), 2 * TArena::ALIGNMENT);
+
+  // Spill into further blocks, and one allocation too big to share a block
+  for (int i = 0; i < 200; ++i) {
+    memset(arena.allocate(48), i, 48);
+  }
+  memset(arena.allocate(4096), 0, 4096);
+  BOOST_CHECK_EQUAL(arena.getBytesUsed(), 2 * TArena::ALIGNMENT + 200 * 48 + 4096);
+
+  // The block kept by reset() is reused from its start
+  arena.reset();
+  BOOST_CHECK_EQUAL(arena.getBytesUsed(), 0U);
+  char* c = static_cast<char*>(arena.allocate(16));
+  char* d = static_cast<char*>(arena.allocate(16));
+  BOOST_CHECK_EQUAL(d - c, 16);
+}
+
+BOOST_AUTO_TEST_CASE( test_scope ) {
+  BOOST_CHECK(TArena::getCurrent() == NULL);
+  TArena outer;
+  TArena inner;
+  {
+    TArena::Scope outerScope(&outer);
+    BOOST_CHECK(TArena::getCurrent() == &outer);
+    {
+      TArena::Scope innerScope(&inner);
+      BOOST_CHECK(TArena::getCurrent() == &inner);
+      {
+        TArena::Scope heapScope(NULL);
+        BOOST_CHECK(TArena::getCurrent() == NULL);
+      }
+      BOOST_CHECK(TArena::getCurrent() == &inner);
+    }
+    BOOST_CHECK(TArena::getCurrent() == &outer);
+  }
+  BOOST_CHECK(TArena::getCurrent() == NULL);
+}
+
+BOOST_AUTO_TEST_CASE( test_allocator ) {
+  TArena arena;
+  ArenaVector heapVector(10, 1);
+  BOOST_CHECK_EQUAL(arena.getBytesUsed(), 0U);
+  {
+    TArena::Scope scope(&arena);
+    ArenaMap map;
+    for (int i = 0; i < 1000; ++i) {
+      map[i] = i;
+    }
+    BOOST_CHECK(inArena(arena, 0));
+    BOOST_CHECK_EQUAL(map.size(), 1000U);
+
+    // Heap memory is freed to the heap even while an arena is current,
+    // and growing it moves it into the arena
+    heapVector.resize(1000, 2);
+    BOOST_CHECK_EQUAL(heapVector[999], 2);
+  }
+
+  // Arena memory released after the scope ends is left to reset(), and
+  // the arena knows it is no longer in use
+  BOOST_CHECK_EQUAL(arena.getLiveAllocations(), 1U);
+  size_t used = arena.getBytesUsed();
+  heapVector.clear();
+  ArenaVector().swap(heapVector);
+  BOOST_CHECK_EQUAL(arena.getBytesUsed(), used);
+  BOOST_CHECK_EQUAL(arena.getLiveAllocations(), 0U);
+  arena.reset();
+}
+
+BOOST_AUTO_TEST_CASE( test_generated_struct ) {
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  TBinaryProtocol prot(buf);
+  ArenaTree tree = makeTree(4);
+  tree.write(&prot);
+
+  TArena arena;
+  ArenaTree kept;
+  {
+    TArena::Scope scope(&arena);
+    ArenaTree result;
+    result.read(&prot);
+    BOOST_CHECK(inArena(arena, 0));
+    BOOST_CHECK(result == tree);
+
+    // A value copied outside the arena survives the reset
+    size_t used = arena.getBytesUsed();
+    {
+      TArena::Scope heap(NULL);
+      kept = result;
+    }
+    BOOST_CHECK_EQUAL(arena.getBytesUsed(), used);
+  }
+  BOOST_CHECK_EQUAL(arena.getLiveAllocations(), 0U);
+  arena.reset();
+  BOOST_CHECK(kept == tree);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -24,6 +24,9 @@
 #include <cmath>
 #include "thrift/transport/TBufferTransports.h"
 #include "thrift/protocol/TBinaryProtocol.h"
+#include "thrift/protocol/TCompactProtocol.h"
+#include "thrift/protocol/TJSONProtocol.h"
+#include "thrift/protocol/TTableCodec.h"
 #include "gen-cpp/DebugProtoTest_types.h"
 #include <time.h>
 #ifdef HAVE_SYS_TIME_H
@@ -51,6 +54,213 @@ public:
 
 };
 
+// Times a list<double> of a million elements written and read one element
+// at a time and through the bulk array calls.
+template <class Protocol_>
+void benchmarkDoubleList(const char* name) {
+  using namespace std;
+  using namespace apache::thrift::transport;
+
+  const uint32_t count = 1000000;
+  const int rounds = 20;
+  vector<double> values(count);
+  for (uint32_t i = 0; i < count; i ++) {
+    values[i] = i * 0.5;
+  }
+  vector<double> result(count);
+  boost::shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer(count * 9));
+  Protocol_ prot(buf);
+
+  {
+    Timer timer;
+    for (int r = 0; r < rounds; r ++) {
+      buf->resetBuffer();
+      for (uint32_t i = 0; i < count; i ++) {
+        prot.writeDouble(values[i]);
+      }
+    }
+    double write = rounds * count / (1000000 * timer.frame());
+    timer.start();
+    for (int r = 0; r < rounds; r ++) {
+      buf->resetBuffer();
+      prot.writeDoubleArray(&values[0], count);
+    }
+    cout << " " << name << " write doubles: " << write << " M/s, bulk: "
+         << rounds * count / (1000000 * timer.frame()) << " M/s" << endl;
+  }
+
+  uint8_t* data;
+  uint32_t datasize;
+  buf->getBuffer(&data, &datasize);
+  string serialized((const char*)data, datasize);
+
+  {
+    Timer timer;
+    for (int r = 0; r < rounds; r ++) {
+      buf->resetBuffer((uint8_t*)serialized.data(), datasize);
+      for (uint32_t i = 0; i < count; i ++) {
+        prot.readDouble(result[i]);
+      }
+    }
+    double read = rounds * count / (1000000 * timer.frame());
+    timer.start();
+    for (int r = 0; r < rounds; r ++) {
+      buf->resetBuffer((uint8_t*)serialized.data(), datasize);
+      prot.readDoubleArray(&result[0], count);
+    }
+    cout << " " << name << " read doubles: " << read << " M/s, bulk: "
+         << rounds * count / (1000000 * timer.frame()) << " M/s" << endl;
+  }
+}
+
+// Times a struct written and read through the JSON protocol, whose cost is
+// mostly number formatting and parsing and string escaping.
+template <class Struct_>
+void benchmarkJSON(const char* name, const Struct_& value, int num) {
+  using namespace std;
+  using namespace apache::thrift::transport;
+  using namespace apache::thrift::protocol;
+
+  boost::shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  TJSONProtocol prot(buf);
+
+  {
+    Timer timer;
+    for (int i = 0; i < num; i ++) {
+      buf->resetBuffer();
+      value.write(&prot);
+    }
+    double frame = timer.frame();
+    cout << " JSON write " << name << ": " << num / (1000 * frame) << " kHz, "
+         << (double)num * buf->available_read() / (1000000 * frame) << " MB/s" << endl;
+  }
+
+  string serialized = buf->getBufferAsString();
+
+  {
+    Timer timer;
+    for (int i = 0; i < num; i ++) {
+      Struct_ value2;
+      boost::shared_ptr<TMemoryBuffer> buf2(
+        new TMemoryBuffer((uint8_t*)serialized.data(), (uint32_t)serialized.size()));
+      TJSONProtocol prot2(buf2);
+      value2.read(&prot2);
+    }
+    double frame = timer.frame();
+    cout << " JSON read " << name << ": " << num / (1000 * frame) << " kHz, "
+         << (double)num * serialized.size() / (1000000 * frame) << " MB/s" << endl;
+  }
+}
+
+using apache::thrift::protocol::TContainerTable;
+using apache::thrift::protocol::TFieldTable;
+using apache::thrift::protocol::TStructTable;
+using apache::thrift::protocol::TListOps;
+using apache::thrift::protocol::T_BOOL;
+using apache::thrift::protocol::T_BYTE;
+using apache::thrift::protocol::T_I16;
+using apache::thrift::protocol::T_I32;
+using apache::thrift::protocol::T_I64;
+using apache::thrift::protocol::T_DOUBLE;
+using apache::thrift::protocol::T_STRING;
+using apache::thrift::protocol::T_LIST;
+using apache::thrift::protocol::T_STOP;
+using thrift::test::debug::OneOfEach;
+
+// The tables the tables option would generate for OneOfEach, so that
+// TTableCodec can be timed against the generated code of the same struct
+static const TContainerTable byteListTable = {
+  { T_BYTE, false, NULL, NULL }, { T_STOP, false, NULL, NULL },
+  &TListOps<std::vector<int8_t> >::ops, false
+};
+static const TContainerTable i16ListTable = {
+  { T_I16, false, NULL, NULL }, { T_STOP, false, NULL, NULL },
+  &TListOps<std::vector<int16_t> >::ops, false
+};
+static const TContainerTable i64ListTable = {
+  { T_I64, false, NULL, NULL }, { T_STOP, false, NULL, NULL },
+  &TListOps<std::vector<int64_t> >::ops, true
+};
+
+#define ONE_OF_EACH_FIELD(id_, name_, type_, binary_, list_)             \
+  { id_, #name_, { type_, binary_, NULL, list_ }, 0,                     \
+    THRIFT_FIELD_OFFSET(OneOfEach, name_),                               \
+    static_cast<int32_t>(THRIFT_FIELD_OFFSET(OneOfEach, __isset.name_)) }
+
+static const TFieldTable oneOfEachFields[] = {
+  ONE_OF_EACH_FIELD(1, im_true, T_BOOL, false, NULL),
+  ONE_OF_EACH_FIELD(2, im_false, T_BOOL, false, NULL),
+  ONE_OF_EACH_FIELD(3, a_bite, T_BYTE, false, NULL),
+  ONE_OF_EACH_FIELD(4, integer16, T_I16, false, NULL),
+  ONE_OF_EACH_FIELD(5, integer32, T_I32, false, NULL),
+  ONE_OF_EACH_FIELD(6, integer64, T_I64, false, NULL),
+  ONE_OF_EACH_FIELD(7, double_precision, T_DOUBLE, false, NULL),
+  ONE_OF_EACH_FIELD(8, some_characters, T_STRING, false, NULL),
+  ONE_OF_EACH_FIELD(9, zomg_unicode, T_STRING, false, NULL),
+  ONE_OF_EACH_FIELD(10, what_who, T_BOOL, false, NULL),
+  ONE_OF_EACH_FIELD(11, base64, T_STRING, true, NULL),
+  ONE_OF_EACH_FIELD(12, byte_list, T_LIST, false, &byteListTable),
+  ONE_OF_EACH_FIELD(13, i16_list, T_LIST, false, &i16ListTable),
+  ONE_OF_EACH_FIELD(14, i64_list, T_LIST, false, &i64ListTable)
+};
+
+static const TStructTable oneOfEachTable = { "OneOfEach", oneOfEachFields, 14 };
+
+// Times OneOfEach written and read through Protocol_ by its generated code
+// and by TTableCodec, both called through TProtocol as generated code is.
+template <class Protocol_>
+void benchmarkTable(const char* name, const OneOfEach& ooe, int num) {
+  using namespace std;
+  using namespace apache::thrift::transport;
+  using namespace apache::thrift::protocol;
+
+  boost::shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  Protocol_ prot(buf);
+  TProtocol* iprot = &prot;
+
+  string generated;
+  string table;
+  {
+    Timer timer;
+    for (int i = 0; i < num; i ++) {
+      buf->resetBuffer();
+      ooe.write(iprot);
+    }
+    double write = num / (1000 * timer.frame());
+    generated = buf->getBufferAsString();
+    timer.start();
+    for (int i = 0; i < num; i ++) {
+      buf->resetBuffer();
+      table_write(iprot, oneOfEachTable, &ooe);
+    }
+    cout << " " << name << " write: " << write << " kHz, table: "
+         << num / (1000 * timer.frame()) << " kHz" << endl;
+    table = buf->getBufferAsString();
+  }
+
+  if (table != generated) {
+    cout << " " << name << " table output differs!" << endl;
+  }
+
+  {
+    Timer timer;
+    for (int i = 0; i < num; i ++) {
+      OneOfEach ooe2;
+      buf->resetBuffer((uint8_t*)generated.data(), (uint32_t)generated.size());
+      ooe2.read(iprot);
+    }
+    double read = num / (1000 * timer.frame());
+    timer.start();
+    for (int i = 0; i < num; i ++) {
+      OneOfEach ooe2;
+      buf->resetBuffer((uint8_t*)generated.data(), (uint32_t)generated.size());
+      table_read(iprot, oneOfEachTable, &ooe2);
+    }
+    cout << " " << name << " read: " << read << " kHz, table: "
+         << num / (1000 * timer.frame()) << " kHz" << endl;
+  }
+}
+
 int main() {
   using namespace std;
   using namespace thrift::test::debug;
@@ -106,6 +316,81 @@ int main() {
     cout << " Read: " << num / (1000 * timer.frame()) << " kHz" << endl;
   }
 
+  {
+
+    Timer timer;
+
+    for (int i = 0; i < num; i ++) {
+      OneOfEachView ooe2;
+      boost::shared_ptr<TMemoryBuffer> buf2(new TMemoryBuffer(data, datasize));
+      TBinaryProtocolT<TBufferBase> prot(buf2);
+      ooe2.read(&prot);
+    }
+    cout << " Read (view): " << num / (1000 * timer.frame()) << " kHz" << endl;
+  }
+
+  // Large binary fields are where views pay off: the owning read copies
+  // every blob, the view read only points into the buffer.
+  Base64 b64;
+  b64.a = 1;
+  b64.b1.assign(64 * 1024, 'a');
+  b64.b2.assign(64 * 1024, 'b');
+  b64.b3.assign(64 * 1024, 'c');
+  b64.b4.assign(64 * 1024, 'd');
+  b64.b5.assign(64 * 1024, 'e');
+  b64.b6.assign(64 * 1024, 'f');
+
+  buf->resetBuffer();
+  {
+    TBinaryProtocolT<TBufferBase> prot(buf);
+    b64.write(&prot);
+  }
+  buf->getBuffer(&data, &datasize);
+
+  int bigNum = 10000;
+
+  {
+
+    Timer timer;
+
+    for (int i = 0; i < bigNum; i ++) {
+      Base64 b642;
+      boost::shared_ptr<TMemoryBuffer> buf2(new TMemoryBuffer(data, datasize));
+      TBinaryProtocolT<TBufferBase> prot(buf2);
+      b642.read(&prot);
+    }
+    cout << " Read 384KiB: " << bigNum / (1000 * timer.frame()) << " kHz" << endl;
+  }
+
+  {
+
+    Timer timer;
+
+    for (int i = 0; i < bigNum; i ++) {
+      Base64View b642;
+      boost::shared_ptr<TMemoryBuffer> buf2(new TMemoryBuffer(data, datasize));
+      TBinaryProtocolT<TBufferBase> prot(buf2);
+      b642.read(&prot);
+    }
+    cout << " Read 384KiB (view): " << bigNum / (1000 * timer.frame()) << " kHz" << endl;
+  }
+
+  benchmarkDoubleList<TBinaryProtocolT<TBufferBase> >("Binary");
+  benchmarkDoubleList<TCompactProtocolT<TBufferBase> >("Compact");
+
+  benchmarkTable<TBinaryProtocol>("Binary", ooe, num);
+  benchmarkTable<TCompactProtocol>("Compact", ooe, num);
+
+  benchmarkJSON("OneOfEach", ooe, 100000);
+
+  CompactProtoTestStruct numbers;
+  for (int i = 0; i < 10000; i ++) {
+    numbers.i64_list.push_back((int64_t)i * 1000003 - 5000000000LL);
+    numbers.double_list.push_back(i / 7.0);
+  }
+  numbers.a_string.assign(64 * 1024, 'x');
+  benchmarkJSON("10k numbers", numbers, 100);
+
 
   return 0;
 }
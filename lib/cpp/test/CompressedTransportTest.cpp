@@ -0,0 +1,304 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define BOOST_TEST_MODULE CompressedTransportTest
+#include <boost/test/unit_test.hpp>
+
+#include <thrift/thrift-config.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/TCompressedTransport.h>
+#ifdef HAVE_LZ4
+#include <thrift/transport/TLZ4Codec.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <thrift/transport/TZstdCodec.h>
+#endif
+
+#include <stdlib.h>
+#include <vector>
+
+#include "gen-cpp/ThriftTest_types.h"
+
+using namespace apache::thrift::transport;
+using apache::thrift::protocol::TBinaryProtocol;
+using boost::shared_ptr;
+
+namespace {
+
+// Codecs to test with, each made fresh, as codecs keep state
+std::vector<shared_ptr<TCompressionCodec> > makeCodecs(const std::string& dictionary = "") {
+  std::vector<shared_ptr<TCompressionCodec> > codecs;
+#ifdef HAVE_LZ4
+  codecs.push_back(shared_ptr<TCompressionCodec>(
+      new TLZ4Codec(TLZ4Codec::DEFAULT_ACCELERATION, dictionary)));
+#endif
+#ifdef HAVE_ZSTD
+  codecs.push_back(shared_ptr<TCompressionCodec>(
+      new TZstdCodec(TZstdCodec::DEFAULT_LEVEL, dictionary)));
+#endif
+  (void)dictionary;
+  return codecs;
+}
+
+std::string compressible(uint32_t len) {
+  std::string data;
+  while (data.size() < len) {
+    data += "the quick brown fox jumps over the lazy dog ";
+  }
+  data.resize(len);
+  return data;
+}
+
+std::string incompressible(uint32_t len) {
+  std::string data(len, '\0');
+  uint32_t x = 12345;
+  for (uint32_t i = 0; i < len; ++i) {
+    x = x * 1103515245 + 12345;
+    data[i] = static_cast<char>(x >> 24);
+  }
+  return data;
+}
+
+thrift::test::Insanity makeInsanity(int n) {
+  thrift::test::Insanity insanity;
+  insanity.userMap[thrift::test::Numberz::FIVE] = n;
+  insanity.userMap[thrift::test::Numberz::EIGHT] = n * 3;
+  for (int i = 0; i < 3; ++i) {
+    thrift::test::Xtruct xtruct;
+    xtruct.string_thing = "Goodbye4 " + compressible(static_cast<uint32_t>(n % 7));
+    xtruct.byte_thing = static_cast<int8_t>(i);
+    xtruct.i32_thing = n + i;
+    xtruct.i64_thing = static_cast<int64_t>(n) * 1000000 + i;
+    insanity.xtructs.push_back(xtruct);
+  }
+  return insanity;
+}
+
+std::string makeDictionary() {
+  shared_ptr<TMemoryBuffer> samples(new TMemoryBuffer());
+  TBinaryProtocol protocol(samples);
+  for (int n = 1000; n < 1100; ++n) {
+    makeInsanity(n).write(&protocol);
+  }
+  return samples->getBufferAsString();
+}
+
+// Writes small messages through a transport from one factory and reads
+// them back through one from another
+void checkFactories(TTransportFactory& writeFactory, TTransportFactory& readFactory,
+                    bool dictionary) {
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  shared_ptr<TTransport> writer = writeFactory.getTransport(buffer);
+  TBinaryProtocol writeProtocol(writer);
+  uint32_t uncompressed = 0;
+  for (int n = 0; n < 100; ++n) {
+    uncompressed += makeInsanity(n).write(&writeProtocol);
+    writer->flush();
+  }
+  if (dictionary) {
+    BOOST_CHECK_LT(buffer->available_read(), uncompressed / 2);
+  }
+
+  shared_ptr<TTransport> reader = readFactory.getTransport(buffer);
+  TBinaryProtocol readProtocol(reader);
+  for (int n = 0; n < 100; ++n) {
+    thrift::test::Insanity insanity;
+    insanity.read(&readProtocol);
+    BOOST_REQUIRE(insanity == makeInsanity(n));
+  }
+}
+
+int codecsMade = 0;
+
+template <class Codec_>
+shared_ptr<TCompressionCodec> countedCodec(int param, std::string dictionary) {
+  ++codecsMade;
+  return shared_ptr<TCompressionCodec>(new Codec_(param, dictionary));
+}
+
+template <class Codec_>
+void checkFactory(int param) {
+  std::string dictionary = makeDictionary();
+
+  // Constructor arguments, with every block compressed
+  TCompressedTransportFactory<Codec_> withDictionary(param, dictionary, 0);
+  checkFactories(withDictionary, withDictionary, true);
+
+  // A function, called for each transport
+  typedef typename TCompressedTransportFactory<Codec_>::codec_func_t codec_func_t;
+  codecsMade = 0;
+  TCompressedTransportFactory<Codec_> fromFunction(
+      codec_func_t(apache::thrift::stdcxx::bind(&countedCodec<Codec_>, param, dictionary)),
+      0);
+  checkFactories(fromFunction, withDictionary, true);
+  BOOST_CHECK_EQUAL(codecsMade, 1);
+
+  // Defaults
+  TCompressedTransportFactory<Codec_> plain;
+  checkFactories(plain, plain, false);
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE( CompressedTransportTest )
+
+BOOST_AUTO_TEST_CASE( test_blocks ) {
+  std::vector<shared_ptr<TCompressionCodec> > codecs = makeCodecs();
+  codecs.push_back(shared_ptr<TCompressionCodec>());
+
+  for (size_t c = 0; c < codecs.size(); ++c) {
+    shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+    TCompressedTransport writer(buffer, codecs[c]);
+
+    std::vector<std::string> blocks;
+    blocks.push_back(compressible(10));
+    blocks.push_back(compressible(100000));
+    blocks.push_back(incompressible(5000));
+    blocks.push_back(compressible(TCompressedTransport::DEFAULT_MIN_COMPRESS_SIZE));
+
+    // Which codec each block is framed with
+    std::vector<uint8_t> expected;
+    uint8_t id = codecs[c] ? codecs[c]->getId() : TCompressionCodec::CODEC_NONE;
+    expected.push_back(TCompressionCodec::CODEC_NONE);
+    expected.push_back(id);
+    expected.push_back(TCompressionCodec::CODEC_NONE);
+    expected.push_back(id);
+
+    std::vector<uint32_t> offsets;
+    for (size_t i = 0; i < blocks.size(); ++i) {
+      offsets.push_back(buffer->available_read());
+      // in pieces, as protocols write
+      writer.write(reinterpret_cast<const uint8_t*>(blocks[i].data()), 3);
+      writer.write(reinterpret_cast<const uint8_t*>(blocks[i].data()) + 3,
+                   static_cast<uint32_t>(blocks[i].size()) - 3);
+      writer.flush();
+    }
+    // nothing written, so no block
+    writer.flush();
+
+    std::string raw = buffer->getBufferAsString();
+    if (codecs[c]) {
+      BOOST_CHECK(raw.size() < 100000);
+    }
+    for (size_t i = 0; i < blocks.size(); ++i) {
+      BOOST_CHECK_EQUAL(static_cast<int>(static_cast<uint8_t>(raw[offsets[i]])),
+                        static_cast<int>(expected[i]));
+    }
+
+    TCompressedTransport reader(buffer, codecs[c]);
+    for (size_t i = 0; i < blocks.size(); ++i) {
+      std::string got(blocks[i].size(), '\0');
+      reader.readAll(reinterpret_cast<uint8_t*>(&got[0]), static_cast<uint32_t>(got.size()));
+      BOOST_CHECK(got == blocks[i]);
+    }
+    uint8_t byte;
+    BOOST_CHECK_EQUAL(reader.read(&byte, 1), 0U);
+  }
+}
+
+BOOST_AUTO_TEST_CASE( test_structs_with_dictionary ) {
+  // Small messages, which a dictionary of others like them makes worth
+  // compressing
+  std::string dictionary = makeDictionary();
+
+  std::vector<shared_ptr<TCompressionCodec> > writeCodecs = makeCodecs(dictionary);
+  std::vector<shared_ptr<TCompressionCodec> > readCodecs = makeCodecs(dictionary);
+  for (size_t c = 0; c < writeCodecs.size(); ++c) {
+    shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+    shared_ptr<TCompressedTransport> writer(
+        new TCompressedTransport(buffer, writeCodecs[c], 0));
+    TBinaryProtocol writeProtocol(writer);
+    uint32_t uncompressed = 0;
+    for (int n = 0; n < 100; ++n) {
+      uncompressed += makeInsanity(n).write(&writeProtocol);
+      writer->flush();
+    }
+    BOOST_CHECK_LT(buffer->available_read(), uncompressed / 2);
+
+    shared_ptr<TCompressedTransport> reader(
+        new TCompressedTransport(buffer, readCodecs[c]));
+    TBinaryProtocol readProtocol(reader);
+    for (int n = 0; n < 100; ++n) {
+      thrift::test::Insanity insanity;
+      insanity.read(&readProtocol);
+      BOOST_REQUIRE(insanity == makeInsanity(n));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE( test_factory ) {
+#ifdef HAVE_LZ4
+  checkFactory<TLZ4Codec>(2);
+#endif
+#ifdef HAVE_ZSTD
+  checkFactory<TZstdCodec>(3);
+#endif
+}
+
+BOOST_AUTO_TEST_CASE( test_bad_blocks ) {
+  std::vector<shared_ptr<TCompressionCodec> > codecs = makeCodecs();
+  for (size_t c = 0; c < codecs.size(); ++c) {
+    shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+    TCompressedTransport writer(buffer, codecs[c]);
+    std::string block = compressible(10000);
+    writer.write(reinterpret_cast<const uint8_t*>(block.data()),
+                 static_cast<uint32_t>(block.size()));
+    writer.flush();
+    std::string raw = buffer->getBufferAsString();
+    uint8_t buf[100];
+
+    // garbled
+    std::string garbled = raw;
+    for (size_t i = TCompressedTransport::HEADER_SIZE; i < garbled.size(); i += 7) {
+      garbled[i] = static_cast<char>(~garbled[i]);
+    }
+    shared_ptr<TMemoryBuffer> in(new TMemoryBuffer());
+    in->write(reinterpret_cast<const uint8_t*>(garbled.data()),
+              static_cast<uint32_t>(garbled.size()));
+    TCompressedTransport garbledReader(in, codecs[c]);
+    BOOST_CHECK_THROW(garbledReader.read(buf, sizeof(buf)), TTransportException);
+
+    // with a codec the reader does not have
+    in.reset(new TMemoryBuffer());
+    in->write(reinterpret_cast<const uint8_t*>(raw.data()), static_cast<uint32_t>(raw.size()));
+    TCompressedTransport plainReader(in, shared_ptr<TCompressionCodec>());
+    BOOST_CHECK_THROW(plainReader.read(buf, sizeof(buf)), TTransportException);
+
+    // larger than allowed
+    in.reset(new TMemoryBuffer());
+    in->write(reinterpret_cast<const uint8_t*>(raw.data()), static_cast<uint32_t>(raw.size()));
+    TCompressedTransport smallReader(in, codecs[c]);
+    smallReader.setMaxBlockSize(1000);
+    BOOST_CHECK_THROW(smallReader.read(buf, sizeof(buf)), TTransportException);
+
+    // cut short in the header
+    in.reset(new TMemoryBuffer());
+    in->write(reinterpret_cast<const uint8_t*>(raw.data()), 4);
+    TCompressedTransport shortReader(in, codecs[c]);
+    try {
+      shortReader.read(buf, sizeof(buf));
+      BOOST_ERROR("expected END_OF_FILE");
+    } catch (TTransportException& e) {
+      BOOST_CHECK_EQUAL(e.getType(), TTransportException::END_OF_FILE);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,223 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Compares TCompressedTransport's codecs, and TZlibTransport, on serialized
+ * ThriftTest structs, written and read a message at a time as RPC would.
+ * For each it reports:
+ *
+ *   ratio      uncompressed bytes over bytes sent
+ *   write_MB/s uncompressed bytes written and flushed per second
+ *   read_MB/s  uncompressed bytes read per second
+ *
+ * Usage: CompressionBenchmark [--messages=N] [--xtructs=N]
+ * (defaults: 20000 Insanity messages of 3 Xtructs each).  The "+dict"
+ * codecs use a Zstandard dictionary trained on other messages like them.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <thrift/thrift-config.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/TCompressedTransport.h>
+#include <thrift/transport/TZlibTransport.h>
+#ifdef HAVE_LZ4
+#include <thrift/transport/TLZ4Codec.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <thrift/transport/TZstdCodec.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <string>
+#include <vector>
+
+#include "gen-cpp/ThriftTest_types.h"
+
+using namespace apache::thrift::transport;
+using apache::thrift::protocol::TBinaryProtocol;
+using boost::shared_ptr;
+
+static double now() {
+  timeval tv;
+  THRIFT_GETTIMEOFDAY(&tv, 0);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static const char* WORDS[] = {
+  "Hello", "Goodbye", "thrift", "compressed", "transport", "message", "zero",
+  "struct", "insanity", "numberz", "user", "map", "list"
+};
+
+/** Serializes an Insanity of numXtructs Xtructs, varying with n. */
+static std::string makeMessage(uint32_t n, uint32_t numXtructs) {
+  thrift::test::Insanity insanity;
+  insanity.userMap[thrift::test::Numberz::FIVE] = n;
+  insanity.userMap[thrift::test::Numberz::EIGHT] = n * 7919;
+  for (uint32_t i = 0; i < numXtructs; ++i) {
+    thrift::test::Xtruct xtruct;
+    uint32_t r = (n * 2654435761u) ^ (i * 40503u);
+    xtruct.string_thing = std::string(WORDS[r % 13]) + " " + WORDS[(r >> 8) % 13];
+    xtruct.byte_thing = static_cast<int8_t>(r >> 16);
+    xtruct.i32_thing = static_cast<int32_t>(r % 100000);
+    xtruct.i64_thing = static_cast<int64_t>(n) * 1000003 + i;
+    insanity.xtructs.push_back(xtruct);
+  }
+
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TBinaryProtocol protocol(buffer);
+  insanity.write(&protocol);
+  return buffer->getBufferAsString();
+}
+
+/**
+ * Writes every message through writer into wire, flushing after each, then
+ * reads them back through reader.
+ */
+static void runOne(const char* name,
+                   const shared_ptr<TMemoryBuffer>& wire,
+                   TTransport& writer,
+                   TTransport& reader,
+                   const std::vector<std::string>& messages) {
+  uint64_t total = 0;
+  for (size_t i = 0; i < messages.size(); ++i) {
+    total += messages[i].size();
+  }
+
+  double start = now();
+  for (size_t i = 0; i < messages.size(); ++i) {
+    writer.write(reinterpret_cast<const uint8_t*>(messages[i].data()),
+                 static_cast<uint32_t>(messages[i].size()));
+    writer.flush();
+  }
+  double writeTime = now() - start;
+  uint32_t sent = wire->available_read();
+
+  std::vector<uint8_t> buf;
+  start = now();
+  for (size_t i = 0; i < messages.size(); ++i) {
+    buf.resize(messages[i].size());
+    reader.readAll(&buf[0], static_cast<uint32_t>(buf.size()));
+    if (memcmp(&buf[0], messages[i].data(), buf.size()) != 0) {
+      fprintf(stderr, "%s: message %lu does not match\n", name, static_cast<unsigned long>(i));
+      exit(1);
+    }
+  }
+  double readTime = now() - start;
+
+  printf("%-12s %8.2f %12.1f %12.1f\n",
+         name,
+         static_cast<double>(total) / sent,
+         total / writeTime / (1024 * 1024),
+         total / readTime / (1024 * 1024));
+  fflush(stdout);
+}
+
+static void runCodec(const char* name,
+                     shared_ptr<TCompressionCodec> writeCodec,
+                     shared_ptr<TCompressionCodec> readCodec,
+                     const std::vector<std::string>& messages) {
+  shared_ptr<TMemoryBuffer> wire(new TMemoryBuffer());
+  TCompressedTransport writer(wire, writeCodec);
+  TCompressedTransport reader(wire, readCodec);
+  runOne(name, wire, writer, reader, messages);
+}
+
+int main(int argc, char** argv) {
+  uint32_t numMessages = 20000;
+  uint32_t numXtructs = 3;
+  for (int i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], "--messages=", 11) == 0) {
+      numMessages = static_cast<uint32_t>(atol(argv[i] + 11));
+    } else if (strncmp(argv[i], "--xtructs=", 10) == 0) {
+      numXtructs = static_cast<uint32_t>(atol(argv[i] + 10));
+    } else {
+      fprintf(stderr, "unknown argument %s\n", argv[i]);
+      return 1;
+    }
+  }
+  if (numMessages == 0) {
+    fprintf(stderr, "messages must be positive\n");
+    return 1;
+  }
+
+  std::vector<std::string> messages;
+  for (uint32_t n = 0; n < numMessages; ++n) {
+    messages.push_back(makeMessage(n, numXtructs));
+  }
+  printf("%u messages of %lu bytes on average\n\n",
+         numMessages,
+         static_cast<unsigned long>(messages[numMessages / 2].size()));
+  printf("%-12s %8s %12s %12s\n", "codec", "ratio", "write_MB/s", "read_MB/s");
+
+  runCodec("none", shared_ptr<TCompressionCodec>(), shared_ptr<TCompressionCodec>(), messages);
+
+  {
+    shared_ptr<TMemoryBuffer> wire(new TMemoryBuffer());
+    TZlibTransport writer(wire);
+    TZlibTransport reader(wire);
+    runOne("zlib", wire, writer, reader, messages);
+  }
+
+#ifdef HAVE_ZSTD
+  std::vector<std::string> samples;
+  for (uint32_t n = numMessages; n < numMessages + 2000; ++n) {
+    samples.push_back(makeMessage(n, numXtructs));
+  }
+  std::string dictionary = TZstdCodec::trainDictionary(samples, 16 * 1024);
+#else
+  std::string dictionary;
+#endif
+
+#ifdef HAVE_LZ4
+  runCodec("lz4",
+           shared_ptr<TCompressionCodec>(new TLZ4Codec()),
+           shared_ptr<TCompressionCodec>(new TLZ4Codec()),
+           messages);
+  if (!dictionary.empty()) {
+    runCodec("lz4+dict",
+             shared_ptr<TCompressionCodec>(new TLZ4Codec(TLZ4Codec::DEFAULT_ACCELERATION, dictionary)),
+             shared_ptr<TCompressionCodec>(new TLZ4Codec(TLZ4Codec::DEFAULT_ACCELERATION, dictionary)),
+             messages);
+  }
+#endif
+
+#ifdef HAVE_ZSTD
+  runCodec("zstd-1",
+           shared_ptr<TCompressionCodec>(new TZstdCodec(1)),
+           shared_ptr<TCompressionCodec>(new TZstdCodec(1)),
+           messages);
+  runCodec("zstd-3",
+           shared_ptr<TCompressionCodec>(new TZstdCodec(3)),
+           shared_ptr<TCompressionCodec>(new TZstdCodec(3)),
+           messages);
+  runCodec("zstd-1+dict",
+           shared_ptr<TCompressionCodec>(new TZstdCodec(1, dictionary)),
+           shared_ptr<TCompressionCodec>(new TZstdCodec(1, dictionary)),
+           messages);
+#endif
+
+  return 0;
+}
@@ -0,0 +1,92 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/auto_unit_test.hpp>
+#include <thrift/server/TConcurrencyLimiter.h>
+
+#include <unistd.h>
+
+using apache::thrift::server::TConcurrencyLimiter;
+
+BOOST_AUTO_TEST_SUITE( ConcurrencyLimiterTest )
+
+BOOST_AUTO_TEST_CASE( test_limit_admission ) {
+  TConcurrencyLimiter limiter(5000, 1, 1024);
+  size_t limit = limiter.getLimit();
+  BOOST_CHECK_EQUAL(limit, TConcurrencyLimiter::INITIAL_LIMIT);
+
+  for (size_t i = 0; i < limit; ++i) {
+    BOOST_CHECK(limiter.acquire());
+  }
+  BOOST_CHECK(!limiter.acquire());
+  BOOST_CHECK_EQUAL(limiter.getInFlight(), limit);
+  BOOST_CHECK_EQUAL(limiter.getRejectedCount(), 1u);
+
+  limiter.release(-1);
+  BOOST_CHECK(limiter.acquire());
+}
+
+BOOST_AUTO_TEST_CASE( test_limit_grows_while_fast_and_busy ) {
+  TConcurrencyLimiter limiter(5000, 1, 1024);
+  // Keep the limit saturated with requests that queue for no time at all
+  for (int round = 0; round < 2000; ++round) {
+    while (limiter.acquire()) {
+    }
+    limiter.release(0);
+  }
+  BOOST_CHECK(limiter.getLimit() > TConcurrencyLimiter::INITIAL_LIMIT);
+}
+
+BOOST_AUTO_TEST_CASE( test_limit_idle_does_not_grow ) {
+  TConcurrencyLimiter limiter(5000, 1, 1024);
+  for (int round = 0; round < 2000; ++round) {
+    BOOST_CHECK(limiter.acquire());
+    limiter.release(0);
+  }
+  BOOST_CHECK_EQUAL(limiter.getLimit(), TConcurrencyLimiter::INITIAL_LIMIT);
+}
+
+BOOST_AUTO_TEST_CASE( test_limit_backs_off_on_queueing ) {
+  TConcurrencyLimiter limiter(1000, 4, 1024);
+  BOOST_CHECK(limiter.acquire());
+  limiter.release(2000);
+  size_t limit = limiter.getLimit();
+  BOOST_CHECK(limit < TConcurrencyLimiter::INITIAL_LIMIT);
+
+  // A second late request out of the same backlog is not charged again
+  BOOST_CHECK(limiter.acquire());
+  limiter.release(2000);
+  BOOST_CHECK_EQUAL(limiter.getLimit(), limit);
+
+  // ...but one after the backlog had time to drain is
+  usleep(3000);
+  BOOST_CHECK(limiter.acquire());
+  limiter.release(2000);
+  BOOST_CHECK(limiter.getLimit() < limit);
+
+  // and the limit never drops under its floor
+  for (int i = 0; i < 100; ++i) {
+    usleep(2000);
+    limiter.acquire();
+    limiter.release(1500);
+  }
+  BOOST_CHECK_EQUAL(limiter.getLimit(), 4u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,166 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/auto_unit_test.hpp>
+#include <boost/shared_ptr.hpp>
+#include <thrift/TDispatchProcessor.h>
+#include <thrift/concurrency/Util.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TDeadlineProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+
+#include <unistd.h>
+
+using apache::thrift::TDispatchProcessor;
+using apache::thrift::concurrency::Util;
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TDeadlineProtocol;
+using apache::thrift::protocol::TMessageType;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::protocol::T_CALL;
+using apache::thrift::protocol::T_REPLY;
+using apache::thrift::protocol::T_STRUCT;
+using apache::thrift::transport::TMemoryBuffer;
+using boost::shared_ptr;
+
+BOOST_AUTO_TEST_SUITE( DeadlineTest )
+
+/**
+ * Answers every call with an empty struct, after sleeping for delayMs
+ */
+class SleepProcessor : public TDispatchProcessor {
+ public:
+  SleepProcessor(int delayMs) : calls(0), delayMs_(delayMs) {}
+
+  int calls;
+  std::string lastName;
+
+ protected:
+  bool dispatchCall(TProtocol* in, TProtocol* out,
+                    const std::string& fname, int32_t seqid, void*) {
+    ++calls;
+    lastName = fname;
+    in->skip(T_STRUCT);
+    in->readMessageEnd();
+    in->getTransport()->readEnd();
+
+    usleep(delayMs_ * 1000);
+
+    out->writeMessageBegin(fname, T_REPLY, seqid);
+    out->writeStructBegin("result");
+    out->writeFieldStop();
+    out->writeStructEnd();
+    out->writeMessageEnd();
+    out->getTransport()->writeEnd();
+    out->getTransport()->flush();
+    return true;
+  }
+
+ private:
+  int delayMs_;
+};
+
+void writeCall(shared_ptr<TProtocol> proto, const std::string& name) {
+  proto->writeMessageBegin(name, T_CALL, 7);
+  proto->writeStructBegin("args");
+  proto->writeFieldStop();
+  proto->writeStructEnd();
+  proto->writeMessageEnd();
+}
+
+BOOST_AUTO_TEST_CASE( test_client_appends_budget ) {
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  shared_ptr<TProtocol> binary(new TBinaryProtocol(buffer));
+  shared_ptr<TDeadlineProtocol> deadline(new TDeadlineProtocol(binary));
+
+  writeCall(deadline, "ping");
+  deadline->setTimeout(150);
+  writeCall(deadline, "ping");
+
+  std::string name;
+  TMessageType type;
+  int32_t seqid;
+  binary->readMessageBegin(name, type, seqid);
+  BOOST_CHECK_EQUAL(name, "ping");
+  binary->skip(T_STRUCT);
+  binary->readMessageEnd();
+  binary->readMessageBegin(name, type, seqid);
+  BOOST_CHECK_EQUAL(name, "ping@150");
+}
+
+BOOST_AUTO_TEST_CASE( test_strip_deadline ) {
+  int64_t deadline = 0;
+  std::string name("Calculator:add@250");
+  int64_t now = Util::currentTime();
+  BOOST_CHECK(TDeadlineProtocol::stripDeadline(name, deadline));
+  BOOST_CHECK_EQUAL(name, "Calculator:add");
+  BOOST_CHECK(deadline >= now + 250 && deadline <= Util::currentTime() + 250);
+
+  TDeadlineProtocol::setArrivalTime(now - 1000);
+  name = "add@250";
+  BOOST_CHECK(TDeadlineProtocol::stripDeadline(name, deadline));
+  BOOST_CHECK_EQUAL(deadline, now - 750);
+  BOOST_CHECK(TDeadlineProtocol::isExpired(deadline));
+
+  name = "add";
+  BOOST_CHECK(!TDeadlineProtocol::stripDeadline(name, deadline));
+  name = "add@";
+  BOOST_CHECK(!TDeadlineProtocol::stripDeadline(name, deadline));
+  name = "add@1x";
+  BOOST_CHECK(!TDeadlineProtocol::stripDeadline(name, deadline));
+  BOOST_CHECK_EQUAL(name, "add@1x");
+}
+
+BOOST_AUTO_TEST_CASE( test_processor_honours_deadline ) {
+  shared_ptr<TMemoryBuffer> inBuffer(new TMemoryBuffer());
+  shared_ptr<TMemoryBuffer> outBuffer(new TMemoryBuffer());
+  shared_ptr<TProtocol> in(new TBinaryProtocol(inBuffer));
+  shared_ptr<TProtocol> out(new TBinaryProtocol(outBuffer));
+
+  // In time: dispatched under its plain name and answered
+  SleepProcessor fast(0);
+  writeCall(in, "ping@10000");
+  BOOST_CHECK(fast.process(in, out, NULL));
+  BOOST_CHECK_EQUAL(fast.calls, 1);
+  BOOST_CHECK_EQUAL(fast.lastName, "ping");
+  BOOST_CHECK(outBuffer->available_read() > 0);
+  outBuffer->resetBuffer();
+
+  // Late on arrival: skipped without dispatching or answering
+  writeCall(in, "ping@10");
+  writeCall(in, "ping");
+  TDeadlineProtocol::setArrivalTime(Util::currentTime() - 100);
+  BOOST_CHECK(fast.process(in, out, NULL));
+  BOOST_CHECK_EQUAL(fast.calls, 1);
+  BOOST_CHECK_EQUAL(outBuffer->available_read(), 0u);
+  // ...leaving the following call intact
+  BOOST_CHECK(fast.process(in, out, NULL));
+  BOOST_CHECK_EQUAL(fast.calls, 2);
+  BOOST_CHECK(outBuffer->available_read() > 0);
+  outBuffer->resetBuffer();
+
+  // Overran by the handler: dispatched, but the reply is dropped
+  SleepProcessor slow(50);
+  writeCall(in, "ping@10");
+  BOOST_CHECK(slow.process(in, out, NULL));
+  BOOST_CHECK_EQUAL(slow.calls, 1);
+  BOOST_CHECK_EQUAL(outBuffer->available_read(), 0u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -30,4 +30,9 @@ bool Empty::operator<(Empty const& other) const {
   return false;
 }
 
+bool EmptyView::operator<(EmptyView const& other) const {
+  (void) other;
+  return false;
+}
+
 }}}
@@ -0,0 +1,117 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/auto_unit_test.hpp>
+#include <string.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TFieldDispatch.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/DebugProtoTest_types.h"
+
+using namespace apache::thrift::protocol;
+using apache::thrift::transport::TMemoryBuffer;
+using boost::shared_ptr;
+using thrift::test::debug::Bonk;
+
+namespace {
+
+// Counts of the stats named name, or zero if it has not counted anything
+void findStats(const char* name, long& outOfOrder, long& unknown) {
+  outOfOrder = 0;
+  unknown = 0;
+  for (TFieldStats* stats = field_stats_list(); stats != NULL; stats = stats->next) {
+    if (strcmp(stats->name, name) == 0) {
+      outOfOrder = stats->outOfOrder;
+      unknown = stats->unknown;
+    }
+  }
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE( FieldDispatchTest )
+
+BOOST_AUTO_TEST_CASE( test_field_index ) {
+  const int16_t ids[] = { -2, 1, 5, 100, 32000 };
+  // Counted stats join a list that lives as long as the program
+  static TFieldStats stats = { "test_field_index", 0, 0, 0, NULL };
+  uint32_t next = 0;
+
+  // In order, with absent fields between
+  BOOST_CHECK_EQUAL(field_index(ids, 5, -2, next, &stats), 0U);
+  BOOST_CHECK_EQUAL(field_index(ids, 5, 5, next, &stats), 2U);
+  BOOST_CHECK_EQUAL(next, 3U);
+  BOOST_CHECK_EQUAL(field_index(ids, 5, 32000, next, &stats), 4U);
+  BOOST_CHECK_EQUAL(stats.outOfOrder, 0);
+
+  // Out of order, and unknown
+  BOOST_CHECK_EQUAL(field_index(ids, 5, 1, next, &stats), 1U);
+  BOOST_CHECK_EQUAL(next, 2U);
+  BOOST_CHECK_EQUAL(field_index(ids, 5, 6, next, &stats), 5U);
+  BOOST_CHECK_EQUAL(field_index(ids, 5, 32001, next, &stats), 5U);
+  BOOST_CHECK_EQUAL(next, 2U);
+  BOOST_CHECK_EQUAL(stats.outOfOrder, 1);
+  BOOST_CHECK_EQUAL(stats.unknown, 2);
+
+  BOOST_CHECK_EQUAL(field_index(ids, 0, 1, next, NULL), 0U);
+
+  long outOfOrder;
+  long unknown;
+  findStats("test_field_index", outOfOrder, unknown);
+  BOOST_CHECK_EQUAL(outOfOrder, 1);
+  BOOST_CHECK_EQUAL(unknown, 2);
+}
+
+BOOST_AUTO_TEST_CASE( test_generated_read ) {
+  // Fields backwards, with an unknown one between
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  TBinaryProtocol prot(buf);
+  prot.writeStructBegin("Bonk");
+  prot.writeFieldBegin("message", T_STRING, 2);
+  prot.writeString(std::string("backwards"));
+  prot.writeFieldEnd();
+  prot.writeFieldBegin("unknown", T_I64, 3000);
+  prot.writeI64(1);
+  prot.writeFieldEnd();
+  prot.writeFieldBegin("type", T_I32, 1);
+  prot.writeI32(7);
+  prot.writeFieldEnd();
+  prot.writeFieldStop();
+  prot.writeStructEnd();
+
+  long outOfOrder;
+  long unknown;
+  findStats("Bonk", outOfOrder, unknown);
+
+  Bonk bonk;
+  bonk.read(&prot);
+  BOOST_CHECK_EQUAL(bonk.message, "backwards");
+  BOOST_CHECK_EQUAL(bonk.type, 7);
+  BOOST_CHECK_EQUAL(buf->available_read(), 0U);
+
+#ifdef THRIFT_FIELD_STATS
+  long outOfOrder2;
+  long unknown2;
+  findStats("Bonk", outOfOrder2, unknown2);
+  BOOST_CHECK_EQUAL(outOfOrder2, outOfOrder + 1);
+  BOOST_CHECK_EQUAL(unknown2, unknown + 1);
+#endif
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,153 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/auto_unit_test.hpp>
+#include <thrift/TFieldMask.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include "gen-cpp/DebugProtoTest_types.h"
+
+using apache::thrift::TException;
+using apache::thrift::TFieldMask;
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TCompactProtocol;
+using apache::thrift::protocol::TProtocolException;
+using apache::thrift::transport::TMemoryBuffer;
+using boost::shared_ptr;
+using namespace thrift::test::debug;
+
+namespace {
+
+Nesting makeNesting() {
+  Nesting n;
+  n.my_bonk.type = 31337;
+  n.my_bonk.message = "bonk";
+  n.my_ooe.im_true = true;
+  n.my_ooe.integer32 = -7;
+  n.my_ooe.integer64 = 1;
+  n.my_ooe.some_characters = "skipped";
+  n.my_ooe.i16_list.push_back(4);
+  return n;
+}
+
+/*
+ * Reads a serialized Nesting back through a mask, checking that the whole
+ * struct is consumed whatever the mask.
+ */
+template <class Protocol_>
+Nesting project(const Nesting& in, const TFieldMask& mask) {
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  Protocol_ prot(buf);
+  uint32_t written = in.write(&prot);
+
+  Nesting out;
+  BOOST_CHECK_EQUAL(out.readFields(&prot, mask), written);
+  BOOST_CHECK_EQUAL(buf->available_read(), 0U);
+  return out;
+}
+
+template <class Protocol_>
+void checkProjection() {
+  Nesting in = makeNesting();
+
+  Nesting out = project<Protocol_>(
+    in, TFieldMask::fromPaths<Nesting>("my_bonk.message, my_ooe.integer32"));
+  BOOST_CHECK_EQUAL(out.my_bonk.message, "bonk");
+  BOOST_CHECK_EQUAL(out.my_bonk.type, 0);
+  BOOST_CHECK_EQUAL(out.my_ooe.integer32, -7);
+  BOOST_CHECK(!out.my_ooe.im_true);
+  BOOST_CHECK_EQUAL(out.my_ooe.integer64, OneOfEach().integer64);
+  BOOST_CHECK(out.my_ooe.some_characters.empty());
+  BOOST_CHECK(out.my_ooe.i16_list == OneOfEach().i16_list);
+
+  // A struct field named alone is read whole
+  out = project<Protocol_>(in, TFieldMask::fromPaths<Nesting>("my_ooe"));
+  BOOST_CHECK(out.my_ooe == in.my_ooe);
+  BOOST_CHECK(out.my_bonk == Bonk());
+
+  out = project<Protocol_>(in, TFieldMask::all());
+  BOOST_CHECK(out == in);
+
+  out = project<Protocol_>(in, TFieldMask());
+  BOOST_CHECK(out == Nesting());
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE( FieldMaskTest )
+
+BOOST_AUTO_TEST_CASE( test_binary ) {
+  checkProjection<TBinaryProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE( test_compact ) {
+  checkProjection<TCompactProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE( test_mask ) {
+  TFieldMask mask;
+  BOOST_CHECK(!mask.includes(1));
+  mask.add(1).add(100).addNested(-3).add(2);
+  BOOST_CHECK(mask.includes(1));
+  BOOST_CHECK(mask.includes(100));
+  BOOST_CHECK(mask.includes(-3));
+  BOOST_CHECK(!mask.includes(2));
+  BOOST_CHECK(mask.nested(1).isAll());
+  BOOST_CHECK(mask.nested(-3).includes(2));
+  BOOST_CHECK(!mask.nested(-3).includes(1));
+
+  // Copies are independent
+  TFieldMask copy(mask);
+  copy.addNested(-3).add(1);
+  BOOST_CHECK(copy.nested(-3).includes(1));
+  BOOST_CHECK(!mask.nested(-3).includes(1));
+
+  // Including a whole field wins over a nested mask, in either order
+  mask.add(-3);
+  BOOST_CHECK(mask.nested(-3).isAll());
+  mask.addNested(-3).add(5);
+  BOOST_CHECK(mask.nested(-3).isAll());
+
+  BOOST_CHECK(TFieldMask::all().includes(12345));
+  BOOST_CHECK(TFieldMask::all().nested(1).isAll());
+}
+
+BOOST_AUTO_TEST_CASE( test_unknown_paths ) {
+  BOOST_CHECK_THROW(TFieldMask::fromPaths<Nesting>("nope"), TException);
+  BOOST_CHECK_THROW(TFieldMask::fromPaths<Nesting>("my_bonk.nope"), TException);
+  BOOST_CHECK_THROW(TFieldMask::fromPaths<Nesting>("my_bonk.message.length"), TException);
+  BOOST_CHECK_NO_THROW(TFieldMask::fromPaths<Nesting>(" , my_bonk ,"));
+}
+
+BOOST_AUTO_TEST_CASE( test_required_fields ) {
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  TBinaryProtocol prot(buf);
+  Empty().write(&prot);
+  Empty().write(&prot);
+
+  // A required field only has to be present if it was asked for
+  StructWithASomemap s;
+  BOOST_CHECK_NO_THROW(s.readFields(&prot, TFieldMask()));
+  BOOST_CHECK_THROW(
+    s.readFields(&prot, TFieldMask::fromPaths<StructWithASomemap>("somemap_field")),
+    TProtocolException);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
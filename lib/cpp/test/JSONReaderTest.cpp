@@ -0,0 +1,106 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/auto_unit_test.hpp>
+#include <thrift/protocol/TJSONProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/DebugProtoTest_types.h"
+
+using apache::thrift::protocol::TJSONProtocol;
+using apache::thrift::transport::TBufferedTransport;
+using apache::thrift::transport::TMemoryBuffer;
+using apache::thrift::transport::TTransport;
+using boost::shared_ptr;
+using namespace thrift::test::debug;
+
+namespace {
+
+HolyMoley makeHolyMoley() {
+  HolyMoley hm;
+  OneOfEach ooe;
+  ooe.integer64 = -1234567890123LL;
+  ooe.double_precision = 1.0 / 3.0;
+  ooe.some_characters.assign(5000, 'x');
+  ooe.some_characters += "\"quoted\" \\ and \t tabbed";
+  ooe.zomg_unicode = "\xd3\x80\xe2\x85\xae";
+  ooe.base64.assign(1001, '\xfe');
+  hm.big.push_back(ooe);
+  ooe.a_bite = 1;
+  ooe.some_characters = "\"";
+  ooe.base64 = "ab";
+  hm.big.push_back(ooe);
+
+  std::vector<std::string> strings;
+  strings.push_back("");
+  strings.push_back("\\\\");
+  hm.contain.insert(strings);
+
+  std::vector<Bonk> bonks(1);
+  bonks[0].type = -3;
+  bonks[0].message = "the raven";
+  hm.bonks["poe"] = bonks;
+  return hm;
+}
+
+std::string serialize(const HolyMoley& hm) {
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  TJSONProtocol prot(buf);
+  hm.write(&prot);
+  return buf->getBufferAsString();
+}
+
+/*
+ * Reads json back through trans, which is fed from a memory buffer, and
+ * checks that it is consumed exactly.
+ */
+void checkRead(const HolyMoley& hm, const std::string& json,
+               shared_ptr<TTransport> trans) {
+  TJSONProtocol prot(trans);
+  HolyMoley hm2;
+  BOOST_CHECK_EQUAL(hm2.read(&prot), json.size());
+  BOOST_CHECK(hm2 == hm);
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE( JSONReaderTest )
+
+BOOST_AUTO_TEST_CASE( test_memory_buffer ) {
+  // Everything can be borrowed at once
+  HolyMoley hm = makeHolyMoley();
+  std::string json = serialize(hm);
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  buf->write((const uint8_t*)json.data(), static_cast<uint32_t>(json.size()));
+  checkRead(hm, json, buf);
+  BOOST_CHECK_EQUAL(buf->available_read(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE( test_buffer_boundaries ) {
+  // Small read buffers put tokens across the ends of what can be borrowed
+  HolyMoley hm = makeHolyMoley();
+  std::string json = serialize(hm);
+  for (uint32_t size = 1; size < 40; size += 3) {
+    shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+    buf->write((const uint8_t*)json.data(), static_cast<uint32_t>(json.size()));
+    shared_ptr<TBufferedTransport> trans(new TBufferedTransport(buf, size));
+    checkRead(hm, json, trans);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
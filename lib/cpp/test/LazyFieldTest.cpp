@@ -0,0 +1,176 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/auto_unit_test.hpp>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/TJSONProtocol.h>
+#include "gen-cpp/LazyFieldTest_types.h"
+
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TCompactProtocol;
+using apache::thrift::protocol::TJSONProtocol;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::transport::TMemoryBuffer;
+using boost::shared_ptr;
+using namespace thrift::test::debug;
+
+namespace {
+
+LazyNesting makeLazyNesting() {
+  LazyNesting ln;
+  ln.id = 17;
+  OneOfEach& ooe = ln.mutable_my_ooe();
+  ooe.im_true = true;
+  ooe.integer32 = -4;
+  ooe.some_characters = "lazy";
+  ooe.i16_list.push_back(3);
+  for (int i = 0; i < 3; ++i) {
+    Bonk bonk;
+    bonk.type = i;
+    bonk.message = "bonk";
+    ln.mutable_bonks().push_back(bonk);
+  }
+  HolyMoley hm;
+  hm.big.push_back(ln.get_my_ooe());
+  hm.bonks["more"] = ln.get_bonks();
+  std::map<std::string, HolyMoley> moleys;
+  moleys["hm"] = hm;
+  ln.__set_moleys(moleys);
+  ln.last = true;
+  return ln;
+}
+
+template <class Protocol_>
+std::string serialize(const LazyNesting& ln) {
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  Protocol_ prot(buf);
+  uint32_t size = ln.serializedSize(&prot);
+  ln.write(&prot);
+  BOOST_CHECK_EQUAL(size, buf->available_read());
+  return buf->getBufferAsString();
+}
+
+template <class Protocol_>
+LazyNesting deserialize(const std::string& data) {
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  buf->write(reinterpret_cast<const uint8_t*>(data.data()),
+             static_cast<uint32_t>(data.size()));
+  Protocol_ prot(buf);
+  LazyNesting ln;
+  ln.read(&prot);
+  BOOST_CHECK_EQUAL(buf->available_read(), 0U);
+  return ln;
+}
+
+template <class Protocol_>
+void checkRoundTrip() {
+  LazyNesting orig = makeLazyNesting();
+  std::string data = serialize<Protocol_>(orig);
+
+  LazyNesting ln = deserialize<Protocol_>(data);
+  BOOST_CHECK_EQUAL(ln.id, 17);
+  BOOST_CHECK(ln.last);
+  BOOST_CHECK(ln.__isset.moleys);
+  BOOST_CHECK(ln.__is_raw_my_ooe());
+  BOOST_CHECK(ln.__is_raw_bonks());
+  BOOST_CHECK(ln.__is_raw_moleys());
+
+  // Untouched fields are copied back out byte for byte
+  BOOST_CHECK(serialize<Protocol_>(ln) == data);
+  BOOST_CHECK(ln.__is_raw_bonks());
+
+  // and decoded on first access
+  BOOST_CHECK_EQUAL(ln.get_bonks().size(), 3U);
+  BOOST_CHECK(!ln.__is_raw_bonks());
+  BOOST_CHECK(ln.get_bonks() == orig.get_bonks());
+  BOOST_CHECK(ln.get_my_ooe() == orig.get_my_ooe());
+  BOOST_CHECK(ln == orig);
+  BOOST_CHECK(serialize<Protocol_>(ln) == data);
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE( LazyFieldTest )
+
+BOOST_AUTO_TEST_CASE( test_binary ) {
+  checkRoundTrip<TBinaryProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE( test_compact ) {
+  checkRoundTrip<TCompactProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE( test_other_protocol ) {
+  LazyNesting orig = makeLazyNesting();
+  LazyNesting ln = deserialize<TBinaryProtocol>(serialize<TBinaryProtocol>(orig));
+
+  // Raw binary bytes are re-encoded for any other protocol
+  std::string compact = serialize<TCompactProtocol>(ln);
+  BOOST_CHECK(compact == serialize<TCompactProtocol>(orig));
+  BOOST_CHECK(deserialize<TCompactProtocol>(compact) == orig);
+
+  // Protocols without raw values decode eagerly
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  TJSONProtocol json(buf);
+  orig.write(&json);
+  LazyNesting fromJson;
+  fromJson.read(&json);
+  BOOST_CHECK(!fromJson.__is_raw_my_ooe());
+  BOOST_CHECK(fromJson.get_my_ooe() == orig.get_my_ooe());
+  BOOST_CHECK(fromJson == orig);
+}
+
+BOOST_AUTO_TEST_CASE( test_modify ) {
+  LazyNesting orig = makeLazyNesting();
+  std::string data = serialize<TCompactProtocol>(orig);
+
+  // Setting a field drops its raw bytes
+  LazyNesting ln = deserialize<TCompactProtocol>(data);
+  ln.__set_bonks(std::vector<Bonk>());
+  BOOST_CHECK(!ln.__is_raw_bonks());
+  BOOST_CHECK(deserialize<TCompactProtocol>(serialize<TCompactProtocol>(ln)).get_bonks().empty());
+
+  // So does changing it through mutable_
+  ln = deserialize<TCompactProtocol>(data);
+  ln.mutable_my_ooe().integer32 = 99;
+  LazyNesting copy = deserialize<TCompactProtocol>(serialize<TCompactProtocol>(ln));
+  BOOST_CHECK_EQUAL(copy.get_my_ooe().integer32, 99);
+  BOOST_CHECK(copy.get_moleys() == orig.get_moleys());
+}
+
+BOOST_AUTO_TEST_CASE( test_copy_and_swap ) {
+  LazyNesting orig = makeLazyNesting();
+  std::string data = serialize<TBinaryProtocol>(orig);
+  LazyNesting ln = deserialize<TBinaryProtocol>(data);
+
+  LazyNesting copy(ln);
+  BOOST_CHECK(copy.__is_raw_moleys());
+  BOOST_CHECK(serialize<TBinaryProtocol>(copy) == data);
+
+  LazyNesting other;
+  swap(other, copy);
+  BOOST_CHECK(!copy.__is_raw_moleys());
+  BOOST_CHECK(other.__is_raw_moleys());
+  BOOST_CHECK(other == orig);
+  BOOST_CHECK(copy == LazyNesting());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
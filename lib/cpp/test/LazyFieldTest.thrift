@@ -0,0 +1,32 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+// cpp.lazy fields for LazyFieldTest.cpp
+
+include "DebugProtoTest.thrift"
+
+namespace cpp thrift.test.debug
+
+struct LazyNesting {
+  1: i32 id,
+  2: DebugProtoTest.OneOfEach my_ooe (cpp.lazy = "true"),
+  3: list<DebugProtoTest.Bonk> bonks (cpp.lazy = "true"),
+  4: optional map<string,DebugProtoTest.HolyMoley> moleys (cpp.lazy = "true"),
+  5: bool last,
+}
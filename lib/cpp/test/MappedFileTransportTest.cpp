@@ -0,0 +1,227 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/auto_unit_test.hpp>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <thrift/transport/TFileTransport.h>
+#include <thrift/transport/TMappedFileTransport.h>
+
+using namespace apache::thrift::transport;
+
+namespace {
+
+const uint32_t CHUNK_SIZE = 1024;
+
+// A log file, and its index, removed at the end of the test
+class TempLog {
+ public:
+  TempLog() {
+    char path[] = "/tmp/thrift.MappedFileTransportTest.XXXXXX";
+    int fd = mkstemp(path);
+    BOOST_REQUIRE(fd >= 0);
+    close(fd);
+    path_ = path;
+  }
+
+  ~TempLog() {
+    unlink(path_.c_str());
+    unlink(TMappedFileTransport::indexPath(path_).c_str());
+  }
+
+  const std::string& path() const {
+    return path_;
+  }
+
+ private:
+  std::string path_;
+};
+
+// Event n is n bytes of n, give or take the size of a chunk
+std::string event(uint32_t n) {
+  return std::string(n % 300 + 1, static_cast<char>(n));
+}
+
+void writeEvents(const std::string& path, uint32_t first, uint32_t count) {
+  TFileTransport transport(path);
+  transport.setChunkSize(CHUNK_SIZE);
+  for (uint32_t n = first; n < first + count; ++n) {
+    std::string e = event(n);
+    transport.write(reinterpret_cast<const uint8_t*>(e.data()),
+                    static_cast<uint32_t>(e.size()));
+  }
+}
+
+// Reads the next event through read(), which stops at its end
+std::string readEvent(TFileReaderTransport& transport) {
+  uint8_t buf[512];
+  uint32_t got = transport.read(buf, sizeof(buf));
+  return std::string(reinterpret_cast<char*>(buf), got);
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE( MappedFileTransportTest )
+
+BOOST_AUTO_TEST_CASE( test_read_all_events ) {
+  TempLog log;
+  writeEvents(log.path(), 0, 500);
+
+  TMappedFileTransport transport(log.path(), CHUNK_SIZE);
+  BOOST_CHECK_EQUAL(transport.getNumEvents(), 500U);
+  for (uint32_t n = 0; n < 500; ++n) {
+    BOOST_REQUIRE_EQUAL(readEvent(transport), event(n));
+  }
+  uint8_t buf[1];
+  BOOST_CHECK_EQUAL(transport.read(buf, 1), 0U);
+  BOOST_CHECK_THROW(transport.readAll(buf, 1), TEOFException);
+}
+
+BOOST_AUTO_TEST_CASE( test_seek_like_tfiletransport ) {
+  // Seeking to any chunk gets to the same event as it does with
+  // TFileTransport, which scans for it
+  TempLog log;
+  writeEvents(log.path(), 0, 500);
+
+  TFileTransport scanned(log.path(), true);
+  scanned.setChunkSize(CHUNK_SIZE);
+  TMappedFileTransport mapped(log.path(), CHUNK_SIZE);
+  BOOST_REQUIRE_EQUAL(mapped.getNumChunks(), scanned.getNumChunks());
+  BOOST_CHECK(mapped.getNumChunks() > 10);
+
+  for (int32_t chunk = static_cast<int32_t>(mapped.getNumChunks()) - 2; chunk >= 0; chunk -= 3) {
+    scanned.seekToChunk(chunk);
+    mapped.seekToChunk(chunk);
+    BOOST_CHECK_EQUAL(mapped.getCurChunk(), static_cast<uint32_t>(chunk));
+    BOOST_CHECK_EQUAL(readEvent(mapped), readEvent(scanned));
+  }
+
+  mapped.seekToChunk(-1);
+  BOOST_CHECK_EQUAL(mapped.getCurChunk(), mapped.getNumChunks() - 1);
+  mapped.seekToEnd();
+  BOOST_CHECK(!mapped.peek());
+
+  mapped.seekToEvent(123);
+  BOOST_CHECK_EQUAL(mapped.getCurEvent(), 123U);
+  BOOST_CHECK_EQUAL(readEvent(mapped), event(123));
+}
+
+BOOST_AUTO_TEST_CASE( test_borrow ) {
+  TempLog log;
+  writeEvents(log.path(), 0, 3);
+
+  TMappedFileTransport transport(log.path(), CHUNK_SIZE);
+  uint32_t len = 1;
+  const uint8_t* data = transport.borrow(NULL, &len);
+  BOOST_REQUIRE(data != NULL);
+  BOOST_CHECK_EQUAL(std::string(reinterpret_cast<const char*>(data), len), event(0));
+
+  // Borrowing does not cross events
+  transport.consume(len - 1);
+  len = 2;
+  BOOST_CHECK(transport.borrow(NULL, &len) == NULL);
+  transport.consume(1);
+  BOOST_CHECK_THROW(transport.consume(1), TTransportException);
+
+  len = 1;
+  data = transport.borrow(NULL, &len);
+  BOOST_REQUIRE(data != NULL);
+  BOOST_CHECK_EQUAL(std::string(reinterpret_cast<const char*>(data), len), event(1));
+}
+
+BOOST_AUTO_TEST_CASE( test_cached_index ) {
+  TempLog log;
+  writeEvents(log.path(), 0, 200);
+  {
+    TMappedFileTransport transport(log.path(), CHUNK_SIZE);
+    BOOST_CHECK_EQUAL(transport.getNumEvents(), 200U);
+  }
+  BOOST_CHECK_EQUAL(access(TMappedFileTransport::indexPath(log.path()).c_str(), R_OK), 0);
+
+  // Only the new events are scanned for, after the cached ones
+  writeEvents(log.path(), 200, 100);
+  {
+    TMappedFileTransport transport(log.path(), CHUNK_SIZE);
+    BOOST_CHECK_EQUAL(transport.getNumEvents(), 300U);
+    transport.seekToEvent(150);
+    BOOST_CHECK_EQUAL(readEvent(transport), event(150));
+    transport.seekToEvent(250);
+    BOOST_CHECK_EQUAL(readEvent(transport), event(250));
+  }
+
+  // An index that does not fit the log is rebuilt
+  FILE* index = fopen(TMappedFileTransport::indexPath(log.path()).c_str(), "r+b");
+  BOOST_REQUIRE(index != NULL);
+  // the second offset, out of order with the third
+  fseek(index, 64, SEEK_SET);
+  fputc(0x7f, index);
+  fclose(index);
+  {
+    TMappedFileTransport transport(log.path(), CHUNK_SIZE);
+    BOOST_CHECK_EQUAL(transport.getNumEvents(), 300U);
+    for (uint32_t n = 0; n < 300; ++n) {
+      BOOST_REQUIRE_EQUAL(readEvent(transport), event(n));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE( test_rewritten_log ) {
+  // A log rewritten in place keeps its inode, and here its size and its
+  // last event too, but not the events at the start of its chunks
+  TempLog log;
+  writeEvents(log.path(), 1, 2);
+  writeEvents(log.path(), 10, 100);
+  {
+    TMappedFileTransport transport(log.path(), CHUNK_SIZE);
+    BOOST_CHECK_EQUAL(transport.getNumEvents(), 102U);
+  }
+
+  BOOST_REQUIRE_EQUAL(truncate(log.path().c_str(), 0), 0);
+  writeEvents(log.path(), 2, 1);
+  writeEvents(log.path(), 1, 1);
+  writeEvents(log.path(), 10, 100);
+  {
+    TMappedFileTransport transport(log.path(), CHUNK_SIZE);
+    BOOST_CHECK_EQUAL(transport.getNumEvents(), 102U);
+    BOOST_CHECK_EQUAL(readEvent(transport), event(2));
+    BOOST_CHECK_EQUAL(readEvent(transport), event(1));
+    BOOST_CHECK_EQUAL(readEvent(transport), event(10));
+  }
+}
+
+BOOST_AUTO_TEST_CASE( test_appended_events ) {
+  // Events written after the end is reached are read
+  TempLog log;
+  writeEvents(log.path(), 0, 10);
+
+  TMappedFileTransport transport(log.path(), CHUNK_SIZE);
+  for (uint32_t n = 0; n < 10; ++n) {
+    BOOST_REQUIRE_EQUAL(readEvent(transport), event(n));
+  }
+  BOOST_CHECK(!transport.peek());
+
+  writeEvents(log.path(), 10, 10);
+  for (uint32_t n = 10; n < 20; ++n) {
+    BOOST_REQUIRE_EQUAL(readEvent(transport), event(n));
+  }
+  BOOST_CHECK_EQUAL(transport.getNumEvents(), 20U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,461 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Compares the TNonblockingServer IO backends with many mostly idle
+ * connections.  For each backend and connection count it reports:
+ *
+ *   connect  time to open all connections
+ *   sweep    requests/s when every connection sends one request in turn,
+ *            i.e. every connection goes through read -> write -> read
+ *   hot      requests/s and mean latency on a few busy connections while
+ *            all the others sit idle
+ *   storm    new connections/s while several client threads keep
+ *            connecting, making one request and resetting the connection
+ *
+ * Usage: NonblockingServerBenchmark [--io-threads=N] [--workers=N]
+ *                                   [--payload=BYTES] [--zerocopy=BYTES]
+ *                                   [--reuse-port] [--pin] [connections ...]
+ * (default connection counts: 10000 50000 100000).  Counts are clamped to
+ * what RLIMIT_NOFILE allows; raise it (ulimit -n) for the larger runs.
+ * With --workers calls are processed on a ThreadManager pool instead of the
+ * IO threads.  --payload makes every reply carry that many bytes, and
+ * --zerocopy sets the server's zero-copy threshold.  --reuse-port adds rows
+ * ("+rp") where every IO thread accepts on its own SO_REUSEPORT socket.
+ * --pin pins the IO threads to the CPUs the benchmark may run on, and with
+ * --workers also gives each of their NUMA nodes that many workers of its own.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <thrift/concurrency/PlatformThreadFactory.h>
+#include <thrift/concurrency/ThreadManager.h>
+#include <thrift/concurrency/Util.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/server/TNonblockingServer.h>
+#include <thrift/transport/TBufferTransports.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace apache::thrift;
+using namespace apache::thrift::concurrency;
+using namespace apache::thrift::protocol;
+using namespace apache::thrift::server;
+using namespace apache::thrift::transport;
+using boost::shared_ptr;
+
+static void discardOutput(const char* /* msg */) {}
+
+static double now() {
+  timeval tv;
+  THRIFT_GETTIMEOFDAY(&tv, 0);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/** Answers every call with a reply carrying payloadSize bytes. */
+class PingProcessor : public TProcessor {
+ public:
+  explicit PingProcessor(size_t payloadSize) : payload_(payloadSize, 'x') {}
+
+  virtual bool process(shared_ptr<TProtocol> in,
+                       shared_ptr<TProtocol> out,
+                       void* /* connectionContext */) {
+    std::string name;
+    TMessageType type;
+    int32_t seqid;
+    in->readMessageBegin(name, type, seqid);
+    in->skip(T_STRUCT);
+    in->readMessageEnd();
+    in->getTransport()->readEnd();
+
+    out->writeMessageBegin(name, T_REPLY, seqid);
+    out->writeStructBegin("ping_result");
+    if (!payload_.empty()) {
+      out->writeFieldBegin("success", T_STRING, 0);
+      out->writeBinary(payload_);
+      out->writeFieldEnd();
+    }
+    out->writeFieldStop();
+    out->writeStructEnd();
+    out->writeMessageEnd();
+    out->getTransport()->writeEnd();
+    out->getTransport()->flush();
+    return true;
+  }
+
+ private:
+  std::string payload_;
+};
+
+/** A framed "ping" call, ready to be sent on a raw socket. */
+static std::string makeRequest() {
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  TBinaryProtocol prot(buf);
+  prot.writeMessageBegin("ping", T_CALL, 1);
+  prot.writeStructBegin("ping_args");
+  prot.writeFieldStop();
+  prot.writeStructEnd();
+  prot.writeMessageEnd();
+
+  std::string body = buf->getBufferAsString();
+  uint32_t frameSize = htonl(static_cast<uint32_t>(body.size()));
+  return std::string(reinterpret_cast<const char*>(&frameSize), 4) + body;
+}
+
+static bool sendAll(int fd, const std::string& data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t n = send(fd, data.data() + sent, data.size() - sent, 0);
+    if (n <= 0) {
+      return false;
+    }
+    sent += n;
+  }
+  return true;
+}
+
+static bool recvAll(int fd, uint8_t* buf, size_t len) {
+  size_t got = 0;
+  while (got < len) {
+    ssize_t n = recv(fd, buf + got, len - got, 0);
+    if (n <= 0) {
+      return false;
+    }
+    got += n;
+  }
+  return true;
+}
+
+static bool readReply(int fd, std::vector<uint8_t>& buf) {
+  uint32_t frameSize;
+  if (!recvAll(fd, reinterpret_cast<uint8_t*>(&frameSize), 4)) {
+    return false;
+  }
+  frameSize = ntohl(frameSize);
+  if (frameSize > buf.size()) {
+    buf.resize(frameSize);
+  }
+  return recvAll(fd, &buf[0], frameSize);
+}
+
+/**
+ * Connect to the server on loopback.  Source addresses are spread over
+ * 127.0.0.0/8 so we don't run out of ephemeral ports above ~28k connections.
+ */
+static int connectTo(int port, int index) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  sockaddr_in src;
+  memset(&src, 0, sizeof(src));
+  src.sin_family = AF_INET;
+  src.sin_addr.s_addr = htonl(0x7f000001 + index / 20000);
+  if (bind(fd, reinterpret_cast<sockaddr*>(&src), sizeof(src)) < 0) {
+    ::close(fd);
+    return -1;
+  }
+
+  sockaddr_in dst;
+  memset(&dst, 0, sizeof(dst));
+  dst.sin_family = AF_INET;
+  dst.sin_port = htons(static_cast<uint16_t>(port));
+  dst.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, reinterpret_cast<sockaddr*>(&dst), sizeof(dst)) < 0) {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static size_t maxConnections() {
+  rlimit rl;
+  if (getrlimit(RLIMIT_NOFILE, &rl) != 0) {
+    return 0;
+  }
+  // try to make room for server and client side of every connection
+  rl.rlim_cur = rl.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &rl);
+  getrlimit(RLIMIT_NOFILE, &rl);
+  return rl.rlim_cur > 256 ? (rl.rlim_cur - 256) / 2 : 0;
+}
+
+/** Close without leaving the connection in TIME_WAIT. */
+static void abortConnection(int fd) {
+  struct linger ling = {1, 0};
+  setsockopt(fd, SOL_SOCKET, SO_LINGER, &ling, sizeof(ling));
+  ::close(fd);
+}
+
+/** One client thread of the reconnect storm. */
+class StormClient : public Runnable {
+ public:
+  StormClient(int port, int firstIndex, size_t numConnections)
+    : port_(port),
+      firstIndex_(firstIndex),
+      numConnections_(numConnections),
+      request_(makeRequest()),
+      buf_(256),
+      completed_(0) {}
+
+  void run() {
+    for (size_t i = 0; i < numConnections_; ++i) {
+      int fd = connectTo(port_, firstIndex_ + static_cast<int>(i));
+      if (fd < 0) {
+        continue;
+      }
+      if (sendAll(fd, request_) && readReply(fd, buf_)) {
+        ++completed_;
+      }
+      abortConnection(fd);
+    }
+  }
+
+  size_t getCompleted() const { return completed_; }
+
+ private:
+  int port_;
+  int firstIndex_;
+  size_t numConnections_;
+  std::string request_;
+  std::vector<uint8_t> buf_;
+  size_t completed_;
+};
+
+static void runOne(const char* backendName,
+                   TNonblockingIOBackend backend,
+                   size_t numIOThreads,
+                   size_t numWorkers,
+                   size_t payloadSize,
+                   size_t zeroCopyThreshold,
+                   bool reusePort,
+                   const std::vector<int>& ioThreadCpus,
+                   size_t numConnections,
+                   int port) {
+  shared_ptr<TNonblockingServer> server(
+    new TNonblockingServer(shared_ptr<TProcessor>(new PingProcessor(payloadSize)), port));
+  server->setIOBackend(backend);
+  server->setNumIOThreads(numIOThreads);
+  server->setZeroCopyThreshold(zeroCopyThreshold);
+  server->setReusePort(reusePort);
+  server->setIOThreadCpus(ioThreadCpus);
+
+  shared_ptr<ThreadManager> threadManager;
+  if (numWorkers > 0) {
+    threadManager = ThreadManager::newSimpleThreadManager(numWorkers);
+    threadManager->threadFactory(
+      shared_ptr<PlatformThreadFactory>(new PlatformThreadFactory()));
+    threadManager->start();
+    server->setThreadManager(threadManager);
+    if (!ioThreadCpus.empty()) {
+      server->setNumaWorkerThreads(numWorkers);
+    }
+  }
+
+  PlatformThreadFactory threadFactory;
+  threadFactory.setDetached(false);
+  shared_ptr<Thread> serverThread = threadFactory.newThread(server);
+  serverThread->start();
+
+  // wait for the server to listen
+  int probe = -1;
+  for (int i = 0; i < 500 && probe < 0; ++i) {
+    usleep(10000);
+    probe = connectTo(port, 0);
+  }
+  if (probe < 0) {
+    fprintf(stderr, "server did not come up on port %d\n", port);
+    exit(1);
+  }
+  abortConnection(probe);
+
+  std::vector<int> fds;
+  fds.reserve(numConnections);
+  double start = now();
+  for (size_t i = 0; i < numConnections; ++i) {
+    int fd = connectTo(port, static_cast<int>(i));
+    if (fd < 0) {
+      fprintf(stderr, "connect #%lu failed: %s\n", (unsigned long)i, strerror(errno));
+      break;
+    }
+    fds.push_back(fd);
+  }
+  double connectTime = now() - start;
+
+  const std::string request = makeRequest();
+  std::vector<uint8_t> replyBuf(256);
+
+  // sweep: every connection makes a request, in batches
+  const size_t kBatch = 256;
+  const int kRounds = 3;
+  size_t sweepRequests = 0;
+  start = now();
+  for (int round = 0; round < kRounds; ++round) {
+    for (size_t b = 0; b < fds.size(); b += kBatch) {
+      size_t e = std::min(fds.size(), b + kBatch);
+      for (size_t i = b; i < e; ++i) {
+        sendAll(fds[i], request);
+      }
+      for (size_t i = b; i < e; ++i) {
+        if (readReply(fds[i], replyBuf)) {
+          ++sweepRequests;
+        }
+      }
+    }
+  }
+  double sweepTime = now() - start;
+
+  // hot: a handful of busy connections among the idle ones
+  const size_t kHot = std::min(fds.size(), static_cast<size_t>(16));
+  const int kHotRounds = 5000;
+  size_t hotRequests = 0;
+  start = now();
+  for (int round = 0; round < kHotRounds; ++round) {
+    for (size_t i = 0; i < kHot; ++i) {
+      sendAll(fds[i], request);
+    }
+    for (size_t i = 0; i < kHot; ++i) {
+      if (readReply(fds[i], replyBuf)) {
+        ++hotRequests;
+      }
+    }
+  }
+  double hotTime = now() - start;
+
+  for (size_t i = 0; i < fds.size(); ++i) {
+    abortConnection(fds[i]);
+  }
+
+  // storm: short-lived connections from several threads at once
+  const int kStormThreads = 4;
+  const size_t kStormConnections = 2000;
+  std::vector<shared_ptr<StormClient> > clients;
+  std::vector<shared_ptr<Thread> > clientThreads;
+  start = now();
+  for (int t = 0; t < kStormThreads; ++t) {
+    clients.push_back(shared_ptr<StormClient>(
+      new StormClient(port, t * static_cast<int>(kStormConnections), kStormConnections)));
+    clientThreads.push_back(threadFactory.newThread(clients.back()));
+    clientThreads.back()->start();
+  }
+  size_t stormConnections = 0;
+  for (int t = 0; t < kStormThreads; ++t) {
+    clientThreads[t]->join();
+    stormConnections += clients[t]->getCompleted();
+  }
+  double stormTime = now() - start;
+
+  printf("%-11s %8lu %10.3f %14.0f %12.0f %12.1f %12.0f\n",
+         backendName,
+         (unsigned long)fds.size(),
+         connectTime,
+         sweepRequests / sweepTime,
+         hotRequests / hotTime,
+         hotRequests ? hotTime * 1000000.0 * kHot / hotRequests : 0.0,
+         stormConnections / stormTime);
+  fflush(stdout);
+  server->stop();
+  serverThread->join();
+  if (threadManager) {
+    threadManager->stop();
+  }
+}
+
+int main(int argc, char** argv) {
+  size_t numIOThreads = 1;
+  size_t numWorkers = 0;
+  size_t payloadSize = 0;
+  size_t zeroCopyThreshold = 0;
+  bool reusePort = false;
+  std::vector<int> ioThreadCpus;
+  std::vector<size_t> counts;
+  for (int i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], "--io-threads=", 13) == 0) {
+      numIOThreads = static_cast<size_t>(atoi(argv[i] + 13));
+    } else if (strncmp(argv[i], "--workers=", 10) == 0) {
+      numWorkers = static_cast<size_t>(atoi(argv[i] + 10));
+    } else if (strncmp(argv[i], "--payload=", 10) == 0) {
+      payloadSize = static_cast<size_t>(atol(argv[i] + 10));
+    } else if (strncmp(argv[i], "--zerocopy=", 11) == 0) {
+      zeroCopyThreshold = static_cast<size_t>(atol(argv[i] + 11));
+    } else if (strcmp(argv[i], "--reuse-port") == 0) {
+      reusePort = true;
+    } else if (strcmp(argv[i], "--pin") == 0) {
+      Util::getCurrentThreadCpus(ioThreadCpus);
+    } else {
+      counts.push_back(static_cast<size_t>(atol(argv[i])));
+    }
+  }
+  if (counts.empty()) {
+    counts.push_back(10000);
+    counts.push_back(50000);
+    counts.push_back(100000);
+  }
+
+  // keep the server quiet, it logs every connection count change
+  GlobalOutput.setOutputFunction(discardOutput);
+
+  size_t limit = maxConnections();
+  printf("%-11s %8s %10s %14s %12s %12s %12s\n",
+         "backend", "conns", "connect_s", "sweep_req/s", "hot_req/s", "hot_avg_us",
+         "storm_conn/s");
+
+  int port = 19100;
+  for (size_t c = 0; c < counts.size(); ++c) {
+    size_t n = counts[c];
+    if (n > limit) {
+      fprintf(stderr, "clamping %lu connections to %lu (RLIMIT_NOFILE)\n",
+              (unsigned long)n, (unsigned long)limit);
+      n = limit;
+    }
+    runOne("libevent", T_IO_BACKEND_LIBEVENT, numIOThreads, numWorkers,
+           payloadSize, zeroCopyThreshold, false, ioThreadCpus, n, port++);
+#ifdef HAVE_SYS_EPOLL_H
+    runOne("epoll", T_IO_BACKEND_EPOLL, numIOThreads, numWorkers,
+           payloadSize, zeroCopyThreshold, false, ioThreadCpus, n, port++);
+#endif
+    if (reusePort) {
+      runOne("libevent+rp", T_IO_BACKEND_LIBEVENT, numIOThreads, numWorkers,
+             payloadSize, zeroCopyThreshold, true, ioThreadCpus, n, port++);
+#ifdef HAVE_SYS_EPOLL_H
+      runOne("epoll+rp", T_IO_BACKEND_EPOLL, numIOThreads, numWorkers,
+             payloadSize, zeroCopyThreshold, true, ioThreadCpus, n, port++);
+#endif
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,217 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/auto_unit_test.hpp>
+#include <locale.h>
+#include <math.h>
+#include <string.h>
+#include <limits>
+#include <string>
+#include <thrift/protocol/TNumberUtils.h>
+#include <thrift/protocol/TJSONProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+
+using apache::thrift::protocol::kMaxNumberChars;
+using apache::thrift::protocol::number_format_integer;
+using apache::thrift::protocol::number_format_double;
+using apache::thrift::protocol::number_parse_double;
+using apache::thrift::protocol::TJSONProtocol;
+using apache::thrift::protocol::TProtocolException;
+using apache::thrift::transport::TMemoryBuffer;
+
+namespace {
+
+std::string formatInteger(int64_t value) {
+  char buf[kMaxNumberChars];
+  return std::string(buf, number_format_integer(value, buf));
+}
+
+std::string formatDouble(double value) {
+  char buf[kMaxNumberChars];
+  return std::string(buf, number_format_double(value, buf));
+}
+
+bool parseDouble(const std::string& str, double& value) {
+  return number_parse_double(str.data(), static_cast<uint32_t>(str.size()), value);
+}
+
+// Formats value and checks that it reads back bit for bit
+void checkRoundTrip(double value) {
+  std::string str = formatDouble(value);
+  double back = 0;
+  BOOST_REQUIRE_MESSAGE(parseDouble(str, back), str);
+  BOOST_CHECK_MESSAGE(memcmp(&back, &value, sizeof(value)) == 0, str);
+}
+
+boost::shared_ptr<TJSONProtocol> jsonReader(const std::string& text) {
+  boost::shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  buf->write((const uint8_t*)text.data(), static_cast<uint32_t>(text.size()));
+  return boost::shared_ptr<TJSONProtocol>(new TJSONProtocol(buf));
+}
+
+/**
+ * Sets LC_NUMERIC to a locale with a decimal comma for the life of the
+ * object, if one is installed.
+ */
+class CommaLocale {
+ public:
+  CommaLocale() : set_(false) {
+    const char* names[] = { "de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8", "de_DE", NULL };
+    for (int i = 0; names[i] != NULL && !set_; ++i) {
+      set_ = (setlocale(LC_NUMERIC, names[i]) != NULL);
+    }
+  }
+  ~CommaLocale() {
+    setlocale(LC_NUMERIC, "C");
+  }
+  bool isSet() const {
+    return set_;
+  }
+
+ private:
+  bool set_;
+};
+
+}
+
+BOOST_AUTO_TEST_SUITE( NumberUtilsTest )
+
+BOOST_AUTO_TEST_CASE( test_format_integer ) {
+  BOOST_CHECK_EQUAL(formatInteger(0), "0");
+  BOOST_CHECK_EQUAL(formatInteger(7), "7");
+  BOOST_CHECK_EQUAL(formatInteger(-31337), "-31337");
+  BOOST_CHECK_EQUAL(formatInteger((std::numeric_limits<int64_t>::max)()),
+                    "9223372036854775807");
+  BOOST_CHECK_EQUAL(formatInteger((std::numeric_limits<int64_t>::min)()),
+                    "-9223372036854775808");
+}
+
+BOOST_AUTO_TEST_CASE( test_format_double ) {
+  BOOST_CHECK_EQUAL(formatDouble(0.0), "0");
+  BOOST_CHECK_EQUAL(formatDouble(-0.0), "-0");
+  BOOST_CHECK_EQUAL(formatDouble(42.0), "42");
+  BOOST_CHECK_EQUAL(formatDouble(0.1), "0.1");
+  BOOST_CHECK_EQUAL(formatDouble(-2.5), "-2.5");
+  BOOST_CHECK_EQUAL(formatDouble(1e300), "1e+300");
+  BOOST_CHECK_EQUAL(formatDouble(1e-5), "1e-05");
+  BOOST_CHECK_EQUAL(formatDouble(1.25e-4), "0.000125");
+  BOOST_CHECK_EQUAL(formatDouble(1e17), "1e+17");
+
+  checkRoundTrip(10.0 / 3.0);
+  checkRoundTrip(M_PI);
+  checkRoundTrip(1e-305);
+  checkRoundTrip(4.9406564584124654e-324);
+  checkRoundTrip((std::numeric_limits<double>::max)());
+  checkRoundTrip((std::numeric_limits<double>::min)());
+
+  // A spread of bit patterns across the whole range
+  uint64_t bits = 0x123456789abcdefULL;
+  for (int i = 0; i < 100000; ++i) {
+    bits = bits * 6364136223846793005ULL + 1442695040888963407ULL;
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    if (value == value && value != HUGE_VAL && value != -HUGE_VAL) {
+      checkRoundTrip(value);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE( test_parse_double ) {
+  double value = 0;
+  BOOST_CHECK(parseDouble("0.1", value) && value == 0.1);
+  BOOST_CHECK(parseDouble("-12.5e2", value) && value == -1250.0);
+  BOOST_CHECK(parseDouble("1E-2", value) && value == 0.01);
+  BOOST_CHECK(parseDouble("0.000000000000000000000000001", value) && value == 1e-27);
+  BOOST_CHECK(parseDouble("123456789012345678901234567890", value) &&
+              value == 123456789012345678901234567890.0);
+  BOOST_CHECK(parseDouble("1e-400", value) && value == 0.0);
+
+  BOOST_CHECK(!parseDouble("", value));
+  BOOST_CHECK(!parseDouble("-", value));
+  BOOST_CHECK(!parseDouble(".", value));
+  BOOST_CHECK(!parseDouble("1e", value));
+  BOOST_CHECK(!parseDouble("1.2.3", value));
+  BOOST_CHECK(!parseDouble("1,5", value));
+  BOOST_CHECK(!parseDouble("1e400", value));
+}
+
+BOOST_AUTO_TEST_CASE( test_locale ) {
+  CommaLocale locale;
+  if (!locale.isSet()) {
+    BOOST_TEST_MESSAGE("No locale with a decimal comma installed");
+    return;
+  }
+
+  BOOST_CHECK_EQUAL(formatDouble(0.1), "0.1");
+  BOOST_CHECK_EQUAL(formatDouble(1.5e-300), "1.5e-300");
+  double value = 0;
+  BOOST_CHECK(parseDouble("0.1", value) && value == 0.1);
+  BOOST_CHECK(parseDouble("0.30000000000000004", value) && value == 0.1 + 0.2);
+  BOOST_CHECK(!parseDouble("0,1", value));
+}
+
+BOOST_AUTO_TEST_CASE( test_json_numbers ) {
+  boost::shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  TJSONProtocol prot(buf);
+
+  prot.writeI64((std::numeric_limits<int64_t>::min)());
+  prot.writeByte(-128);
+  prot.writeDouble(0.1);
+  prot.writeDouble(HUGE_VAL);
+  BOOST_CHECK_EQUAL(buf->getBufferAsString(),
+                    "-9223372036854775808-1280.1\"Infinity\"");
+
+  int64_t i64;
+  int8_t byte;
+  double dub;
+  jsonReader("-9223372036854775808 ")->readI64(i64);
+  BOOST_CHECK_EQUAL(i64, (std::numeric_limits<int64_t>::min)());
+  jsonReader("2.5e-3 ")->readDouble(dub);
+  BOOST_CHECK_EQUAL(dub, 2.5e-3);
+
+  // Values out of range of the field type are errors, not wrapped
+  BOOST_CHECK_THROW(jsonReader("128 ")->readByte(byte), TProtocolException);
+  BOOST_CHECK_THROW(jsonReader("9223372036854775808 ")->readI64(i64),
+                    TProtocolException);
+  BOOST_CHECK_THROW(jsonReader("1.5 ")->readI64(i64), TProtocolException);
+}
+
+BOOST_AUTO_TEST_CASE( test_json_string_escapes ) {
+  boost::shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  TJSONProtocol prot(buf);
+
+  // Long enough to cover both whole 16 byte blocks and the tail
+  std::string in("plain text that needs no escaping at all, \"then\" a quote,"
+                 " a \\ backslash, a\ttab and\x01 a control character");
+  in += '\x7f';
+  in += "\xc3\xa9";
+  prot.writeString(in);
+
+  std::string json = buf->getBufferAsString();
+  BOOST_CHECK(json.find("\\\"then\\\"") != std::string::npos);
+  BOOST_CHECK(json.find(" \\\\ backslash") != std::string::npos);
+  BOOST_CHECK(json.find("a\\ttab") != std::string::npos);
+  BOOST_CHECK(json.find("\\u0001") != std::string::npos);
+
+  std::string out;
+  prot.readString(out);
+  BOOST_CHECK_EQUAL(out, in);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,196 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/auto_unit_test.hpp>
+#include <limits>
+#include <vector>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/TJSONProtocol.h>
+
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TCompactProtocol;
+using apache::thrift::protocol::TJSONProtocol;
+using apache::thrift::protocol::TProtocolException;
+using apache::thrift::protocol::TType;
+using apache::thrift::protocol::T_DOUBLE;
+using apache::thrift::protocol::T_I32;
+using apache::thrift::protocol::T_I64;
+using apache::thrift::transport::TBufferedTransport;
+using apache::thrift::transport::TMemoryBuffer;
+using boost::shared_ptr;
+
+namespace {
+
+std::vector<int32_t> i32Values() {
+  std::vector<int32_t> values;
+  values.push_back(0);
+  values.push_back(-1);
+  values.push_back(std::numeric_limits<int32_t>::min());
+  values.push_back(std::numeric_limits<int32_t>::max());
+  for (int32_t i = 0; i < 2000; ++i) {
+    values.push_back(i * 7919 - 1000000);
+  }
+  return values;
+}
+
+std::vector<int64_t> i64Values() {
+  std::vector<int64_t> values;
+  values.push_back(0);
+  values.push_back(-1);
+  values.push_back(std::numeric_limits<int64_t>::min());
+  values.push_back(std::numeric_limits<int64_t>::max());
+  for (int64_t i = 0; i < 2000; ++i) {
+    values.push_back(i * 1000003 * 1000003 - 50);
+  }
+  return values;
+}
+
+std::vector<double> doubleValues() {
+  std::vector<double> values;
+  values.push_back(0.0);
+  values.push_back(-0.5);
+  values.push_back(std::numeric_limits<double>::max());
+  for (int i = 0; i < 2000; ++i) {
+    values.push_back(i / 3.0);
+  }
+  return values;
+}
+
+/*
+ * Writes the arrays in bulk and checks that the bytes match writing each
+ * element on its own, then reads them back in bulk through a transport with
+ * a read buffer of the given size, so small sizes exercise the refills.
+ */
+template <class Protocol_>
+void checkArrays(uint32_t readBufferSize) {
+  std::vector<int32_t> i32s = i32Values();
+  std::vector<int64_t> i64s = i64Values();
+  std::vector<double> doubles = doubleValues();
+
+  shared_ptr<TMemoryBuffer> bulk(new TMemoryBuffer());
+  Protocol_ bulkProt(bulk);
+  uint32_t written = 0;
+  written += bulkProt.writeListBegin(T_I32, static_cast<uint32_t>(i32s.size()));
+  written += bulkProt.writeI32Array(&i32s[0], static_cast<uint32_t>(i32s.size()));
+  written += bulkProt.writeListEnd();
+  written += bulkProt.writeListBegin(T_I64, static_cast<uint32_t>(i64s.size()));
+  written += bulkProt.writeI64Array(&i64s[0], static_cast<uint32_t>(i64s.size()));
+  written += bulkProt.writeListEnd();
+  written += bulkProt.writeListBegin(T_DOUBLE, static_cast<uint32_t>(doubles.size()));
+  written += bulkProt.writeDoubleArray(&doubles[0], static_cast<uint32_t>(doubles.size()));
+  written += bulkProt.writeListEnd();
+  BOOST_CHECK_EQUAL(written, bulk->available_read());
+
+  shared_ptr<TMemoryBuffer> single(new TMemoryBuffer());
+  Protocol_ singleProt(single);
+  singleProt.writeListBegin(T_I32, static_cast<uint32_t>(i32s.size()));
+  for (size_t i = 0; i < i32s.size(); ++i) {
+    singleProt.writeI32(i32s[i]);
+  }
+  singleProt.writeListEnd();
+  singleProt.writeListBegin(T_I64, static_cast<uint32_t>(i64s.size()));
+  for (size_t i = 0; i < i64s.size(); ++i) {
+    singleProt.writeI64(i64s[i]);
+  }
+  singleProt.writeListEnd();
+  singleProt.writeListBegin(T_DOUBLE, static_cast<uint32_t>(doubles.size()));
+  for (size_t i = 0; i < doubles.size(); ++i) {
+    singleProt.writeDouble(doubles[i]);
+  }
+  singleProt.writeListEnd();
+  BOOST_CHECK(bulk->getBufferAsString() == single->getBufferAsString());
+
+  shared_ptr<TBufferedTransport> buffered(
+      new TBufferedTransport(bulk, readBufferSize));
+  Protocol_ readProt(buffered);
+  std::vector<int32_t> i32sRead(i32s.size());
+  std::vector<int64_t> i64sRead(i64s.size());
+  std::vector<double> doublesRead(doubles.size());
+  TType elemType;
+  uint32_t size;
+  uint32_t read = 0;
+  read += readProt.readListBegin(elemType, size);
+  BOOST_REQUIRE_EQUAL(size, i32sRead.size());
+  read += readProt.readI32Array(&i32sRead[0], size);
+  read += readProt.readListEnd();
+  read += readProt.readListBegin(elemType, size);
+  BOOST_REQUIRE_EQUAL(size, i64sRead.size());
+  read += readProt.readI64Array(&i64sRead[0], size);
+  read += readProt.readListEnd();
+  read += readProt.readListBegin(elemType, size);
+  BOOST_REQUIRE_EQUAL(size, doublesRead.size());
+  read += readProt.readDoubleArray(&doublesRead[0], size);
+  read += readProt.readListEnd();
+  BOOST_CHECK_EQUAL(read, written);
+  BOOST_CHECK(i32sRead == i32s);
+  BOOST_CHECK(i64sRead == i64s);
+  BOOST_CHECK(doublesRead == doubles);
+}
+
+/**
+ * Read one i32 varint from the given bytes, either through readI32Array or
+ * through readI32.
+ */
+int32_t readCompactI32(const uint8_t* bytes, uint32_t len, bool bulk) {
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer(len));
+  buffer->write(bytes, len);
+  TCompactProtocol prot(buffer);
+  int32_t value = 0;
+  if (bulk) {
+    prot.readI32Array(&value, 1);
+  } else {
+    prot.readI32(value);
+  }
+  return value;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE( ProtocolArrayTest )
+
+BOOST_AUTO_TEST_CASE( test_binary ) {
+  checkArrays<TBinaryProtocol>(512);
+  checkArrays<TBinaryProtocol>(13);
+}
+
+BOOST_AUTO_TEST_CASE( test_compact ) {
+  checkArrays<TCompactProtocol>(512);
+  checkArrays<TCompactProtocol>(13);
+}
+
+BOOST_AUTO_TEST_CASE( test_compact_varint_limit ) {
+  // zigzag(INT32_MIN) takes the full 5 bytes; a sixth byte is malformed
+  // whichever path reads it.
+  const uint8_t longest[] = { 0xff, 0xff, 0xff, 0xff, 0x0f };
+  const uint8_t overlong[] = { 0x80, 0x80, 0x80, 0x80, 0x80, 0x00 };
+  for (int bulk = 0; bulk < 2; ++bulk) {
+    BOOST_CHECK_EQUAL(readCompactI32(longest, sizeof(longest), bulk != 0),
+                      std::numeric_limits<int32_t>::min());
+    BOOST_CHECK_THROW(readCompactI32(overlong, sizeof(overlong), bulk != 0),
+                      TProtocolException);
+  }
+}
+
+BOOST_AUTO_TEST_CASE( test_default_loop ) {
+  checkArrays<TJSONProtocol>(512);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
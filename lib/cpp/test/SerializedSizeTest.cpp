@@ -0,0 +1,196 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/auto_unit_test.hpp>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/TJSONProtocol.h>
+#include "gen-cpp/DebugProtoTest_types.h"
+
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TCompactProtocol;
+using apache::thrift::protocol::TJSONProtocol;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::protocol::TProtocolException;
+using apache::thrift::protocol::T_REPLY;
+using apache::thrift::transport::TFramedTransport;
+using apache::thrift::transport::TMemoryBuffer;
+using boost::shared_ptr;
+using namespace thrift::test::debug;
+
+namespace {
+
+OneOfEach makeOneOfEach() {
+  OneOfEach ooe;
+  ooe.im_true = true;
+  ooe.integer16 = -27000;
+  ooe.integer32 = 1 << 24;
+  ooe.integer64 = -6000LL * 1000 * 1000;
+  ooe.double_precision = 3.141592653589793;
+  ooe.some_characters = "some characters";
+  ooe.zomg_unicode = "\xd7\n\a\t";
+  ooe.base64 = std::string(300, 'x');
+  ooe.i16_list.push_back(-1);
+  return ooe;
+}
+
+/*
+ * Checks that serializedSize() predicts exactly the bytes write() puts on
+ * the wire.
+ */
+template <class Protocol_, class Struct_>
+void checkSize(const Struct_& s) {
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  Protocol_ prot(buf);
+  BOOST_REQUIRE(prot.hasSerializedSize());
+
+  uint32_t expected = s.serializedSize(&prot);
+  s.write(&prot);
+  BOOST_CHECK_EQUAL(expected, buf->available_read());
+
+  // The same again through the virtual TProtocol interface.
+  TProtocol* vprot = &prot;
+  BOOST_CHECK_EQUAL(s.serializedSize(vprot), expected);
+}
+
+template <class Protocol_>
+void checkAllStructs() {
+  checkSize<Protocol_>(Empty());
+  checkSize<Protocol_>(makeOneOfEach());
+
+  HolyMoley hm;
+  hm.big.push_back(makeOneOfEach());
+  hm.big.push_back(OneOfEach());
+  std::vector<std::string> words;
+  words.push_back("then");
+  words.push_back("a");
+  hm.contain.insert(words);
+  hm.bonks["nothing"];
+  hm.bonks["something"].push_back(Bonk());
+  checkSize<Protocol_>(hm);
+
+  // Bools folded into compact field headers, plus every container shape.
+  CompactProtoTestStruct cpts;
+  cpts.a_byte = 127;
+  cpts.a_i64 = 1LL << 62;
+  cpts.true_field = true;
+  cpts.false_field = false;
+  cpts.boolean_list.push_back(true);
+  cpts.boolean_list.push_back(false);
+  cpts.string_set.insert("first");
+  cpts.struct_set.insert(Empty());
+  cpts.i64_byte_map[-1] = 1;
+  cpts.byte_boolean_map[1] = true;
+  cpts.byte_map_map[0];
+  cpts.byte_map_map[1][2] = 3;
+  cpts.list_byte_map[std::vector<int8_t>(20, 7)] = 0;
+  checkSize<Protocol_>(cpts);
+
+  // Field id gaps too large for the compact delta encoding.
+  BigFieldIdStruct big;
+  big.field1 = "one";
+  big.field2 = "forty-five";
+  checkSize<Protocol_>(big);
+
+  // Implicit (negative) field ids and optional fields.
+  TupleProtocolTestStruct tuple;
+  tuple.__set_field1(1);
+  tuple.__set_field3(-300000);
+  tuple.__set_field12(0);
+  checkSize<Protocol_>(tuple);
+
+  // Numeric lists long enough for the compact long-form list header.
+  CompactProtoTestStruct lists;
+  for (int i = 0; i < 40; ++i) {
+    lists.i32_list.push_back(i * 1000003);
+    lists.i64_list.push_back(-static_cast<int64_t>(i) << 40);
+    lists.double_list.push_back(i / 3.0);
+  }
+  checkSize<Protocol_>(lists);
+
+  TestUnion u;
+  u.__set_i32_set(std::set<int32_t>());
+  u.i32_set.insert(-5);
+  u.i32_set.insert(1 << 30);
+  checkSize<Protocol_>(u);
+}
+
+template <class Protocol_>
+void checkMessageBegin() {
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  Protocol_ prot(buf);
+  uint32_t expected = prot.serializedSizeMessageBegin("someMethod", T_REPLY, 1 << 20);
+  prot.writeMessageBegin("someMethod", T_REPLY, 1 << 20);
+  BOOST_CHECK_EQUAL(expected, buf->available_read());
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE( SerializedSizeTest )
+
+BOOST_AUTO_TEST_CASE( test_binary ) {
+  checkAllStructs<TBinaryProtocol>();
+  checkMessageBegin<TBinaryProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE( test_compact ) {
+  checkAllStructs<TCompactProtocol>();
+  checkMessageBegin<TCompactProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE( test_unsupported_protocol ) {
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  TJSONProtocol prot(buf);
+  BOOST_CHECK(!prot.hasSerializedSize());
+  BOOST_CHECK_THROW(makeOneOfEach().serializedSize(&prot), TProtocolException);
+}
+
+BOOST_AUTO_TEST_CASE( test_memory_buffer_reserve ) {
+  TMemoryBuffer buf(16);
+  buf.write((const uint8_t*)"0123456789", 10);
+  buf.reserveWrite(1000);
+
+  uint8_t* before = NULL;
+  uint32_t len = 0;
+  buf.getBuffer(&before, &len);
+  BOOST_CHECK_EQUAL(len, 10U);
+
+  // Writing exactly what was reserved must not move the buffer.
+  std::string payload(1000, 'p');
+  buf.write((const uint8_t*)payload.data(), 1000);
+  uint8_t* after = NULL;
+  buf.getBuffer(&after, &len);
+  BOOST_CHECK(after == before);
+  BOOST_CHECK_EQUAL(len, 1010U);
+}
+
+BOOST_AUTO_TEST_CASE( test_framed_reserve ) {
+  shared_ptr<TMemoryBuffer> sink(new TMemoryBuffer());
+  TFramedTransport framed(sink, 64);
+  framed.write((const uint8_t*)"abc", 3);
+  framed.reserveWrite(5000);
+
+  std::string payload(5000, 'q');
+  framed.write((const uint8_t*)payload.data(), 5000);
+  framed.flush();
+  BOOST_CHECK_EQUAL(sink->available_read(), 4U + 5003U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,140 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/auto_unit_test.hpp>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/TJSONProtocol.h>
+#include "gen-cpp/DebugProtoTest_types.h"
+
+using apache::thrift::TStringView;
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TCompactProtocol;
+using apache::thrift::protocol::TJSONProtocol;
+using apache::thrift::protocol::TProtocolException;
+using apache::thrift::transport::TMemoryBuffer;
+using boost::shared_ptr;
+using thrift::test::debug::HolyMoley;
+using thrift::test::debug::HolyMoleyView;
+using thrift::test::debug::OneOfEach;
+using thrift::test::debug::OneOfEachView;
+
+namespace {
+
+OneOfEach makeOneOfEach() {
+  OneOfEach ooe;
+  ooe.im_true = true;
+  ooe.integer32 = 1 << 24;
+  ooe.some_characters = "some characters";
+  ooe.zomg_unicode = "\xd7\n\a\t";
+  ooe.base64 = std::string("\1\0\3\255", 4);
+  ooe.i16_list.push_back(4);
+  return ooe;
+}
+
+template <class Protocol_>
+void checkRoundtrip() {
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  Protocol_ prot(buf);
+  OneOfEach ooe = makeOneOfEach();
+  ooe.write(&prot);
+
+  OneOfEachView view;
+  view.read(&prot);
+  BOOST_CHECK_EQUAL(view.im_true, true);
+  BOOST_CHECK_EQUAL(view.integer32, 1 << 24);
+  BOOST_CHECK_EQUAL(view.some_characters, TStringView("some characters"));
+  BOOST_CHECK_EQUAL(view.zomg_unicode.str(), ooe.zomg_unicode);
+  BOOST_CHECK_EQUAL(view.base64.str(), ooe.base64);
+  BOOST_CHECK_EQUAL(view.i16_list.size(), 4U);
+  BOOST_CHECK(view.__isset.base64);
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE( StringViewTest )
+
+BOOST_AUTO_TEST_CASE( test_binary_roundtrip ) {
+  checkRoundtrip<TBinaryProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE( test_compact_roundtrip ) {
+  checkRoundtrip<TCompactProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE( test_view_points_into_buffer ) {
+  OneOfEach ooe = makeOneOfEach();
+  std::string serialized;
+  {
+    shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+    TBinaryProtocol prot(buf);
+    ooe.write(&prot);
+    serialized = buf->getBufferAsString();
+  }
+
+  shared_ptr<TMemoryBuffer> buf(
+      new TMemoryBuffer((uint8_t*)serialized.data(),
+                        static_cast<uint32_t>(serialized.size())));
+  TBinaryProtocol prot(buf);
+  OneOfEachView view;
+  view.read(&prot);
+
+  const char* begin = serialized.data();
+  const char* end = begin + serialized.size();
+  BOOST_CHECK(view.some_characters.data() > begin);
+  BOOST_CHECK(view.some_characters.end() <= end);
+  BOOST_CHECK(view.base64.data() > begin);
+  BOOST_CHECK(view.base64.end() <= end);
+}
+
+BOOST_AUTO_TEST_CASE( test_nested_containers ) {
+  HolyMoley hm;
+  hm.big.push_back(makeOneOfEach());
+  hm.big.push_back(makeOneOfEach());
+  std::vector<std::string> words;
+  words.push_back("then");
+  words.push_back("a");
+  hm.contain.insert(words);
+  hm.bonks["nothing"];
+
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  TBinaryProtocol prot(buf);
+  hm.write(&prot);
+
+  HolyMoleyView view;
+  view.read(&prot);
+  BOOST_REQUIRE_EQUAL(view.big.size(), 2U);
+  BOOST_CHECK_EQUAL(view.big[1].some_characters, TStringView("some characters"));
+  BOOST_REQUIRE_EQUAL(view.contain.size(), 1U);
+  BOOST_CHECK_EQUAL(view.contain.begin()->at(0), TStringView("then"));
+  BOOST_CHECK_EQUAL(view.bonks.count(TStringView("nothing")), 1U);
+}
+
+BOOST_AUTO_TEST_CASE( test_unsupported_protocol ) {
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  TJSONProtocol prot(buf);
+  OneOfEach ooe = makeOneOfEach();
+  ooe.write(&prot);
+
+  OneOfEachView view;
+  BOOST_CHECK_THROW(view.read(&prot), TProtocolException);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
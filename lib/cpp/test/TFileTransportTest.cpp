@@ -26,11 +26,26 @@
 #include <sys/time.h>
 #endif
 #include <getopt.h>
+#include <pthread.h>
+#include <string.h>
 #include <boost/test/unit_test.hpp>
 
+#include <algorithm>
+#include <map>
+
+#include <thrift/concurrency/PlatformThreadFactory.h>
+#include <thrift/concurrency/ThreadManager.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
 #include <thrift/transport/TFileTransport.h>
 
 using namespace apache::thrift::transport;
+using apache::thrift::concurrency::Guard;
+using apache::thrift::concurrency::PlatformThreadFactory;
+using apache::thrift::concurrency::ThreadManager;
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TBinaryProtocolFactory;
+using apache::thrift::protocol::TProtocol;
 
 /**************************************************************************
  * Global state
@@ -340,6 +355,315 @@ BOOST_AUTO_TEST_CASE(test_noop_flush) {
   }
 }
 
+/**
+ * Writer thread for test_group_commit: each event holds the thread number,
+ * the event's sequence number and a payload of varying length.
+ */
+struct GroupCommitWriter {
+  TFileTransport* transport;
+  uint32_t thread;
+  uint32_t numEvents;
+
+  static const uint32_t MAX_PAYLOAD = 300;
+
+  void run() {
+    uint8_t buf[12 + MAX_PAYLOAD];
+    for (uint32_t n = 0; n < numEvents; ++n) {
+      uint32_t len = (n * 37 + thread * 11) % MAX_PAYLOAD;
+      memcpy(buf, &thread, 4);
+      memcpy(buf + 4, &n, 4);
+      memcpy(buf + 8, &len, 4);
+      memset(buf + 12, static_cast<int>(n & 0xff), len);
+      transport->write(buf, 12 + len);
+      if (n % 100 == 99) {
+        transport->flush();
+      }
+    }
+  }
+
+  static void* start(void* arg) {
+    static_cast<GroupCommitWriter*>(arg)->run();
+    return NULL;
+  }
+};
+
+/**
+ * Make sure events written concurrently in group commit mode, across many
+ * chunks, all read back in the order each thread wrote them.
+ */
+BOOST_AUTO_TEST_CASE(test_group_commit) {
+  TempFile f(tmp_dir, "thrift.TFileTransportTest.");
+  static const uint32_t NUM_THREADS = 4;
+  static const uint32_t NUM_EVENTS = 2000;
+  static const uint32_t CHUNK_SIZE = 4096;
+
+  {
+    TFileTransport transport(f.getPath());
+    transport.setGroupCommit(true);
+    transport.setChunkSize(CHUNK_SIZE);
+    // A small ring, so that writers sometimes wait for a free slot
+    transport.setEventBufferSize(16);
+
+    GroupCommitWriter writers[NUM_THREADS];
+    pthread_t threads[NUM_THREADS];
+    for (uint32_t t = 0; t < NUM_THREADS; ++t) {
+      writers[t].transport = &transport;
+      writers[t].thread = t;
+      writers[t].numEvents = NUM_EVENTS;
+      BOOST_REQUIRE_EQUAL(pthread_create(&threads[t], NULL, GroupCommitWriter::start,
+                                         &writers[t]), 0);
+    }
+    for (uint32_t t = 0; t < NUM_THREADS; ++t) {
+      pthread_join(threads[t], NULL);
+    }
+    transport.flush();
+  }
+
+  TFileTransport reader(f.getPath(), true);
+  reader.setChunkSize(CHUNK_SIZE);
+  uint32_t expected[NUM_THREADS] = { 0 };
+  uint8_t buf[12 + GroupCommitWriter::MAX_PAYLOAD];
+  for (uint32_t i = 0; i < NUM_THREADS * NUM_EVENTS; ++i) {
+    reader.readAll(buf, 12);
+    uint32_t thread;
+    uint32_t n;
+    uint32_t len;
+    memcpy(&thread, buf, 4);
+    memcpy(&n, buf + 4, 4);
+    memcpy(&len, buf + 8, 4);
+    BOOST_REQUIRE_LT(thread, NUM_THREADS);
+    BOOST_REQUIRE_EQUAL(n, expected[thread]);
+    BOOST_REQUIRE_EQUAL(len, (n * 37 + thread * 11) % GroupCommitWriter::MAX_PAYLOAD);
+    if (len > 0) {
+      reader.readAll(buf + 12, len);
+      BOOST_CHECK_EQUAL(buf[12], static_cast<uint8_t>(n & 0xff));
+      BOOST_CHECK_EQUAL(buf[11 + len], static_cast<uint8_t>(n & 0xff));
+    }
+    ++expected[thread];
+  }
+  BOOST_CHECK(!reader.peek());
+  BOOST_CHECK(reader.getNumChunks() > 1);
+}
+
+/**
+ * Make sure flush() syncs in group commit mode, except with SYNC_NONE.
+ */
+BOOST_AUTO_TEST_CASE(test_group_commit_sync_mode) {
+  TempFile f(tmp_dir, "thrift.TFileTransportTest.");
+  FsyncLog log;
+  fsync_log = &log;
+
+  TFileTransport transport(f.getPath());
+  transport.setGroupCommit(true);
+  transport.setFlushMaxBytes(0xffffffff);
+  transport.setFlushMaxUs(0xffffffff);
+  uint8_t buf[] = "a";
+
+  transport.write(buf, 1);
+  transport.flush();
+  BOOST_CHECK_EQUAL(log.getCalls()->size(), 1U);
+
+  // Nothing new to sync
+  transport.flush();
+  BOOST_CHECK_EQUAL(log.getCalls()->size(), 1U);
+
+  transport.setSyncMode(TFileTransport::SYNC_NONE);
+  transport.write(buf, 1);
+  transport.flush();
+  BOOST_CHECK_EQUAL(log.getCalls()->size(), 1U);
+
+  fsync_log = NULL;
+}
+
+/**
+ * Processor for test_process_parallel: each message's struct holds a key and
+ * a sequence number, which it records in the order they are processed.
+ */
+class ReplayRecorder : public apache::thrift::TProcessor {
+ public:
+  ReplayRecorder(uint32_t numKeys) : seen_(numKeys) {}
+
+  bool process(boost::shared_ptr<TProtocol> in,
+               boost::shared_ptr<TProtocol> /* out */,
+               void* /* connectionContext */) {
+    std::string name;
+    apache::thrift::protocol::TMessageType type;
+    int32_t seqid;
+    int32_t key;
+    int32_t seq;
+    in->readMessageBegin(name, type, seqid);
+    std::string structName;
+    in->readStructBegin(structName);
+    std::string fieldName;
+    apache::thrift::protocol::TType fieldType;
+    int16_t fieldId;
+    in->readFieldBegin(fieldName, fieldType, fieldId);
+    in->readI32(key);
+    in->readFieldEnd();
+    in->readFieldBegin(fieldName, fieldType, fieldId);
+    in->readI32(seq);
+    in->readFieldEnd();
+    in->readFieldBegin(fieldName, fieldType, fieldId);
+    in->readStructEnd();
+    in->readMessageEnd();
+    if (name == "fail") {
+      throw TTransportException("failed on purpose");
+    }
+
+    Guard g(mutex_);
+    seen_[key].push_back(seq);
+    order_.push_back(seq);
+    return true;
+  }
+
+  std::vector<std::vector<int32_t> > seen_;
+  std::vector<int32_t> order_;
+  Mutex mutex_;
+};
+
+uint64_t replayKey(const std::string& /* name */, const uint8_t* message, uint32_t len) {
+  // the key is the first field, right after the name "replay" or "fail"
+  boost::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer(const_cast<uint8_t*>(message), len));
+  TBinaryProtocol protocol(buffer);
+  std::string name;
+  apache::thrift::protocol::TMessageType type;
+  int32_t seqid;
+  protocol.readMessageBegin(name, type, seqid);
+  std::string fieldName;
+  apache::thrift::protocol::TType fieldType;
+  int16_t fieldId;
+  int32_t key;
+  protocol.readStructBegin(fieldName);
+  protocol.readFieldBegin(fieldName, fieldType, fieldId);
+  protocol.readI32(key);
+  return static_cast<uint64_t>(key);
+}
+
+/**
+ * Make sure processParallel() processes every message of a log once, in
+ * order per chunk or per key, including messages written as several events
+ * that run over into the next chunk.
+ */
+BOOST_AUTO_TEST_CASE(test_process_parallel) {
+  TempFile f(tmp_dir, "thrift.TFileTransportTest.");
+  static const uint32_t NUM_KEYS = 7;
+  static const uint32_t NUM_MESSAGES = 3000;
+
+  {
+    TFileTransport transport(f.getPath());
+    transport.setChunkSize(4096);
+    boost::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+    TBinaryProtocol protocol(buffer);
+    for (uint32_t n = 0; n < NUM_MESSAGES; ++n) {
+      protocol.writeMessageBegin(n % 101 == 0 ? "fail" : "replay",
+                                 apache::thrift::protocol::T_ONEWAY, 0);
+      protocol.writeStructBegin("args");
+      protocol.writeFieldBegin("key", apache::thrift::protocol::T_I32, 1);
+      protocol.writeI32(static_cast<int32_t>(n % NUM_KEYS));
+      protocol.writeFieldEnd();
+      protocol.writeFieldBegin("seq", apache::thrift::protocol::T_I32, 2);
+      protocol.writeI32(static_cast<int32_t>(n));
+      protocol.writeFieldEnd();
+      protocol.writeFieldStop();
+      protocol.writeStructEnd();
+      protocol.writeMessageEnd();
+
+      uint8_t* data;
+      uint32_t len;
+      buffer->getBuffer(&data, &len);
+      if (n % 3 == 0) {
+        // as two events, which may end up in different chunks
+        transport.write(data, 10);
+        transport.write(data + 10, len - 10);
+      } else {
+        transport.write(data, len);
+      }
+      buffer->resetBuffer();
+    }
+  }
+
+  // The chunk each message ends in, which is the one it is replayed with.
+  // A read buffer the size of a chunk keeps getCurChunk() exact.
+  std::vector<uint32_t> chunkOf(NUM_MESSAGES);
+  {
+    boost::shared_ptr<TFileTransport> reader(new TFileTransport(f.getPath(), true));
+    reader->setChunkSize(4096);
+    reader->setReadBuffSize(4096);
+    reader->setReadTimeout(TFileTransport::NO_TAIL_READ_TIMEOUT);
+    boost::shared_ptr<TProtocol> in(new TBinaryProtocol(reader));
+    ReplayRecorder serial(NUM_KEYS);
+    for (uint32_t n = 0; n < NUM_MESSAGES; ++n) {
+      try {
+        serial.process(in, in, NULL);
+      } catch (TTransportException&) {
+        BOOST_REQUIRE(n % 101 == 0);
+      }
+      chunkOf[n] = reader->getCurChunk();
+    }
+    BOOST_REQUIRE_GT(chunkOf[NUM_MESSAGES - 1], 10u);
+  }
+
+  boost::shared_ptr<ThreadManager> threadManager = ThreadManager::newSimpleThreadManager(4);
+  threadManager->threadFactory(boost::shared_ptr<PlatformThreadFactory>(new PlatformThreadFactory()));
+  threadManager->start();
+
+  for (int order = TFileProcessor::REPLAY_CHUNK_ORDER;
+       order <= TFileProcessor::REPLAY_KEY_ORDER;
+       ++order) {
+    boost::shared_ptr<TFileTransport> reader(new TFileTransport(f.getPath(), true));
+    reader->setChunkSize(4096);
+    // a read buffer that runs over chunk boundaries, unless kept to them
+    reader->setReadBuffSize(3000);
+    boost::shared_ptr<ReplayRecorder> recorder(new ReplayRecorder(NUM_KEYS));
+    TFileProcessor processor(recorder,
+                             boost::shared_ptr<TBinaryProtocolFactory>(new TBinaryProtocolFactory()),
+                             reader);
+    processor.setMaxPendingChunks(3);
+    processor.processParallel(threadManager,
+                              static_cast<TFileProcessor::ReplayOrder>(order),
+                              replayKey);
+
+    TFileProcessor::ReplayStats stats = processor.getReplayStats();
+    BOOST_CHECK_EQUAL(stats.messages, NUM_MESSAGES);
+    BOOST_CHECK_EQUAL(stats.failures, (NUM_MESSAGES + 100) / 101);
+    BOOST_CHECK_EQUAL(stats.chunksDone, stats.chunksRead);
+    BOOST_CHECK(stats.chunksRead > 10);
+
+    uint32_t processed = 0;
+    for (uint32_t key = 0; key < NUM_KEYS; ++key) {
+      std::vector<int32_t> seqs = recorder->seen_[key];
+      processed += static_cast<uint32_t>(seqs.size());
+      if (order == TFileProcessor::REPLAY_KEY_ORDER) {
+        for (size_t i = 1; i < seqs.size(); ++i) {
+          BOOST_REQUIRE_LT(seqs[i - 1], seqs[i]);
+        }
+      } else {
+        std::sort(seqs.begin(), seqs.end());
+      }
+      for (size_t i = 0; i < seqs.size(); ++i) {
+        BOOST_CHECK_EQUAL(seqs[i] % static_cast<int32_t>(NUM_KEYS), static_cast<int32_t>(key));
+        BOOST_CHECK(seqs[i] % 101 != 0);
+      }
+    }
+    BOOST_CHECK_EQUAL(processed, NUM_MESSAGES - stats.failures);
+
+    if (order == TFileProcessor::REPLAY_CHUNK_ORDER) {
+      std::map<uint32_t, int32_t> lastInChunk;
+      for (size_t i = 0; i < recorder->order_.size(); ++i) {
+        int32_t seq = recorder->order_[i];
+        uint32_t chunk = chunkOf[seq];
+        std::map<uint32_t, int32_t>::iterator last = lastInChunk.find(chunk);
+        if (last != lastInChunk.end()) {
+          BOOST_REQUIRE_LT(last->second, seq);
+        }
+        lastInChunk[chunk] = seq;
+      }
+    }
+  }
+
+  threadManager->stop();
+}
+
 /**************************************************************************
  * General Initialization
  **************************************************************************/
@@ -0,0 +1,178 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/auto_unit_test.hpp>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/TJSONProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/TableCodecTest_types.h"
+
+// TableCodecTest.thrift is generated with the tables option, so all of its
+// structs but Foreign go through TTableCodec
+
+using namespace apache::thrift::protocol;
+using apache::thrift::transport::TMemoryBuffer;
+using boost::shared_ptr;
+using namespace thrift::test::tables;
+
+namespace {
+
+Complex makeComplex() {
+  Complex c;
+  c.cp_default = 1;
+  c.cp_required = -2;
+  c.req_simp.im_default = 3;
+  c.req_simp.im_required = 4;
+  Simple s;
+  s.im_required = 5;
+  s.__set_im_optional(6);
+  c.the_map[7] = s;
+  c.the_map[-8] = Simple();
+  c.__set_opt_simp(s);
+  return c;
+}
+
+OldSchool makeOldSchool() {
+  OldSchool o;
+  o.im_int = 300;
+  o.im_str = "old school";
+  std::map<int32_t, std::string> m;
+  m[1] = "one";
+  m[-100000] = std::string(1000, 'x');
+  o.im_big.push_back(m);
+  o.im_big.push_back(std::map<int32_t, std::string>());
+  return o;
+}
+
+template <class Protocol_, class Struct_>
+void checkRoundTrip(const Struct_& value) {
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  Protocol_ prot(buf);
+  uint32_t written = value.write(&prot);
+  BOOST_CHECK_EQUAL(written, buf->available_read());
+
+  Struct_ value2;
+  BOOST_CHECK_EQUAL(value2.read(&prot), written);
+  BOOST_CHECK(value2 == value);
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE( TableCodecTest )
+
+BOOST_AUTO_TEST_CASE( test_round_trip ) {
+  // Binary and compact have codecs of their own, JSON uses the TProtocol one
+  checkRoundTrip<TBinaryProtocol>(makeComplex());
+  checkRoundTrip<TCompactProtocol>(makeComplex());
+  checkRoundTrip<TJSONProtocol>(makeComplex());
+  checkRoundTrip<TBinaryProtocol>(makeOldSchool());
+  checkRoundTrip<TCompactProtocol>(makeOldSchool());
+  checkRoundTrip<TJSONProtocol>(makeOldSchool());
+
+  JavaTestHelper j;
+  j.req_int = 1;
+  j.req_obj = "obj";
+  j.req_bin = std::string("\0\xff", 2);
+  j.__set_opt_bin(std::string(100, '\x80'));
+  checkRoundTrip<TBinaryProtocol>(j);
+  checkRoundTrip<TJSONProtocol>(j);
+}
+
+BOOST_AUTO_TEST_CASE( test_serialized_size ) {
+  // serializedSize() is still generated, so it checks the table's encoding
+  Complex c = makeComplex();
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  TBinaryProtocol prot(buf);
+  BOOST_CHECK_EQUAL(c.write(&prot), c.serializedSize(&prot));
+  BOOST_CHECK_EQUAL(buf->available_read(), c.serializedSize(&prot));
+}
+
+BOOST_AUTO_TEST_CASE( test_optional_fields ) {
+  // Unset optional fields are left out, and left unset when read
+  Simple s;
+  s.im_required = 1;
+  s.im_optional = 2;
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  TBinaryProtocol prot(buf);
+  s.write(&prot);
+
+  Simple s2;
+  s2.read(&prot);
+  BOOST_CHECK(s2.__isset.im_default);
+  BOOST_CHECK(!s2.__isset.im_optional);
+  BOOST_CHECK_EQUAL(s2.im_optional, 0);
+}
+
+BOOST_AUTO_TEST_CASE( test_unknown_and_unordered_fields ) {
+  // Fields out of order, of an unknown id or of the wrong type
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  TCompactProtocol prot(buf);
+  prot.writeStructBegin("Simple");
+  prot.writeFieldBegin("im_optional", T_I16, 3);
+  prot.writeI16(30);
+  prot.writeFieldEnd();
+  prot.writeFieldBegin("unknown", T_STRING, 9);
+  prot.writeString("skipped");
+  prot.writeFieldEnd();
+  prot.writeFieldBegin("im_default", T_I32, 1);
+  prot.writeI32(10);
+  prot.writeFieldEnd();
+  prot.writeFieldBegin("im_required", T_I16, 2);
+  prot.writeI16(20);
+  prot.writeFieldEnd();
+  prot.writeFieldStop();
+  prot.writeStructEnd();
+
+  Simple s;
+  s.read(&prot);
+  BOOST_CHECK_EQUAL(buf->available_read(), 0U);
+  BOOST_CHECK(!s.__isset.im_default);
+  BOOST_CHECK_EQUAL(s.im_required, 20);
+  BOOST_CHECK(s.__isset.im_optional);
+  BOOST_CHECK_EQUAL(s.im_optional, 30);
+}
+
+BOOST_AUTO_TEST_CASE( test_missing_required ) {
+  // An unset optional field is not written, so the required one is missing
+  Tricky2 t2;
+  t2.im_optional = 1;
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  TBinaryProtocol prot(buf);
+  t2.write(&prot);
+
+  Tricky3 t3;
+  BOOST_CHECK_THROW(t3.read(&prot), TProtocolException);
+}
+
+BOOST_AUTO_TEST_CASE( test_foreign_struct ) {
+  // A struct holding one from an included IDL is read and written by
+  // generated code, beside structs that use tables
+  Foreign f;
+  f.id = 9;
+  thrift::test::Simple s;
+  s.im_required = 2;
+  s.__set_im_optional(3);
+  f.simples.push_back(s);
+  f.simples.push_back(thrift::test::Simple());
+  checkRoundTrip<TBinaryProtocol>(f);
+  checkRoundTrip<TCompactProtocol>(f);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
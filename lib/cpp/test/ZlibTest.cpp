@@ -326,6 +326,102 @@ void test_no_write() {
   BOOST_CHECK_EQUAL(membuf->available_read(), (uint32_t) 0);
 }
 
+void test_pooled_streams(const uint8_t* buf, uint32_t buf_len) {
+  boost::shared_ptr<TZlibStreamPool> pool(new TZlibStreamPool());
+  TZlibTransportFactory factory(pool, 4096);
+
+  for (int i = 0; i < 3; ++i) {
+    boost::shared_ptr<TMemoryBuffer> membuf(new TMemoryBuffer());
+    {
+      boost::shared_ptr<TTransport> w_trans = factory.getTransport(membuf);
+      w_trans->write(buf, buf_len);
+      w_trans->flush();
+      // unflushed data is discarded when the stream goes back to the pool
+      w_trans->write(buf, buf_len);
+    }
+    {
+      boost::shared_ptr<TTransport> r_trans = factory.getTransport(membuf);
+      boost::shared_array<uint8_t> mirror(new uint8_t[buf_len]);
+      uint32_t got = r_trans->readAll(mirror.get(), buf_len);
+      BOOST_REQUIRE_EQUAL(got, buf_len);
+      BOOST_CHECK_EQUAL(memcmp(mirror.get(), buf, buf_len), 0);
+    }
+
+    // A deflate and an inflate stream, initialized the first time only
+    BOOST_CHECK_EQUAL(pool->getNumCreated(), (uint64_t) 2);
+    BOOST_CHECK_EQUAL(pool->getIdleCount(), (size_t) 2);
+  }
+
+  // Streams at another level are kept apart
+  TZlibTransportFactory fast_factory(pool, 4096, Z_BEST_SPEED);
+  boost::shared_ptr<TMemoryBuffer> membuf(new TMemoryBuffer());
+  fast_factory.getTransport(membuf);
+  BOOST_CHECK_EQUAL(pool->getNumCreated(), (uint64_t) 3);
+  BOOST_CHECK_EQUAL(pool->getIdleCount(), (size_t) 3);
+}
+
+void test_reset_per_frame(const uint8_t* buf, uint32_t buf_len) {
+  boost::shared_ptr<TZlibStreamPool> pool(new TZlibStreamPool());
+  boost::shared_ptr<TMemoryBuffer> membuf(new TMemoryBuffer());
+  boost::shared_ptr<TZlibTransport> w_zlib_trans(
+    new TZlibTransport(membuf,
+                       TZlibTransport::DEFAULT_URBUF_SIZE,
+                       TZlibTransport::DEFAULT_CRBUF_SIZE,
+                       TZlibTransport::DEFAULT_UWBUF_SIZE,
+                       TZlibTransport::DEFAULT_CWBUF_SIZE,
+                       Z_DEFAULT_COMPRESSION,
+                       pool));
+  w_zlib_trans->setResetPerFrame(true);
+
+  // Three frames, of the first, second and last thirds of buf
+  uint32_t third = buf_len / 3;
+  w_zlib_trans->write(buf, third);
+  w_zlib_trans->flush();
+  uint32_t second_start = membuf->available_read();
+  w_zlib_trans->write(buf + third, third);
+  w_zlib_trans->flush();
+  uint32_t second_end = membuf->available_read();
+  // nothing written, so no frame
+  w_zlib_trans->flush();
+  BOOST_CHECK_EQUAL(membuf->available_read(), second_end);
+  w_zlib_trans->write(buf + 2 * third, buf_len - 2 * third);
+  w_zlib_trans->flush();
+
+  // Each frame is a stream of its own
+  std::string wire = membuf->getBufferAsString();
+  boost::shared_ptr<TMemoryBuffer> second(new TMemoryBuffer(
+      reinterpret_cast<uint8_t*>(&wire[second_start]), second_end - second_start));
+  TZlibTransport second_trans(second);
+  boost::shared_array<uint8_t> mirror(new uint8_t[buf_len]);
+  BOOST_REQUIRE_EQUAL(second_trans.readAll(mirror.get(), third), third);
+  BOOST_CHECK_EQUAL(memcmp(mirror.get(), buf + third, third), 0);
+  second_trans.verifyChecksum();
+
+  // and a reader resetting per frame reads them all
+  boost::shared_ptr<TZlibTransport> r_zlib_trans(new TZlibTransport(membuf));
+  r_zlib_trans->setResetPerFrame(true);
+  uint32_t got = r_zlib_trans->readAll(mirror.get(), buf_len);
+  BOOST_REQUIRE_EQUAL(got, buf_len);
+  BOOST_CHECK_EQUAL(memcmp(mirror.get(), buf, buf_len), 0);
+  // having checked every frame as it ended
+  r_zlib_trans->verifyChecksum();
+
+  // Without the end of the last frame the input is incomplete
+  wire.erase(wire.length() - 1);
+  boost::shared_ptr<TMemoryBuffer> truncated(new TMemoryBuffer(
+      reinterpret_cast<uint8_t*>(&wire[0]), static_cast<uint32_t>(wire.length())));
+  TZlibTransport truncated_trans(truncated);
+  truncated_trans.setResetPerFrame(true);
+  BOOST_REQUIRE_EQUAL(truncated_trans.readAll(mirror.get(), buf_len), buf_len);
+  BOOST_CHECK_EQUAL(memcmp(mirror.get(), buf, buf_len), 0);
+  try {
+    truncated_trans.verifyChecksum();
+    BOOST_ERROR("verifyChecksum() did not report an error");
+  } catch (TTransportException& ex) {
+    BOOST_CHECK_EQUAL(ex.getType(), TTransportException::CORRUPTED_DATA);
+  }
+}
+
 /*
  * Initialization
  */
@@ -349,6 +445,8 @@ void add_tests(boost::unit_test::test_suite* suite,
   ADD_TEST_CASE(suite, name, test_incomplete_checksum, buf, buf_len);
   ADD_TEST_CASE(suite, name, test_invalid_checksum, buf, buf_len);
   ADD_TEST_CASE(suite, name, test_write_after_flush, buf, buf_len);
+  ADD_TEST_CASE(suite, name, test_pooled_streams, buf, buf_len);
+  ADD_TEST_CASE(suite, name, test_reset_per_frame, buf, buf_len);
 
   boost::shared_ptr<SizeGenerator> size_32k(new ConstantSizeGenerator(1<<15));
   boost::shared_ptr<SizeGenerator> size_lognormal(new LogNormalSizeGenerator(20, 30));
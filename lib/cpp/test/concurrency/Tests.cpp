@@ -64,6 +64,12 @@ int main(int argc, char** argv) {
     std::cout << "\t\tThreadFactory monitor timeout test" << std::endl;
 
     assert(threadFactoryTests.monitorTimeoutTest());
+
+#if !defined(USE_BOOST_THREAD) && !defined(USE_STD_THREAD)
+    std::cout << "\t\tThreadFactory CPU set test" << std::endl;
+
+    assert(threadFactoryTests.cpuSetTest());
+#endif
   }
 
   if (runAll || args[0].compare("util") == 0) {
@@ -99,6 +105,29 @@ int main(int argc, char** argv) {
     TimerManagerTests timerManagerTests;
 
     assert(timerManagerTests.test00());
+
+    std::cout << "\t\tWheelTimerManager test01" << std::endl;
+
+    assert(timerManagerTests.test01());
+  }
+
+  if (runAll || args[0].compare("timer-manager-benchmark") == 0) {
+
+    std::cout << "TimerManager benchmark..." << std::endl;
+
+    TimerManagerTests timerManagerTests;
+
+    {
+      TimerManager timerManager;
+
+      timerManagerTests.benchmark(timerManager);
+    }
+
+    {
+      WheelTimerManager timerManager;
+
+      timerManagerTests.benchmark(timerManager);
+    }
   }
 
   if (runAll || args[0].compare("thread-manager") == 0) {
@@ -123,6 +152,42 @@ int main(int argc, char** argv) {
 
       assert(threadManagerTests.blockTest(delay, workerCount));
 
+      ThreadManagerTests workStealingTests(true);
+
+      std::cout << "\t\tWork stealing ThreadManager load test: worker count: " << workerCount << " task count: " << taskCount << " delay: " << delay << std::endl;
+
+      assert(workStealingTests.loadTest(taskCount, delay, workerCount));
+
+      std::cout << "\t\tWork stealing ThreadManager block test: worker count: " << workerCount << " delay: " << delay << std::endl;
+
+      assert(workStealingTests.blockTest(delay, workerCount));
+    }
+  }
+
+  if (runAll || args[0].compare("thread-manager-contention") == 0) {
+
+    std::cout << "ThreadManager contention benchmark..." << std::endl;
+
+    {
+
+      size_t workerCount = 8;
+
+      size_t taskCount = 100000;
+
+      for (size_t producerCount = 1; producerCount <= 8; producerCount*= 2) {
+
+        std::cout << "\t\tThreadManager contention test: producer count: " << producerCount << " worker count: " << workerCount << " task count: " << producerCount * taskCount << std::endl;
+
+        ThreadManagerTests threadManagerTests;
+
+        assert(threadManagerTests.contentionTest(producerCount, taskCount, workerCount));
+
+        std::cout << "\t\tWork stealing ThreadManager contention test: producer count: " << producerCount << " worker count: " << workerCount << " task count: " << producerCount * taskCount << std::endl;
+
+        ThreadManagerTests workStealingTests(true);
+
+        assert(workStealingTests.contentionTest(producerCount, taskCount, workerCount));
+      }
     }
   }
 
@@ -27,6 +27,7 @@
 #include <unistd.h>
 #include <iostream>
 #include <set>
+#include <vector>
 
 namespace apache { namespace thrift { namespace concurrency { namespace test {
 
@@ -347,6 +348,51 @@ public:
 
     return success;
   }
+
+#if !defined(USE_BOOST_THREAD) && !defined(USE_STD_THREAD)
+  class CpuSetTask : public Runnable {
+  public:
+
+    void run() {
+      Util::getCurrentThreadCpus(_cpus);
+    }
+
+    std::vector<int> _cpus;
+  };
+
+  /**
+   * Check that threads start on the factory's CPU set
+   */
+  bool cpuSetTest() {
+
+    std::vector<int> allowed;
+
+    if (!Util::getCurrentThreadCpus(allowed) || allowed.empty()) {
+      std::cout << "\t\t\tSkipped, no thread affinity" << std::endl;
+      return true;
+    }
+
+    PlatformThreadFactory threadFactory;
+
+    threadFactory.setDetached(false);
+
+    threadFactory.setCpuSet(std::vector<int>(1, allowed.back()));
+
+    shared_ptr<CpuSetTask> task = shared_ptr<CpuSetTask>(new CpuSetTask());
+
+    shared_ptr<Thread> thread = threadFactory.newThread(task);
+
+    thread->start();
+
+    thread->join();
+
+    bool success = task->_cpus.size() == 1 && task->_cpus[0] == allowed.back();
+
+    std::cout << "\t\t\t" << (success ? "Success" : "Failure") << "!" << std::endl;
+
+    return success;
+  }
+#endif
 };
 
 const double ThreadFactoryTests::ERROR = .20;
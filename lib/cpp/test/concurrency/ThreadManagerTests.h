@@ -20,6 +20,7 @@
 #include <thrift/thrift-config.h>
 #include <thrift/concurrency/ThreadManager.h>
 #include <thrift/concurrency/PlatformThreadFactory.h>
+#include <thrift/concurrency/Atomic.h>
 #include <thrift/concurrency/Monitor.h>
 #include <thrift/concurrency/Util.h>
 
@@ -28,6 +29,7 @@
 #include <iostream>
 #include <set>
 #include <stdint.h>
+#include <vector>
 
 namespace apache { namespace thrift { namespace concurrency { namespace test {
 
@@ -44,6 +46,20 @@ public:
 
   static const double ERROR;
 
+  /**
+   * @param workStealing test newWorkStealingThreadManager instead of
+   * newSimpleThreadManager
+   */
+  ThreadManagerTests(bool workStealing=false) :
+    _workStealing(workStealing) {}
+
+  shared_ptr<ThreadManager> newThreadManager(size_t workerCount, size_t pendingTaskCountMax=0) {
+    if (_workStealing) {
+      return ThreadManager::newWorkStealingThreadManager(workerCount, pendingTaskCountMax);
+    }
+    return ThreadManager::newSimpleThreadManager(workerCount, pendingTaskCountMax);
+  }
+
   class Task: public Runnable {
 
   public:
@@ -108,7 +124,7 @@ public:
 
     size_t activeCount = count;
 
-    shared_ptr<ThreadManager> threadManager = ThreadManager::newSimpleThreadManager(workerCount);
+    shared_ptr<ThreadManager> threadManager = newThreadManager(workerCount);
 
     shared_ptr<PlatformThreadFactory> threadFactory = shared_ptr<PlatformThreadFactory>(new PlatformThreadFactory());
 
@@ -248,7 +264,7 @@ public:
 
       size_t activeCounts[] = {workerCount, pendingTaskMaxCount, 1};
 
-      shared_ptr<ThreadManager> threadManager = ThreadManager::newSimpleThreadManager(workerCount, pendingTaskMaxCount);
+      shared_ptr<ThreadManager> threadManager = newThreadManager(workerCount, pendingTaskMaxCount);
 
       shared_ptr<PlatformThreadFactory> threadFactory = shared_ptr<PlatformThreadFactory>(new PlatformThreadFactory());
 
@@ -371,6 +387,112 @@ public:
     std::cout << "\t\t\t" << (success ? "Success" : "Failure") << std::endl;
     return success;
  }
+
+  class CountTask: public Runnable {
+
+  public:
+
+    CountTask(Monitor& monitor, volatile long& count) :
+      _monitor(monitor),
+      _count(count) {}
+
+    void run() {
+      if (atomicAdd(&_count, -1) == 0) {
+        Synchronized s(_monitor);
+        _monitor.notify();
+      }
+    }
+
+    Monitor& _monitor;
+    volatile long& _count;
+  };
+
+  class Producer: public Runnable {
+
+  public:
+
+    Producer(shared_ptr<ThreadManager> threadManager, shared_ptr<Runnable> task, size_t count) :
+      _threadManager(threadManager),
+      _task(task),
+      _count(count) {}
+
+    void run() {
+      for (size_t ix = 0; ix < _count; ix++) {
+        _threadManager->add(_task);
+      }
+    }
+
+    shared_ptr<ThreadManager> _threadManager;
+    shared_ptr<Runnable> _task;
+    size_t _count;
+  };
+
+  /**
+   * Contention benchmark.  producerCount threads each add taskCount empty
+   * tasks as fast as they can, so the rate measures nothing but the cost of
+   * queueing and dispatching tasks.
+   */
+  bool contentionTest(size_t producerCount=4, size_t taskCount=100000, size_t workerCount=4) {
+
+    Monitor monitor;
+
+    volatile long activeCount = static_cast<long>(producerCount * taskCount);
+
+    shared_ptr<ThreadManager> threadManager = newThreadManager(workerCount);
+
+    shared_ptr<PlatformThreadFactory> threadFactory = shared_ptr<PlatformThreadFactory>(new PlatformThreadFactory());
+
+    threadManager->threadFactory(threadFactory);
+
+    threadManager->start();
+
+    shared_ptr<Runnable> task(new CountTask(monitor, activeCount));
+
+    PlatformThreadFactory producerFactory;
+
+    producerFactory.setDetached(false);
+
+    std::vector<shared_ptr<Thread> > producers;
+
+    for (size_t ix = 0; ix < producerCount; ix++) {
+
+      producers.push_back(producerFactory.newThread(shared_ptr<Runnable>(new Producer(threadManager, task, taskCount))));
+    }
+
+    int64_t time00 = Util::currentTime();
+
+    for (size_t ix = 0; ix < producerCount; ix++) {
+
+      producers[ix]->start();
+    }
+
+    {
+      Synchronized s(monitor);
+
+      while (activeCount > 0) {
+
+        monitor.wait();
+      }
+    }
+
+    int64_t time01 = Util::currentTime();
+
+    for (size_t ix = 0; ix < producerCount; ix++) {
+
+      producers[ix]->join();
+    }
+
+    double elapsed = time01 > time00 ? static_cast<double>(time01 - time00) : 1.0;
+
+    bool success = threadManager->pendingTaskCount() == 0;
+
+    std::cout << "\t\t\t" << (success ? "Success" : "Failure") << "! "
+              << static_cast<int64_t>(producerCount * taskCount * 1000.0 / elapsed) << " tasks/s" << std::endl;
+
+    return success;
+  }
+
+  bool _workStealing;
 };
 
 const double ThreadManagerTests::ERROR = .20;
@@ -18,12 +18,15 @@
  */
 
 #include <thrift/concurrency/TimerManager.h>
+#include <thrift/concurrency/WheelTimerManager.h>
+#include <thrift/concurrency/Atomic.h>
 #include <thrift/concurrency/PlatformThreadFactory.h>
 #include <thrift/concurrency/Monitor.h>
 #include <thrift/concurrency/Util.h>
 
 #include <assert.h>
 #include <iostream>
+#include <vector>
 
 namespace apache { namespace thrift { namespace concurrency { namespace test {
 
@@ -144,6 +147,156 @@ class TimerManagerTests {
     return true;
   }
 
+  /**
+   * This test schedules tasks on a WheelTimerManager that land in the
+   * innermost wheel and, past 256 ticks, in the next one.  It cancels one
+   * of them and verifies that the others fire on time and the cancelled one
+   * never does.
+   */
+  bool test01(int64_t timeout=100LL) {
+
+    std::vector<shared_ptr<TimerManagerTests::Task> > tasks;
+
+    shared_ptr<TimerManagerTests::Task> cancelledTask;
+
+    {
+      WheelTimerManager timerManager;
+
+      timerManager.threadFactory(shared_ptr<PlatformThreadFactory>(new PlatformThreadFactory()));
+
+      timerManager.start();
+
+      assert(timerManager.state() == TimerManager::STARTED);
+
+      Synchronized s(_monitor);
+
+      for (int64_t ix = 1; ix <= 4; ix++) {
+
+        tasks.push_back(shared_ptr<TimerManagerTests::Task>(new TimerManagerTests::Task(_monitor, ix * timeout)));
+
+        timerManager.schedule(tasks.back(), ix * timeout);
+      }
+
+      cancelledTask.reset(new TimerManagerTests::Task(_monitor, 2 * timeout));
+
+      WheelTimerManager::Handle handle = timerManager.schedule(cancelledTask, 2 * timeout);
+
+      assert(timerManager.taskCount() == tasks.size() + 1);
+
+      assert(timerManager.cancel(handle));
+
+      assert(!timerManager.cancel(handle));
+
+      while (!tasks.back()->_done) {
+        _monitor.wait();
+      }
+
+      assert(timerManager.taskCount() == 0);
+    }
+
+    bool success = !cancelledTask->_done;
+
+    for (size_t ix = 0; ix < tasks.size(); ix++) {
+      success = success && tasks[ix]->_done && tasks[ix]->_success;
+    }
+
+    std::cout << "\t\t\t" << (success ? "Success" : "Failure") << "!" << std::endl;
+
+    return success;
+  }
+
+  class CountTask: public Runnable {
+
+   public:
+
+    CountTask(Monitor& monitor, volatile long& count) :
+      _monitor(monitor),
+      _count(count) {}
+
+    void run() {
+      if (atomicAdd(&_count, -1) == 0) {
+        Synchronized s(_monitor);
+        _monitor.notifyAll();
+      }
+    }
+
+    Monitor& _monitor;
+    volatile long& _count;
+  };
+
+  /**
+   * Benchmark.  Adds count timers an hour or two out, as per-request
+   * deadlines would be, then cancels them (WheelTimerManager only, as
+   * TimerManager::remove() does nothing), then has count timers spread over
+   * the next spreadMs fire.
+   */
+  void benchmark(TimerManager& timerManager, size_t count=200000, int64_t spreadMs=200LL) {
+
+    WheelTimerManager* wheel = dynamic_cast<WheelTimerManager*>(&timerManager);
+
+    timerManager.threadFactory(shared_ptr<PlatformThreadFactory>(new PlatformThreadFactory()));
+
+    timerManager.start();
+
+    volatile long activeCount = 0;
+
+    shared_ptr<Runnable> task(new TimerManagerTests::CountTask(_monitor, activeCount));
+
+    std::vector<WheelTimerManager::Handle> handles;
+
+    handles.reserve(count);
+
+    int64_t time00 = Util::currentTimeUsec();
+
+    for (size_t ix = 0; ix < count; ix++) {
+      int64_t timeout = 3600000LL + static_cast<int64_t>(ix % 3600000);
+      if (wheel) {
+        handles.push_back(wheel->schedule(task, timeout));
+      } else {
+        timerManager.add(task, timeout);
+      }
+    }
+
+    int64_t time01 = Util::currentTimeUsec();
+
+    std::cout << "\t\t\t" << (wheel ? "WheelTimerManager" : "TimerManager") << " add: "
+              << (time01 - time00) * 1000.0 / count << "ns/timer" << std::endl;
+
+    if (wheel) {
+      for (size_t ix = 0; ix < count; ix++) {
+        wheel->cancel(handles[ix]);
+      }
+
+      int64_t time02 = Util::currentTimeUsec();
+
+      std::cout << "\t\t\tWheelTimerManager cancel: " << (time02 - time01) * 1000.0 / count << "ns/timer" << std::endl;
+    }
+
+    size_t pending = timerManager.taskCount();
+
+    activeCount = static_cast<long>(count);
+
+    time00 = Util::currentTimeUsec();
+
+    for (size_t ix = 0; ix < count; ix++) {
+      timerManager.add(task, static_cast<int64_t>(ix % spreadMs));
+    }
+
+    {
+      Synchronized s(_monitor);
+
+      while (activeCount > 0) {
+        _monitor.wait();
+      }
+    }
+
+    time01 = Util::currentTimeUsec();
+
+    std::cout << "\t\t\t" << (wheel ? "WheelTimerManager" : "TimerManager") << " fire "
+              << count << " timers over " << spreadMs << "ms with " << pending << " pending: "
+              << (time01 - time00) / 1000 << "ms" << std::endl;
+  }
+
   friend class TestTask;
 
   Monitor _monitor;